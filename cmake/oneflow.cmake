@@ -142,6 +142,9 @@ foreach(oneflow_single_file ${oneflow_all_src})
     elseif("${oneflow_single_file}" MATCHES "^${PROJECT_SOURCE_DIR}/oneflow/(core|user|xrt)/.*_test\\.cpp$")
       # test file
       list(APPEND of_all_test_cc ${oneflow_single_file})
+    elseif("${oneflow_single_file}" MATCHES "^${PROJECT_SOURCE_DIR}/oneflow/(core|user|xrt)/.*_benchmark\\.cpp$")
+      # benchmark file
+      list(APPEND of_all_benchmark_cc ${oneflow_single_file})
     elseif("${oneflow_single_file}" MATCHES "^${PROJECT_SOURCE_DIR}/oneflow/core/graph/.*\\.cpp$")
     else()
       # not test file
@@ -320,6 +323,13 @@ if(BUILD_TESTING)
   endif()
 endif()
 
+# build benchmark, not registered with ctest
+if(BUILD_BENCHMARK AND of_all_benchmark_cc)
+  oneflow_add_executable(oneflow_benchmarkexe ${of_all_benchmark_cc})
+  target_link_libraries(oneflow_benchmarkexe ${of_libs} ${oneflow_third_party_libs} ${oneflow_exe_third_party_libs})
+  set_target_properties(oneflow_benchmarkexe PROPERTIES RUNTIME_OUTPUT_DIRECTORY "${PROJECT_BINARY_DIR}/bin")
+endif()
+
 # build transport_test
 foreach(cc ${of_transport_test_cc})
   get_filename_component(transport_test_name ${cc} NAME_WE)
@@ -135,6 +135,11 @@ if(WIN32)
   list(APPEND oneflow_third_party_libs "Ws2_32.lib")
 endif()
 
+if(UNIX AND NOT APPLE)
+  # shm_open and shm_unlink of the shared memory comm net
+  list(APPEND oneflow_third_party_libs rt)
+endif()
+
 set(oneflow_third_party_dependencies
   zlib_copy_headers_to_destination
   zlib_copy_libs_to_destination
@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/actor/actor_message.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/common/varint.h"
 
 namespace oneflow {
 
@@ -63,6 +64,7 @@ ActorMsg ActorMsg::BuildRegstMsgToProducer(int64_t consumer, int64_t producer,
   msg.msg_type_ = ActorMsgType::kRegstMsg;
   msg.regst_wrapper_.regst = regst_raw_ptr;
   msg.regst_wrapper_.comm_net_token = nullptr;
+  msg.regst_wrapper_.regst_status = RegstStatus();
   // you can NOT access the regst ptr when multi nodes, because the address is in another machine
   msg.regst_wrapper_.has_sole_empty_tensor_in_sole_tensor_list = false;
   return msg;
@@ -134,4 +136,60 @@ int64_t ActorMsg::eord_regst_desc_id() const {
   return eord_regst_desc_id_;
 }
 
+void ActorMsg::EncodeToWire(std::string* buf) const {
+  AppendVarint64(ZigZagEncode64(src_actor_id_), buf);
+  AppendVarint64(ZigZagEncode64(dst_actor_id_), buf);
+  AppendVarint64(static_cast<uint64_t>(msg_type_), buf);
+  if (msg_type_ == ActorMsgType::kRegstMsg) {
+    AppendVarint64(reinterpret_cast<uintptr_t>(regst_wrapper_.regst), buf);
+    AppendVarint64(reinterpret_cast<uintptr_t>(regst_wrapper_.comm_net_token), buf);
+    AppendVarint64(ZigZagEncode64(regst_wrapper_.regst_status.regst_desc_id), buf);
+    AppendVarint64(ZigZagEncode64(regst_wrapper_.regst_status.piece_id), buf);
+    AppendVarint64(ZigZagEncode64(regst_wrapper_.regst_status.act_id), buf);
+    AppendVarint64(regst_wrapper_.has_sole_empty_tensor_in_sole_tensor_list, buf);
+  } else if (msg_type_ == ActorMsgType::kEordMsg) {
+    AppendVarint64(ZigZagEncode64(eord_regst_desc_id_), buf);
+  } else if (msg_type_ == ActorMsgType::kCmdMsg) {
+    AppendVarint64(static_cast<uint64_t>(actor_cmd_), buf);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+bool ActorMsg::DecodeFromWire(const char** ptr, const char* end) {
+  uint64_t vals[6];
+  auto ReadVarints = [&](int num) {
+    FOR_RANGE(int, i, 0, num) {
+      if (!ReadVarint64(ptr, end, &vals[i])) { return false; }
+    }
+    return true;
+  };
+  if (!ReadVarints(3)) { return false; }
+  src_actor_id_ = ZigZagDecode64(vals[0]);
+  dst_actor_id_ = ZigZagDecode64(vals[1]);
+  if (vals[2] == static_cast<uint64_t>(ActorMsgType::kRegstMsg)) {
+    msg_type_ = ActorMsgType::kRegstMsg;
+    if (!ReadVarints(6) || vals[5] > 1) { return false; }
+    regst_wrapper_.regst = reinterpret_cast<Regst*>(static_cast<uintptr_t>(vals[0]));
+    regst_wrapper_.comm_net_token = reinterpret_cast<void*>(static_cast<uintptr_t>(vals[1]));
+    regst_wrapper_.regst_status.regst_desc_id = ZigZagDecode64(vals[2]);
+    regst_wrapper_.regst_status.piece_id = ZigZagDecode64(vals[3]);
+    regst_wrapper_.regst_status.act_id = ZigZagDecode64(vals[4]);
+    regst_wrapper_.has_sole_empty_tensor_in_sole_tensor_list = vals[5] == 1;
+  } else if (vals[2] == static_cast<uint64_t>(ActorMsgType::kEordMsg)) {
+    msg_type_ = ActorMsgType::kEordMsg;
+    if (!ReadVarints(1)) { return false; }
+    eord_regst_desc_id_ = ZigZagDecode64(vals[0]);
+  } else if (vals[2] == static_cast<uint64_t>(ActorMsgType::kCmdMsg)) {
+    msg_type_ = ActorMsgType::kCmdMsg;
+    if (!ReadVarints(1) || vals[0] > static_cast<uint64_t>(ActorCmd::kConstructActor)) {
+      return false;
+    }
+    actor_cmd_ = static_cast<ActorCmd>(vals[0]);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 }  // namespace oneflow
@@ -67,6 +67,11 @@ class ActorMsg final {
     in_stream.Read(this, sizeof(ActorMsg));
   }
 
+  // Compact encoding for the network: ids, tokens and the regst status as varints, nothing of
+  // the union that the msg type does not use. DecodeFromWire returns false on malformed input.
+  void EncodeToWire(std::string* buf) const;
+  bool DecodeFromWire(const char** ptr, const char* end);
+
  private:
   struct RegstWrapper {
     Regst* regst;
@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/job/env_desc.h"
 #include "oneflow/core/job/global_for.h"
+#include "oneflow/core/common/balanced_splitter.h"
 
 #ifdef OF_PLATFORM_POSIX
 
@@ -55,14 +56,32 @@ int SockListen(int listen_sockfd, uint16_t listen_port, int32_t total_machine_nu
   return bind_result;
 }
 
-int64_t GetMachineId(const sockaddr_in& sa) {
-  char addr[INET_ADDRSTRLEN];
-  memset(addr, '\0', sizeof(addr));
-  PCHECK(inet_ntop(AF_INET, &(sa.sin_addr), addr, INET_ADDRSTRLEN));
-  for (int64_t i = 0; i < Global<ResourceDesc, ForSession>::Get()->TotalMachineNum(); ++i) {
-    if (Global<ResourceDesc, ForSession>::Get()->machine(i).addr() == addr) { return i; }
+// Sent by the connecting side right after connect(). It tells the accepting side which peer and
+// which of its connections the socket is, which the peer address alone cannot when several
+// processes share one host.
+struct ConnHandshake {
+  int64_t machine_id;
+  int64_t conn_id;
+};
+
+void SendConnHandshake(int sockfd, int64_t machine_id, int32_t conn_id) {
+  ConnHandshake handshake;
+  handshake.machine_id = machine_id;
+  handshake.conn_id = conn_id;
+  PCHECK(write(sockfd, &handshake, sizeof(handshake)) == sizeof(handshake));
+}
+
+ConnHandshake RecvConnHandshake(int sockfd) {
+  ConnHandshake handshake;
+  char* ptr = reinterpret_cast<char*>(&handshake);
+  size_t remaining = sizeof(handshake);
+  while (remaining > 0) {
+    ssize_t n = read(sockfd, ptr, remaining);
+    PCHECK(n > 0);
+    ptr += n;
+    remaining -= n;
   }
-  UNIMPLEMENTED();
+  return handshake;
 }
 
 std::string GenPortKey(int64_t machine_id) { return "EpollPort/" + std::to_string(machine_id); }
@@ -98,18 +117,53 @@ void EpollCommNet::SendActorMsg(int64_t dst_machine_id, const ActorMsg& actor_ms
   SocketMsg msg;
   msg.msg_type = SocketMsgType::kActor;
   msg.actor_msg = actor_msg;
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  GetSocketHelper(dst_machine_id, 0)->AsyncWrite(msg);
 }
 
 void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg& transport_msg) {
   SocketMsg msg;
   msg.msg_type = SocketMsgType::kTransport;
   msg.transport_msg = transport_msg;
-  SendSocketMsg(dst_machine_id, msg);
+  GetSocketHelper(dst_machine_id, 0)->AsyncWrite(msg);
+}
+
+void EpollCommNet::SendRequestReadMsgs(const RequestWriteMsg& request_write_msg) {
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(request_write_msg.src_token);
+  const int64_t body_byte = src_mem_desc->byte_size;
+  const int32_t body_conn_num = std::max(conn_num_per_peer_ - 1, 1);
+  int64_t part_num = 1;
+  if (body_conn_num > 1 && body_byte >= std::max<int64_t>(stripe_min_body_byte_, body_conn_num)) {
+    part_num = body_conn_num;
+  }
+  BalancedSplitter splitter(body_byte, part_num);
+  FOR_RANGE(int64_t, i, 0, part_num) {
+    SocketMsg msg;
+    msg.msg_type = SocketMsgType::kRequestRead;
+    msg.request_read_msg.src_token = request_write_msg.src_token;
+    msg.request_read_msg.dst_token = request_write_msg.dst_token;
+    msg.request_read_msg.read_id = request_write_msg.read_id;
+    msg.request_read_msg.offset = splitter.At(i).begin();
+    msg.request_read_msg.byte_size = splitter.At(i).size();
+    msg.request_read_msg.part_num = part_num;
+    const int32_t conn_id = part_num == 1 ? NextBodyConnId() : 1 + i;
+    GetSocketHelper(request_write_msg.dst_machine_id, conn_id)->AsyncWrite(msg);
+  }
+}
+
+void EpollCommNet::RequestReadPartDone(const RequestReadMsg& request_read_msg) {
+  if (request_read_msg.part_num > 1) {
+    std::unique_lock<std::mutex> lck(striped_read_mtx_);
+    auto it = read_id2done_part_num_.emplace(request_read_msg.read_id, 0).first;
+    it->second += 1;
+    if (it->second < request_read_msg.part_num) { return; }
+    read_id2done_part_num_.erase(it);
+  }
+  ReadDone(request_read_msg.read_id);
 }
 
-void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+int32_t EpollCommNet::NextBodyConnId() {
+  if (conn_num_per_peer_ == 1) { return 0; }
+  return 1 + body_conn_cnt_.fetch_add(1, std::memory_order_relaxed) % (conn_num_per_peer_ - 1);
 }
 
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
@@ -119,14 +173,14 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
   return mem_desc;
 }
 
-EpollCommNet::EpollCommNet() {
+EpollCommNet::EpollCommNet() : body_conn_cnt_(0) {
   pollers_.resize(Global<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
   for (IOEventPoller* poller : pollers_) { poller->Start(); }
 }
 
-EpollCommNet::EpollCommNet(const Plan& plan) : CommNetIf(plan) {
+EpollCommNet::EpollCommNet(const Plan& plan) : CommNetIf(plan), body_conn_cnt_(0) {
   pollers_.resize(Global<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
@@ -137,7 +191,11 @@ void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Global<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Global<ResourceDesc, ForSession>::Get()->TotalMachineNum();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  const EpollCommNetConf& conf = Global<ResourceDesc, ForSession>::Get()->epoll_comm_net_conf();
+  conn_num_per_peer_ = conf.connection_num_per_peer();
+  CHECK_GE(conn_num_per_peer_, 1);
+  stripe_min_body_byte_ = conf.stripe_min_body_byte();
+  machine_id2sockfds_.assign(total_machine_num, std::vector<int>(conn_num_per_peer_, -1));
   sockfd2helper_.clear();
   size_t poller_idx = 0;
   auto NewSocketHelper = [&](int sockfd) {
@@ -149,14 +207,15 @@ void EpollCommNet::InitSockets() {
   // listen
   int listen_sockfd = socket(AF_INET, SOCK_STREAM, 0);
   int32_t this_listen_port = Global<EnvDesc>::Get()->data_port();
+  const int32_t listen_backlog = total_machine_num * conn_num_per_peer_;
   if (this_listen_port != -1) {
-    CHECK_EQ(SockListen(listen_sockfd, this_listen_port, total_machine_num), 0);
+    CHECK_EQ(SockListen(listen_sockfd, this_listen_port, listen_backlog), 0);
     PushPort(this_machine_id,
              ((this_machine.data_port_agent() != -1) ? (this_machine.data_port_agent())
                                                      : (this_listen_port)));
   } else {
     for (this_listen_port = 1024; this_listen_port < GetMaxVal<uint16_t>(); ++this_listen_port) {
-      if (SockListen(listen_sockfd, this_listen_port, total_machine_num) == 0) {
+      if (SockListen(listen_sockfd, this_listen_port, listen_backlog) == 0) {
         PushPort(this_machine_id, this_listen_port);
         break;
       }
@@ -174,36 +233,44 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Global<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int32_t, conn_id, 0, conn_num_per_peer_) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      const int val = 1;
+      PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      SendConnHandshake(sockfd, this_machine_id, conn_id);
+      CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
+      machine_id2sockfds_[peer_id][conn_id] = sockfd;
+    }
   }
 
   // accept
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int32_t, idx, 0, src_machine_count * conn_num_per_peer_) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
+    const ConnHandshake handshake = RecvConnHandshake(sockfd);
+    CHECK_LT(handshake.conn_id, conn_num_per_peer_);
+    int* peer_sockfd = &machine_id2sockfds_.at(handshake.machine_id).at(handshake.conn_id);
+    CHECK_EQ(*peer_sockfd, -1);
     CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    int64_t peer_machine_id = GetMachineId(peer_sockaddr);
-    machine_id2sockfd_[peer_machine_id] = sockfd;
+    *peer_sockfd = sockfd;
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    LOG(INFO) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    std::string sockfds;
+    for (int sockfd : machine_id2sockfds_[machine_id]) { sockfds += " " + std::to_string(sockfd); }
+    LOG(INFO) << "machine " << machine_id << " sockfd" << sockfds;
   }
 }
 
-SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id, int32_t conn_id) {
+  int sockfd = machine_id2sockfds_.at(machine_id).at(conn_id);
   return sockfd2helper_.at(sockfd);
 }
 
@@ -214,7 +281,7 @@ void EpollCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token
   msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
   msg.request_write_msg.dst_token = dst_token;
   msg.request_write_msg.read_id = read_id;
-  GetSocketHelper(src_machine_id)->AsyncWrite(msg);
+  GetSocketHelper(src_machine_id, 0)->AsyncWrite(msg);
 }
 
 }  // namespace oneflow
@@ -36,8 +36,15 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void RegisterMemoryDone() override;
 
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
-  void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  // answers a RequestWrite with one RequestRead per body part
+  void SendRequestReadMsgs(const RequestWriteMsg& request_write_msg);
+  void RequestReadPartDone(const RequestReadMsg& request_read_msg);
+  // reads on behalf of another CommNet, read_id is completed by ReadDone of this one
+  void ReadFromRemotePeer(void* read_id, int64_t src_machine_id, void* src_token,
+                          void* dst_token) {
+    DoRead(read_id, src_machine_id, src_token, dst_token);
+  }
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -46,12 +53,19 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   EpollCommNet();
   DEPRECATED EpollCommNet(const Plan& plan);
   void InitSockets();
-  SocketHelper* GetSocketHelper(int64_t machine_id);
+  SocketHelper* GetSocketHelper(int64_t machine_id, int32_t conn_id);
+  int32_t NextBodyConnId();
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  int32_t conn_num_per_peer_;
+  int64_t stripe_min_body_byte_;
+  // indexed by machine id and then connection id
+  std::vector<std::vector<int>> machine_id2sockfds_;
   HashMap<int, SocketHelper*> sockfd2helper_;
+  std::atomic<int64_t> body_conn_cnt_;
+  std::mutex striped_read_mtx_;
+  HashMap<void*, int64_t> read_id2done_part_num_;
 };
 
 }  // namespace oneflow
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/comm_network/epoll/socket_helper.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/global_for.h"
 
 #ifdef OF_PLATFORM_POSIX
 
@@ -21,9 +23,16 @@ namespace oneflow {
 
 SocketHelper::SocketHelper(int sockfd, IOEventPoller* poller) {
   read_helper_ = new SocketReadHelper(sockfd);
-  write_helper_ = new SocketWriteHelper(sockfd, poller);
-  poller->AddFd(sockfd, [this]() { read_helper_->NotifyMeSocketReadable(); },
-                [this]() { write_helper_->NotifyMeSocketWriteable(); });
+  write_helper_ = new SocketWriteHelper(
+      sockfd, poller, Global<ResourceDesc, ForSession>::Get()->epoll_comm_net_conf());
+  if (write_helper_->zero_copy_enabled()) {
+    poller->AddFd(sockfd, [this]() { read_helper_->NotifyMeSocketReadable(); },
+                  [this]() { write_helper_->NotifyMeSocketWriteable(); },
+                  [this]() { write_helper_->NotifyMeSocketError(); });
+  } else {
+    poller->AddFd(sockfd, [this]() { read_helper_->NotifyMeSocketReadable(); },
+                  [this]() { write_helper_->NotifyMeSocketWriteable(); });
+  }
 }
 
 SocketHelper::~SocketHelper() {
@@ -54,10 +54,15 @@ struct RequestWriteMsg {
   void* read_id;
 };
 
+// A body may be striped over several connections, each part carrying [offset, offset + byte_size)
+// of the regst. The read is done when all part_num parts have arrived.
 struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  int64_t offset;
+  int64_t byte_size;
+  int64_t part_num;
 };
 
 struct SocketMsg {
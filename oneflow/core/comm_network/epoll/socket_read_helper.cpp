@@ -21,6 +21,8 @@ limitations under the License.
 #ifdef OF_PLATFORM_POSIX
 
 #include <netinet/tcp.h>
+#include <sys/uio.h>
+#include <cstring>
 
 namespace oneflow {
 
@@ -28,41 +30,86 @@ SocketReadHelper::~SocketReadHelper() {
   // do nothing
 }
 
+namespace {
+
+// many small headers arrive in one read through this buffer
+const size_t kReadBufSize = 256 * 1024;
+// bodies at least this large are read straight into the regst instead of through the buffer
+const size_t kDirectReadMinBodySize = 4096;
+
+}  // namespace
+
 SocketReadHelper::SocketReadHelper(int sockfd) {
   sockfd_ = sockfd;
-  SwitchToMsgHeadReadHandle();
+  read_buf_.resize(kReadBufSize);
+  read_buf_begin_ = 0;
+  read_buf_end_ = 0;
+  SwitchToFrameHeadReadHandle();
 }
 
 void SocketReadHelper::NotifyMeSocketReadable() { ReadUntilSocketNotReadable(); }
 
-void SocketReadHelper::SwitchToMsgHeadReadHandle() {
-  cur_read_handle_ = &SocketReadHelper::MsgHeadReadHandle;
-  read_ptr_ = reinterpret_cast<char*>(&cur_msg_);
-  read_size_ = sizeof(cur_msg_);
-}
-
-void SocketReadHelper::ReadUntilSocketNotReadable() {
-  while ((this->*cur_read_handle_)()) {}
-}
-
-bool SocketReadHelper::MsgHeadReadHandle() {
-  return DoCurRead(&SocketReadHelper::SetStatusWhenMsgHeadDone);
+void SocketReadHelper::SwitchToFrameHeadReadHandle() {
+  set_cur_read_done_ = &SocketReadHelper::SetStatusWhenFrameHeadDone;
+  read_ptr_ = reinterpret_cast<char*>(&frame_head_);
+  read_size_ = sizeof(frame_head_);
 }
 
-bool SocketReadHelper::MsgBodyReadHandle() {
-  return DoCurRead(&SocketReadHelper::SetStatusWhenMsgBodyDone);
+void SocketReadHelper::SwitchToNextBodyOrFrameHead() {
+  if (pending_body_msgs_.empty()) {
+    SwitchToFrameHeadReadHandle();
+    return;
+  }
+  const RequestReadMsg& msg = pending_body_msgs_.front();
+  auto mem_desc = static_cast<const SocketMemDesc*>(msg.dst_token);
+  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + msg.offset;
+  read_size_ = msg.byte_size;
+  set_cur_read_done_ = &SocketReadHelper::SetStatusWhenMsgBodyDone;
 }
 
-bool SocketReadHelper::DoCurRead(void (SocketReadHelper::*set_cur_read_done)()) {
-  ssize_t n = read(sockfd_, read_ptr_, read_size_);
+void SocketReadHelper::ReadUntilSocketNotReadable() {
+  do { ConsumeReadBuffer(); } while (DoCurRead());
+  // once per wakeup rather than once per read syscall
   const int val = 1;
   PCHECK(setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, (char*)&val, sizeof(int)) == 0);
-  if (n == read_size_) {
-    (this->*set_cur_read_done)();
-    return true;
-  } else if (n >= 0) {
+}
+
+void SocketReadHelper::ConsumeReadBuffer() {
+  while (true) {
+    if (read_size_ == 0) {
+      (this->*set_cur_read_done_)();
+      continue;
+    }
+    const size_t n = std::min(read_size_, read_buf_end_ - read_buf_begin_);
+    if (n == 0) { break; }
+    memcpy(read_ptr_, read_buf_.data() + read_buf_begin_, n);
+    read_buf_begin_ += n;
     read_ptr_ += n;
     read_size_ -= n;
+  }
+  read_buf_begin_ = 0;
+  read_buf_end_ = 0;
+}
+
+bool SocketReadHelper::DoCurRead() {
+  iovec iovs[2];
+  int iov_num = 0;
+  const bool read_body_directly = read_size_ >= kDirectReadMinBodySize;
+  if (read_body_directly) { iovs[iov_num++] = iovec{read_ptr_, read_size_}; }
+  iovs[iov_num++] = iovec{read_buf_.data(), read_buf_.size()};
+  ssize_t n = readv(sockfd_, iovs, iov_num);
+  if (n == 0) {
+    // peer closed, nothing more to read
+    return false;
+  } else if (n > 0) {
+    size_t read_cnt = n;
+    if (read_body_directly) {
+      const size_t body_cnt = std::min(read_cnt, read_size_);
+      read_ptr_ += body_cnt;
+      read_size_ -= body_cnt;
+      read_cnt -= body_cnt;
+    }
+    read_buf_end_ = read_cnt;
     return true;
   } else {
     CHECK_EQ(n, -1);
@@ -71,49 +118,52 @@ bool SocketReadHelper::DoCurRead(void (SocketReadHelper::*set_cur_read_done)())
   }
 }
 
-void SocketReadHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
+void SocketReadHelper::SetStatusWhenFrameHeadDone() {
+  CHECK_EQ(frame_head_.version, kSocketWireVersion) << "sockfd " << sockfd_;
+  CHECK_GT(frame_head_.msg_num, 0);
+  frame_buf_.resize(frame_head_.msg_byte_size);
+  read_ptr_ = frame_buf_.data();
+  read_size_ = frame_buf_.size();
+  set_cur_read_done_ = &SocketReadHelper::SetStatusWhenFrameMsgsDone;
+}
+
+void SocketReadHelper::SetStatusWhenFrameMsgsDone() {
+  const char* ptr = frame_buf_.data();
+  const char* end = ptr + frame_buf_.size();
+  FOR_RANGE(int32_t, i, 0, frame_head_.msg_num) {
+    CHECK(DecodeSocketMsg(&ptr, end, &cur_msg_)) << "sockfd " << sockfd_ << ": malformed frame";
+    switch (cur_msg_.msg_type) {
 #define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: SetStatusWhen##x##MsgHeadDone(); break;
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
+  case SocketMsgType::k##x: Handle##x##Msg(); break;
+      OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
 #undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
+      default: UNIMPLEMENTED();
+    }
   }
+  CHECK(ptr == end) << "sockfd " << sockfd_ << ": malformed frame";
+  SwitchToNextBodyOrFrameHead();
 }
 
 void SocketReadHelper::SetStatusWhenMsgBodyDone() {
-  if (cur_msg_.msg_type == SocketMsgType::kRequestRead) {
-    Global<EpollCommNet>::Get()->ReadDone(cur_msg_.request_read_msg.read_id);
-  }
-  SwitchToMsgHeadReadHandle();
+  Global<EpollCommNet>::Get()->RequestReadPartDone(pending_body_msgs_.front());
+  pending_body_msgs_.pop();
+  SwitchToNextBodyOrFrameHead();
 }
 
-void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  SocketMsg msg_to_send;
-  msg_to_send.msg_type = SocketMsgType::kRequestRead;
-  msg_to_send.request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
-  msg_to_send.request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
-  msg_to_send.request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
-  Global<EpollCommNet>::Get()->SendSocketMsg(cur_msg_.request_write_msg.dst_machine_id,
-                                             msg_to_send);
-  SwitchToMsgHeadReadHandle();
+void SocketReadHelper::HandleRequestWriteMsg() {
+  Global<EpollCommNet>::Get()->SendRequestReadMsgs(cur_msg_.request_write_msg);
 }
 
-void SocketReadHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
-  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr);
-  read_size_ = mem_desc->byte_size;
-  cur_read_handle_ = &SocketReadHelper::MsgBodyReadHandle;
+void SocketReadHelper::HandleRequestReadMsg() {
+  pending_body_msgs_.push(cur_msg_.request_read_msg);
 }
 
-void SocketReadHelper::SetStatusWhenActorMsgHeadDone() {
+void SocketReadHelper::HandleActorMsg() {
   Global<ActorMsgBus>::Get()->SendMsgWithoutCommNet(cur_msg_.actor_msg);
-  SwitchToMsgHeadReadHandle();
 }
 
-void SocketReadHelper::SetStatusWhenTransportMsgHeadDone() {
+void SocketReadHelper::HandleTransportMsg() {
   Global<Transport>::Get()->EnqueueTransportMsg(cur_msg_.transport_msg);
-  SwitchToMsgHeadReadHandle();
 }
 
 }  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_READ_HELPER_H_
 
 #include "oneflow/core/comm_network/epoll/socket_message.h"
+#include "oneflow/core/comm_network/epoll/socket_wire_format.h"
 
 #ifdef OF_PLATFORM_POSIX
 
@@ -33,26 +34,36 @@ class SocketReadHelper final {
   void NotifyMeSocketReadable();
 
  private:
-  void SwitchToMsgHeadReadHandle();
+  void SwitchToFrameHeadReadHandle();
+  // the bodies of a frame follow its msgs, the next frame head follows the last body
+  void SwitchToNextBodyOrFrameHead();
   void ReadUntilSocketNotReadable();
 
-  bool MsgHeadReadHandle();
-  bool MsgBodyReadHandle();
-
-  bool DoCurRead(void (SocketReadHelper::*set_cur_read_done)());
-  void SetStatusWhenMsgHeadDone();
+  // hands the buffered bytes to the current target until the buffer is empty
+  void ConsumeReadBuffer();
+  // one readv into the current body (if large) and the read buffer, false if not readable
+  bool DoCurRead();
+  void SetStatusWhenFrameHeadDone();
+  void SetStatusWhenFrameMsgsDone();
   void SetStatusWhenMsgBodyDone();
 
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
+#define MAKE_ENTRY(x, y) void Handle##x##Msg();
   OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
 #undef MAKE_ENTRY
 
   int sockfd_;
 
+  SocketWireFrameHead frame_head_;
+  std::vector<char> frame_buf_;
   SocketMsg cur_msg_;
-  bool (SocketReadHelper::*cur_read_handle_)();
+  std::queue<RequestReadMsg> pending_body_msgs_;
+  void (SocketReadHelper::*set_cur_read_done_)();
   char* read_ptr_;
   size_t read_size_;
+
+  std::vector<char> read_buf_;
+  size_t read_buf_begin_;
+  size_t read_buf_end_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,134 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/epoll/socket_wire_format.h"
+#include "oneflow/core/common/varint.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+namespace {
+
+void AppendPtr(const void* ptr, std::string* buf) {
+  AppendVarint64(reinterpret_cast<uintptr_t>(ptr), buf);
+}
+
+void AppendInt(int64_t val, std::string* buf) { AppendVarint64(ZigZagEncode64(val), buf); }
+
+bool ReadPtr(const char** ptr, const char* end, void** val) {
+  uint64_t raw = 0;
+  if (!ReadVarint64(ptr, end, &raw)) { return false; }
+  *val = reinterpret_cast<void*>(static_cast<uintptr_t>(raw));
+  return true;
+}
+
+template<typename T>
+bool ReadInt(const char** ptr, const char* end, T* val) {
+  uint64_t raw = 0;
+  if (!ReadVarint64(ptr, end, &raw)) { return false; }
+  *val = static_cast<T>(ZigZagDecode64(raw));
+  return true;
+}
+
+void EncodeRequestWriteMsg(const RequestWriteMsg& msg, std::string* buf) {
+  AppendPtr(msg.src_token, buf);
+  AppendInt(msg.dst_machine_id, buf);
+  AppendPtr(msg.dst_token, buf);
+  AppendPtr(msg.read_id, buf);
+}
+
+bool DecodeRequestWriteMsg(const char** ptr, const char* end, RequestWriteMsg* msg) {
+  return ReadPtr(ptr, end, &msg->src_token) && ReadInt(ptr, end, &msg->dst_machine_id)
+         && ReadPtr(ptr, end, &msg->dst_token) && ReadPtr(ptr, end, &msg->read_id);
+}
+
+void EncodeRequestReadMsg(const RequestReadMsg& msg, std::string* buf) {
+  AppendPtr(msg.src_token, buf);
+  AppendPtr(msg.dst_token, buf);
+  AppendPtr(msg.read_id, buf);
+  AppendInt(msg.offset, buf);
+  AppendInt(msg.byte_size, buf);
+  AppendInt(msg.part_num, buf);
+}
+
+bool DecodeRequestReadMsg(const char** ptr, const char* end, RequestReadMsg* msg) {
+  return ReadPtr(ptr, end, &msg->src_token) && ReadPtr(ptr, end, &msg->dst_token)
+         && ReadPtr(ptr, end, &msg->read_id) && ReadInt(ptr, end, &msg->offset)
+         && ReadInt(ptr, end, &msg->byte_size) && ReadInt(ptr, end, &msg->part_num)
+         && msg->offset >= 0 && msg->byte_size >= 0 && msg->part_num >= 1;
+}
+
+void EncodeActorMsg(const ActorMsg& msg, std::string* buf) { msg.EncodeToWire(buf); }
+
+bool DecodeActorMsg(const char** ptr, const char* end, ActorMsg* msg) {
+  return msg->DecodeFromWire(ptr, end);
+}
+
+void EncodeTransportMsg(const TransportMsg& msg, std::string* buf) {
+  AppendVarint64(msg.token, buf);
+  AppendPtr(msg.src_mem_token, buf);
+  AppendPtr(msg.dst_mem_token, buf);
+  AppendVarint64(msg.size, buf);
+  AppendInt(msg.src_machine_id, buf);
+  AppendInt(msg.dst_machine_id, buf);
+  AppendVarint64(static_cast<uint64_t>(msg.type), buf);
+}
+
+bool DecodeTransportMsg(const char** ptr, const char* end, TransportMsg* msg) {
+  uint64_t size = 0;
+  uint64_t type = 0;
+  if (!(ReadVarint64(ptr, end, &msg->token) && ReadPtr(ptr, end, &msg->src_mem_token)
+        && ReadPtr(ptr, end, &msg->dst_mem_token) && ReadVarint64(ptr, end, &size)
+        && ReadInt(ptr, end, &msg->src_machine_id) && ReadInt(ptr, end, &msg->dst_machine_id)
+        && ReadVarint64(ptr, end, &type))) {
+    return false;
+  }
+  if (type > static_cast<uint64_t>(TransportMsgType::kAck)) { return false; }
+  msg->size = size;
+  msg->type = static_cast<TransportMsgType>(type);
+  return true;
+}
+
+}  // namespace
+
+void EncodeSocketMsg(const SocketMsg& msg, std::string* buf) {
+  AppendVarint64(static_cast<uint64_t>(msg.msg_type), buf);
+  switch (msg.msg_type) {
+#define MAKE_ENTRY(x, y) \
+  case SocketMsgType::k##x: Encode##x##Msg(msg.y##_msg, buf); break;
+    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
+#undef MAKE_ENTRY
+    default: UNIMPLEMENTED();
+  }
+}
+
+bool DecodeSocketMsg(const char** ptr, const char* end, SocketMsg* msg) {
+  uint64_t msg_type = 0;
+  if (!ReadVarint64(ptr, end, &msg_type)) { return false; }
+  switch (msg_type) {
+#define MAKE_ENTRY(x, y)                                        \
+  case static_cast<uint64_t>(SocketMsgType::k##x):              \
+    msg->msg_type = SocketMsgType::k##x;                        \
+    return Decode##x##Msg(ptr, end, &msg->y##_msg);
+    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
+#undef MAKE_ENTRY
+    default: return false;
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
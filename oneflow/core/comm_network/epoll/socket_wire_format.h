@@ -0,0 +1,48 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_WIRE_FORMAT_H_
+#define ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_WIRE_FORMAT_H_
+
+#include "oneflow/core/comm_network/epoll/socket_message.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// What an epoll CommNet connection carries:
+//   stream := frame*
+//   frame  := SocketWireFrameHead, msg_num encoded msgs of msg_byte_size bytes in total, then
+//             the bodies of the RequestRead msgs of the frame in msg order
+//   msg    := varint msg type, then the fields of that type as varints
+// Senders batch all pending msgs to a peer into one frame. A reader rejects other versions.
+const uint8_t kSocketWireVersion = 1;
+
+struct SocketWireFrameHead {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t msg_num;
+  uint32_t msg_byte_size;
+};
+
+void EncodeSocketMsg(const SocketMsg& msg, std::string* buf);
+// returns false on malformed input
+bool DecodeSocketMsg(const char** ptr, const char* end, SocketMsg* msg);
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_EPOLL_SOCKET_WIRE_FORMAT_H_
@@ -0,0 +1,179 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/epoll/socket_wire_format.h"
+#include "oneflow/core/common/varint.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+void* RandomPtr(std::mt19937_64* gen) {
+  // heap addresses are 47 bits at most on x86_64 and aarch64
+  return reinterpret_cast<void*>(static_cast<uintptr_t>((*gen)() & ((1ULL << 47) - 1)));
+}
+
+SocketMsg RandomSocketMsg(std::mt19937_64* gen) {
+  SocketMsg msg;
+  memset(&msg, 0, sizeof(msg));
+  std::uniform_int_distribution<int64_t> small_int(-1, 4096);
+  switch ((*gen)() % 4) {
+    case 0: {
+      msg.msg_type = SocketMsgType::kRequestWrite;
+      msg.request_write_msg.src_token = RandomPtr(gen);
+      msg.request_write_msg.dst_machine_id = small_int(*gen);
+      msg.request_write_msg.dst_token = RandomPtr(gen);
+      msg.request_write_msg.read_id = RandomPtr(gen);
+      break;
+    }
+    case 1: {
+      msg.msg_type = SocketMsgType::kRequestRead;
+      msg.request_read_msg.src_token = RandomPtr(gen);
+      msg.request_read_msg.dst_token = RandomPtr(gen);
+      msg.request_read_msg.read_id = RandomPtr(gen);
+      msg.request_read_msg.offset = (*gen)() % (1LL << 40);
+      msg.request_read_msg.byte_size = (*gen)() % (1LL << 30);
+      msg.request_read_msg.part_num = 1 + (*gen)() % 8;
+      break;
+    }
+    case 2: {
+      msg.msg_type = SocketMsgType::kActor;
+      const int64_t src = (*gen)() % (1LL << 50);
+      const int64_t dst = (*gen)() % (1LL << 50);
+      switch ((*gen)() % 3) {
+        case 0:
+          msg.actor_msg =
+              ActorMsg::BuildRegstMsgToProducer(src, dst, static_cast<Regst*>(RandomPtr(gen)));
+          break;
+        case 1: msg.actor_msg = ActorMsg::BuildEordMsg(dst, small_int(*gen)); break;
+        default: msg.actor_msg = ActorMsg::BuildCommandMsg(dst, ActorCmd::kStart); break;
+      }
+      break;
+    }
+    default: {
+      msg.msg_type = SocketMsgType::kTransport;
+      msg.transport_msg.token = (*gen)();
+      msg.transport_msg.src_mem_token = RandomPtr(gen);
+      msg.transport_msg.dst_mem_token = RandomPtr(gen);
+      msg.transport_msg.size = (*gen)() % (1LL << 30);
+      msg.transport_msg.src_machine_id = small_int(*gen);
+      msg.transport_msg.dst_machine_id = small_int(*gen);
+      msg.transport_msg.type = TransportMsgType::kSend;
+      break;
+    }
+  }
+  return msg;
+}
+
+}  // namespace
+
+TEST(Varint, round_trip) {
+  std::vector<uint64_t> vals = {0, 1, 127, 128, 16383, 16384, std::numeric_limits<uint64_t>::max()};
+  std::string buf;
+  for (uint64_t val : vals) { AppendVarint64(val, &buf); }
+  const char* ptr = buf.data();
+  const char* end = ptr + buf.size();
+  for (uint64_t val : vals) {
+    uint64_t decoded = 0;
+    ASSERT_TRUE(ReadVarint64(&ptr, end, &decoded));
+    ASSERT_EQ(decoded, val);
+  }
+  ASSERT_TRUE(ptr == end);
+  for (int64_t val : {int64_t(0), int64_t(-1), int64_t(1), std::numeric_limits<int64_t>::min(),
+                      std::numeric_limits<int64_t>::max()}) {
+    ASSERT_EQ(ZigZagDecode64(ZigZagEncode64(val)), val);
+  }
+  ASSERT_EQ(ZigZagEncode64(-1), 1);
+  // truncated and overlong input
+  std::string truncated(1, '\x80');
+  ptr = truncated.data();
+  uint64_t decoded = 0;
+  ASSERT_FALSE(ReadVarint64(&ptr, truncated.data() + truncated.size(), &decoded));
+  ASSERT_TRUE(ptr == truncated.data());
+  std::string overlong(kMaxVarint64Bytes, '\xff');
+  overlong.push_back('\x01');
+  ptr = overlong.data();
+  ASSERT_FALSE(ReadVarint64(&ptr, overlong.data() + overlong.size(), &decoded));
+}
+
+TEST(SocketWireFormat, round_trip) {
+  std::mt19937_64 gen(0);
+  FOR_RANGE(int, i, 0, 10000) {
+    const SocketMsg msg = RandomSocketMsg(&gen);
+    std::string buf;
+    EncodeSocketMsg(msg, &buf);
+    const char* ptr = buf.data();
+    SocketMsg decoded;
+    ASSERT_TRUE(DecodeSocketMsg(&ptr, buf.data() + buf.size(), &decoded));
+    ASSERT_TRUE(ptr == buf.data() + buf.size());
+    ASSERT_EQ(decoded.msg_type, msg.msg_type);
+    std::string re_encoded;
+    EncodeSocketMsg(decoded, &re_encoded);
+    ASSERT_EQ(re_encoded, buf);
+  }
+}
+
+TEST(SocketWireFormat, fuzz) {
+  std::mt19937_64 gen(1);
+  SocketMsg msg;
+  // every strict prefix of a valid msg is rejected
+  FOR_RANGE(int, i, 0, 1000) {
+    std::string buf;
+    EncodeSocketMsg(RandomSocketMsg(&gen), &buf);
+    FOR_RANGE(size_t, len, 0, buf.size()) {
+      const char* ptr = buf.data();
+      ASSERT_FALSE(DecodeSocketMsg(&ptr, buf.data() + len, &msg));
+    }
+  }
+  // random bytes either decode within bounds or are rejected, they never crash
+  int64_t decoded_cnt = 0;
+  FOR_RANGE(int, i, 0, 100000) {
+    std::string buf(gen() % 64, '\0');
+    for (char& c : buf) { c = static_cast<char>(gen()); }
+    const char* ptr = buf.data();
+    const char* end = buf.data() + buf.size();
+    while (ptr < end && DecodeSocketMsg(&ptr, end, &msg)) {
+      ASSERT_TRUE(ptr <= end);
+      decoded_cnt += 1;
+    }
+  }
+  LOG(INFO) << "random inputs decoded into " << decoded_cnt << " msgs";
+}
+
+TEST(SocketWireFormat, bytes_per_msg) {
+  std::mt19937_64 gen(2);
+  const int64_t msg_num = 64 * 1024;
+  int64_t encoded_byte = 0;
+  FOR_RANGE(int64_t, i, 0, msg_num) {
+    std::string buf;
+    EncodeSocketMsg(RandomSocketMsg(&gen), &buf);
+    encoded_byte += buf.size();
+  }
+  const double avg_msg_byte = static_cast<double>(encoded_byte) / msg_num;
+  ASSERT_LT(avg_msg_byte, sizeof(SocketMsg));
+  for (int64_t batch : {1, 8, 64}) {
+    LOG(INFO) << "batch " << batch << ": "
+              << avg_msg_byte + static_cast<double>(sizeof(SocketWireFrameHead)) / batch
+              << " B/msg on the wire, " << sizeof(SocketMsg) << " B/msg as raw SocketMsg";
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -15,14 +15,30 @@ limitations under the License.
 */
 #include "oneflow/core/comm_network/epoll/socket_write_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/comm_network/epoll/socket_wire_format.h"
 
 #ifdef OF_PLATFORM_POSIX
 
 #include <sys/eventfd.h>
+#include <linux/errqueue.h>
+#include <cstring>
 
 namespace oneflow {
 
+namespace {
+
+// linux rejects more than IOV_MAX (1024) iovecs in a single sendmsg
+const size_t kMaxIovNumPerWrite = 1024;
+
+}  // namespace
+
 SocketWriteHelper::~SocketWriteHelper() {
+  if (sent_msg_cnt_ > 0) {
+    LOG(INFO) << "sockfd " << sockfd_ << " sent " << sent_msg_cnt_ << " msgs in "
+              << sent_frame_cnt_ << " frames, "
+              << static_cast<double>(sent_frame_byte_cnt_) / sent_msg_cnt_
+              << " bytes per msg on the wire (sizeof(SocketMsg) = " << sizeof(SocketMsg) << ")";
+  }
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
   {
@@ -32,7 +48,12 @@ SocketWriteHelper::~SocketWriteHelper() {
   }
 }
 
-SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
+SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller,
+                                     const EpollCommNetConf& conf)
+    : max_batch_msg_num_(std::min<int32_t>(std::max<int32_t>(conf.max_batch_msg_num(), 1),
+                                           std::numeric_limits<uint16_t>::max())),
+      zero_copy_min_body_byte_(conf.zero_copy_min_body_byte()),
+      zero_copy_enabled_(false) {
   sockfd_ = sockfd;
   queue_not_empty_fd_ = eventfd(0, 0);
   PCHECK(queue_not_empty_fd_ != -1);
@@ -40,9 +61,25 @@ SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
   cur_msg_queue_ = new std::queue<SocketMsg>;
   pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  batch_msgs_.reserve(max_batch_msg_num_);
+  iovs_.reserve(2 * max_batch_msg_num_);
+  cur_iov_idx_ = 0;
+  cur_batch_use_zero_copy_ = false;
+  sent_msg_cnt_ = 0;
+  sent_frame_cnt_ = 0;
+  sent_frame_byte_cnt_ = 0;
+  if (conf.enable_zero_copy()) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    const int val = 1;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0) {
+      zero_copy_enabled_ = true;
+    } else {
+      PLOG(WARNING) << "SO_ZEROCOPY is not supported on sockfd " << sockfd_;
+    }
+#else
+    LOG(WARNING) << "MSG_ZEROCOPY is not supported on this platform";
+#endif
+  }
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
@@ -55,6 +92,14 @@ void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
 
 void SocketWriteHelper::NotifyMeSocketWriteable() { WriteUntilMsgQueueEmptyOrSocketNotWriteable(); }
 
+void SocketWriteHelper::NotifyMeSocketError() {
+  int error = 0;
+  socklen_t len = sizeof(error);
+  PCHECK(getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &error, &len) == 0);
+  CHECK_EQ(error, 0) << "sockfd " << sockfd_ << ": " << strerror(error);
+  ReapZeroCopyCompletions();
+}
+
 void SocketWriteHelper::SendQueueNotEmptyEvent() {
   uint64_t event_num = 1;
   PCHECK(write(queue_not_empty_fd_, &event_num, 8) == 8);
@@ -67,10 +112,17 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
+  while (true) {
+    if (cur_iov_idx_ == iovs_.size() && !InitWriteBatch()) { return; }
+    if (!DoCurBatchWrite()) { return; }
+  }
 }
 
-bool SocketWriteHelper::InitMsgWriteHandle() {
+bool SocketWriteHelper::InitWriteBatch() {
+  batch_msgs_.clear();
+  iovs_.clear();
+  cur_iov_idx_ = 0;
+  cur_batch_use_zero_copy_ = false;
   if (cur_msg_queue_->empty()) {
     {
       std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
@@ -78,70 +130,98 @@ bool SocketWriteHelper::InitMsgWriteHandle() {
     }
     if (cur_msg_queue_->empty()) { return false; }
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
+  while (!cur_msg_queue_->empty() && batch_msgs_.size() < max_batch_msg_num_) {
+    batch_msgs_.push_back(cur_msg_queue_->front());
+    cur_msg_queue_->pop();
+  }
+  frame_buf_.assign(sizeof(SocketWireFrameHead), '\0');
+  for (const SocketMsg& msg : batch_msgs_) { EncodeSocketMsg(msg, &frame_buf_); }
+  SocketWireFrameHead frame_head;
+  frame_head.version = kSocketWireVersion;
+  frame_head.reserved = 0;
+  frame_head.msg_num = batch_msgs_.size();
+  frame_head.msg_byte_size = frame_buf_.size() - sizeof(SocketWireFrameHead);
+  memcpy(&frame_buf_[0], &frame_head, sizeof(SocketWireFrameHead));
+  iovs_.push_back(iovec{&frame_buf_[0], frame_buf_.size()});
+  sent_msg_cnt_ += batch_msgs_.size();
+  sent_frame_cnt_ += 1;
+  sent_frame_byte_cnt_ += frame_buf_.size();
+  for (const SocketMsg& msg : batch_msgs_) {
+    if (msg.msg_type == SocketMsgType::kRequestRead) {
+      const RequestReadMsg& request_read_msg = msg.request_read_msg;
+      if (request_read_msg.byte_size == 0) { continue; }
+      auto src_mem_desc = static_cast<const SocketMemDesc*>(request_read_msg.src_token);
+      char* body_ptr = static_cast<char*>(src_mem_desc->mem_ptr) + request_read_msg.offset;
+      iovs_.push_back(iovec{body_ptr, static_cast<size_t>(request_read_msg.byte_size)});
+      // The sender reuses a regst only after the receiver has consumed it, so the pages pinned
+      // by MSG_ZEROCOPY are never overwritten while the kernel may still transmit them.
+      if (zero_copy_enabled_ && request_read_msg.byte_size >= zero_copy_min_body_byte_) {
+        cur_batch_use_zero_copy_ = true;
+      }
+    }
+  }
   return true;
 }
 
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
-}
-
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
-}
-
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
-    return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
-    return true;
-  } else {
+bool SocketWriteHelper::DoCurBatchWrite() {
+  msghdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_iov = iovs_.data() + cur_iov_idx_;
+  hdr.msg_iovlen = std::min(iovs_.size() - cur_iov_idx_, kMaxIovNumPerWrite);
+  int flags = MSG_NOSIGNAL;
+#ifdef MSG_ZEROCOPY
+  if (cur_batch_use_zero_copy_) { flags |= MSG_ZEROCOPY; }
+#endif
+  ssize_t n = sendmsg(sockfd_, &hdr, flags);
+  if (n < 0) {
     CHECK_EQ(n, -1);
+    if (cur_batch_use_zero_copy_ && errno == ENOBUFS) {
+      // too many unreaped zero copy notifications, fall back to copying for this batch
+      ReapZeroCopyCompletions();
+      cur_batch_use_zero_copy_ = false;
+      return true;
+    }
     PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
     return false;
   }
-}
-
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
-#define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
+  size_t written = n;
+  while (written > 0) {
+    iovec* iov = &iovs_.at(cur_iov_idx_);
+    if (written >= iov->iov_len) {
+      written -= iov->iov_len;
+      cur_iov_idx_ += 1;
+    } else {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+      written = 0;
+    }
   }
+  // skip empty iovecs so that a fully written batch is detected
+  while (cur_iov_idx_ < iovs_.size() && iovs_.at(cur_iov_idx_).iov_len == 0) { cur_iov_idx_ += 1; }
+  return true;
 }
 
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+void SocketWriteHelper::ReapZeroCopyCompletions() {
+#ifdef MSG_ZEROCOPY
+  if (!zero_copy_enabled_) { return; }
+  char control[128];
+  while (true) {
+    msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    if (recvmsg(sockfd_, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+      return;
+    }
+    // the notifications only tell which sends completed, the bodies are owned by regsts
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm != nullptr; cm = CMSG_NXTHDR(&hdr, cm)) {
+      const auto* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+      CHECK_EQ(err->ee_origin, SO_EE_ORIGIN_ZEROCOPY);
+      CHECK_EQ(err->ee_errno, 0);
+    }
+  }
+#endif
 }
 
 }  // namespace oneflow
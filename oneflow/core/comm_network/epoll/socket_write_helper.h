@@ -18,9 +18,12 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/io_event_poller.h"
 #include "oneflow/core/comm_network/epoll/socket_message.h"
+#include "oneflow/core/job/resource.pb.h"
 
 #ifdef OF_PLATFORM_POSIX
 
+#include <sys/uio.h>
+
 namespace oneflow {
 
 class SocketWriteHelper final {
@@ -29,28 +32,25 @@ class SocketWriteHelper final {
   SocketWriteHelper() = delete;
   ~SocketWriteHelper();
 
-  SocketWriteHelper(int sockfd, IOEventPoller* poller);
+  SocketWriteHelper(int sockfd, IOEventPoller* poller, const EpollCommNetConf& conf);
 
   void AsyncWrite(const SocketMsg& msg);
 
   void NotifyMeSocketWriteable();
+  void NotifyMeSocketError();
+
+  bool zero_copy_enabled() const { return zero_copy_enabled_; }
 
  private:
   void SendQueueNotEmptyEvent();
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
-
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
-  OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
+  // encodes as many queued msgs as allowed into one frame and gathers it and the bodies in iovs_
+  bool InitWriteBatch();
+  // one sendmsg for the unwritten part of iovs_, returns false if the socket is not writeable
+  bool DoCurBatchWrite();
+  void ReapZeroCopyCompletions();
 
   int sockfd_;
   int queue_not_empty_fd_;
@@ -60,10 +60,20 @@ class SocketWriteHelper final {
   std::mutex pending_msg_queue_mtx_;
   std::queue<SocketMsg>* pending_msg_queue_;
 
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  const size_t max_batch_msg_num_;
+  const size_t zero_copy_min_body_byte_;
+  bool zero_copy_enabled_;
+
+  std::vector<SocketMsg> batch_msgs_;
+  // must not move while it is referenced by iovs_
+  std::string frame_buf_;
+  std::vector<struct iovec> iovs_;
+  size_t cur_iov_idx_;
+  bool cur_batch_use_zero_copy_;
+
+  int64_t sent_msg_cnt_;
+  int64_t sent_frame_cnt_;
+  int64_t sent_frame_byte_cnt_;
 };
 
 }  // namespace oneflow
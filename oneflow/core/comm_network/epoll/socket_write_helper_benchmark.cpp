@@ -0,0 +1,227 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/epoll/socket_write_helper.h"
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/comm_network/epoll/socket_wire_format.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <netinet/tcp.h>
+
+namespace oneflow {
+
+namespace {
+
+const int64_t kMsgNum = 20000;
+
+// returns a connected (sender, receiver) pair of loopback tcp sockets
+std::pair<int, int> ConnectLoopback() {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(listen_fd != -1);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  PCHECK(bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+  PCHECK(listen(listen_fd, 1) == 0);
+  socklen_t addr_len = sizeof(addr);
+  PCHECK(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0);
+  int send_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(send_fd != -1);
+  PCHECK(connect(send_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+  int recv_fd = accept(listen_fd, nullptr, nullptr);
+  PCHECK(recv_fd != -1);
+  PCHECK(close(listen_fd) == 0);
+  const int val = 1;
+  PCHECK(setsockopt(send_fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)) == 0);
+  return std::make_pair(send_fd, recv_fd);
+}
+
+std::thread StartDrainThread(int recv_fd, size_t total_byte, BlockingCounter* done) {
+  return std::thread([recv_fd, total_byte, done]() {
+    std::vector<char> buf(1 << 20);
+    size_t received = 0;
+    while (received < total_byte) {
+      ssize_t n = read(recv_fd, buf.data(), buf.size());
+      PCHECK(n > 0);
+      received += n;
+    }
+    CHECK_EQ(received, total_byte);
+    done->Decrease();
+  });
+}
+
+// buffered blocking reader for the framed stream written by SocketWriteHelper
+class FrameReader final {
+ public:
+  explicit FrameReader(int fd) : fd_(fd), buf_(1 << 20), begin_(0), end_(0) {}
+
+  void Read(char* dst, size_t size) {
+    while (size > 0) {
+      if (begin_ == end_) {
+        ssize_t n = read(fd_, buf_.data(), buf_.size());
+        PCHECK(n > 0);
+        begin_ = 0;
+        end_ = n;
+      }
+      const size_t n = std::min(size, end_ - begin_);
+      if (dst != nullptr) {
+        memcpy(dst, buf_.data() + begin_, n);
+        dst += n;
+      }
+      begin_ += n;
+      size -= n;
+    }
+  }
+
+ private:
+  int fd_;
+  std::vector<char> buf_;
+  size_t begin_;
+  size_t end_;
+};
+
+// parses frames until msg_num msgs and their bodies have arrived
+std::thread StartFrameDrainThread(int recv_fd, int64_t msg_num, BlockingCounter* done) {
+  return std::thread([recv_fd, msg_num, done]() {
+    FrameReader reader(recv_fd);
+    std::vector<char> msg_buf;
+    int64_t received = 0;
+    while (received < msg_num) {
+      SocketWireFrameHead head;
+      reader.Read(reinterpret_cast<char*>(&head), sizeof(head));
+      CHECK_EQ(head.version, kSocketWireVersion);
+      msg_buf.resize(head.msg_byte_size);
+      reader.Read(msg_buf.data(), msg_buf.size());
+      const char* ptr = msg_buf.data();
+      const char* end = ptr + msg_buf.size();
+      std::vector<int64_t> body_sizes;
+      FOR_RANGE(int32_t, i, 0, head.msg_num) {
+        SocketMsg msg;
+        CHECK(DecodeSocketMsg(&ptr, end, &msg));
+        if (msg.msg_type == SocketMsgType::kRequestRead) {
+          body_sizes.push_back(msg.request_read_msg.byte_size);
+        }
+      }
+      CHECK(ptr == end);
+      for (int64_t body_size : body_sizes) { reader.Read(nullptr, body_size); }
+      received += head.msg_num;
+    }
+    CHECK_EQ(received, msg_num);
+    done->Decrease();
+  });
+}
+
+std::vector<SocketMsg> MakeMsgs(SocketMemDesc* body_desc) {
+  std::vector<SocketMsg> msgs(kMsgNum);
+  FOR_RANGE(int64_t, i, 0, kMsgNum) {
+    SocketMsg* msg = &msgs.at(i);
+    memset(msg, 0, sizeof(SocketMsg));
+    if (body_desc->byte_size == 0) {
+      msg->msg_type = SocketMsgType::kActor;
+    } else {
+      msg->msg_type = SocketMsgType::kRequestRead;
+      msg->request_read_msg.src_token = body_desc;
+      msg->request_read_msg.offset = 0;
+      msg->request_read_msg.byte_size = body_desc->byte_size;
+      msg->request_read_msg.part_num = 1;
+    }
+  }
+  return msgs;
+}
+
+void BlockingWriteAll(int fd, const char* ptr, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, ptr, size);
+    PCHECK(n > 0);
+    ptr += n;
+    size -= n;
+  }
+}
+
+// the write pattern of the baseline SocketWriteHelper, one write() per raw header and per body
+double MeasurePerMsgWriteSeconds(size_t body_byte) {
+  std::vector<char> body(body_byte);
+  SocketMemDesc body_desc{body.data(), body.size()};
+  std::vector<SocketMsg> msgs = MakeMsgs(&body_desc);
+  std::pair<int, int> fds = ConnectLoopback();
+  BlockingCounter done(1);
+  std::thread drain_thread =
+      StartDrainThread(fds.second, kMsgNum * (sizeof(SocketMsg) + body_byte), &done);
+  auto start = std::chrono::steady_clock::now();
+  for (const SocketMsg& msg : msgs) {
+    BlockingWriteAll(fds.first, reinterpret_cast<const char*>(&msg), sizeof(SocketMsg));
+    if (body_byte > 0) { BlockingWriteAll(fds.first, body.data(), body.size()); }
+  }
+  done.WaitUntilCntEqualZero();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  drain_thread.join();
+  PCHECK(close(fds.first) == 0);
+  PCHECK(close(fds.second) == 0);
+  return elapsed.count();
+}
+
+double MeasureWriteHelperSeconds(size_t body_byte, bool enable_zero_copy) {
+  std::vector<char> body(body_byte);
+  SocketMemDesc body_desc{body.data(), body.size()};
+  std::vector<SocketMsg> msgs = MakeMsgs(&body_desc);
+  std::pair<int, int> fds = ConnectLoopback();
+  BlockingCounter done(1);
+  std::thread drain_thread = StartFrameDrainThread(fds.second, kMsgNum, &done);
+  EpollCommNetConf conf;
+  conf.set_enable_zero_copy(enable_zero_copy);
+  double seconds = 0;
+  {
+    IOEventPoller poller;
+    SocketWriteHelper write_helper(fds.first, &poller, conf);
+    poller.AddFd(fds.first, []() {}, [&write_helper]() { write_helper.NotifyMeSocketWriteable(); },
+                 [&write_helper]() { write_helper.NotifyMeSocketError(); });
+    poller.Start();
+    auto start = std::chrono::steady_clock::now();
+    for (const SocketMsg& msg : msgs) { write_helper.AsyncWrite(msg); }
+    done.WaitUntilCntEqualZero();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds = elapsed.count();
+    poller.Stop();
+    // the poller closes fds.first on destruction
+  }
+  drain_thread.join();
+  PCHECK(close(fds.second) == 0);
+  return seconds;
+}
+
+void LogThroughput(const std::string& name, size_t body_byte, double seconds) {
+  const double total_byte = kMsgNum * (sizeof(SocketMsg) + body_byte);
+  LOG(INFO) << name << " body " << body_byte << " B: " << kMsgNum / seconds << " msg/s, "
+            << total_byte / seconds / 1e9 << " GB/s";
+}
+
+}  // namespace
+
+TEST(SocketWriteHelper, loopback_benchmark) {
+  for (size_t body_byte : {size_t(0), size_t(1024), size_t(256 * 1024)}) {
+    LogThroughput("write per msg", body_byte, MeasurePerMsgWriteSeconds(body_byte));
+    LogThroughput("SocketWriteHelper", body_byte, MeasureWriteHelperSeconds(body_byte, false));
+    LogThroughput("SocketWriteHelper zero copy", body_byte,
+                  MeasureWriteHelperSeconds(body_byte, true));
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
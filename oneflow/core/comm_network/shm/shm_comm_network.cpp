@@ -0,0 +1,278 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/shm/shm_comm_network.h"
+#include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/actor/actor_message_bus.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/device/cuda_util.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/global_for.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <unistd.h>
+
+namespace oneflow {
+
+namespace {
+
+const size_t kShmRingCapacity = 4096;
+// how often a poller with pending msgs looks for room in the ring of its peer
+const int64_t kPendingMsgRetryIntervalUs = 100;
+
+std::string GenHostKey(int64_t machine_id) { return "ShmHost/" + std::to_string(machine_id); }
+
+// ring written by src_machine_id and read by the process with receiver_pid
+std::string GenRingName(int64_t receiver_pid, int64_t src_machine_id) {
+  return "/oneflow_shm_" + std::to_string(receiver_pid) + "_ring_"
+         + std::to_string(src_machine_id);
+}
+
+std::string GenSegmentName(int64_t owner_pid, int64_t segment_id) {
+  return "/oneflow_shm_" + std::to_string(owner_pid) + "_seg_" + std::to_string(segment_id);
+}
+
+std::string GetHostName() {
+  char hostname[255];
+  CHECK_EQ(gethostname(hostname, sizeof(hostname)), 0);
+  return std::string(hostname);
+}
+
+}  // namespace
+
+ShmCommNet::~ShmCommNet() {
+  // our pollers flush the pending msgs while the peers still drain their rings
+  for (auto& pair : local_peer2send_ring_) {
+    while (pair.second.pending_msg_cnt.load(std::memory_order_acquire) > 0) {
+      std::this_thread::yield();
+    }
+  }
+  // nobody sends to us anymore once all processes get here
+  OF_SESSION_BARRIER();
+  for (auto& pair : local_peer2recv_ring_) { pair.second.ring->Close(); }
+  for (std::thread& poller : recv_ring_pollers_) { poller.join(); }
+#ifdef WITH_CUDA
+  for (char* ptr : cuda_registered_ptrs_) { OF_CUDA_CHECK(cudaHostUnregister(ptr)); }
+#endif
+}
+
+void ShmCommNet::RegisterMemoryDone() {
+  // do nothing
+}
+
+void ShmCommNet::SendActorMsg(int64_t dst_machine_id, const ActorMsg& actor_msg) {
+  if (IsLocalPeer(dst_machine_id)) {
+    ShmMsg msg;
+    msg.msg_type = ShmMsgType::kActor;
+    msg.actor_msg = actor_msg;
+    SendShmMsg(dst_machine_id, msg);
+  } else {
+    Global<EpollCommNet>::Get()->SendActorMsg(dst_machine_id, actor_msg);
+  }
+}
+
+char* ShmCommNet::AllocateSharedHostMem(const MemoryCase& mem_case, size_t byte_size) {
+  CHECK(mem_case.has_host_mem());
+  std::unique_lock<std::mutex> lck(segments_mtx_);
+  const int64_t segment_id = ptr2segment_.size();
+  std::unique_ptr<ShmSegment> segment(
+      new ShmSegment(GenSegmentName(getpid(), segment_id), byte_size));
+  char* ptr = segment->ptr();
+  if (mem_case.host_mem().has_cuda_pinned_mem()) {
+#ifdef WITH_CUDA
+    CudaCurrentDeviceGuard guard(mem_case.host_mem().cuda_pinned_mem().device_id());
+    OF_CUDA_CHECK(cudaHostRegister(ptr, byte_size, cudaHostRegisterDefault));
+    cuda_registered_ptrs_.push_back(ptr);
+#else
+    UNIMPLEMENTED();
+#endif
+  }
+  CHECK(ptr2segment_.emplace(ptr, std::make_pair(segment_id, std::move(segment))).second);
+  return ptr;
+}
+
+ShmMemDesc* ShmCommNet::NewMemDesc(void* ptr, size_t byte_size) {
+  ShmMemDesc* mem_desc = new ShmMemDesc;
+  mem_desc->socket_mem_desc.mem_ptr = ptr;
+  mem_desc->socket_mem_desc.byte_size = byte_size;
+  mem_desc->segment_id = -1;
+  mem_desc->segment_offset = 0;
+  char* begin = static_cast<char*>(ptr);
+  std::unique_lock<std::mutex> lck(segments_mtx_);
+  auto it = ptr2segment_.upper_bound(begin);
+  if (it != ptr2segment_.begin()) {
+    --it;
+    const ShmSegment* segment = it->second.second.get();
+    if (begin + byte_size <= segment->ptr() + segment->byte_size()) {
+      mem_desc->segment_id = it->second.first;
+      mem_desc->segment_offset = begin - segment->ptr();
+    }
+  }
+  return mem_desc;
+}
+
+ShmCommNet::ShmCommNet() { InitPeerRings(); }
+
+void ShmCommNet::InitPeerRings() {
+  const int64_t this_machine_id = GlobalProcessCtx::Rank();
+  const std::string this_host = GetHostName();
+  Global<CtrlClient>::Get()->PushKV(GenHostKey(this_machine_id),
+                                    this_host + "/" + std::to_string(getpid()));
+  for (int64_t peer_id : peer_machine_id()) {
+    std::string host_and_pid;
+    Global<CtrlClient>::Get()->PullKV(GenHostKey(peer_id), &host_and_pid);
+    const size_t sep_pos = host_and_pid.rfind('/');
+    CHECK_NE(sep_pos, std::string::npos);
+    if (host_and_pid.substr(0, sep_pos) != this_host) { continue; }
+    CHECK(local_peer2pid_.emplace(peer_id, oneflow_cast<int64_t>(host_and_pid.substr(sep_pos + 1)))
+              .second);
+  }
+  for (const auto& pair : local_peer2pid_) {
+    PeerRing* recv_ring = &local_peer2recv_ring_[pair.first];
+    recv_ring->segment.reset(new ShmSegment(GenRingName(getpid(), pair.first),
+                                            ShmRing<ShmMsg>::ByteSize(kShmRingCapacity)));
+    ShmRing<ShmMsg>::Init(recv_ring->segment->ptr(), kShmRingCapacity);
+    recv_ring->ring.reset(new ShmRing<ShmMsg>(recv_ring->segment->ptr()));
+  }
+  OF_SESSION_BARRIER();
+  for (const auto& pair : local_peer2pid_) {
+    PeerRing* send_ring = &local_peer2send_ring_[pair.first];
+    send_ring->segment.reset(new ShmSegment(GenRingName(pair.second, this_machine_id)));
+    send_ring->ring.reset(new ShmRing<ShmMsg>(send_ring->segment->ptr()));
+  }
+  OF_SESSION_BARRIER();
+  // every peer has mapped its ring, no name is left behind if a process dies later
+  for (auto& pair : local_peer2recv_ring_) { pair.second.segment->Unlink(); }
+  Global<CtrlClient>::Get()->ClearKV(GenHostKey(this_machine_id));
+  for (auto& pair : local_peer2recv_ring_) {
+    const int64_t src_machine_id = pair.first;
+    ShmRing<ShmMsg>* ring = pair.second.ring.get();
+    recv_ring_pollers_.emplace_back(
+        [this, src_machine_id, ring]() { PollPeerRing(src_machine_id, ring); });
+  }
+  LOG(INFO) << "CommNet:Shm " << local_peer2pid_.size() << " local peers";
+}
+
+bool ShmCommNet::IsLocalPeer(int64_t machine_id) const {
+  return local_peer2send_ring_.find(machine_id) != local_peer2send_ring_.end();
+}
+
+void ShmCommNet::SendShmMsg(int64_t dst_machine_id, const ShmMsg& msg) {
+  PeerRing* send_ring = &local_peer2send_ring_.at(dst_machine_id);
+  ChannelStatus status = kChannelStatusSuccess;
+  if (send_ring->pending_msg_cnt.load(std::memory_order_acquire) == 0
+      && send_ring->ring->TrySend(msg, &status)) {
+    CHECK_EQ(status, kChannelStatusSuccess);
+    return;
+  }
+  // never wait for the peer here, its poller may be waiting for us as well
+  {
+    std::unique_lock<std::mutex> lck(send_ring->pending_msgs_mtx);
+    send_ring->pending_msgs.push_back(msg);
+    send_ring->pending_msg_cnt.store(send_ring->pending_msgs.size(), std::memory_order_release);
+  }
+  local_peer2recv_ring_.at(dst_machine_id).ring->Notify();
+}
+
+bool ShmCommNet::RetryPendingMsgs(PeerRing* send_ring) {
+  if (send_ring->pending_msg_cnt.load(std::memory_order_acquire) == 0) { return false; }
+  std::unique_lock<std::mutex> lck(send_ring->pending_msgs_mtx);
+  ChannelStatus status = kChannelStatusSuccess;
+  while (!send_ring->pending_msgs.empty()
+         && send_ring->ring->TrySend(send_ring->pending_msgs.front(), &status)) {
+    CHECK_EQ(status, kChannelStatusSuccess);
+    send_ring->pending_msgs.pop_front();
+  }
+  send_ring->pending_msg_cnt.store(send_ring->pending_msgs.size(), std::memory_order_release);
+  return !send_ring->pending_msgs.empty();
+}
+
+void ShmCommNet::PollPeerRing(int64_t src_machine_id, ShmRing<ShmMsg>* ring) {
+  PeerRing* send_ring = &local_peer2send_ring_.at(src_machine_id);
+  ShmMsg msg;
+  ChannelStatus status = kChannelStatusSuccess;
+  while (true) {
+    const int64_t timeout_us = RetryPendingMsgs(send_ring) ? kPendingMsgRetryIntervalUs : -1;
+    if (!ring->TryReceive(&msg, timeout_us, &status)) { continue; }
+    if (status != kChannelStatusSuccess) { break; }
+    HandleShmMsg(src_machine_id, msg);
+  }
+}
+
+void ShmCommNet::HandleShmMsg(int64_t src_machine_id, const ShmMsg& msg) {
+  if (msg.msg_type == ShmMsgType::kActor) {
+    Global<ActorMsgBus>::Get()->SendMsgWithoutCommNet(msg.actor_msg);
+  } else if (msg.msg_type == ShmMsgType::kRequestWrite) {
+    HandleRequestWriteMsg(src_machine_id, msg.request_write_msg);
+  } else if (msg.msg_type == ShmMsgType::kRequestRead) {
+    HandleRequestReadMsg(src_machine_id, msg.request_read_msg);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+void ShmCommNet::HandleRequestWriteMsg(int64_t src_machine_id, const ShmRequestWriteMsg& msg) {
+  auto src_mem_desc = static_cast<const ShmMemDesc*>(msg.src_token);
+  CHECK_NE(src_mem_desc->segment_id, -1) << "memory read by a local peer must be shared";
+  ShmMsg reply;
+  reply.msg_type = ShmMsgType::kRequestRead;
+  reply.request_read_msg.segment_id = src_mem_desc->segment_id;
+  reply.request_read_msg.segment_offset = src_mem_desc->segment_offset;
+  reply.request_read_msg.byte_size = src_mem_desc->socket_mem_desc.byte_size;
+  reply.request_read_msg.dst_token = msg.dst_token;
+  reply.request_read_msg.read_id = msg.read_id;
+  SendShmMsg(src_machine_id, reply);
+}
+
+void ShmCommNet::HandleRequestReadMsg(int64_t src_machine_id, const ShmRequestReadMsg& msg) {
+  const ShmSegment* segment = GetPeerSegment(src_machine_id, msg.segment_id);
+  CHECK_LE(msg.segment_offset + msg.byte_size, segment->byte_size());
+  auto dst_mem_desc = static_cast<const ShmMemDesc*>(msg.dst_token);
+  CHECK_LE(msg.byte_size, dst_mem_desc->socket_mem_desc.byte_size);
+  memcpy(dst_mem_desc->socket_mem_desc.mem_ptr, segment->ptr() + msg.segment_offset,
+         msg.byte_size);
+  ReadDone(msg.read_id);
+}
+
+const ShmSegment* ShmCommNet::GetPeerSegment(int64_t machine_id, int64_t segment_id) {
+  std::unique_lock<std::mutex> lck(segments_mtx_);
+  auto key = std::make_pair(machine_id, segment_id);
+  auto it = peer_segment_id2segment_.find(key);
+  if (it == peer_segment_id2segment_.end()) {
+    const std::string name = GenSegmentName(local_peer2pid_.at(machine_id), segment_id);
+    it = peer_segment_id2segment_.emplace(key, std::unique_ptr<ShmSegment>(new ShmSegment(name)))
+             .first;
+  }
+  return it->second.get();
+}
+
+void ShmCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) {
+  if (IsLocalPeer(src_machine_id)) {
+    ShmMsg msg;
+    msg.msg_type = ShmMsgType::kRequestWrite;
+    msg.request_write_msg.src_token = src_token;
+    msg.request_write_msg.dst_token = dst_token;
+    msg.request_write_msg.read_id = read_id;
+    SendShmMsg(src_machine_id, msg);
+  } else {
+    Global<EpollCommNet>::Get()->ReadFromRemotePeer(read_id, src_machine_id, src_token, dst_token);
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
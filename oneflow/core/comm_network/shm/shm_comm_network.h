@@ -0,0 +1,90 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_COMM_NETWORK_H_
+#define ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_COMM_NETWORK_H_
+
+#include "oneflow/core/comm_network/comm_network.h"
+#include "oneflow/core/comm_network/shm/shm_memory_desc.h"
+#include "oneflow/core/comm_network/shm/shm_message.h"
+#include "oneflow/core/comm_network/shm/shm_ring.h"
+#include "oneflow/core/comm_network/shm/shm_segment.h"
+#include "oneflow/core/memory/memory_case.pb.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// CommNet for processes on the same host. Actor msgs go through shared memory rings, and regst
+// bodies are copied once by the reader out of the shared segment the owner allocated them in.
+// Peers on other hosts are served by Global<EpollCommNet>.
+class ShmCommNet final : public CommNetIf<ShmMemDesc> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmCommNet);
+  ~ShmCommNet();
+
+  void RegisterMemoryDone() override;
+
+  void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
+
+  bool has_local_peer() const { return !local_peer2send_ring_.empty(); }
+  // zero filled host memory that local peers can read, freed when the ShmCommNet is deleted
+  char* AllocateSharedHostMem(const MemoryCase& mem_case, size_t byte_size);
+
+ private:
+  struct PeerRing {
+    std::unique_ptr<ShmSegment> segment;
+    std::unique_ptr<ShmRing<ShmMsg>> ring;
+    // msgs that found the send ring full, retried by the poller of the same peer
+    std::mutex pending_msgs_mtx;
+    std::deque<ShmMsg> pending_msgs;
+    // size of pending_msgs, senders keep appending while it is not zero to preserve their order
+    std::atomic<size_t> pending_msg_cnt;
+    PeerRing() : pending_msg_cnt(0) {}
+  };
+
+  ShmMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
+
+  friend class Global<ShmCommNet>;
+  ShmCommNet();
+  void InitPeerRings();
+  bool IsLocalPeer(int64_t machine_id) const;
+  void SendShmMsg(int64_t dst_machine_id, const ShmMsg& msg);
+  // moves pending msgs into the send ring until it is full, returns whether some are left
+  bool RetryPendingMsgs(PeerRing* send_ring);
+  void PollPeerRing(int64_t src_machine_id, ShmRing<ShmMsg>* ring);
+  void HandleShmMsg(int64_t src_machine_id, const ShmMsg& msg);
+  void HandleRequestWriteMsg(int64_t src_machine_id, const ShmRequestWriteMsg& msg);
+  void HandleRequestReadMsg(int64_t src_machine_id, const ShmRequestReadMsg& msg);
+  const ShmSegment* GetPeerSegment(int64_t machine_id, int64_t segment_id);
+  void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
+
+  HashMap<int64_t, int64_t> local_peer2pid_;
+  HashMap<int64_t, PeerRing> local_peer2send_ring_;
+  HashMap<int64_t, PeerRing> local_peer2recv_ring_;
+  std::vector<std::thread> recv_ring_pollers_;
+
+  std::mutex segments_mtx_;
+  // own segments keyed by their begin address
+  std::map<char*, std::pair<int64_t, std::unique_ptr<ShmSegment>>> ptr2segment_;
+  HashMap<std::pair<int64_t, int64_t>, std::unique_ptr<ShmSegment>> peer_segment_id2segment_;
+  std::vector<char*> cuda_registered_ptrs_;
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_COMM_NETWORK_H_
@@ -0,0 +1,38 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MEMORY_DESC_H_
+#define ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MEMORY_DESC_H_
+
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// socket_mem_desc must stay the first member, remote peers are served by EpollCommNet which
+// reads the same token as a SocketMemDesc.
+struct ShmMemDesc {
+  SocketMemDesc socket_mem_desc;
+  // -1 if the memory is not in a shared segment of this process
+  int64_t segment_id;
+  int64_t segment_offset;
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MEMORY_DESC_H_
@@ -0,0 +1,57 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MESSAGE_H_
+#define ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MESSAGE_H_
+
+#include "oneflow/core/common/platform.h"
+#include "oneflow/core/actor/actor_message.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+enum class ShmMsgType { kRequestWrite, kRequestRead, kActor };
+
+// sent by the reader to the process owning the src regst
+struct ShmRequestWriteMsg {
+  void* src_token;
+  void* dst_token;
+  void* read_id;
+};
+
+// tells the reader where the src regst lives in the shared segments of its owner
+struct ShmRequestReadMsg {
+  int64_t segment_id;
+  int64_t segment_offset;
+  int64_t byte_size;
+  void* dst_token;
+  void* read_id;
+};
+
+struct ShmMsg {
+  ShmMsgType msg_type;
+  union {
+    ShmRequestWriteMsg request_write_msg;
+    ShmRequestReadMsg request_read_msg;
+    ActorMsg actor_msg;
+  };
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_MESSAGE_H_
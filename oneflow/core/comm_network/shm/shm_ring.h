@@ -0,0 +1,244 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_RING_H_
+#define ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_RING_H_
+
+#include "oneflow/core/common/platform.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+// Bounded queue living in memory shared by two processes. Items are copied bytewise, so T must
+// not hold pointers that are only valid in the sending process. Any number of threads of the
+// sending process may TrySend, each claims a cell with one CAS and never blocks. One thread of
+// the receiving process receives, it spins for a while and then parks on a futex in the shared
+// memory.
+template<typename T>
+class ShmRing final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmRing);
+  ShmRing() = delete;
+  // mem must hold ByteSize(capacity) bytes and be formatted by Init in one of the processes
+  explicit ShmRing(char* mem);
+  ~ShmRing() = default;
+
+  static size_t ByteSize(size_t capacity) { return sizeof(Header) + capacity * sizeof(Cell); }
+  static void Init(char* mem, size_t capacity);
+
+  // returns false if the ring is full, never blocks
+  bool TrySend(const T& item, ChannelStatus* status);
+  ChannelStatus Receive(T* item);
+  // returns false if no item arrived within timeout_us or Notify was called, a negative
+  // timeout_us waits without a time limit
+  bool TryReceive(T* item, int64_t timeout_us, ChannelStatus* status);
+  // makes a pending or the next TryReceive of this process return, called in the receiver process
+  void Notify();
+  // wakes the receiver, which returns kChannelStatusErrorClosed once the ring is drained
+  void Close();
+
+  size_t capacity() const { return header_->capacity; }
+
+ private:
+  static const size_t kCacheLineSize = 64;
+  static const int64_t kSpinCount = 4096;
+
+  struct Header {
+    // next cell claimed by the senders
+    std::atomic<uint64_t> head;
+    char pad0[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+    // next cell read by the receiver
+    std::atomic<uint64_t> tail;
+    char pad1[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+    std::atomic<int32_t> wake_seq;
+    std::atomic<int32_t> is_receiver_parked;
+    std::atomic<int32_t> is_closed;
+    uint64_t capacity;
+    char pad2[kCacheLineSize - 3 * sizeof(std::atomic<int32_t>) - sizeof(uint64_t)];
+  };
+
+  // seq is pos + 1 once the item of pos is written and pos + capacity once it is read
+  struct Cell {
+    std::atomic<uint64_t> seq;
+    T data;
+  };
+
+  bool IsReady() const;
+  bool IsReadyOrClosed() const;
+  // returns false if woken without an item after timeout_us or by Notify
+  bool WaitUntilReadyOrClosed(int64_t timeout_us);
+  void WakeReceiver(int wake_num);
+
+  Header* header_;
+  Cell* cells_;
+  std::atomic<bool> is_notified_;
+};
+
+template<typename T>
+void ShmRing<T>::Init(char* mem, size_t capacity) {
+  static_assert(std::is_trivially_copyable<T>::value, "");
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                "atomics shared between processes must be lock free");
+  CHECK_GT(capacity, 0);
+  Header* header = new (mem) Header;
+  header->head.store(0, std::memory_order_relaxed);
+  header->tail.store(0, std::memory_order_relaxed);
+  header->wake_seq.store(0, std::memory_order_relaxed);
+  header->is_receiver_parked.store(0, std::memory_order_relaxed);
+  header->is_closed.store(0, std::memory_order_relaxed);
+  header->capacity = capacity;
+  Cell* cells = reinterpret_cast<Cell*>(mem + sizeof(Header));
+  FOR_RANGE(size_t, i, 0, capacity) {
+    Cell* cell = new (cells + i) Cell;
+    cell->seq.store(i, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<typename T>
+ShmRing<T>::ShmRing(char* mem)
+    : header_(reinterpret_cast<Header*>(mem)),
+      cells_(reinterpret_cast<Cell*>(mem + sizeof(Header))),
+      is_notified_(false) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  CHECK_GT(header_->capacity, 0);
+}
+
+template<typename T>
+bool ShmRing<T>::TrySend(const T& item, ChannelStatus* status) {
+  if (header_->is_closed.load(std::memory_order_acquire)) {
+    *status = kChannelStatusErrorClosed;
+    return true;
+  }
+  const uint64_t capacity = header_->capacity;
+  uint64_t pos = header_->head.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[pos % capacity];
+    const uint64_t seq = cell->seq.load(std::memory_order_acquire);
+    const int64_t diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (header_->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      // the cell still holds the item of pos - capacity
+      return false;
+    } else {
+      pos = header_->head.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = item;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header_->is_receiver_parked.load(std::memory_order_seq_cst)) { WakeReceiver(1); }
+  *status = kChannelStatusSuccess;
+  return true;
+}
+
+template<typename T>
+bool ShmRing<T>::IsReady() const {
+  const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  return cells_[tail % header_->capacity].seq.load(std::memory_order_acquire) == tail + 1;
+}
+
+template<typename T>
+bool ShmRing<T>::IsReadyOrClosed() const {
+  return IsReady() || header_->is_closed.load(std::memory_order_acquire);
+}
+
+template<typename T>
+bool ShmRing<T>::WaitUntilReadyOrClosed(int64_t timeout_us) {
+  FOR_RANGE(int64_t, i, 0, kSpinCount) {
+    if (IsReadyOrClosed()) { return true; }
+  }
+  struct timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+  bool is_ready_or_closed = false;
+  while (true) {
+    const int32_t wake_seq = header_->wake_seq.load(std::memory_order_seq_cst);
+    header_->is_receiver_parked.store(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (IsReadyOrClosed()) {
+      is_ready_or_closed = true;
+      break;
+    }
+    if (is_notified_.exchange(false)) { break; }
+    // returns at once if a sender has bumped wake_seq in the meantime
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(&header_->wake_seq), FUTEX_WAIT, wake_seq,
+            timeout_us < 0 ? nullptr : &timeout, nullptr, 0);
+    if (timeout_us >= 0) {
+      is_ready_or_closed = IsReadyOrClosed();
+      break;
+    }
+  }
+  header_->is_receiver_parked.store(0, std::memory_order_relaxed);
+  return is_ready_or_closed;
+}
+
+template<typename T>
+void ShmRing<T>::WakeReceiver(int wake_num) {
+  header_->wake_seq.fetch_add(1, std::memory_order_seq_cst);
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(&header_->wake_seq), FUTEX_WAKE, wake_num,
+          nullptr, nullptr, 0);
+}
+
+template<typename T>
+bool ShmRing<T>::TryReceive(T* item, int64_t timeout_us, ChannelStatus* status) {
+  if (!WaitUntilReadyOrClosed(timeout_us)) { return false; }
+  if (!IsReady()) {
+    *status = kChannelStatusErrorClosed;
+    return true;
+  }
+  const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  Cell* cell = &cells_[tail % header_->capacity];
+  *item = cell->data;
+  cell->seq.store(tail + header_->capacity, std::memory_order_release);
+  header_->tail.store(tail + 1, std::memory_order_relaxed);
+  *status = kChannelStatusSuccess;
+  return true;
+}
+
+template<typename T>
+ChannelStatus ShmRing<T>::Receive(T* item) {
+  ChannelStatus status = kChannelStatusSuccess;
+  while (!TryReceive(item, -1, &status)) {}
+  return status;
+}
+
+template<typename T>
+void ShmRing<T>::Notify() {
+  is_notified_.store(true, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header_->is_receiver_parked.load(std::memory_order_seq_cst)) { WakeReceiver(1); }
+}
+
+template<typename T>
+void ShmRing<T>::Close() {
+  header_->is_closed.store(1, std::memory_order_seq_cst);
+  WakeReceiver(INT32_MAX);
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_RING_H_
@@ -0,0 +1,133 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/shm/shm_ring.h"
+#include "oneflow/core/comm_network/shm/shm_segment.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <sys/wait.h>
+
+namespace oneflow {
+
+namespace {
+
+std::string GenTestSegmentName(const std::string& suffix) {
+  return "/oneflow_shm_ring_test_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+ChannelStatus SendUntilAccepted(ShmRing<int64_t>* ring, int64_t val) {
+  ChannelStatus status = kChannelStatusSuccess;
+  while (!ring->TrySend(val, &status)) { std::this_thread::yield(); }
+  return status;
+}
+
+}  // namespace
+
+TEST(ShmRing, cross_process_fifo) {
+  const int64_t msg_num = 100000;
+  ShmSegment segment(GenTestSegmentName("fifo"), ShmRing<int64_t>::ByteSize(64));
+  ShmRing<int64_t>::Init(segment.ptr(), 64);
+  pid_t pid = fork();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    ShmRing<int64_t> ring(segment.ptr());
+    FOR_RANGE(int64_t, i, 0, msg_num) {
+      CHECK_EQ(SendUntilAccepted(&ring, i), kChannelStatusSuccess);
+    }
+    ring.Close();
+    _exit(0);
+  }
+  ShmRing<int64_t> ring(segment.ptr());
+  ASSERT_EQ(ring.capacity(), 64);
+  int64_t val = -1;
+  FOR_RANGE(int64_t, i, 0, msg_num) {
+    ASSERT_EQ(ring.Receive(&val), kChannelStatusSuccess);
+    ASSERT_EQ(val, i);
+  }
+  ASSERT_EQ(ring.Receive(&val), kChannelStatusErrorClosed);
+  int status = -1;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(ShmRing, multi_thread_senders) {
+  const int64_t sender_num = 4;
+  const int64_t range_num = 20000;
+  ShmSegment segment(GenTestSegmentName("senders"), ShmRing<int64_t>::ByteSize(16));
+  ShmRing<int64_t>::Init(segment.ptr(), 16);
+  ShmRing<int64_t> send_ring(segment.ptr());
+  ShmRing<int64_t> recv_ring(segment.ptr());
+  std::vector<std::thread> senders;
+  FOR_RANGE(int64_t, i, 0, sender_num) {
+    senders.push_back(std::thread([&send_ring, i, range_num]() {
+      FOR_RANGE(int64_t, j, 0, range_num) { SendUntilAccepted(&send_ring, i * range_num + j); }
+    }));
+  }
+  std::vector<int64_t> last_received(sender_num, -1);
+  FOR_RANGE(int64_t, i, 0, sender_num * range_num) {
+    int64_t val = -1;
+    ASSERT_EQ(recv_ring.Receive(&val), kChannelStatusSuccess);
+    const int64_t sender_id = val / range_num;
+    ASSERT_EQ(val % range_num, last_received.at(sender_id) + 1);
+    last_received.at(sender_id) = val % range_num;
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+}
+
+TEST(ShmRing, try_send_to_full_ring) {
+  ShmSegment segment(GenTestSegmentName("full"), ShmRing<int64_t>::ByteSize(4));
+  ShmRing<int64_t>::Init(segment.ptr(), 4);
+  ShmRing<int64_t> ring(segment.ptr());
+  ChannelStatus status = kChannelStatusErrorClosed;
+  FOR_RANGE(int64_t, i, 0, 4) {
+    ASSERT_TRUE(ring.TrySend(i, &status));
+    ASSERT_EQ(status, kChannelStatusSuccess);
+  }
+  ASSERT_FALSE(ring.TrySend(4, &status));
+  int64_t val = -1;
+  ASSERT_EQ(ring.Receive(&val), kChannelStatusSuccess);
+  ASSERT_EQ(val, 0);
+  ASSERT_TRUE(ring.TrySend(4, &status));
+  FOR_RANGE(int64_t, i, 1, 5) {
+    ASSERT_EQ(ring.Receive(&val), kChannelStatusSuccess);
+    ASSERT_EQ(val, i);
+  }
+  ASSERT_FALSE(ring.TryReceive(&val, 1000, &status));
+  ring.Close();
+  ASSERT_TRUE(ring.TrySend(5, &status));
+  ASSERT_EQ(status, kChannelStatusErrorClosed);
+  ASSERT_TRUE(ring.TryReceive(&val, 1000, &status));
+  ASSERT_EQ(status, kChannelStatusErrorClosed);
+}
+
+TEST(ShmRing, notify_wakes_parked_receiver) {
+  ShmSegment segment(GenTestSegmentName("notify"), ShmRing<int64_t>::ByteSize(4));
+  ShmRing<int64_t>::Init(segment.ptr(), 4);
+  ShmRing<int64_t> ring(segment.ptr());
+  std::thread notifier([&ring]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ring.Notify();
+  });
+  int64_t val = -1;
+  ChannelStatus status = kChannelStatusSuccess;
+  ASSERT_FALSE(ring.TryReceive(&val, -1, &status));
+  notifier.join();
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -0,0 +1,65 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/shm/shm_segment.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+ShmSegment::ShmSegment(const std::string& name, size_t byte_size)
+    : name_(name), byte_size_(byte_size), is_linked_by_me_(true) {
+  CHECK_GT(byte_size_, 0);
+  int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  PCHECK(fd != -1) << "shm_open " << name_;
+  PCHECK(ftruncate(fd, byte_size_) == 0) << "ftruncate " << name_;
+  void* ptr = mmap(nullptr, byte_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  PCHECK(ptr != MAP_FAILED) << "mmap " << name_;
+  PCHECK(close(fd) == 0);
+  ptr_ = static_cast<char*>(ptr);
+}
+
+ShmSegment::ShmSegment(const std::string& name) : name_(name), is_linked_by_me_(false) {
+  int fd = shm_open(name_.c_str(), O_RDWR, 0);
+  PCHECK(fd != -1) << "shm_open " << name_;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0);
+  byte_size_ = st.st_size;
+  CHECK_GT(byte_size_, 0);
+  void* ptr = mmap(nullptr, byte_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  PCHECK(ptr != MAP_FAILED) << "mmap " << name_;
+  PCHECK(close(fd) == 0);
+  ptr_ = static_cast<char*>(ptr);
+}
+
+ShmSegment::~ShmSegment() {
+  PCHECK(munmap(ptr_, byte_size_) == 0);
+  if (is_linked_by_me_) { Unlink(); }
+}
+
+void ShmSegment::Unlink() {
+  CHECK(is_linked_by_me_);
+  PCHECK(shm_unlink(name_.c_str()) == 0) << "shm_unlink " << name_;
+  is_linked_by_me_ = false;
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -0,0 +1,55 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_SEGMENT_H_
+#define ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_SEGMENT_H_
+
+#include "oneflow/core/common/platform.h"
+#include "oneflow/core/common/util.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// A named POSIX shared memory object mapped into this process.
+class ShmSegment final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmSegment);
+  ShmSegment() = delete;
+  // creates a zero filled segment, the creator unlinks the name on destruction
+  ShmSegment(const std::string& name, size_t byte_size);
+  // maps a segment created by another process
+  explicit ShmSegment(const std::string& name);
+  ~ShmSegment();
+
+  // the mapping stays valid after the name is removed
+  void Unlink();
+
+  const std::string& name() const { return name_; }
+  char* ptr() const { return ptr_; }
+  size_t byte_size() const { return byte_size_; }
+
+ private:
+  std::string name_;
+  char* ptr_;
+  size_t byte_size_;
+  bool is_linked_by_me_;
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_SHM_SHM_SEGMENT_H_
@@ -0,0 +1,228 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_MPSC_MAILBOX_H_
+#define ONEFLOW_CORE_COMMON_MPSC_MAILBOX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+// Lock-free multi-producer/single-consumer queue with the same interface as Channel.
+// Producers claim a ring slot with one CAS and never take a lock unless the consumer is parked
+// or the ring is full. A full ring spills into a mutex-protected overflow list, so Send never
+// blocks and, like Channel, the mailbox is unbounded. The consumer spins for a while before
+// parking on a condition variable.
+template<typename T>
+class MpscMailbox final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MpscMailbox);
+  MpscMailbox() = delete;
+  explicit MpscMailbox(size_t capacity) : MpscMailbox(capacity, DefaultSpinCount()) {}
+  MpscMailbox(size_t capacity, int64_t spin_count);
+  ~MpscMailbox() = default;
+
+  ChannelStatus Send(const T& item);
+  // returns false if the ring is full, never blocks and never spills into the overflow list
+  bool TrySend(const T& item, ChannelStatus* status);
+  ChannelStatus Receive(T* item);
+  ChannelStatus ReceiveMany(std::queue<T>* items);
+  void Close();
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  static const size_t kCacheLineSize = 64;
+
+  // spinning only pays off when producers can run while the consumer spins
+  static int64_t DefaultSpinCount() { return std::thread::hardware_concurrency() > 1 ? 4096 : 0; }
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t ret = 1;
+    while (ret < n) { ret <<= 1; }
+    return ret;
+  }
+
+  bool TryPop(T* item);
+  // pops the ring first, a sender only spills after all its msgs in the ring were claimed
+  bool TryPopRingOrOverflow(T* item);
+  void WaitUntilReadyOrClosed();
+  void NotifyConsumerIfParked();
+
+  std::vector<Cell> cells_;
+  const size_t mask_;
+  const int64_t spin_count_;
+  char pad0_[kCacheLineSize];
+  std::atomic<size_t> enqueue_pos_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  size_t dequeue_pos_;
+  char pad2_[kCacheLineSize - sizeof(size_t)];
+  std::atomic<bool> is_closed_;
+  std::atomic<bool> is_consumer_parked_;
+  std::mutex overflow_mutex_;
+  std::deque<T> overflow_;
+  // size of overflow_, senders keep spilling while it is not zero to preserve their order
+  std::atomic<size_t> overflow_cnt_;
+  std::mutex park_mutex_;
+  std::condition_variable park_cond_;
+};
+
+template<typename T>
+MpscMailbox<T>::MpscMailbox(size_t capacity, int64_t spin_count)
+    : cells_(RoundUpToPowerOfTwo(capacity)),
+      mask_(cells_.size() - 1),
+      spin_count_(spin_count),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      is_closed_(false),
+      is_consumer_parked_(false),
+      overflow_cnt_(0) {
+  CHECK_GE(capacity, 2);
+  FOR_RANGE(size_t, i, 0, cells_.size()) { cells_.at(i).seq.store(i, std::memory_order_relaxed); }
+}
+
+template<typename T>
+bool MpscMailbox<T>::TrySend(const T& item, ChannelStatus* status) {
+  if (is_closed_.load(std::memory_order_acquire)) {
+    *status = kChannelStatusErrorClosed;
+    return true;
+  }
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t seq = cell->seq.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = item;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  NotifyConsumerIfParked();
+  *status = kChannelStatusSuccess;
+  return true;
+}
+
+template<typename T>
+ChannelStatus MpscMailbox<T>::Send(const T& item) {
+  ChannelStatus status = kChannelStatusSuccess;
+  if (overflow_cnt_.load(std::memory_order_acquire) == 0 && TrySend(item, &status)) {
+    return status;
+  }
+  {
+    std::unique_lock<std::mutex> lock(overflow_mutex_);
+    if (is_closed_.load(std::memory_order_acquire)) { return kChannelStatusErrorClosed; }
+    overflow_.push_back(item);
+    overflow_cnt_.store(overflow_.size(), std::memory_order_release);
+  }
+  NotifyConsumerIfParked();
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+bool MpscMailbox<T>::TryPop(T* item) {
+  Cell* cell = &cells_[dequeue_pos_ & mask_];
+  if (cell->seq.load(std::memory_order_acquire) != dequeue_pos_ + 1) { return false; }
+  *item = std::move(cell->data);
+  cell->seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+  dequeue_pos_ += 1;
+  return true;
+}
+
+template<typename T>
+bool MpscMailbox<T>::TryPopRingOrOverflow(T* item) {
+  if (TryPop(item)) { return true; }
+  if (overflow_cnt_.load(std::memory_order_acquire) == 0) { return false; }
+  // slots claimed before the spill may still be unpublished, their producers are between the
+  // CAS and the seq store and finish soon
+  const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+  while (dequeue_pos_ < enqueue_pos) {
+    if (TryPop(item)) { return true; }
+  }
+  std::unique_lock<std::mutex> lock(overflow_mutex_);
+  *item = std::move(overflow_.front());
+  overflow_.pop_front();
+  overflow_cnt_.store(overflow_.size(), std::memory_order_release);
+  return true;
+}
+
+template<typename T>
+void MpscMailbox<T>::WaitUntilReadyOrClosed() {
+  auto IsReadyOrClosed = [this]() {
+    const Cell& cell = cells_[dequeue_pos_ & mask_];
+    return cell.seq.load(std::memory_order_acquire) == dequeue_pos_ + 1
+           || overflow_cnt_.load(std::memory_order_acquire) > 0
+           || is_closed_.load(std::memory_order_acquire);
+  };
+  FOR_RANGE(int64_t, i, 0, spin_count_) {
+    if (IsReadyOrClosed()) { return; }
+  }
+  std::unique_lock<std::mutex> lock(park_mutex_);
+  is_consumer_parked_.store(true, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  park_cond_.wait(lock, IsReadyOrClosed);
+  is_consumer_parked_.store(false, std::memory_order_relaxed);
+}
+
+template<typename T>
+void MpscMailbox<T>::NotifyConsumerIfParked() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (is_consumer_parked_.load(std::memory_order_seq_cst)) {
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    park_cond_.notify_one();
+  }
+}
+
+template<typename T>
+ChannelStatus MpscMailbox<T>::Receive(T* item) {
+  WaitUntilReadyOrClosed();
+  if (!TryPopRingOrOverflow(item)) { return kChannelStatusErrorClosed; }
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+ChannelStatus MpscMailbox<T>::ReceiveMany(std::queue<T>* items) {
+  WaitUntilReadyOrClosed();
+  T item;
+  if (!TryPopRingOrOverflow(&item)) { return kChannelStatusErrorClosed; }
+  items->push(std::move(item));
+  while (TryPopRingOrOverflow(&item)) { items->push(std::move(item)); }
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+void MpscMailbox<T>::Close() {
+  {
+    std::unique_lock<std::mutex> lock(overflow_mutex_);
+    is_closed_.store(true, std::memory_order_seq_cst);
+  }
+  std::unique_lock<std::mutex> lock(park_mutex_);
+  park_cond_.notify_all();
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_MPSC_MAILBOX_H_
@@ -0,0 +1,88 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/mpsc_mailbox.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+namespace {
+
+const int kSenderNum = 8;
+const int kMsgNumPerSender = 20000;
+const int kPingPongNum = 2000;
+
+template<typename ChannelT>
+double MeasureThroughput(ChannelT* chan) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> senders;
+  FOR_RANGE(int, i, 0, kSenderNum) {
+    senders.push_back(std::thread([chan]() {
+      FOR_RANGE(int, j, 0, kMsgNumPerSender) { CHECK_EQ(chan->Send(j), kChannelStatusSuccess); }
+    }));
+  }
+  std::queue<int> items;
+  int64_t received = 0;
+  while (received < kSenderNum * kMsgNumPerSender) {
+    CHECK_EQ(chan->ReceiveMany(&items), kChannelStatusSuccess);
+    received += items.size();
+    while (!items.empty()) { items.pop(); }
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return received / elapsed.count();
+}
+
+template<typename ChannelT>
+double MeasureRoundTripUs(ChannelT* ping, ChannelT* pong) {
+  std::thread echo([ping, pong]() {
+    int val = 0;
+    while (ping->Receive(&val) == kChannelStatusSuccess) { pong->Send(val); }
+  });
+  auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int, i, 0, kPingPongNum) {
+    int val = -1;
+    ping->Send(i);
+    CHECK_EQ(pong->Receive(&val), kChannelStatusSuccess);
+    CHECK_EQ(val, i);
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  ping->Close();
+  echo.join();
+  return elapsed.count() / kPingPongNum;
+}
+
+}  // namespace
+
+TEST(MpscMailbox, benchmark_against_channel) {
+  Channel<int> channel;
+  MpscMailbox<int> mailbox(8192);
+  const double channel_throughput = MeasureThroughput(&channel);
+  const double mailbox_throughput = MeasureThroughput(&mailbox);
+  Channel<int> channel_ping;
+  Channel<int> channel_pong;
+  MpscMailbox<int> mailbox_ping(1024);
+  MpscMailbox<int> mailbox_pong(1024);
+  const double channel_rtt_us = MeasureRoundTripUs(&channel_ping, &channel_pong);
+  const double mailbox_rtt_us = MeasureRoundTripUs(&mailbox_ping, &mailbox_pong);
+  LOG(INFO) << "Channel throughput: " << channel_throughput << " msg/s, round trip "
+            << channel_rtt_us << " us";
+  LOG(INFO) << "MpscMailbox throughput: " << mailbox_throughput << " msg/s, round trip "
+            << mailbox_rtt_us << " us";
+  mailbox_pong.Close();
+  channel_pong.Close();
+}
+
+}  // namespace oneflow
@@ -0,0 +1,112 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/mpsc_mailbox.h"
+
+namespace oneflow {
+
+TEST(MpscMailbox, fifo_and_close) {
+  MpscMailbox<int> mailbox(4);
+  ASSERT_EQ(mailbox.capacity(), 4);
+  ChannelStatus status;
+  FOR_RANGE(int, i, 0, 4) {
+    ASSERT_TRUE(mailbox.TrySend(i, &status));
+    ASSERT_EQ(status, kChannelStatusSuccess);
+  }
+  ASSERT_FALSE(mailbox.TrySend(4, &status));
+  int val = -1;
+  ASSERT_EQ(mailbox.Receive(&val), kChannelStatusSuccess);
+  ASSERT_EQ(val, 0);
+  ASSERT_EQ(mailbox.Send(4), kChannelStatusSuccess);
+  mailbox.Close();
+  ASSERT_EQ(mailbox.Send(5), kChannelStatusErrorClosed);
+  std::queue<int> items;
+  ASSERT_EQ(mailbox.ReceiveMany(&items), kChannelStatusSuccess);
+  ASSERT_EQ(items.size(), 4);
+  FOR_RANGE(int, i, 1, 5) {
+    ASSERT_EQ(items.front(), i);
+    items.pop();
+  }
+  ASSERT_EQ(mailbox.Receive(&val), kChannelStatusErrorClosed);
+}
+
+TEST(MpscMailbox, overflow) {
+  MpscMailbox<int> mailbox(4);
+  ChannelStatus status;
+  // sends spill instead of blocking once the ring is full
+  FOR_RANGE(int, i, 0, 100) { ASSERT_EQ(mailbox.Send(i), kChannelStatusSuccess); }
+  ASSERT_FALSE(mailbox.TrySend(100, &status));
+  int val = -1;
+  FOR_RANGE(int, i, 0, 50) {
+    ASSERT_EQ(mailbox.Receive(&val), kChannelStatusSuccess);
+    ASSERT_EQ(val, i);
+  }
+  FOR_RANGE(int, i, 100, 110) { ASSERT_EQ(mailbox.Send(i), kChannelStatusSuccess); }
+  std::queue<int> items;
+  ASSERT_EQ(mailbox.ReceiveMany(&items), kChannelStatusSuccess);
+  ASSERT_EQ(items.size(), 60);
+  FOR_RANGE(int, i, 50, 110) {
+    ASSERT_EQ(items.front(), i);
+    items.pop();
+  }
+  // the ring is used again once the overflow is drained
+  ASSERT_TRUE(mailbox.TrySend(110, &status));
+  ASSERT_EQ(mailbox.Receive(&val), kChannelStatusSuccess);
+  ASSERT_EQ(val, 110);
+}
+
+TEST(MpscMailbox, cross_send_to_full_mailboxes) {
+  // two consumers that only receive after sending to each other's full mailbox
+  MpscMailbox<int> lhs(4);
+  MpscMailbox<int> rhs(4);
+  const int msg_num = 1000;
+  auto SendThenReceive = [msg_num](MpscMailbox<int>* out, MpscMailbox<int>* in) {
+    FOR_RANGE(int, i, 0, msg_num) { CHECK_EQ(out->Send(i), kChannelStatusSuccess); }
+    FOR_RANGE(int, i, 0, msg_num) {
+      int val = -1;
+      CHECK_EQ(in->Receive(&val), kChannelStatusSuccess);
+      CHECK_EQ(val, i);
+    }
+  };
+  std::thread lhs_thread(SendThenReceive, &rhs, &lhs);
+  std::thread rhs_thread(SendThenReceive, &lhs, &rhs);
+  lhs_thread.join();
+  rhs_thread.join();
+}
+
+TEST(MpscMailbox, multi_sender_per_sender_order) {
+  // a small ring makes the senders spill into the overflow list
+  MpscMailbox<int> mailbox(8, 16);
+  const int sender_num = 16;
+  const int range_num = 5000;
+  std::vector<std::thread> senders;
+  FOR_RANGE(int, i, 0, sender_num) {
+    senders.push_back(std::thread([&mailbox, i, range_num]() {
+      FOR_RANGE(int, j, 0, range_num) { mailbox.Send(i * range_num + j); }
+    }));
+  }
+  std::vector<int> last_received(sender_num, -1);
+  FOR_RANGE(int, i, 0, sender_num * range_num) {
+    int val = -1;
+    ASSERT_EQ(mailbox.Receive(&val), kChannelStatusSuccess);
+    const int sender_id = val / range_num;
+    ASSERT_EQ(val % range_num, last_received.at(sender_id) + 1);
+    last_received.at(sender_id) = val % range_num;
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  for (int last : last_received) { ASSERT_EQ(last, range_num - 1); }
+}
+
+}  // namespace oneflow
@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/core/common/shape.h"
 #include "oneflow/core/common/data_type.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/common/tensor_buffer_pool.h"
 #include "oneflow/core/memory/memory_allocator.h"
 
 namespace oneflow {
@@ -31,13 +32,18 @@ inline void CheckTensorBufferDataType(DataType val) {
 class TensorBuffer {
  public:
   struct Deleter {
-    void operator()(void* ptr) { MemoryAllocatorImpl::DeallocateUnPinnedHostMem(ptr); }
+    void operator()(void* ptr) { TensorBufferPool::Get()->Deallocate(ptr, num_bytes); }
+    size_t num_bytes;
   };
   typedef std::unique_ptr<void, Deleter> BufferType;
 
   OF_DISALLOW_COPY_AND_MOVE(TensorBuffer);
   TensorBuffer()
-      : data_(nullptr), num_bytes_(0), shape_(Shape()), data_type_(DataType::kInvalidDataType) {}
+      : data_(nullptr, Deleter{0}),
+        view_ptr_(nullptr),
+        num_bytes_(0),
+        shape_(Shape()),
+        data_type_(DataType::kInvalidDataType) {}
   virtual ~TensorBuffer() = default;
 
   const Shape& shape() const { return shape_; }
@@ -57,29 +63,36 @@ class TensorBuffer {
 
   template<typename T = void>
   inline T* mut_data() {
-    if (data_ == nullptr) { return nullptr; }
+    void* ptr = is_view() ? view_ptr_ : data_.get();
+    if (ptr == nullptr) { return nullptr; }
     CheckDataType<T>(data_type_);
-    return static_cast<T*>(data_.get());
+    return static_cast<T*>(ptr);
   }
 
   template<typename T = void>
   inline const T* data() const {
-    if (data_ == nullptr) { return nullptr; }
+    const void* ptr = is_view() ? view_ptr_ : data_.get();
+    if (ptr == nullptr) { return nullptr; }
     CheckDataType<T>(data_type_);
-    return static_cast<const T*>(data_.get());
+    return static_cast<const T*>(ptr);
   }
 
   void reset() {
     shape_ = Shape();
+    DropView();
     data_.reset();
     data_type_ = DataType::kInvalidDataType;
     num_bytes_ = 0;
   }
 
   void reserve(size_t new_num_bytes) {
+    DropView();
     if (new_num_bytes <= num_bytes_) { return; }
     data_.reset();
-    data_.reset(MemoryAllocatorImpl::AllocateUnPinnedHostMem(new_num_bytes));
+    // the pool hands out whole size classes, the slack is usable capacity
+    new_num_bytes = TensorBufferPool::Get()->RoundUpToClassSize(new_num_bytes);
+    data_.get_deleter().num_bytes = new_num_bytes;
+    data_.reset(TensorBufferPool::Get()->Allocate(new_num_bytes));
     num_bytes_ = new_num_bytes;
   }
 
@@ -87,6 +100,7 @@ class TensorBuffer {
 
   size_t nbytes() const { return elem_cnt() * GetSizeOfDataType(data_type_); }
 
+  // bytes of the owned buffer, a view does not count
   size_t capacity() const { return num_bytes_; }
 
   void Resize(const Shape& new_shape) { Resize(new_shape, data_type_); }
@@ -95,6 +109,7 @@ class TensorBuffer {
     int64_t elem_cnt = new_shape.elem_cnt();
     if (new_type == DataType::kInvalidDataType || elem_cnt == 0) { return; }
     CheckTensorBufferDataType(new_type);
+    DropView();
 
     data_type_ = new_type;
     shape_ = new_shape;
@@ -112,6 +127,20 @@ class TensorBuffer {
     }
   }
 
+  // Points the buffer at memory kept alive by holder instead of owning a copy. The owned buffer
+  // is kept for later use, Resize, reserve and reset() drop the view.
+  void ResetToView(const Shape& shape, DataType data_type, void* ptr,
+                   std::shared_ptr<const void> holder) {
+    CheckTensorBufferDataType(data_type);
+    CHECK(ptr != nullptr);
+    view_ptr_ = ptr;
+    view_holder_ = std::move(holder);
+    shape_ = shape;
+    data_type_ = data_type;
+  }
+
+  bool is_view() const { return view_ptr_ != nullptr; }
+
   void CopyFrom(const TensorBuffer& src) {
     if (&src == this) { return; }
     Resize(src.shape(), src.data_type());
@@ -120,18 +149,29 @@ class TensorBuffer {
 
   void Swap(TensorBuffer* lhs) {
     data_.swap(lhs->data_);
+    std::swap(view_ptr_, lhs->view_ptr_);
     std::swap(num_bytes_, lhs->num_bytes_);
     std::swap(shape_, lhs->shape_);
     std::swap(data_type_, lhs->data_type_);
+    view_holder_.swap(lhs->view_holder_);
   }
 
  private:
+  void DropView() {
+    view_ptr_ = nullptr;
+    view_holder_.reset();
+  }
+
   // TODO(chengcheng)
   static double growth_factor_;
   static double shrink_threshold_;
   static constexpr size_t kTensorBufferAlignedSize = 1024;
 
+  // always memory of the pool, never a view
   BufferType data_;
+  // set when the buffer is a view into memory it does not own, view_holder_ keeps it alive
+  void* view_ptr_;
+  std::shared_ptr<const void> view_holder_;
   size_t num_bytes_;
   Shape shape_;
   DataType data_type_;
@@ -0,0 +1,212 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/tensor_buffer_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+const size_t kClassNumPerDoubling = 4;
+const size_t kThreadCacheBytePerClass = 4 << 20;
+const size_t kMaxThreadCacheBlockNumPerClass = 64;
+const int64_t kCounterFlushInterval = 256;
+
+}  // namespace
+
+const size_t TensorBufferPool::kMinClassByte;
+const size_t TensorBufferPool::kMaxClassByte;
+const size_t TensorBufferPool::kMaxCentralCacheByte;
+
+struct TensorBufferPool::ThreadCache {
+  explicit ThreadCache(TensorBufferPool* pool)
+      : pool(pool), free_lists(pool->class_sizes_.size()), alloc_cnt(0), hit_cnt(0) {}
+  // a finished thread hands its blocks to the threads still running
+  ~ThreadCache() {
+    FOR_RANGE(size_t, class_id, 0, free_lists.size()) {
+      const std::vector<void*>& free_list = free_lists.at(class_id);
+      if (free_list.empty()) { continue; }
+      pool->SpillToCentralList(class_id, free_list.data(), free_list.size());
+    }
+    pool->FlushCounters(this);
+  }
+
+  TensorBufferPool* pool;
+  std::vector<std::vector<void*>> free_lists;
+  int64_t alloc_cnt;
+  int64_t hit_cnt;
+};
+
+TensorBufferPool* TensorBufferPool::Get() {
+  // never destroyed, thread caches may return blocks during process exit
+  static TensorBufferPool* pool = new TensorBufferPool();
+  return pool;
+}
+
+TensorBufferPool::TensorBufferPool()
+    : alloc_cnt_(0),
+      hit_cnt_(0),
+      reserved_byte_(0),
+      peak_reserved_byte_(0),
+      central_cached_byte_(0) {
+  for (size_t base = kMinClassByte; base < kMaxClassByte; base *= 2) {
+    FOR_RANGE(size_t, i, 0, kClassNumPerDoubling) {
+      class_sizes_.push_back(base + i * base / kClassNumPerDoubling);
+    }
+  }
+  class_sizes_.push_back(kMaxClassByte);
+  FOR_RANGE(size_t, i, 0, class_sizes_.size()) { central_lists_.emplace_back(new CentralList()); }
+}
+
+int32_t TensorBufferPool::ClassId4Size(size_t byte_size) const {
+  auto it = std::lower_bound(class_sizes_.begin(), class_sizes_.end(), byte_size);
+  if (it == class_sizes_.end()) { return -1; }
+  return it - class_sizes_.begin();
+}
+
+size_t TensorBufferPool::RoundUpToClassSize(size_t byte_size) const {
+  const int32_t class_id = ClassId4Size(byte_size);
+  return class_id == -1 ? byte_size : class_sizes_.at(class_id);
+}
+
+size_t TensorBufferPool::ThreadCacheCapacity(int32_t class_id) const {
+  return std::min(kMaxThreadCacheBlockNumPerClass,
+                  kThreadCacheBytePerClass / class_sizes_[class_id]);
+}
+
+TensorBufferPool::ThreadCache* TensorBufferPool::GetThreadCache() {
+  thread_local ThreadCache cache(this);
+  return &cache;
+}
+
+void* TensorBufferPool::MallocBlock(size_t byte_size) {
+  void* ptr = malloc(byte_size);
+  CHECK_NOTNULL(ptr);
+  const int64_t reserved_byte =
+      reserved_byte_.fetch_add(byte_size, std::memory_order_relaxed) + byte_size;
+  int64_t peak = peak_reserved_byte_.load(std::memory_order_relaxed);
+  while (reserved_byte > peak
+         && !peak_reserved_byte_.compare_exchange_weak(peak, reserved_byte,
+                                                       std::memory_order_relaxed)) {}
+  return ptr;
+}
+
+void TensorBufferPool::FreeBlock(void* ptr, size_t byte_size) {
+  free(ptr);
+  reserved_byte_.fetch_sub(byte_size, std::memory_order_relaxed);
+}
+
+void TensorBufferPool::SpillToCentralList(int32_t class_id, void* const* blocks,
+                                          size_t block_num) {
+  const size_t byte_size = class_sizes_.at(class_id);
+  CentralList* central_list = central_lists_.at(class_id).get();
+  std::unique_lock<std::mutex> lock(central_list->mutex);
+  FOR_RANGE(size_t, i, 0, block_num) {
+    const int64_t cached_byte =
+        central_cached_byte_.fetch_add(byte_size, std::memory_order_relaxed) + byte_size;
+    if (cached_byte <= static_cast<int64_t>(kMaxCentralCacheByte)) {
+      central_list->blocks.push_back(blocks[i]);
+    } else {
+      central_cached_byte_.fetch_sub(byte_size, std::memory_order_relaxed);
+      FreeBlock(blocks[i], byte_size);
+    }
+  }
+}
+
+void TensorBufferPool::FlushCounters(ThreadCache* cache) {
+  alloc_cnt_.fetch_add(cache->alloc_cnt, std::memory_order_relaxed);
+  hit_cnt_.fetch_add(cache->hit_cnt, std::memory_order_relaxed);
+  cache->alloc_cnt = 0;
+  cache->hit_cnt = 0;
+}
+
+void* TensorBufferPool::Allocate(size_t byte_size) {
+  const int32_t class_id = ClassId4Size(byte_size);
+  if (class_id == -1) {
+    alloc_cnt_.fetch_add(1, std::memory_order_relaxed);
+    return MallocBlock(byte_size);
+  }
+  CHECK_EQ(class_sizes_.at(class_id), byte_size);
+  ThreadCache* cache = GetThreadCache();
+  std::vector<void*>* free_list = &cache->free_lists.at(class_id);
+  if (free_list->empty()) {
+    // refill half of the thread cache in one go, or take a single block if the class bypasses it
+    CentralList* central_list = central_lists_.at(class_id).get();
+    std::unique_lock<std::mutex> lock(central_list->mutex);
+    const size_t refill_num = std::min(
+        central_list->blocks.size(), std::max<size_t>((ThreadCacheCapacity(class_id) + 1) / 2, 1));
+    free_list->insert(free_list->end(), central_list->blocks.end() - refill_num,
+                      central_list->blocks.end());
+    central_list->blocks.resize(central_list->blocks.size() - refill_num);
+    central_cached_byte_.fetch_sub(refill_num * byte_size, std::memory_order_relaxed);
+  }
+  void* ptr = nullptr;
+  if (free_list->empty()) {
+    ptr = MallocBlock(byte_size);
+  } else {
+    ptr = free_list->back();
+    free_list->pop_back();
+    cache->hit_cnt += 1;
+  }
+  cache->alloc_cnt += 1;
+  if (cache->alloc_cnt >= kCounterFlushInterval) { FlushCounters(cache); }
+  return ptr;
+}
+
+void TensorBufferPool::Deallocate(void* ptr, size_t byte_size) {
+  if (ptr == nullptr) { return; }
+  const int32_t class_id = ClassId4Size(byte_size);
+  if (class_id == -1) {
+    FreeBlock(ptr, byte_size);
+    return;
+  }
+  CHECK_EQ(class_sizes_.at(class_id), byte_size);
+  const size_t capacity = ThreadCacheCapacity(class_id);
+  if (capacity == 0) {
+    SpillToCentralList(class_id, &ptr, 1);
+    return;
+  }
+  std::vector<void*>* free_list = &GetThreadCache()->free_lists.at(class_id);
+  free_list->push_back(ptr);
+  if (free_list->size() > capacity) {
+    // keep half so that alternating frees and allocations stay thread local
+    const size_t spill_num = free_list->size() - capacity / 2;
+    SpillToCentralList(class_id, free_list->data() + free_list->size() - spill_num, spill_num);
+    free_list->resize(free_list->size() - spill_num);
+  }
+}
+
+TensorBufferPool::Stats TensorBufferPool::GetStats() const {
+  Stats stats;
+  stats.alloc_cnt = alloc_cnt_.load(std::memory_order_relaxed);
+  stats.hit_cnt = hit_cnt_.load(std::memory_order_relaxed);
+  stats.reserved_byte = reserved_byte_.load(std::memory_order_relaxed);
+  stats.peak_reserved_byte = peak_reserved_byte_.load(std::memory_order_relaxed);
+  stats.central_cached_byte = central_cached_byte_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void TensorBufferPool::ReleaseCentralCache() {
+  FOR_RANGE(size_t, class_id, 0, central_lists_.size()) {
+    CentralList* central_list = central_lists_.at(class_id).get();
+    std::unique_lock<std::mutex> lock(central_list->mutex);
+    for (void* ptr : central_list->blocks) { FreeBlock(ptr, class_sizes_.at(class_id)); }
+    central_cached_byte_.fetch_sub(central_list->blocks.size() * class_sizes_.at(class_id),
+                                   std::memory_order_relaxed);
+    central_list->blocks.clear();
+  }
+}
+
+}  // namespace oneflow
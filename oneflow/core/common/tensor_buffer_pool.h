@@ -0,0 +1,93 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_TENSOR_BUFFER_POOL_H_
+#define ONEFLOW_CORE_COMMON_TENSOR_BUFFER_POOL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Size-class pool behind TensorBuffer storage. Requests are rounded up to one of four classes
+// per power of two. Freed blocks go to a small per-thread cache first and spill over to a
+// per-class central list, so the data pipeline threads rarely reach malloc or each other.
+// Classes too large for a thread cache use the central lists only. The central lists hold at
+// most kMaxCentralCacheByte, blocks freed beyond that go back to malloc. Blocks larger than the
+// biggest class are malloc'ed and freed directly.
+class TensorBufferPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TensorBufferPool);
+  ~TensorBufferPool() = delete;
+
+  struct Stats {
+    int64_t alloc_cnt;
+    // served from a thread cache or a central list instead of malloc
+    int64_t hit_cnt;
+    // bytes malloc'ed by the pool and not freed yet, cached blocks included
+    int64_t reserved_byte;
+    int64_t peak_reserved_byte;
+    // bytes of the blocks in the central lists
+    int64_t central_cached_byte;
+  };
+
+  static TensorBufferPool* Get();
+
+  // returns the byte size of the block that serves a request of byte_size
+  size_t RoundUpToClassSize(size_t byte_size) const;
+  // byte_size must be what RoundUpToClassSize returned
+  void* Allocate(size_t byte_size);
+  void Deallocate(void* ptr, size_t byte_size);
+
+  // hit and alloc counts of running threads are flushed every few hundred allocations
+  Stats GetStats() const;
+  // frees the blocks in the central lists, thread caches are left alone
+  void ReleaseCentralCache();
+
+  static const size_t kMinClassByte = 1024;
+  static const size_t kMaxClassByte = 64 << 20;
+  static const size_t kMaxCentralCacheByte = 512 << 20;
+
+ private:
+  struct CentralList {
+    std::mutex mutex;
+    std::vector<void*> blocks;
+  };
+  struct ThreadCache;
+
+  TensorBufferPool();
+
+  // -1 if byte_size is larger than the largest class
+  int32_t ClassId4Size(size_t byte_size) const;
+  // 0 for the classes that bypass the thread caches
+  size_t ThreadCacheCapacity(int32_t class_id) const;
+  ThreadCache* GetThreadCache();
+  // moves the blocks to the central list of class_id, frees those beyond kMaxCentralCacheByte
+  void SpillToCentralList(int32_t class_id, void* const* blocks, size_t block_num);
+  void* MallocBlock(size_t byte_size);
+  void FreeBlock(void* ptr, size_t byte_size);
+  void FlushCounters(ThreadCache* cache);
+
+  std::vector<size_t> class_sizes_;
+  std::vector<std::unique_ptr<CentralList>> central_lists_;
+  std::atomic<int64_t> alloc_cnt_;
+  std::atomic<int64_t> hit_cnt_;
+  std::atomic<int64_t> reserved_byte_;
+  std::atomic<int64_t> peak_reserved_byte_;
+  std::atomic<int64_t> central_cached_byte_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_TENSOR_BUFFER_POOL_H_
@@ -0,0 +1,138 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/tensor_buffer_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+const int kThreadNum = 8;
+const int kRoundNum = 200;
+const int kBufferNumPerRound = 256;
+
+// every thread allocates a batch of image-sized blocks, touches them and frees them, as the
+// data pipeline does for each batch
+template<typename AllocateT, typename DeallocateT>
+double MeasureAllocPerSecond(const AllocateT& Allocate, const DeallocateT& Deallocate) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  FOR_RANGE(int, t, 0, kThreadNum) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      std::vector<std::pair<void*, size_t>> blocks(kBufferNumPerRound);
+      FOR_RANGE(int, round, 0, kRoundNum) {
+        for (auto& block : blocks) {
+          block.second = 1024 + gen() % (512 * 1024);
+          block.first = Allocate(&block.second);
+          static_cast<char*>(block.first)[0] = 1;
+        }
+        for (auto& block : blocks) { Deallocate(block.first, block.second); }
+      }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return kThreadNum * kRoundNum * kBufferNumPerRound / elapsed.count();
+}
+
+}  // namespace
+
+TEST(TensorBufferPool, size_classes) {
+  TensorBufferPool* pool = TensorBufferPool::Get();
+  ASSERT_EQ(pool->RoundUpToClassSize(1), TensorBufferPool::kMinClassByte);
+  ASSERT_EQ(pool->RoundUpToClassSize(1024), 1024);
+  ASSERT_EQ(pool->RoundUpToClassSize(1025), 1280);
+  ASSERT_EQ(pool->RoundUpToClassSize(3 << 20), 3 << 20);
+  ASSERT_EQ(pool->RoundUpToClassSize((3 << 20) + 1), (7 << 20) / 2);
+  ASSERT_EQ(pool->RoundUpToClassSize(TensorBufferPool::kMaxClassByte),
+            TensorBufferPool::kMaxClassByte);
+  ASSERT_EQ(pool->RoundUpToClassSize(TensorBufferPool::kMaxClassByte + 1),
+            TensorBufferPool::kMaxClassByte + 1);
+  for (size_t byte_size = 1; byte_size < (1 << 20); byte_size = byte_size * 3 / 2 + 1) {
+    const size_t class_size = pool->RoundUpToClassSize(byte_size);
+    ASSERT_GE(class_size, byte_size);
+    ASSERT_LE(class_size, std::max<size_t>(byte_size * 5 / 4, TensorBufferPool::kMinClassByte));
+  }
+}
+
+TEST(TensorBufferPool, reuse_and_stats) {
+  TensorBufferPool* pool = TensorBufferPool::Get();
+  const size_t byte_size = pool->RoundUpToClassSize(100 * 1000);
+  void* ptr = pool->Allocate(byte_size);
+  pool->Deallocate(ptr, byte_size);
+  const TensorBufferPool::Stats before = pool->GetStats();
+  // the same thread gets its block back without touching malloc
+  ASSERT_EQ(pool->Allocate(byte_size), ptr);
+  const int64_t reserved_byte = pool->GetStats().reserved_byte;
+  ASSERT_EQ(reserved_byte, before.reserved_byte);
+  // a block freed on another thread is reused there
+  std::thread([&]() {
+    pool->Deallocate(ptr, byte_size);
+    void* other = pool->Allocate(byte_size);
+    ASSERT_EQ(other, ptr);
+    pool->Deallocate(other, byte_size);
+  }).join();
+  ASSERT_EQ(pool->GetStats().reserved_byte, reserved_byte);
+  // large blocks bypass the pool
+  const size_t large_byte_size = TensorBufferPool::kMaxClassByte * 2;
+  void* large = pool->Allocate(large_byte_size);
+  ASSERT_EQ(pool->GetStats().reserved_byte, reserved_byte + large_byte_size);
+  pool->Deallocate(large, large_byte_size);
+  ASSERT_EQ(pool->GetStats().reserved_byte, reserved_byte);
+  ASSERT_GE(pool->GetStats().peak_reserved_byte, reserved_byte + large_byte_size);
+}
+
+TEST(TensorBufferPool, central_cache_limit) {
+  TensorBufferPool* pool = TensorBufferPool::Get();
+  pool->ReleaseCentralCache();
+  const size_t byte_size = TensorBufferPool::kMaxClassByte;
+  const size_t block_num = TensorBufferPool::kMaxCentralCacheByte / byte_size + 2;
+  const int64_t reserved_byte = pool->GetStats().reserved_byte;
+  std::vector<void*> blocks;
+  FOR_RANGE(size_t, i, 0, block_num) { blocks.push_back(pool->Allocate(byte_size)); }
+  // the largest classes bypass the thread cache, so freed blocks are visible centrally at once
+  pool->Deallocate(blocks.front(), byte_size);
+  ASSERT_EQ(pool->GetStats().central_cached_byte, byte_size);
+  FOR_RANGE(size_t, i, 1, block_num) { pool->Deallocate(blocks.at(i), byte_size); }
+  const TensorBufferPool::Stats stats = pool->GetStats();
+  ASSERT_EQ(stats.central_cached_byte, TensorBufferPool::kMaxCentralCacheByte);
+  ASSERT_EQ(stats.reserved_byte, reserved_byte + TensorBufferPool::kMaxCentralCacheByte);
+  pool->ReleaseCentralCache();
+  ASSERT_EQ(pool->GetStats().central_cached_byte, 0);
+  ASSERT_EQ(pool->GetStats().reserved_byte, reserved_byte);
+}
+
+TEST(TensorBufferPool, benchmark_against_malloc) {
+  TensorBufferPool* pool = TensorBufferPool::Get();
+  const double malloc_per_second = MeasureAllocPerSecond(
+      [](size_t* byte_size) { return malloc(*byte_size); },
+      [](void* ptr, size_t byte_size) { free(ptr); });
+  const TensorBufferPool::Stats before = pool->GetStats();
+  const double pool_per_second = MeasureAllocPerSecond(
+      [pool](size_t* byte_size) {
+        *byte_size = pool->RoundUpToClassSize(*byte_size);
+        return pool->Allocate(*byte_size);
+      },
+      [pool](void* ptr, size_t byte_size) { pool->Deallocate(ptr, byte_size); });
+  const TensorBufferPool::Stats after = pool->GetStats();
+  LOG(INFO) << "malloc: " << malloc_per_second << " alloc/s";
+  LOG(INFO) << "TensorBufferPool: " << pool_per_second << " alloc/s, hit rate "
+            << static_cast<double>(after.hit_cnt - before.hit_cnt)
+                   / (after.alloc_cnt - before.alloc_cnt)
+            << ", peak reserved " << after.peak_reserved_byte << " B";
+}
+
+}  // namespace oneflow
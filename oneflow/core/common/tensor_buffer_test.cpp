@@ -0,0 +1,54 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/tensor_buffer.h"
+
+namespace oneflow {
+
+TEST(TensorBuffer, view_does_not_own_memory) {
+  TensorBuffer buffer;
+  buffer.Resize(Shape({4096}), DataType::kChar);
+  void* owned = buffer.mut_data();
+  const size_t capacity = buffer.capacity();
+  std::shared_ptr<std::vector<char>> mem(new std::vector<char>(100));
+  buffer.ResetToView(Shape({100}), DataType::kChar, mem->data(), mem);
+  ASSERT_TRUE(buffer.is_view());
+  ASSERT_EQ(buffer.data(), mem->data());
+  ASSERT_EQ(buffer.capacity(), capacity);
+  ASSERT_EQ(mem.use_count(), 2);
+  // the owned buffer is reused once the view is dropped, the viewed memory is never freed
+  buffer.Resize(Shape({4096}), DataType::kChar);
+  ASSERT_FALSE(buffer.is_view());
+  ASSERT_EQ(buffer.mut_data(), owned);
+  ASSERT_EQ(mem.use_count(), 1);
+  buffer.ResetToView(Shape({100}), DataType::kChar, mem->data(), mem);
+  buffer.reset();
+  ASSERT_EQ(buffer.data(), nullptr);
+  ASSERT_EQ(mem.use_count(), 1);
+}
+
+TEST(TensorBuffer, swap_view) {
+  TensorBuffer lhs;
+  TensorBuffer rhs;
+  rhs.Resize(Shape({10}), DataType::kChar);
+  std::shared_ptr<std::vector<char>> mem(new std::vector<char>(10));
+  lhs.ResetToView(Shape({10}), DataType::kChar, mem->data(), mem);
+  lhs.Swap(&rhs);
+  ASSERT_FALSE(lhs.is_view());
+  ASSERT_TRUE(rhs.is_view());
+  ASSERT_EQ(rhs.data(), mem->data());
+}
+
+}  // namespace oneflow
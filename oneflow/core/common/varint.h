@@ -0,0 +1,64 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_VARINT_H_
+#define ONEFLOW_CORE_COMMON_VARINT_H_
+
+#include <cstdint>
+#include <string>
+
+namespace oneflow {
+
+// LEB128 as in protobuf: 7 bits per byte, low bits first, high bit set on all but the last byte.
+
+const int kMaxVarint64Bytes = 10;
+
+inline void AppendVarint64(uint64_t val, std::string* buf) {
+  while (val >= 0x80) {
+    buf->push_back(static_cast<char>(val | 0x80));
+    val >>= 7;
+  }
+  buf->push_back(static_cast<char>(val));
+}
+
+// returns false on truncated or overlong input and leaves *ptr untouched
+inline bool ReadVarint64(const char** ptr, const char* end, uint64_t* val) {
+  uint64_t result = 0;
+  const char* cur = *ptr;
+  for (int i = 0; i < kMaxVarint64Bytes && cur < end; ++i) {
+    const uint64_t byte = static_cast<uint8_t>(*cur++);
+    if (i == kMaxVarint64Bytes - 1 && byte > 1) { return false; }
+    result |= (byte & 0x7f) << (7 * i);
+    if (byte < 0x80) {
+      *val = result;
+      *ptr = cur;
+      return true;
+    }
+  }
+  return false;
+}
+
+// maps small negative values such as -1 to small unsigned ones
+inline uint64_t ZigZagEncode64(int64_t val) {
+  return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+inline int64_t ZigZagDecode64(uint64_t val) {
+  return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_VARINT_H_
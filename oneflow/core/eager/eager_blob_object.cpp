@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/eager/eager_blob_object.h"
 #include "oneflow/core/vm/allocator.h"
+#include "oneflow/core/vm/cpu_allocator.h"
 #include "oneflow/core/job/parallel_desc.h"
 #include "oneflow/core/framework/to_string.h"
 
@@ -32,8 +33,14 @@ Maybe<void> EagerBlobObject::InitBlob() {
   {
     header_buffer_.reset();
     int64_t header_byte_size = rt_blob_desc_->ByteSizeOfBlobHeader();
-    const auto& FreeHeader = [header_byte_size](char* dptr) { std::free(dptr); };
-    char* ptr = reinterpret_cast<char*>(std::malloc(header_byte_size));
+    // headers are small and allocated for every op output, the size classes of CpuAllocator
+    // serve them from a thread local free list
+    vm::Allocator* header_allocator = Global<vm::CpuAllocator>::Get();
+    const auto& FreeHeader = [header_allocator, header_byte_size](char* dptr) {
+      header_allocator->Deallocate(dptr, header_byte_size);
+    };
+    char* ptr = nullptr;
+    header_allocator->Allocate(&ptr, header_byte_size);
     header_buffer_ = std::unique_ptr<char, std::function<void(char*)>>(ptr, FreeHeader);
   }
   blob_.reset(new Blob(*mem_case_, rt_blob_desc_.get(), header_buffer_.get(), nullptr));
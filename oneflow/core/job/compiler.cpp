@@ -18,9 +18,36 @@ limitations under the License.
 #include "oneflow/core/persistence/tee_persistent_log_stream.h"
 #include "oneflow/core/graph/op_graph.h"
 #include "oneflow/core/job_rewriter/job_completer.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
+CompilePhaseTimer::CompilePhaseTimer(int64_t job_id, Plan* plan)
+    : job_id_(job_id), plan_(plan), last_time_(std::chrono::steady_clock::now()) {}
+
+void CompilePhaseTimer::Tick(const std::string& phase) {
+  const auto now = std::chrono::steady_clock::now();
+  CompilePhaseTime* phase_time =
+      (*plan_->mutable_compile_times()->mutable_job_id2compile_time())[job_id_].add_phase_time();
+  phase_time->set_phase(phase);
+  phase_time->set_seconds(std::chrono::duration<double>(now - last_time_).count());
+  last_time_ = now;
+}
+
+void LogCompilePhaseTimes(int64_t job_id, const Plan& plan) {
+  const auto& job_id2compile_time = plan.compile_times().job_id2compile_time();
+  const auto it = job_id2compile_time.find(job_id);
+  if (it == job_id2compile_time.end()) { return; }
+  double total_seconds = 0;
+  for (const CompilePhaseTime& phase_time : it->second.phase_time()) {
+    total_seconds += phase_time.seconds();
+  }
+  LOG(INFO) << "compile time of job " << job_id << ": " << total_seconds << "s";
+  for (const CompilePhaseTime& phase_time : it->second.phase_time()) {
+    LOG(INFO) << "  " << phase_time.phase() << ": " << phase_time.seconds() << "s";
+  }
+}
+
 void Compiler::GenNetTopo(Plan* plan) const {
   HashMap<int64_t, int64_t> rid2mid;
   HashMap<int64_t, int64_t> tid2mid;
@@ -64,32 +91,57 @@ void Compiler::GenNetTopo(Plan* plan) const {
 
 void Compiler::Compile(Job* job, Plan* plan, bool need_job_complete) const {
   const JobDesc& job_desc = GlobalJobDesc();
-  if (need_job_complete) { JobCompleter().Complete(job); }
+  CompilePhaseTimer timer(job_desc.job_id(), plan);
+  if (need_job_complete) {
+    JobCompleter().Complete(job);
+    timer.Tick("JobCompleter");
+  }
   Global<OpGraph>::New(*job);
+  timer.Tick("OpGraph");
   if (Global<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
     TeePersistentLogStream::Create(StrCat("optimized_job", job_desc.job_id()))->Write(*job);
     Global<OpGraph>::Get()->ToDotWithFilePath("optimized_dlnet_" + std::to_string(job_desc.job_id())
                                               + "_op_graph.dot");
+    timer.Tick("DebugDump");
   }
   auto logical_gph = std::make_unique<LogicalGraph>(*job);
+  timer.Tick("LogicalGraph");
   auto task_gph = std::make_unique<TaskGraph>(std::move(logical_gph));
+  timer.Tick("TaskGraph");
+  // regst desc ids, exec node ids and the names of the system ops built by boxing and copy
+  // task nodes are all drawn from global counters, so these stages stay serial to keep the plan
+  // deterministic
   using std::placeholders::_1;
   task_gph->ForEachNode(std::bind(&TaskNode::ProduceAllRegstsAndBindEdges, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::ConsumeAllRegsts, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::PinConsumedRegst, _1));
+  timer.Tick("ProduceAndConsumeRegsts");
   task_gph->TopoForEachNode(&TaskNode::Build);
+  timer.Tick("Build");
   task_gph->RemoveEmptyRegsts();
   task_gph->MergeChainAndAddOrderingCtrlEdgeInSameChain();
+  timer.Tick("MergeChain");
   if (job_desc.enable_inplace()) {
     auto IsReachable = Global<OpGraph>::Get()->MakePredicatorIsOpNameDataOrCtrlReachable();
     task_gph->EnableInplaceMemSharing(IsReachable);
+    timer.Tick("InplaceMemSharing");
   }
   task_gph->TopoForEachNode(&TaskNode::InferTimeShapeIfMeaningful);
+  timer.Tick("InferTimeShape");
 
+  // kernel conf generation only reads the task graph, so every task is serialized in parallel
+  // into a slot reserved in ForEachNode order
+  std::vector<std::pair<TaskNode*, TaskProto*>> task_node7proto;
   task_gph->ForEachNode([&](TaskNode* task_node) {
     if (task_node->IsMeaningLess()) { return; }
-    task_node->ToProto(plan->mutable_task()->Add());
+    task_node7proto.emplace_back(task_node, plan->mutable_task()->Add());
+  });
+  ParallelFor(0, task_node7proto.size(), 1, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      task_node7proto.at(i).first->ToProto(task_node7proto.at(i).second);
+    }
   });
+  timer.Tick("ToProto");
   {
     auto* job_id2job_conf = plan->mutable_job_confs()->mutable_job_id2job_conf();
     (*job_id2job_conf)[GlobalJobDesc().job_id()] = GlobalJobDesc().job_conf();
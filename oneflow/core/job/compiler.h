@@ -33,6 +33,24 @@ class Compiler final {
   void GenNetTopo(Plan* plan) const;
 };
 
+// Appends the wall time of every compile phase of a job to plan->compile_times()
+class CompilePhaseTimer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CompilePhaseTimer);
+  CompilePhaseTimer(int64_t job_id, Plan* plan);
+  ~CompilePhaseTimer() = default;
+
+  // records the time since the last Tick (or the construction) as the time of phase
+  void Tick(const std::string& phase);
+
+ private:
+  int64_t job_id_;
+  Plan* plan_;
+  std::chrono::steady_clock::time_point last_time_;
+};
+
+void LogCompilePhaseTimes(int64_t job_id, const Plan& plan);
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_JOB_COMPILER_H_
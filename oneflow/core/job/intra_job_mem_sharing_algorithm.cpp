@@ -0,0 +1,452 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/intra_job_mem_sharing_algorithm.h"
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
+
+namespace oneflow {
+
+namespace {
+
+void MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(const std::vector<int64_t>& order,
+                                                          const MemChainRegstInfo& info,
+                                                          MemBlockResultInfo* result) {
+  std::vector<int64_t>* regst_offsets = &(result->regst_offsets);
+  regst_offsets->assign(info.regst_sizes.size(), -1);
+  int64_t buffer_size = 1;
+  std::vector<std::pair<int64_t, int64_t>> occupied_pieces;
+  for (int64_t regst : order) {
+    occupied_pieces.clear();
+    for (int64_t mutual_regst : info.regst2mutual_exclusion_regsts.at(regst)) {
+      int64_t begin = regst_offsets->at(mutual_regst);
+      if (begin == -1) { continue; }
+      int64_t end = begin + info.regst_sizes.at(mutual_regst);
+      CHECK(begin < end && end <= buffer_size);
+      occupied_pieces.emplace_back(begin, end);
+    }
+    std::sort(occupied_pieces.begin(), occupied_pieces.end());
+    // first fit: the lowest free piece that is large enough, or else the one at the end of the
+    // buffer, grown to the size needed
+    int64_t size = info.regst_sizes.at(regst);
+    int64_t free_begin = 0;
+    int64_t offset = -1;
+    for (const auto& piece : occupied_pieces) {
+      if (piece.first > free_begin && piece.first - free_begin >= size) {
+        offset = free_begin;
+        break;
+      }
+      free_begin = std::max(free_begin, piece.second);
+    }
+    if (offset == -1) {
+      offset = free_begin;
+      if (buffer_size - free_begin < size) { buffer_size = free_begin + size; }
+    }
+    CHECK(offset >= 0 && offset < buffer_size);
+    regst_offsets->at(regst) = offset;
+  }
+  result->mem_block_size = buffer_size;
+}
+
+// Best fit over the pieces of a growing buffer. The free pieces are indexed by (size, offset),
+// so a lookup picks the smallest one that fits and the lowest offset among equals.
+class BfcAllocator final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(BfcAllocator);
+  explicit BfcAllocator(int64_t size) : buffer_size_(size) {
+    offset2piece_.emplace(0, Piece{size, true});
+    free_pieces_.emplace(size, 0);
+  }
+  ~BfcAllocator() = default;
+
+  // Return offset of the buffer for this allocate size memory
+  int64_t AllocateRaw(int64_t size);
+  void FreeRaw(int64_t offset, int64_t size);
+  int64_t buffer_size() const { return buffer_size_; }
+
+ private:
+  struct Piece {
+    int64_t end;
+    bool is_free;
+  };
+  using PieceIt = std::map<int64_t, Piece>::iterator;
+
+  static int64_t PieceSize(PieceIt it) { return it->second.end - it->first; }
+  void EraseFreePiece(PieceIt it) { CHECK_EQ(free_pieces_.erase({PieceSize(it), it->first}), 1); }
+  void InsertFreePiece(PieceIt it) { CHECK(free_pieces_.emplace(PieceSize(it), it->first).second); }
+
+  int64_t buffer_size_;
+  std::map<int64_t, Piece> offset2piece_;
+  std::set<std::pair<int64_t, int64_t>> free_pieces_;
+};
+
+int64_t BfcAllocator::AllocateRaw(int64_t size) {
+  CHECK_GT(size, 0);
+  int64_t offset = -1;
+  auto candidate = free_pieces_.lower_bound({size, 0});
+  if (candidate == free_pieces_.end()) {
+    PieceIt last_it = std::prev(offset2piece_.end());
+    if (last_it->second.is_free) {
+      offset = last_it->first;
+      EraseFreePiece(last_it);
+      last_it->second.is_free = false;
+      last_it->second.end = offset + size;
+    } else {
+      offset = buffer_size_;
+      offset2piece_.emplace(offset, Piece{offset + size, false});
+    }
+    buffer_size_ = offset + size;
+  } else {
+    int64_t piece_size = candidate->first;
+    offset = candidate->second;
+    free_pieces_.erase(candidate);
+    PieceIt it = offset2piece_.find(offset);
+    CHECK(it != offset2piece_.end());
+    if (piece_size > size) {
+      PieceIt rest_it = offset2piece_.emplace_hint(std::next(it), offset + size,
+                                                   Piece{it->second.end, true});
+      InsertFreePiece(rest_it);
+      it->second.end = offset + size;
+    }
+    it->second.is_free = false;
+  }
+  return offset;
+}
+
+void BfcAllocator::FreeRaw(int64_t offset, int64_t size) {
+  PieceIt it = offset2piece_.find(offset);
+  CHECK(it != offset2piece_.end());
+  CHECK(it->second.is_free == false);
+  CHECK_EQ(PieceSize(it), size);
+  it->second.is_free = true;
+  // free pieces never touch each other, so only the neighbors can merge
+  PieceIt next_it = std::next(it);
+  if (next_it != offset2piece_.end() && next_it->second.is_free) {
+    EraseFreePiece(next_it);
+    it->second.end = next_it->second.end;
+    offset2piece_.erase(next_it);
+  }
+  if (it != offset2piece_.begin()) {
+    PieceIt prev_it = std::prev(it);
+    if (prev_it->second.is_free) {
+      EraseFreePiece(prev_it);
+      prev_it->second.end = it->second.end;
+      offset2piece_.erase(it);
+      it = prev_it;
+    }
+  }
+  InsertFreePiece(it);
+}
+
+// Alloc and free index of every regst on the timeline
+void GetRegstLifetimes(const MemChainRegstInfo& info, std::vector<int64_t>* alloc_indexes,
+                       std::vector<int64_t>* free_indexes) {
+  alloc_indexes->assign(info.regst_sizes.size(), -1);
+  free_indexes->assign(info.regst_sizes.size(), -1);
+  for (int64_t i = 0; i < info.alloc_regsts_timeline.size(); ++i) {
+    for (int64_t regst : info.alloc_regsts_timeline.at(i)) { alloc_indexes->at(regst) = i; }
+    for (int64_t regst : info.free_regsts_timeline.at(i)) { free_indexes->at(regst) = i; }
+  }
+}
+
+// Total size of the regsts alive after the allocs of every task
+std::vector<int64_t> GetTimelineBreadths(const MemChainRegstInfo& info) {
+  std::vector<int64_t> breadths(info.alloc_regsts_timeline.size());
+  int64_t alive_size = 0;
+  for (int64_t i = 0; i < breadths.size(); ++i) {
+    for (int64_t regst : info.alloc_regsts_timeline.at(i)) {
+      alive_size += info.regst_sizes.at(regst);
+    }
+    breadths.at(i) = alive_size;
+    for (int64_t regst : info.free_regsts_timeline.at(i)) {
+      alive_size -= info.regst_sizes.at(regst);
+    }
+  }
+  return breadths;
+}
+
+// Places the regsts one by one into the smallest gap that fits among their placed mutual
+// exclusions, on top of them if there is none. Only order[first_pos:] is placed, the others keep
+// their offsets. peaks->at(i) is the peak once order[i] is placed. The mutual exclusions looked
+// at are added to visit_num, they are what the placement costs.
+int64_t PlaceByOrderWithBestFit(const std::vector<int64_t>& order, int64_t first_pos,
+                                const MemChainRegstInfo& info, std::vector<int64_t>* regst_offsets,
+                                std::vector<int64_t>* peaks, int64_t* visit_num) {
+  if (first_pos == 0) {
+    regst_offsets->assign(info.regst_sizes.size(), -1);
+    peaks->assign(order.size(), 0);
+  }
+  for (int64_t i = first_pos; i < order.size(); ++i) { regst_offsets->at(order.at(i)) = -1; }
+  int64_t peak = first_pos == 0 ? 0 : peaks->at(first_pos - 1);
+  std::vector<std::pair<int64_t, int64_t>> occupied_pieces;
+  for (int64_t i = first_pos; i < order.size(); ++i) {
+    const int64_t regst = order.at(i);
+    occupied_pieces.clear();
+    *visit_num += 1 + info.regst2mutual_exclusion_regsts.at(regst).size();
+    for (int64_t mutual_regst : info.regst2mutual_exclusion_regsts.at(regst)) {
+      int64_t begin = regst_offsets->at(mutual_regst);
+      if (begin == -1) { continue; }
+      occupied_pieces.emplace_back(begin, begin + info.regst_sizes.at(mutual_regst));
+    }
+    std::sort(occupied_pieces.begin(), occupied_pieces.end());
+    int64_t size = info.regst_sizes.at(regst);
+    int64_t free_begin = 0;
+    int64_t offset = -1;
+    int64_t best_free_size = std::numeric_limits<int64_t>::max();
+    for (const auto& piece : occupied_pieces) {
+      int64_t free_size = piece.first - free_begin;
+      if (free_size >= size && free_size < best_free_size) {
+        offset = free_begin;
+        best_free_size = free_size;
+      }
+      free_begin = std::max(free_begin, piece.second);
+    }
+    if (offset == -1) { offset = free_begin; }
+    regst_offsets->at(regst) = offset;
+    peak = std::max(peak, offset + size);
+    peaks->at(i) = peak;
+  }
+  return peak;
+}
+
+// Greedy by breadth: the regsts alive at the most crowded task go first, then those at the next
+// crowded one and so on, the larger ones first within a task
+std::vector<int64_t> GenGreedyByBreadthOrder(const MemChainRegstInfo& info,
+                                             const std::vector<int64_t>& alloc_indexes,
+                                             const std::vector<int64_t>& free_indexes) {
+  const std::vector<int64_t> breadths = GetTimelineBreadths(info);
+  const int64_t task_num = breadths.size();
+  std::vector<int64_t> sorted_tasks(task_num);
+  std::iota(sorted_tasks.begin(), sorted_tasks.end(), 0);
+  std::stable_sort(sorted_tasks.begin(), sorted_tasks.end(),
+                   [&](int64_t lhs, int64_t rhs) { return breadths.at(lhs) > breadths.at(rhs); });
+  // sparse table of the min task rank over [i, i + 2^level)
+  std::vector<std::vector<int64_t>> min_ranks(1, std::vector<int64_t>(task_num));
+  for (int64_t rank = 0; rank < task_num; ++rank) {
+    min_ranks.at(0).at(sorted_tasks.at(rank)) = rank;
+  }
+  for (int64_t level = 1; (int64_t(1) << level) <= task_num; ++level) {
+    const std::vector<int64_t>& pre = min_ranks.at(level - 1);
+    const int64_t half = int64_t(1) << (level - 1);
+    std::vector<int64_t> cur(task_num - 2 * half + 1);
+    for (int64_t i = 0; i < cur.size(); ++i) { cur.at(i) = std::min(pre.at(i), pre.at(i + half)); }
+    min_ranks.push_back(std::move(cur));
+  }
+  const int64_t regst_num = info.regst_sizes.size();
+  std::vector<int64_t> regst2rank(regst_num);
+  for (int64_t regst = 0; regst < regst_num; ++regst) {
+    const int64_t begin = alloc_indexes.at(regst);
+    const int64_t len = free_indexes.at(regst) - begin + 1;
+    int64_t level = 0;
+    while ((int64_t(2) << level) <= len) { ++level; }
+    const std::vector<int64_t>& ranks = min_ranks.at(level);
+    regst2rank.at(regst) =
+        std::min(ranks.at(begin), ranks.at(begin + len - (int64_t(1) << level)));
+  }
+  std::vector<int64_t> order(regst_num);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    if (regst2rank.at(lhs) != regst2rank.at(rhs)) {
+      return regst2rank.at(lhs) < regst2rank.at(rhs);
+    }
+    if (info.regst_sizes.at(lhs) != info.regst_sizes.at(rhs)) {
+      return info.regst_sizes.at(lhs) > info.regst_sizes.at(rhs);
+    }
+    return lhs < rhs;
+  });
+  return order;
+}
+
+// Greedy by size: the larger regsts first, the longer lived ones first among equals
+std::vector<int64_t> GenGreedyBySizeOrder(const MemChainRegstInfo& info,
+                                          const std::vector<int64_t>& alloc_indexes,
+                                          const std::vector<int64_t>& free_indexes) {
+  std::vector<int64_t> order(info.regst_sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto Lifetime = [&](int64_t regst) { return free_indexes.at(regst) - alloc_indexes.at(regst); };
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    if (info.regst_sizes.at(lhs) != info.regst_sizes.at(rhs)) {
+      return info.regst_sizes.at(lhs) > info.regst_sizes.at(rhs);
+    }
+    if (Lifetime(lhs) != Lifetime(rhs)) { return Lifetime(lhs) > Lifetime(rhs); }
+    return lhs < rhs;
+  });
+  return order;
+}
+
+void CheckNoMutualExclusionOverlaps(const MemChainRegstInfo& info,
+                                    const std::vector<int64_t>& regst_offsets) {
+  for (int64_t regst = 0; regst < info.regst_sizes.size(); ++regst) {
+    const int64_t begin = regst_offsets.at(regst);
+    const int64_t end = begin + info.regst_sizes.at(regst);
+    CHECK_GE(begin, 0);
+    for (int64_t mutual_regst : info.regst2mutual_exclusion_regsts.at(regst)) {
+      const int64_t mutual_begin = regst_offsets.at(mutual_regst);
+      CHECK(end <= mutual_begin || mutual_begin + info.regst_sizes.at(mutual_regst) <= begin);
+    }
+  }
+}
+
+}  // namespace
+
+void GenRegstMutualExclusions(MemChainRegstInfo* info) {
+  const int64_t regst_num = info->regst_sizes.size();
+  CHECK_EQ(info->alloc_regsts_timeline.size(), info->free_regsts_timeline.size());
+  info->regst2mutual_exclusion_regsts.assign(regst_num, std::vector<int64_t>());
+  std::vector<int64_t> remain_regsts;
+  // position of each regst in remain_regsts, -1 before it is allocated and -2 after it is freed
+  std::vector<int64_t> regst2remain_pos(regst_num, -1);
+  for (int64_t i = 0; i < info->alloc_regsts_timeline.size(); ++i) {
+    for (int64_t alloc_regst : info->alloc_regsts_timeline.at(i)) {
+      CHECK_EQ(regst2remain_pos.at(alloc_regst), -1);
+      std::vector<int64_t>* mutual_exclusion_regsts =
+          &info->regst2mutual_exclusion_regsts.at(alloc_regst);
+      mutual_exclusion_regsts->reserve(remain_regsts.size());
+      for (int64_t remain_regst : remain_regsts) {
+        mutual_exclusion_regsts->push_back(remain_regst);
+        info->regst2mutual_exclusion_regsts.at(remain_regst).push_back(alloc_regst);
+      }
+      regst2remain_pos.at(alloc_regst) = remain_regsts.size();
+      remain_regsts.push_back(alloc_regst);
+    }
+    for (int64_t free_regst : info->free_regsts_timeline.at(i)) {
+      int64_t pos = regst2remain_pos.at(free_regst);
+      CHECK_GE(pos, 0);
+      regst2remain_pos.at(remain_regsts.back()) = pos;
+      remain_regsts.at(pos) = remain_regsts.back();
+      remain_regsts.pop_back();
+      regst2remain_pos.at(free_regst) = -2;
+    }
+  }
+  CHECK(remain_regsts.empty());
+  for (int64_t pos : regst2remain_pos) { CHECK_EQ(pos, -2); }
+}
+
+void MemReusedAlgorithm_MemSizeFirstAlgo(const MemChainRegstInfo& info,
+                                         MemBlockResultInfo* result) {
+  std::vector<int64_t> order(info.regst_sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    return info.regst_sizes.at(lhs) > info.regst_sizes.at(rhs);
+  });
+  MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(order, info, result);
+}
+
+void MemReusedAlgorithm_MutualExclusionFirstAlgo(const MemChainRegstInfo& info,
+                                                 MemBlockResultInfo* result) {
+  std::vector<int64_t> order(info.regst_sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    return info.regst2mutual_exclusion_regsts.at(lhs).size()
+           < info.regst2mutual_exclusion_regsts.at(rhs).size();
+  });
+  MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(order, info, result);
+}
+
+void MemReusedAlgorithm_TimeLineAlgo(const MemChainRegstInfo& info, MemBlockResultInfo* result) {
+  std::vector<int64_t>* regst_offsets = &(result->regst_offsets);
+  regst_offsets->assign(info.regst_sizes.size(), -1);
+  BfcAllocator bfc_allocator(1);
+  CHECK_EQ(info.alloc_regsts_timeline.size(), info.free_regsts_timeline.size());
+  for (int64_t i = 0; i < info.alloc_regsts_timeline.size(); ++i) {
+    for (int64_t alloc_regst : info.alloc_regsts_timeline.at(i)) {
+      CHECK_EQ(regst_offsets->at(alloc_regst), -1);
+      regst_offsets->at(alloc_regst) = bfc_allocator.AllocateRaw(info.regst_sizes.at(alloc_regst));
+    }
+    for (int64_t free_regst : info.free_regsts_timeline.at(i)) {
+      CHECK_NE(regst_offsets->at(free_regst), -1);
+      bfc_allocator.FreeRaw(regst_offsets->at(free_regst), info.regst_sizes.at(free_regst));
+    }
+  }
+  result->mem_block_size = bfc_allocator.buffer_size();
+}
+
+void MemReusedAlgorithm_StripPackingAlgo(const MemChainRegstInfo& info, int64_t max_visit_num,
+                                         MemBlockResultInfo* result) {
+  // the local search gives up after this many tries in a row that find nothing lower
+  static const int64_t kMaxNoImprovementIterNum = 1024;
+  const int64_t regst_num = info.regst_sizes.size();
+  const int64_t lower_bound = MemBlockSizeLowerBound(info);
+  std::vector<int64_t> alloc_indexes;
+  std::vector<int64_t> free_indexes;
+  GetRegstLifetimes(info, &alloc_indexes, &free_indexes);
+
+  int64_t visit_num = 0;
+  std::vector<int64_t> best_order = GenGreedyByBreadthOrder(info, alloc_indexes, free_indexes);
+  std::vector<int64_t> best_offsets;
+  std::vector<int64_t> best_peaks;
+  int64_t best_peak = PlaceByOrderWithBestFit(best_order, 0, info, &best_offsets, &best_peaks,
+                                              &visit_num);
+  std::vector<int64_t> order = GenGreedyBySizeOrder(info, alloc_indexes, free_indexes);
+  std::vector<int64_t> offsets;
+  std::vector<int64_t> peaks;
+  int64_t peak = PlaceByOrderWithBestFit(order, 0, info, &offsets, &peaks, &visit_num);
+  if (peak < best_peak) {
+    best_order.swap(order);
+    best_offsets.swap(offsets);
+    best_peaks.swap(peaks);
+    best_peak = peak;
+  }
+
+  // Every step moves a regst on the peak to a random earlier place in the order, so it gets its
+  // offset before the regsts it competed with. Only the regsts from that place on are placed
+  // again. Steps that keep the peak are taken as well to let the search walk across plateaus.
+  std::mt19937_64 gen(regst_num);
+  std::vector<int64_t> peak_regst_positions;
+  int64_t no_improvement_iter_num = 0;
+  while (visit_num < max_visit_num && best_peak > lower_bound && regst_num > 1
+         && no_improvement_iter_num < kMaxNoImprovementIterNum) {
+    peak_regst_positions.clear();
+    for (int64_t i = 0; i < regst_num; ++i) {
+      int64_t regst = best_order.at(i);
+      if (best_offsets.at(regst) + info.regst_sizes.at(regst) == best_peak) {
+        peak_regst_positions.push_back(i);
+      }
+    }
+    const int64_t from = peak_regst_positions.at(gen() % peak_regst_positions.size());
+    const int64_t to = from == 0 ? 1 + gen() % (regst_num - 1) : gen() % from;
+    order = best_order;
+    offsets = best_offsets;
+    peaks = best_peaks;
+    if (to < from) {
+      std::rotate(order.begin() + to, order.begin() + from, order.begin() + from + 1);
+    } else {
+      std::swap(order.at(from), order.at(to));
+    }
+    peak = PlaceByOrderWithBestFit(order, std::min(from, to), info, &offsets, &peaks, &visit_num);
+    no_improvement_iter_num = peak < best_peak ? 0 : no_improvement_iter_num + 1;
+    if (peak <= best_peak) {
+      best_order.swap(order);
+      best_offsets.swap(offsets);
+      best_peaks.swap(peaks);
+      best_peak = peak;
+    }
+  }
+  CheckNoMutualExclusionOverlaps(info, best_offsets);
+  result->regst_offsets.swap(best_offsets);
+  result->mem_block_size = std::max<int64_t>(best_peak, 1);
+}
+
+int64_t MemBlockSizeLowerBound(const MemChainRegstInfo& info) {
+  int64_t lower_bound = 0;
+  for (int64_t breadth : GetTimelineBreadths(info)) {
+    lower_bound = std::max(lower_bound, breadth);
+  }
+  return lower_bound;
+}
+
+}  // namespace oneflow
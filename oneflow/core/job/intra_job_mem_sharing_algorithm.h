@@ -0,0 +1,61 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_H_
+#define ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// The mem reused regsts of one mem chain, numbered 0, 1, ..., regst_num - 1. Regsts that tie in
+// the order of an algorithm are placed by their numbers, so the numbering decides the result.
+struct MemChainRegstInfo {
+  std::vector<int64_t> regst_sizes;
+  // regsts allocated and freed by every task of the sorted mem chain
+  std::vector<std::vector<int64_t>> alloc_regsts_timeline;
+  std::vector<std::vector<int64_t>> free_regsts_timeline;
+  // regsts alive at the same time as each regst, in no particular order
+  std::vector<std::vector<int64_t>> regst2mutual_exclusion_regsts;
+};
+
+struct MemBlockResultInfo {
+  size_t mem_block_size = 0;
+  std::vector<int64_t> regst_offsets;
+};
+
+// Fills info->regst2mutual_exclusion_regsts from the alloc/free timelines
+void GenRegstMutualExclusions(MemChainRegstInfo* info);
+
+void MemReusedAlgorithm_MemSizeFirstAlgo(const MemChainRegstInfo& info,
+                                         MemBlockResultInfo* result);
+void MemReusedAlgorithm_MutualExclusionFirstAlgo(const MemChainRegstInfo& info,
+                                                 MemBlockResultInfo* result);
+void MemReusedAlgorithm_TimeLineAlgo(const MemChainRegstInfo& info, MemBlockResultInfo* result);
+
+// Treats the regsts as rectangles spanning their lifetimes on the timeline and packs them into
+// a strip as low as it can. The placement starts from greedy by breadth and greedy by size, then
+// a local search reorders the regsts on the peak until it has looked at max_visit_num mutual
+// exclusions, reached the lower bound or stopped improving. Unlike a time limit the budget keeps
+// the result a function of info and max_visit_num, so every run compiles the same plan.
+void MemReusedAlgorithm_StripPackingAlgo(const MemChainRegstInfo& info, int64_t max_visit_num,
+                                         MemBlockResultInfo* result);
+
+// The largest total size of the regsts alive at the same time, no algorithm can do better
+int64_t MemBlockSizeLowerBound(const MemChainRegstInfo& info);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_H_
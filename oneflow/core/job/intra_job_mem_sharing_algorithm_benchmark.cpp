@@ -0,0 +1,69 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/intra_job_mem_sharing_algorithm_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+double MeasureSeconds(const std::function<void()>& Run) {
+  auto start = std::chrono::steady_clock::now();
+  Run();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+}  // namespace
+
+TEST(IntraJobMemSharingAlgorithm, benchmark) {
+  std::mt19937_64 gen(1);
+  for (int64_t task_num : {2000, 8000, 20000}) {
+    MemChainRegstInfo info;
+    const double gen_seconds =
+        MeasureSeconds([&]() { info = GenSyntheticMemChain(task_num, 0, &gen); });
+    int64_t mutual_exclusion_num = 0;
+    for (const auto& regsts : info.regst2mutual_exclusion_regsts) {
+      mutual_exclusion_num += regsts.size();
+    }
+    LOG(INFO) << task_num << " tasks, " << info.regst_sizes.size() << " regsts, "
+              << mutual_exclusion_num / 2 << " mutual exclusions in " << gen_seconds << " s";
+    for (const auto& pair : Algo2NewAndListFn()) {
+      MemBlockResultInfo result;
+      const double seconds = MeasureSeconds([&]() { pair.second.first(info, &result); });
+      std::string list_based = "skipped";
+      // the list based mutual exclusion algorithms are quadratic in the live regsts
+      if (task_num <= 8000) {
+        MemBlockResultInfo expected;
+        const double list_seconds = MeasureSeconds([&]() { pair.second.second(info, &expected); });
+        ASSERT_EQ(result.regst_offsets, expected.regst_offsets) << pair.first;
+        list_based = std::to_string(list_seconds) + " s";
+      }
+      LOG(INFO) << "  " << pair.first << ": " << result.mem_block_size << " B in " << seconds
+                << " s, list based " << list_based;
+    }
+    MemBlockResultInfo result;
+    const double seconds =
+        MeasureSeconds([&]() { MemReusedAlgorithm_StripPackingAlgo(info, 16000000, &result); });
+    LOG(INFO) << "  StripPacking: " << result.mem_block_size << " B in " << seconds
+              << " s, lower bound " << MemBlockSizeLowerBound(info) << " B";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
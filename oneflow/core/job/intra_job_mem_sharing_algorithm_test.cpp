@@ -0,0 +1,129 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/intra_job_mem_sharing_algorithm_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(IntraJobMemSharingAlgorithm, mutual_exclusions) {
+  MemChainRegstInfo info;
+  info.regst_sizes = {1, 1, 1, 1};
+  info.alloc_regsts_timeline = {{0, 1}, {2}, {3}};
+  info.free_regsts_timeline = {{0}, {1, 2}, {3}};
+  GenRegstMutualExclusions(&info);
+  std::vector<std::vector<int64_t>> expected = {{1}, {0, 2}, {1}, {}};
+  FOR_RANGE(int64_t, i, 0, 4) {
+    std::vector<int64_t> mutual_exclusion_regsts = info.regst2mutual_exclusion_regsts.at(i);
+    std::sort(mutual_exclusion_regsts.begin(), mutual_exclusion_regsts.end());
+    ASSERT_EQ(mutual_exclusion_regsts, expected.at(i));
+  }
+}
+
+TEST(IntraJobMemSharingAlgorithm, same_as_list_based) {
+  std::mt19937_64 gen(0);
+  for (int64_t task_num : {1, 2, 5, 30, 200, 1000}) {
+    for (int64_t size_num : {0, 1, 3, 16}) {
+      FOR_RANGE(int64_t, repeat, 0, 4) {
+        MemChainRegstInfo info = GenSyntheticMemChain(task_num, size_num, &gen);
+        if (info.regst_sizes.empty()) { continue; }
+        for (const auto& pair : Algo2NewAndListFn()) {
+          MemBlockResultInfo result;
+          MemBlockResultInfo expected;
+          pair.second.first(info, &result);
+          pair.second.second(info, &expected);
+          ASSERT_EQ(result.mem_block_size, expected.mem_block_size) << pair.first;
+          ASSERT_EQ(result.regst_offsets, expected.regst_offsets) << pair.first;
+        }
+      }
+    }
+  }
+}
+
+TEST(IntraJobMemSharingAlgorithm, strip_packing_known_case) {
+  // regst 1 lives at tasks 0..2 and regst 3 at task 1, regst 0 at tasks 2..4 and regst 2 at
+  // tasks 4..5. Regsts 1 and 0 meet at task 2, so the lower bound of 4 needs them apart, which
+  // every greedy order misses.
+  MemChainRegstInfo info;
+  info.regst_sizes = {1, 1, 3, 3};
+  info.alloc_regsts_timeline = {{1}, {3}, {0}, {}, {2}, {}};
+  info.free_regsts_timeline = {{}, {3}, {1}, {}, {0}, {2}};
+  GenRegstMutualExclusions(&info);
+  ASSERT_EQ(MemBlockSizeLowerBound(info), 4);
+  for (const auto& pair : Algo2NewAndListFn()) {
+    MemBlockResultInfo heuristic_result;
+    pair.second.first(info, &heuristic_result);
+    ASSERT_EQ(heuristic_result.mem_block_size, 5) << pair.first;
+  }
+  MemBlockResultInfo greedy_result;
+  MemReusedAlgorithm_StripPackingAlgo(info, 0, &greedy_result);
+  ASSERT_EQ(greedy_result.mem_block_size, 5);
+  MemBlockResultInfo result;
+  MemReusedAlgorithm_StripPackingAlgo(info, 1000, &result);
+  ASSERT_EQ(result.mem_block_size, 4);
+  ASSERT_EQ(result.regst_offsets, std::vector<int64_t>({0, 3, 1, 0}));
+}
+
+TEST(IntraJobMemSharingAlgorithm, strip_packing) {
+  std::mt19937_64 gen(2);
+  int64_t chain_num = 0;
+  int64_t better_chain_num = 0;
+  int64_t worse_chain_num = 0;
+  for (int64_t task_num : {1, 2, 5, 30, 200, 1000}) {
+    for (int64_t size_num : {0, 1, 3, 16}) {
+      FOR_RANGE(int64_t, repeat, 0, 4) {
+        MemChainRegstInfo info = GenSyntheticMemChain(task_num, size_num, &gen);
+        if (info.regst_sizes.empty()) { continue; }
+        MemBlockResultInfo result;
+        MemReusedAlgorithm_StripPackingAlgo(info, 1000000, &result);
+        ASSERT_EQ(result.regst_offsets.size(), info.regst_sizes.size());
+        // the same plan on every run
+        MemBlockResultInfo rerun_result;
+        MemReusedAlgorithm_StripPackingAlgo(info, 1000000, &rerun_result);
+        ASSERT_EQ(rerun_result.regst_offsets, result.regst_offsets);
+        int64_t peak = 0;
+        FOR_RANGE(int64_t, regst, 0, info.regst_sizes.size()) {
+          const int64_t begin = result.regst_offsets.at(regst);
+          const int64_t end = begin + info.regst_sizes.at(regst);
+          ASSERT_GE(begin, 0);
+          peak = std::max(peak, end);
+          for (int64_t mutual_regst : info.regst2mutual_exclusion_regsts.at(regst)) {
+            const int64_t mutual_begin = result.regst_offsets.at(mutual_regst);
+            ASSERT_TRUE(end <= mutual_begin
+                        || mutual_begin + info.regst_sizes.at(mutual_regst) <= begin);
+          }
+        }
+        ASSERT_EQ(result.mem_block_size, std::max<int64_t>(peak, 1));
+        ASSERT_GE(result.mem_block_size, MemBlockSizeLowerBound(info));
+        size_t heuristic_size = std::numeric_limits<size_t>::max();
+        for (const auto& pair : Algo2NewAndListFn()) {
+          MemBlockResultInfo heuristic_result;
+          pair.second.first(info, &heuristic_result);
+          heuristic_size = std::min(heuristic_size, heuristic_result.mem_block_size);
+        }
+        chain_num += 1;
+        if (result.mem_block_size < heuristic_size) { better_chain_num += 1; }
+        if (result.mem_block_size > heuristic_size) { worse_chain_num += 1; }
+      }
+    }
+  }
+  LOG(INFO) << "strip packing is smaller on " << better_chain_num << " and larger on "
+            << worse_chain_num << " of " << chain_num << " chains";
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,260 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_TEST_UTIL_H_
+#define ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_TEST_UTIL_H_
+
+#include "oneflow/core/job/intra_job_mem_sharing_algorithm.h"
+#include <numeric>
+
+namespace oneflow {
+
+namespace test {
+
+// helpers shared by the intra_job_mem_sharing_algorithm test and benchmark
+
+// The list based allocators the algorithms used before, kept as the reference of the offsets
+
+struct Piece {
+  int64_t begin;
+  int64_t end;
+  bool is_free;
+};
+
+class ListMemBlockBuffer final {
+ public:
+  explicit ListMemBlockBuffer(int64_t size) : buffer_size_(size) {
+    piece_list_.push_back(Piece{0, size, true});
+  }
+
+  void Occupy(int64_t begin, int64_t end) {
+    CHECK(begin < end && end <= buffer_size_);
+    for (auto it = piece_list_.begin(); it != piece_list_.end(); ++it) {
+      if (it->end <= begin) { continue; }
+      if (end <= it->begin) { break; }
+      if (it->is_free) {
+        if (begin != it->begin) {
+          Piece free_piece{it->begin, begin, true};
+          it->begin = begin;
+          it = piece_list_.insert(it, free_piece);
+        } else if (end < it->end) {
+          Piece busy_piece{it->begin, end, false};
+          it->begin = end;
+          it = piece_list_.insert(it, busy_piece);
+          begin = end;
+        } else {
+          it->is_free = false;
+          begin = it->end;
+        }
+      } else {
+        begin = it->end;
+        end = std::max(begin, end);
+      }
+    }
+    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
+      auto pre_it = std::prev(it);
+      if (it->is_free == pre_it->is_free) {
+        it->begin = pre_it->begin;
+        piece_list_.erase(pre_it);
+      }
+    }
+  }
+
+  void FindFreeOffsetAndNewBufferSize(int64_t size, int64_t* offset, int64_t* new_buffer_size) {
+    for (const Piece& piece : piece_list_) {
+      if (piece.is_free && piece.end - piece.begin >= size) {
+        *offset = piece.begin;
+        *new_buffer_size = buffer_size_;
+        return;
+      }
+    }
+    const Piece& last = piece_list_.back();
+    if (last.is_free) {
+      *offset = last.begin;
+      *new_buffer_size = buffer_size_ + size - (last.end - last.begin);
+    } else {
+      *offset = buffer_size_;
+      *new_buffer_size = buffer_size_ + size;
+    }
+  }
+
+ private:
+  std::list<Piece> piece_list_;
+  int64_t buffer_size_;
+};
+
+class ListBfcAllocator final {
+ public:
+  explicit ListBfcAllocator(int64_t size) : buffer_size_(size) {
+    piece_list_.push_back(Piece{0, size, true});
+  }
+
+  int64_t AllocateRaw(int64_t size) {
+    auto candidate = piece_list_.end();
+    for (auto it = piece_list_.begin(); it != piece_list_.end(); ++it) {
+      int64_t piece_size = it->end - it->begin;
+      if (it->is_free && piece_size >= size
+          && (candidate == piece_list_.end() || piece_size < candidate->end - candidate->begin)) {
+        candidate = it;
+      }
+    }
+    int64_t offset = -1;
+    if (candidate == piece_list_.end()) {
+      Piece* last = &piece_list_.back();
+      if (last->is_free) {
+        offset = last->begin;
+        buffer_size_ += size - (last->end - last->begin);
+        last->end = buffer_size_;
+        last->is_free = false;
+        offset2piece_.emplace(offset, std::prev(piece_list_.end()));
+      } else {
+        offset = last->end;
+        buffer_size_ += size;
+        piece_list_.push_back(Piece{offset, buffer_size_, false});
+        offset2piece_.emplace(offset, std::prev(piece_list_.end()));
+      }
+    } else {
+      offset = candidate->begin;
+      if (candidate->end - candidate->begin > size) {
+        candidate->begin += size;
+        offset2piece_.emplace(offset,
+                              piece_list_.insert(candidate, Piece{offset, offset + size, false}));
+      } else {
+        candidate->is_free = false;
+        offset2piece_.emplace(offset, candidate);
+      }
+    }
+    return offset;
+  }
+
+  void FreeRaw(int64_t offset) {
+    offset2piece_.at(offset)->is_free = true;
+    offset2piece_.erase(offset);
+    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
+      auto pre_it = std::prev(it);
+      if (it->is_free && pre_it->is_free) {
+        it->begin = pre_it->begin;
+        piece_list_.erase(pre_it);
+      }
+    }
+  }
+
+  int64_t buffer_size() const { return buffer_size_; }
+
+ private:
+  std::list<Piece> piece_list_;
+  int64_t buffer_size_;
+  HashMap<int64_t, std::list<Piece>::iterator> offset2piece_;
+};
+
+inline void ListAllocateByOrder(const std::vector<int64_t>& order, const MemChainRegstInfo& info,
+                                MemBlockResultInfo* result) {
+  result->regst_offsets.assign(info.regst_sizes.size(), -1);
+  int64_t buffer_size = 1;
+  for (int64_t regst : order) {
+    ListMemBlockBuffer buffer(buffer_size);
+    for (int64_t mutual_regst : info.regst2mutual_exclusion_regsts.at(regst)) {
+      int64_t begin = result->regst_offsets.at(mutual_regst);
+      if (begin != -1) { buffer.Occupy(begin, begin + info.regst_sizes.at(mutual_regst)); }
+    }
+    buffer.FindFreeOffsetAndNewBufferSize(info.regst_sizes.at(regst),
+                                          &result->regst_offsets.at(regst), &buffer_size);
+  }
+  result->mem_block_size = buffer_size;
+}
+
+inline void ListMemSizeFirstAlgo(const MemChainRegstInfo& info, MemBlockResultInfo* result) {
+  std::vector<int64_t> order(info.regst_sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    return info.regst_sizes.at(lhs) > info.regst_sizes.at(rhs);
+  });
+  ListAllocateByOrder(order, info, result);
+}
+
+inline void ListMutualExclusionFirstAlgo(const MemChainRegstInfo& info,
+                                         MemBlockResultInfo* result) {
+  std::vector<int64_t> order(info.regst_sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+    return info.regst2mutual_exclusion_regsts.at(lhs).size()
+           < info.regst2mutual_exclusion_regsts.at(rhs).size();
+  });
+  ListAllocateByOrder(order, info, result);
+}
+
+inline void ListTimeLineAlgo(const MemChainRegstInfo& info, MemBlockResultInfo* result) {
+  result->regst_offsets.assign(info.regst_sizes.size(), -1);
+  ListBfcAllocator allocator(1);
+  for (int64_t i = 0; i < info.alloc_regsts_timeline.size(); ++i) {
+    for (int64_t regst : info.alloc_regsts_timeline.at(i)) {
+      result->regst_offsets.at(regst) = allocator.AllocateRaw(info.regst_sizes.at(regst));
+    }
+    for (int64_t regst : info.free_regsts_timeline.at(i)) {
+      allocator.FreeRaw(result->regst_offsets.at(regst));
+    }
+  }
+  result->mem_block_size = allocator.buffer_size();
+}
+
+// A mem chain shaped like a training graph: most regsts die within a few tasks, some live
+// until the backward pass needs them again. size_num > 0 draws the sizes from that many values
+// to provoke ties.
+inline MemChainRegstInfo GenSyntheticMemChain(int64_t task_num, int64_t size_num,
+                                              std::mt19937_64* gen) {
+  MemChainRegstInfo info;
+  info.alloc_regsts_timeline.resize(task_num);
+  info.free_regsts_timeline.resize(task_num);
+  std::uniform_int_distribution<int64_t> regst_num_dis(0, 2);
+  std::uniform_int_distribution<int64_t> log_size_dis(9, 26);
+  std::uniform_int_distribution<int64_t> size_id_dis(1, std::max<int64_t>(size_num, 1));
+  std::geometric_distribution<int64_t> short_life_dis(0.3);
+  std::bernoulli_distribution is_long_life_dis(0.15);
+  FOR_RANGE(int64_t, i, 0, task_num) {
+    FOR_RANGE(int64_t, j, 0, regst_num_dis(*gen)) {
+      const int64_t regst = info.regst_sizes.size();
+      if (size_num > 0) {
+        info.regst_sizes.push_back(size_id_dis(*gen) * 512);
+      } else {
+        const int64_t log_size = log_size_dis(*gen);
+        info.regst_sizes.push_back((int64_t(1) << log_size) + ((*gen)() % 64) * 512);
+      }
+      int64_t free_index = i + short_life_dis(*gen);
+      if (is_long_life_dis(*gen)) { free_index = i + (*gen)() % (task_num - i); }
+      info.alloc_regsts_timeline.at(i).push_back(regst);
+      info.free_regsts_timeline.at(std::min(free_index, task_num - 1)).push_back(regst);
+    }
+  }
+  GenRegstMutualExclusions(&info);
+  return info;
+}
+
+using AlgoFn = void (*)(const MemChainRegstInfo&, MemBlockResultInfo*);
+
+inline const std::vector<std::pair<std::string, std::pair<AlgoFn, AlgoFn>>>& Algo2NewAndListFn() {
+  static const std::vector<std::pair<std::string, std::pair<AlgoFn, AlgoFn>>> algos = {
+      {"MemSizeFirst", {&MemReusedAlgorithm_MemSizeFirstAlgo, &ListMemSizeFirstAlgo}},
+      {"MutualExclusionFirst",
+       {&MemReusedAlgorithm_MutualExclusionFirstAlgo, &ListMutualExclusionFirstAlgo}},
+      {"TimeLine", {&MemReusedAlgorithm_TimeLineAlgo, &ListTimeLineAlgo}},
+  };
+  return algos;
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_INTRA_JOB_MEM_SHARING_ALGORITHM_TEST_UTIL_H_
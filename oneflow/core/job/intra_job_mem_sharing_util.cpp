@@ -18,8 +18,10 @@ limitations under the License.
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/shape.h"
 #include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/intra_job_mem_sharing_algorithm.h"
 #include "oneflow/core/register/runtime_register_desc.h"
 #include "oneflow/core/thread/thread_pool.h"
+#include <iomanip>
 
 namespace oneflow {
 
@@ -27,6 +29,7 @@ enum MemAllocAlgoType {
   kMemSizeFirstAlgo = 0,
   kMutualExclusionFirstAlgo = 1,
   kTimeLineAlgo = 2,
+  kStripPackingAlgo = 3,
 };
 
 }  // namespace oneflow
@@ -46,10 +49,16 @@ namespace oneflow {
 
 namespace {
 
-struct MemBlockResultInfo {
-  size_t mem_block_size;
-  HashMap<RegstDescProto*, int64_t> regst_desc2offset;
-};
+std::string MemAllocAlgoTypeName(MemAllocAlgoType algo_id) {
+  switch (algo_id) {
+    case kMemSizeFirstAlgo: return "MemSizeFirst";
+    case kMutualExclusionFirstAlgo: return "MutualExclusionFirst";
+    case kTimeLineAlgo: return "TimeLine";
+    case kStripPackingAlgo: return "StripPacking";
+    default: UNIMPLEMENTED();
+  }
+  return "";
+}
 
 int64_t GenDeviceUniqueId(int64_t machine_id, int64_t device_id) {
   return (machine_id << 32) | device_id;
@@ -204,15 +213,12 @@ void GenMemChainTasksAndRegsts(
 void GenRegstAllocFreeTimeLineAndRegstMutualExclusions(
     const std::vector<TaskProto*>& sorted_tasks, const HashSet<RegstDescProto*>& mem_reused_regsts,
     const HashMap<int64_t, RegstDescProto*>& regst_desc_id2regst_desc,
-    std::vector<HashSet<RegstDescProto*>>* alloc_regsts_timeline,
-    std::vector<HashSet<RegstDescProto*>>* free_regsts_timeline,
-    HashMap<RegstDescProto*, HashSet<RegstDescProto*>>* regst2mutual_exclusion_regsts,
+    std::vector<RegstDescProto*>* regsts, MemChainRegstInfo* regst_info,
     HashMap<RegstDescProto*, RegstDescProto*>* consumer2inplaced_regst) {
-  CHECK(alloc_regsts_timeline->empty() && free_regsts_timeline->empty());
-  CHECK(regst2mutual_exclusion_regsts->empty());
+  CHECK(regsts->empty());
   CHECK(consumer2inplaced_regst->empty());
-  alloc_regsts_timeline->resize(sorted_tasks.size());
-  free_regsts_timeline->resize(sorted_tasks.size());
+  std::vector<HashSet<RegstDescProto*>> alloc_regsts_timeline(sorted_tasks.size());
+  std::vector<HashSet<RegstDescProto*>> free_regsts_timeline(sorted_tasks.size());
   HashMap<int64_t, int64_t> task_id2sorted_id;
   for (int64_t i = 0; i < sorted_tasks.size(); ++i) {
     TaskProto* task = sorted_tasks.at(i);
@@ -257,7 +263,7 @@ void GenRegstAllocFreeTimeLineAndRegstMutualExclusions(
       continue;
     }
 
-    CHECK(alloc_regsts_timeline->at(task_id2sorted_id.at(regst_desc->producer_task_id()))
+    CHECK(alloc_regsts_timeline.at(task_id2sorted_id.at(regst_desc->producer_task_id()))
               .insert(regst_desc)
               .second);
     CHECK(regst_desc_id2free_index
@@ -274,345 +280,56 @@ void GenRegstAllocFreeTimeLineAndRegstMutualExclusions(
                  FindLastFreeIndexInSortedTasks(consumer_regst_desc));
   }
   for (const auto& pair : regst_desc_id2free_index) {
-    CHECK(free_regsts_timeline->at(pair.second)
+    CHECK(free_regsts_timeline.at(pair.second)
               .insert(regst_desc_id2regst_desc.at(pair.first))
               .second);
   }
 
-  HashSet<RegstDescProto*> remain_regsts;
-  for (int64_t i = 0; i < sorted_tasks.size(); ++i) {
-    for (RegstDescProto* alloc_regst : alloc_regsts_timeline->at(i)) {
-      CHECK(regst2mutual_exclusion_regsts->emplace(alloc_regst, HashSet<RegstDescProto*>()).second);
-      for (RegstDescProto* remain_regst : remain_regsts) {
-        CHECK(regst2mutual_exclusion_regsts->at(alloc_regst).insert(remain_regst).second);
-        CHECK(regst2mutual_exclusion_regsts->at(remain_regst).insert(alloc_regst).second);
-      }
-      CHECK(remain_regsts.insert(alloc_regst).second);
-    }
-    for (RegstDescProto* free_regst : free_regsts_timeline->at(i)) {
-      CHECK_EQ(remain_regsts.erase(free_regst), 1);
-    }
-  }
-  CHECK(remain_regsts.empty());
-}
-
-struct Piece {
-  int64_t begin;
-  int64_t end;
-  bool is_free;
-};
-using PieceIt = std::list<Piece>::iterator;
-
-class MemBlockBuffer final {
- public:
-  MemBlockBuffer(size_t size) : buffer_size_(size) {
-    Piece start_piece;
-    start_piece.begin = 0;
-    start_piece.end = size;
-    start_piece.is_free = true;
-    piece_list_.push_back(start_piece);
-  };
-  ~MemBlockBuffer() = default;
-
-  void Occupy(int64_t begin, int64_t end);
-  void FindFreeOffsetAndNewBufferSize(int64_t size, int64_t* offset, size_t* new_buffer_size);
-
- private:
-  void CheckValid() {
-    CHECK(piece_list_.size() >= 1);
-    CHECK(piece_list_.begin()->begin == 0);
-    CHECK(std::prev(piece_list_.end())->end == buffer_size_);
-    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
-      auto pre_it = std::prev(it);
-      CHECK(pre_it->begin < pre_it->end && pre_it->end == it->begin);
-    }
-  }
-
-  void MergePieceAndCheckValid() {
-    CheckValid();
-    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
-      auto pre_it = std::prev(it);
-      if (it->is_free == pre_it->is_free) {
-        it->begin = pre_it->begin;
-        CHECK(piece_list_.erase(pre_it) == it);
-      }
-    }
-    CheckValid();
-  }
-
-  std::list<Piece> piece_list_;
-  size_t buffer_size_;
-};
-
-void MemBlockBuffer::Occupy(int64_t begin, int64_t end) {
-  CHECK(begin < end && end <= buffer_size_);
-  for (auto it = piece_list_.begin(); it != piece_list_.end(); ++it) {
-    if (it->end <= begin) { continue; }
-    if (end <= it->begin) { break; }
-    if (it->is_free) {
-      if (begin != it->begin) {
-        CHECK(it->begin < begin);
-        CHECK(begin < it->end);
-        Piece free_piece;
-        free_piece.begin = it->begin;
-        free_piece.end = begin;
-        free_piece.is_free = true;
-        it->begin = begin;
-        it = piece_list_.insert(it, free_piece);
-      } else if (end < it->end) {
-        Piece busy_piece;
-        busy_piece.begin = it->begin;
-        busy_piece.end = end;
-        busy_piece.is_free = false;
-        it->begin = end;
-        it = piece_list_.insert(it, busy_piece);
-        begin = end;
-      } else {
-        it->is_free = false;
-        begin = it->end;
-      }
-    } else {
-      begin = it->end;
-      end = std::max(begin, end);
-    }
-  }
-  MergePieceAndCheckValid();
-}
-
-void MemBlockBuffer::FindFreeOffsetAndNewBufferSize(int64_t size, int64_t* offset,
-                                                    size_t* new_buffer_size) {
-  CheckValid();
-  for (auto it = piece_list_.begin(); it != piece_list_.end(); ++it) {
-    if (it->is_free && (it->end - it->begin) >= size) {
-      *offset = it->begin;
-      *new_buffer_size = buffer_size_;
-      return;
-    }
-  }
-  auto last_it = std::prev(piece_list_.end());
-  if (last_it->is_free) {
-    *offset = last_it->begin;
-    *new_buffer_size = buffer_size_ + size - (last_it->end - last_it->begin);
-  } else {
-    *offset = buffer_size_;
-    *new_buffer_size = buffer_size_ + size;
-  }
-}
-
-void MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(
-    const std::vector<RegstDescProto*>& order,
-    const HashMap<RegstDescProto*, int64_t>& regst_desc2size,
-    const HashMap<RegstDescProto*, HashSet<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
-  HashMap<RegstDescProto*, int64_t>* regst_desc2offset = &(result->regst_desc2offset);
-  size_t buffer_size = 1;
-  for (RegstDescProto* regst_desc : order) {
-    MemBlockBuffer buffer(buffer_size);
-    for (RegstDescProto* mutual_regst : regst2mutual_exclusion_regsts.at(regst_desc)) {
-      if (regst_desc2offset->find(mutual_regst) != regst_desc2offset->end()) {
-        int64_t begin = regst_desc2offset->at(mutual_regst);
-        int64_t end = begin + regst_desc2size.at(mutual_regst);
-        buffer.Occupy(begin, end);
-      }
-    }
-    int64_t offset = -1;
-    buffer.FindFreeOffsetAndNewBufferSize(regst_desc2size.at(regst_desc), &offset, &buffer_size);
-    CHECK(offset >= 0 && offset < buffer_size);
-    CHECK(regst_desc2offset->emplace(regst_desc, offset).second);
-  }
-  result->mem_block_size = buffer_size;
-}
-
-void MemReusedAlgorithm_MemSizeFirstAlgo(
-    const HashMap<RegstDescProto*, HashSet<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
-  std::vector<RegstDescProto*> order;
-  HashMap<RegstDescProto*, int64_t> regst_desc2size;
-  for (const auto& pair : regst2mutual_exclusion_regsts) {
-    order.push_back(pair.first);
-    CHECK(regst_desc2size.emplace(pair.first, RtRegstDesc(*pair.first).TotalMainByteSize4AllRegst())
-              .second);
-  }
-  std::sort(order.begin(), order.end(), [&](RegstDescProto* lhs, RegstDescProto* rhs) {
-    return regst_desc2size.at(lhs) > regst_desc2size.at(rhs);
-  });
-  MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(order, regst_desc2size,
-                                                       regst2mutual_exclusion_regsts, result);
-}
-
-void MemReusedAlgorithm_MutualExclusionFirstAlgo(
-    const HashMap<RegstDescProto*, HashSet<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
-  std::vector<RegstDescProto*> order;
-  HashMap<RegstDescProto*, int64_t> regst_desc2size;
-  for (const auto& pair : regst2mutual_exclusion_regsts) {
-    order.push_back(pair.first);
-    CHECK(regst_desc2size.emplace(pair.first, RtRegstDesc(*pair.first).TotalMainByteSize4AllRegst())
-              .second);
-  }
-  std::sort(order.begin(), order.end(), [&](RegstDescProto* lhs, RegstDescProto* rhs) {
-    return regst2mutual_exclusion_regsts.at(lhs).size()
-           < regst2mutual_exclusion_regsts.at(rhs).size();
-  });
-  MemReusedAlgorithm_AllocateByOrderAndMutualExclusion(order, regst_desc2size,
-                                                       regst2mutual_exclusion_regsts, result);
-}
-
-class BfcAllocator final {
- public:
-  BfcAllocator(int64_t size) : buffer_size_(size) {
-    Piece start_piece;
-    start_piece.begin = 0;
-    start_piece.end = size;
-    start_piece.is_free = true;
-    piece_list_.push_back(start_piece);
-  };
-  ~BfcAllocator() = default;
-
-  // Return offset of the buffer for this allocate size memory
-  int64_t AllocateRaw(int64_t size);
-  void FreeRaw(int64_t offset, int64_t size);
-  int64_t buffer_size() const { return buffer_size_; }
-
- private:
-  void CheckValid() {
-    CHECK(piece_list_.size() >= 1);
-    CHECK(piece_list_.front().begin == 0);
-    CHECK(piece_list_.back().end == buffer_size_);
-    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
-      auto pre_it = std::prev(it);
-      CHECK(pre_it->begin < pre_it->end && pre_it->end == it->begin);
-      CHECK(!(pre_it->is_free && it->is_free));
-    }
-  }
-
-  void MergeFreePieceAndCheckValid() {
-    for (auto it = std::next(piece_list_.begin()); it != piece_list_.end(); ++it) {
-      auto pre_it = std::prev(it);
-      if (it->is_free && pre_it->is_free) {
-        it->begin = pre_it->begin;
-        CHECK(piece_list_.erase(pre_it) == it);
-      }
-    }
-    CheckValid();
-  }
-
-  std::list<Piece> piece_list_;
-  int64_t buffer_size_;
-  HashMap<int64_t, PieceIt> offset2occupied_piece_;
-};
-
-int64_t BfcAllocator::AllocateRaw(int64_t size) {
-  int64_t offset = -1;
-  PieceIt candidate_piece = piece_list_.end();
-  for (auto it = piece_list_.begin(); it != piece_list_.end(); ++it) {
-    int64_t piece_size = it->end - it->begin;
-    if (it->is_free && piece_size >= size) {
-      if (candidate_piece == piece_list_.end()
-          || piece_size < (candidate_piece->end - candidate_piece->begin)) {
-        candidate_piece = it;
-      }
+  // The algorithms break ties by regst number, and the regsts are numbered in the iteration order
+  // of a HashMap filled in timeline order. Changing either changes the offsets of existing plans.
+  HashMap<RegstDescProto*, int64_t> regst2id;
+  for (const HashSet<RegstDescProto*>& alloc_regsts : alloc_regsts_timeline) {
+    for (RegstDescProto* alloc_regst : alloc_regsts) {
+      CHECK(regst2id.emplace(alloc_regst, -1).second);
     }
   }
-  if (candidate_piece == piece_list_.end()) {
-    auto last_it = std::prev(piece_list_.end());
-    if (last_it->is_free) {
-      offset = last_it->begin;
-      buffer_size_ += size - (last_it->end - last_it->begin);
-      last_it->end = buffer_size_;
-      last_it->is_free = false;
-      CHECK(offset2occupied_piece_.emplace(offset, last_it).second);
-    } else {
-      offset = last_it->end;
-      buffer_size_ += size;
-      Piece new_piece;
-      new_piece.begin = last_it->end;
-      new_piece.end = buffer_size_;
-      new_piece.is_free = false;
-      piece_list_.push_back(new_piece);
-      CHECK(offset2occupied_piece_.emplace(offset, std::prev(piece_list_.end())).second);
-    }
-  } else {
-    int64_t piece_size = candidate_piece->end - candidate_piece->begin;
-    offset = candidate_piece->begin;
-    if (piece_size > size) {
-      Piece new_piece;
-      new_piece.begin = candidate_piece->begin;
-      new_piece.end = candidate_piece->begin + size;
-      new_piece.is_free = false;
-      candidate_piece->begin = new_piece.end;
-      PieceIt new_it = piece_list_.insert(candidate_piece, new_piece);
-      CHECK(offset2occupied_piece_.emplace(offset, new_it).second);
-    } else {
-      CHECK_EQ(size, piece_size);
-      candidate_piece->is_free = false;
-      CHECK(offset2occupied_piece_.emplace(offset, candidate_piece).second);
-    }
+  for (auto& pair : regst2id) {
+    pair.second = regsts->size();
+    regsts->push_back(pair.first);
+    regst_info->regst_sizes.push_back(RtRegstDesc(*pair.first).TotalMainByteSize4AllRegst());
   }
-  CheckValid();
-  CHECK_NE(offset, -1);
-  CHECK(offset2occupied_piece_.find(offset) != offset2occupied_piece_.end());
-  return offset;
-}
-
-void BfcAllocator::FreeRaw(int64_t offset, int64_t size) {
-  CHECK(offset2occupied_piece_.find(offset) != offset2occupied_piece_.end());
-  PieceIt occupied_piece = offset2occupied_piece_.at(offset);
-  CHECK(occupied_piece->is_free == false);
-  CHECK_EQ((occupied_piece->end - occupied_piece->begin), size);
-  occupied_piece->is_free = true;
-  CHECK(offset2occupied_piece_.erase(offset) == 1);
-  MergeFreePieceAndCheckValid();
-}
-
-void MemReusedAlgorithm_TimeLineAlgo(
-    const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
-    const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline, MemBlockResultInfo* result) {
-  HashMap<RegstDescProto*, int64_t>* regst_desc2offset = &(result->regst_desc2offset);
-  regst_desc2offset->clear();
-  int64_t buffer_size = 1;
-  BfcAllocator bfc_allocator(buffer_size);
-
-  auto GetRegstSize = [](const RegstDescProto* regst) -> int64_t {
-    return RtRegstDesc(*regst).TotalMainByteSize4AllRegst();
-  };
-
-  CHECK_EQ(alloc_regsts_timeline.size(), free_regsts_timeline.size());
-  for (int64_t i = 0; i < alloc_regsts_timeline.size(); ++i) {
+  regst_info->alloc_regsts_timeline.resize(sorted_tasks.size());
+  regst_info->free_regsts_timeline.resize(sorted_tasks.size());
+  for (int64_t i = 0; i < sorted_tasks.size(); ++i) {
     for (RegstDescProto* alloc_regst : alloc_regsts_timeline.at(i)) {
-      CHECK(regst_desc2offset
-                ->emplace(alloc_regst, bfc_allocator.AllocateRaw(GetRegstSize(alloc_regst)))
-                .second);
+      regst_info->alloc_regsts_timeline.at(i).push_back(regst2id.at(alloc_regst));
     }
     for (RegstDescProto* free_regst : free_regsts_timeline.at(i)) {
-      CHECK(regst_desc2offset->find(free_regst) != regst_desc2offset->end());
-      bfc_allocator.FreeRaw(regst_desc2offset->at(free_regst), GetRegstSize(free_regst));
+      regst_info->free_regsts_timeline.at(i).push_back(regst2id.at(free_regst));
     }
   }
-  result->mem_block_size = bfc_allocator.buffer_size();
+  GenRegstMutualExclusions(regst_info);
 }
 
 void SelectAlgorithmGenMemBlockOffset4Regsts(
-    MemAllocAlgoType algo_id, const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
-    const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline,
-    const HashMap<RegstDescProto*, HashSet<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
+    MemAllocAlgoType algo_id, const MemChainRegstInfo& regst_info,
+    const MemoryAllocationAlgorithmConf& mem_alloc_algo_conf, MemBlockResultInfo* result) {
   CHECK_EQ(result->mem_block_size, 0);
-  CHECK(result->regst_desc2offset.empty());
+  CHECK(result->regst_offsets.empty());
   switch (algo_id) {
-    case kMemSizeFirstAlgo:
-      MemReusedAlgorithm_MemSizeFirstAlgo(regst2mutual_exclusion_regsts, result);
-      break;
+    case kMemSizeFirstAlgo: MemReusedAlgorithm_MemSizeFirstAlgo(regst_info, result); break;
     case kMutualExclusionFirstAlgo:
-      MemReusedAlgorithm_MutualExclusionFirstAlgo(regst2mutual_exclusion_regsts, result);
+      MemReusedAlgorithm_MutualExclusionFirstAlgo(regst_info, result);
       break;
-    case kTimeLineAlgo:
-      MemReusedAlgorithm_TimeLineAlgo(alloc_regsts_timeline, free_regsts_timeline, result);
+    case kTimeLineAlgo: MemReusedAlgorithm_TimeLineAlgo(regst_info, result); break;
+    case kStripPackingAlgo:
+      MemReusedAlgorithm_StripPackingAlgo(
+          regst_info, mem_alloc_algo_conf.strip_packing_algo_max_visit_num(), result);
       break;
     default: UNIMPLEMENTED();
   }
   CHECK_GT(result->mem_block_size, 0);
-  CHECK(!result->regst_desc2offset.empty());
+  CHECK(!result->regst_offsets.empty());
 }
 
 int64_t CountMemAllocAlgoNum() {
@@ -622,6 +339,7 @@ int64_t CountMemAllocAlgoNum() {
   if (mem_alloc_algo_conf.use_mem_size_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_mutual_exclusion_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_time_line_algo()) { ++ret; }
+  if (mem_alloc_algo_conf.use_strip_packing_algo()) { ++ret; }
   CHECK_GE(ret, 0);
   return ret;
 }
@@ -639,6 +357,9 @@ void InitAlgo2Result(HashMap<MemAllocAlgoType, MemBlockResultInfo>* algo2result)
   if (mem_alloc_algo_conf.use_time_line_algo()) {
     CHECK(algo2result->emplace(kTimeLineAlgo, MemBlockResultInfo()).second);
   }
+  if (mem_alloc_algo_conf.use_strip_packing_algo()) {
+    CHECK(algo2result->emplace(kStripPackingAlgo, MemBlockResultInfo()).second);
+  }
 }
 
 }  // namespace
@@ -656,41 +377,55 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan,
   HashMap<int64_t, RegstDescProto*> regst_desc_id2regst_desc;
   GenRegstDescId2RegstDesc(plan, &regst_desc_id2regst_desc);
   // info for algorithm
-  HashMap<int64_t, std::vector<HashSet<RegstDescProto*>>> mem_chain2task2alloc_regsts;
-  HashMap<int64_t, std::vector<HashSet<RegstDescProto*>>> mem_chain2task2free_regsts;
-  HashMap<int64_t, HashMap<RegstDescProto*, HashSet<RegstDescProto*>>>
-      mem_chain2regst2mutual_exclusion_regsts;
+  HashMap<int64_t, std::vector<RegstDescProto*>> mem_chain2regsts;
+  HashMap<int64_t, MemChainRegstInfo> mem_chain2regst_info;
   // info for inplace
   HashMap<int64_t, HashMap<RegstDescProto*, RegstDescProto*>> mem_chain2consumer2inplaced_regst;
+  HashMap<int64_t, HashMap<MemAllocAlgoType, MemBlockResultInfo>> mem_chain2algo2result;
+  for (int64_t mem_chain_id : mem_chains) {
+    mem_chain2regsts[mem_chain_id];
+    mem_chain2regst_info[mem_chain_id];
+    mem_chain2consumer2inplaced_regst[mem_chain_id];
+    InitAlgo2Result(&mem_chain2algo2result[mem_chain_id]);
+  }
+  int64_t work_size = mem_chain2mem_reused_regsts.size() * CountMemAllocAlgoNum();
+  int64_t thread_pool_size = std::max<int64_t>(
+      std::min<int64_t>(work_size, std::thread::hardware_concurrency()), 1);
+  ThreadPool thread_pool(thread_pool_size);
 
-  // step 1: generate regst alloc/free queue AND regst mutual exclusions
-  for (const auto& pair : mem_chain2mem_reused_regsts) {
-    GenRegstAllocFreeTimeLineAndRegstMutualExclusions(
-        mem_chain2sorted_tasks.at(pair.first), pair.second, regst_desc_id2regst_desc,
-        &mem_chain2task2alloc_regsts[pair.first], &mem_chain2task2free_regsts[pair.first],
-        &mem_chain2regst2mutual_exclusion_regsts[pair.first],
-        &mem_chain2consumer2inplaced_regst[pair.first]);
+  // step 1: multi-thread generate regst alloc/free queue AND regst mutual exclusions
+  {
+    BlockingCounter counter(mem_chains.size());
+    for (int64_t mem_chain_id : mem_chains) {
+      thread_pool.AddWork([&, mem_chain_id]() {
+        GenRegstAllocFreeTimeLineAndRegstMutualExclusions(
+            mem_chain2sorted_tasks.at(mem_chain_id), mem_chain2mem_reused_regsts.at(mem_chain_id),
+            regst_desc_id2regst_desc, &mem_chain2regsts.at(mem_chain_id),
+            &mem_chain2regst_info.at(mem_chain_id),
+            &mem_chain2consumer2inplaced_regst.at(mem_chain_id));
+        counter.Decrease();
+      });
+    }
+    counter.WaitUntilCntEqualZero();
   }
 
-  // step 2: multi-thread run several algorithm for each mem chain
-  HashMap<int64_t, HashMap<MemAllocAlgoType, MemBlockResultInfo>> mem_chain2algo2result;
+  // step 2: multi-thread run several algorithm for each mem chain, the largest chains first
   {
-    int64_t work_size = mem_chain2mem_reused_regsts.size() * CountMemAllocAlgoNum();
-    int64_t thread_pool_size = std::min<int64_t>(work_size, std::thread::hardware_concurrency());
+    std::vector<int64_t> sorted_mem_chains(mem_chains.begin(), mem_chains.end());
+    std::sort(sorted_mem_chains.begin(), sorted_mem_chains.end(), [&](int64_t lhs, int64_t rhs) {
+      return mem_chain2regsts.at(lhs).size() > mem_chain2regsts.at(rhs).size();
+    });
+    const MemoryAllocationAlgorithmConf& mem_alloc_algo_conf =
+        GlobalJobDesc().job_conf().memory_allocation_algorithm_conf();
     BlockingCounter counter(work_size);
-    ThreadPool thread_pool(thread_pool_size);
-    for (int64_t mem_chain_id : mem_chains) {
-      InitAlgo2Result(&mem_chain2algo2result[mem_chain_id]);
+    for (int64_t mem_chain_id : sorted_mem_chains) {
+      const MemChainRegstInfo* regst_info = &mem_chain2regst_info.at(mem_chain_id);
       for (auto& pair : mem_chain2algo2result.at(mem_chain_id)) {
         MemAllocAlgoType algo_id = pair.first;
         MemBlockResultInfo* result = &pair.second;
-        thread_pool.AddWork([algo_id, mem_chain_id, &mem_chain2task2alloc_regsts,
-                             &mem_chain2task2free_regsts, &mem_chain2regst2mutual_exclusion_regsts,
-                             result, &counter]() {
-          SelectAlgorithmGenMemBlockOffset4Regsts(
-              algo_id, mem_chain2task2alloc_regsts.at(mem_chain_id),
-              mem_chain2task2free_regsts.at(mem_chain_id),
-              mem_chain2regst2mutual_exclusion_regsts.at(mem_chain_id), result);
+        thread_pool.AddWork([algo_id, regst_info, &mem_alloc_algo_conf, result, &counter]() {
+          SelectAlgorithmGenMemBlockOffset4Regsts(algo_id, *regst_info, mem_alloc_algo_conf,
+                                                  result);
           counter.Decrease();
         });
       }
@@ -701,21 +436,53 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(Plan* plan,
   // step 3: choose best one for each mem chain and set offset for inplace consumer regst
   for (const auto& pair : mem_chain2algo2result) {
     const MemBlockResultInfo* best_result = nullptr;
+    MemAllocAlgoType best_algo_id = kMemSizeFirstAlgo;
+    // the strip packing algo has to be strictly smaller, so ties keep the plans they had before it
     for (const auto& algo_result_pair : pair.second) {
+      if (algo_result_pair.first == kStripPackingAlgo) { continue; }
       if (!best_result || algo_result_pair.second.mem_block_size < best_result->mem_block_size) {
         best_result = &algo_result_pair.second;
+        best_algo_id = algo_result_pair.first;
+      }
+    }
+    const auto strip_packing_it = pair.second.find(kStripPackingAlgo);
+    if (strip_packing_it != pair.second.end()) {
+      const MemBlockResultInfo* result = &strip_packing_it->second;
+      if (!best_result || result->mem_block_size < best_result->mem_block_size) {
+        best_result = result;
+        best_algo_id = kStripPackingAlgo;
       }
     }
     CHECK(best_result != nullptr);
+    {
+      const int64_t lower_bound = MemBlockSizeLowerBound(mem_chain2regst_info.at(pair.first));
+      std::ostringstream report;
+      report << "mem chain " << pair.first << " of " << mem_chain2regsts.at(pair.first).size()
+             << " regsts, lower bound " << lower_bound << " B:";
+      for (MemAllocAlgoType algo_id :
+           {kMemSizeFirstAlgo, kMutualExclusionFirstAlgo, kTimeLineAlgo, kStripPackingAlgo}) {
+        const auto it = pair.second.find(algo_id);
+        if (it == pair.second.end()) { continue; }
+        report << " " << MemAllocAlgoTypeName(algo_id) << " " << it->second.mem_block_size << " B";
+      }
+      report << ", chose " << MemAllocAlgoTypeName(best_algo_id);
+      if (lower_bound > 0) {
+        report << " at " << std::fixed << std::setprecision(2)
+               << (best_result->mem_block_size * 100.0 / lower_bound - 100.0)
+               << "% above the lower bound";
+      }
+      LOG(INFO) << report.str();
+    }
     int64_t mem_block_id = Global<IDMgr>::Get()->NewMemBlockId();
+    const std::vector<RegstDescProto*>& regsts = mem_chain2regsts.at(pair.first);
+    CHECK_EQ(regsts.size(), best_result->regst_offsets.size());
     CHECK_EQ(mem_chain2mem_reused_regsts.at(pair.first).size(),
-             (best_result->regst_desc2offset.size()
-              + mem_chain2consumer2inplaced_regst.at(pair.first).size()));
-    for (const auto& regst_offset_pair : best_result->regst_desc2offset) {
-      RegstDescProto* regst_desc = regst_offset_pair.first;
+             (regsts.size() + mem_chain2consumer2inplaced_regst.at(pair.first).size()));
+    for (int64_t i = 0; i < regsts.size(); ++i) {
+      RegstDescProto* regst_desc = regsts.at(i);
       CHECK_EQ(regst_desc->mem_block_id(), -1);
       regst_desc->set_mem_block_id(mem_block_id);
-      regst_desc->set_mem_block_offset(regst_offset_pair.second);
+      regst_desc->set_mem_block_offset(best_result->regst_offsets.at(i));
     }
     // set inplace
     for (auto& consumer_inplace_pair : mem_chain2consumer2inplaced_regst.at(pair.first)) {
@@ -35,6 +35,7 @@ limitations under the License.
 #include "oneflow/core/job/model_io_job.h"
 #include "oneflow/core/job/inter_job_mem_sharing_util.h"
 #include "oneflow/core/job/plan_util.h"
+#include "oneflow/core/job/plan_cache.h"
 #include "oneflow/core/operator/interface_op_util.h"
 #include "oneflow/core/job/critical_section_desc.h"
 #include "oneflow/core/job/global_for.h"
@@ -325,9 +326,10 @@ Maybe<void> CompileCurJobOnMaster(Job* job, Plan* improved_plan, bool need_job_c
   double start = GetCurTime();
   if (GlobalProcessCtx::IsThisProcessMaster()) {
     Compiler().Compile(job, &naive_plan, need_job_complete);
-    LOG(INFO) << "compile time: " << GetCurTime() - start;
+    CompilePhaseTimer timer(job_desc.job_id(), &complete_plan);
     complete_plan =
         *JUST(Improver().GenAndInferMemBlockIdOnly(*Global<AvailableMemDesc>::Get(), naive_plan));
+    timer.Tick("GenAndInferMemBlockId");
     if (Global<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
       TeePersistentLogStream::Create("naive_plan")->Write(naive_plan);
       TeePersistentLogStream::Create("complete_plan")->Write(complete_plan);
@@ -347,17 +349,27 @@ Maybe<void> CompileCurJobOnMaster(Job* job, Plan* improved_plan, bool need_job_c
     if (GlobalProcessCtx::IsThisProcessMaster()) {
       TeePersistentLogStream::Create("available_mem_desc")->Write(*Global<AvailableMemDesc>::Get());
       CHECK_GT(Global<AvailableMemDesc>::Get()->machine_amd_size(), 0);
+      CompilePhaseTimer timer(job_desc.job_id(), improved_plan);
       *improved_plan = *JUST(Improver().Improve(
           *Global<AvailableMemDesc>::Get(), naive_plan,
           JoinPath(FLAGS_log_dir, ActEventLogger::experiment_act_event_bin_filename())));
+      // Improve starts over from naive_plan, keep the phase times complete_plan has so far
+      *improved_plan->mutable_compile_times() = complete_plan.compile_times();
+      timer.Tick("Improve");
       OF_SESSION_BARRIER();
       TeePersistentLogStream::Create("improved_plan")->Write(*improved_plan);
     }
   } else {
     *improved_plan = complete_plan;
   }
-  GenCollectiveBoxingPlan(job, improved_plan);
-  LOG(INFO) << "compile and improve time: " << GetCurTime() - start;
+  {
+    CompilePhaseTimer timer(job_desc.job_id(), improved_plan);
+    GenCollectiveBoxingPlan(job, improved_plan);
+    timer.Tick("GenCollectiveBoxingPlan");
+  }
+  if (GlobalProcessCtx::IsThisProcessMaster()) {
+    LogCompilePhaseTimes(job_desc.job_id(), *improved_plan);
+  }
   return Maybe<void>::Ok();
 }
 
@@ -372,6 +384,9 @@ void MergePlanWithoutGenNetTopo(Plan* plan, const Plan& other) {
     CHECK(
         plan->mutable_collective_boxing_plan()->mutable_job_id2request_set()->insert(pair).second);
   }
+  for (const auto& pair : other.compile_times().job_id2compile_time()) {
+    CHECK(plan->mutable_compile_times()->mutable_job_id2compile_time()->insert(pair).second);
+  }
 }
 
 void MergeSubPlanWithoutGenNetTopo(Plan* plan, const std::vector<Plan>& sub_plans) {
@@ -1075,6 +1090,24 @@ Maybe<void> CompileAndMergePlanOnMaster(const PbRpf<Job>& conf_jobs, Plan* plan)
       jobs.emplace_back(pull_job);
     }
   }
+  std::unique_ptr<PlanCache> plan_cache;
+  if (GlobalProcessCtx::IsThisProcessMaster() && PlanCache::IsEnabled(conf_jobs)) {
+    plan_cache.reset(new PlanCache(Global<const IOConf>::Get()->plan_cache_dir(),
+                                   PlanCache::GenKey(conf_jobs)));
+    double start = GetCurTime();
+    if (plan_cache->TryLoad(plan)) {
+      LOG(INFO) << "plan cache hit: " << plan_cache->key() << ", load time: "
+                << GetCurTime() - start;
+      // the plan holds the conf of every job it was compiled from, main job included
+      for (const auto& pair : plan->job_confs().job_id2job_conf()) {
+        AddJobName2JobId(pair.second.job_name(), pair.first);
+      }
+      PushPlan("merged_plan", *plan);
+      OF_SESSION_BARRIER();
+      return Maybe<void>::Ok();
+    }
+    LOG(INFO) << "plan cache miss: " << plan_cache->key();
+  }
   std::vector<Plan> sub_plans(jobs.size());
   FOR_RANGE(int64_t, i, 0, jobs.size()) {
     AddJobName2JobId(jobs.at(i)->job_conf().job_name(), i);
@@ -1102,6 +1135,12 @@ Maybe<void> CompileAndMergePlanOnMaster(const PbRpf<Job>& conf_jobs, Plan* plan)
       TeePersistentLogStream::Create("merged_plan")->Write(*plan);
       PlanUtil::ToDotFile(*plan, "/dot/merged_plan.dot");
     }
+    if (plan_cache) {
+      // the phase times were logged as the jobs compiled, a cache hit must not replay them
+      Plan cached_plan(*plan);
+      cached_plan.clear_compile_times();
+      plan_cache->Store(cached_plan);
+    }
     PushPlan("merged_plan", *plan);
   } else {
     PullPlan("merged_plan", plan);
@@ -0,0 +1,188 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/plan_cache.h"
+#include "oneflow/core/common/platform.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/job/available_memory_desc.pb.h"
+#include "oneflow/core/job/env_desc.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/job_set.pb.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/version.h"
+#include "oneflow/core/persistence/persistent_in_stream.h"
+#include "oneflow/core/persistence/persistent_out_stream.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <iomanip>
+#include <random>
+#include <set>
+#include <xxhash.h>
+
+#ifdef OF_PLATFORM_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace oneflow {
+
+namespace {
+
+// map fields are serialized in hash order by default
+std::string SerializeDeterministically(const PbMessage& msg) {
+  std::string ret;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&ret);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    CHECK(msg.SerializePartialToCodedStream(&coded_stream));
+  }
+  return ret;
+}
+
+// the schema of file and of the files it imports, a build that changes them reads plans
+// differently
+void CollectProtoSchemas(const google::protobuf::FileDescriptor* file,
+                         std::set<std::string>* visited_names, std::vector<std::string>* parts) {
+  if (!visited_names->insert(file->name()).second) { return; }
+  google::protobuf::FileDescriptorProto file_proto;
+  file->CopyTo(&file_proto);
+  parts->push_back(SerializeDeterministically(file_proto));
+  FOR_RANGE(int, i, 0, file->dependency_count()) {
+    CollectProtoSchemas(file->dependency(i), visited_names, parts);
+  }
+}
+
+// an entry is the XXH64 of the serialized plan followed by it, a truncated or overwritten entry
+// may still parse
+const size_t kDigestByte = sizeof(XXH64_hash_t);
+
+// path, size and mtime of the library holding this code, builds without a git version differ
+// in them
+std::string LibraryBuildStamp() {
+#ifdef OF_PLATFORM_POSIX
+  Dl_info dl_info;
+  struct stat file_stat;
+  if (dladdr(reinterpret_cast<void*>(&LibraryBuildStamp), &dl_info) != 0
+      && dl_info.dli_fname != nullptr && stat(dl_info.dli_fname, &file_stat) == 0) {
+    return std::string(dl_info.dli_fname) + ":" + std::to_string(file_stat.st_size) + ":"
+           + std::to_string(file_stat.st_mtime);
+  }
+#endif
+  return "";
+}
+
+}  // namespace
+
+std::string GenPlanCacheKey(const std::vector<std::string>& parts) {
+  using uint128_t = unsigned __int128;
+  const uint128_t kPrime = (static_cast<uint128_t>(1) << 88) + 0x13B;
+  uint128_t hash = (static_cast<uint128_t>(0x6c62272e07bb0142ULL) << 64) | 0x62b821756295c58dULL;
+  auto Update = [&](const char* data, size_t size) {
+    FOR_RANGE(size_t, i, 0, size) {
+      hash ^= static_cast<uint8_t>(data[i]);
+      hash *= kPrime;
+    }
+  };
+  for (const std::string& part : parts) {
+    const uint64_t part_size = part.size();
+    Update(reinterpret_cast<const char*>(&part_size), sizeof(part_size));
+    Update(part.data(), part.size());
+  }
+  std::ostringstream ss;
+  ss << std::hex << std::setfill('0') << std::setw(16) << static_cast<uint64_t>(hash >> 64)
+     << std::setw(16) << static_cast<uint64_t>(hash);
+  return ss.str();
+}
+
+PlanCache::PlanCache(const std::string& cache_dir, const std::string& key)
+    : cache_dir_(cache_dir), key_(key) {}
+
+std::string PlanCache::GenKey(const PbRpf<Job>& jobs) {
+  std::vector<std::string> parts;
+#ifdef WITH_GIT_VERSION
+  parts.push_back(GetOneFlowGitVersion());
+#endif  // WITH_GIT_VERSION
+  parts.push_back(LibraryBuildStamp());
+  std::set<std::string> visited_proto_names;
+  CollectProtoSchemas(Plan::descriptor()->file(), &visited_proto_names, &parts);
+  CollectProtoSchemas(Job::descriptor()->file(), &visited_proto_names, &parts);
+  parts.push_back(SerializeDeterministically(Global<EnvDesc>::Get()->env_proto()));
+  parts.push_back(SerializeDeterministically(Global<ResourceDesc, ForSession>::Get()->resource()));
+  IOConf io_conf(*Global<const IOConf>::Get());
+  io_conf.clear_plan_cache_dir();
+  parts.push_back(SerializeDeterministically(io_conf));
+  parts.push_back(SerializeDeterministically(*Global<AvailableMemDesc>::Get()));
+  for (const Job& job : jobs) { parts.push_back(SerializeDeterministically(job)); }
+  return GenPlanCacheKey(parts);
+}
+
+bool PlanCache::IsEnabled(const PbRpf<Job>& jobs) {
+  if (Global<const IOConf>::Get()->plan_cache_dir().empty()) { return false; }
+  for (const Job& job : jobs) {
+    if (job.job_conf().exp_run_conf().enable_experiment_run()) { return false; }
+  }
+  return true;
+}
+
+std::string PlanCache::FilePath() const { return JoinPath(cache_dir_, key_ + ".plan"); }
+
+bool PlanCache::TryLoad(Plan* plan) const {
+  const std::string path = FilePath();
+  if (!LocalFS()->FileExists(path)) { return false; }
+  const uint64_t file_size = LocalFS()->GetFileSize(path);
+  if (file_size < kDigestByte) {
+    LOG(WARNING) << "ignore the truncated plan cache " << path;
+    return false;
+  }
+  XXH64_hash_t digest = 0;
+  std::string buffer(file_size - kDigestByte, '\0');
+  {
+    PersistentInStream in_stream(LocalFS(), path);
+    CHECK_EQ(in_stream.ReadFully(reinterpret_cast<char*>(&digest), kDigestByte), 0);
+    if (!buffer.empty()) { CHECK_EQ(in_stream.ReadFully(&buffer[0], buffer.size()), 0); }
+  }
+  if (XXH64(buffer.data(), buffer.size(), 0) != digest || !plan->ParseFromString(buffer)) {
+    LOG(WARNING) << "ignore the corrupted plan cache " << path;
+    plan->Clear();
+    return false;
+  }
+  return true;
+}
+
+void PlanCache::Store(const Plan& plan) const {
+#ifdef OF_PLATFORM_POSIX
+  // the file system checks every write, test the dir here so that a bad one only skips caching
+  if (access(cache_dir_.c_str(), W_OK) != 0) {
+    PLOG(WARNING) << "skip caching the plan, " << cache_dir_ << " is not writable";
+    return;
+  }
+#endif
+  std::string buffer;
+  CHECK(plan.SerializeToString(&buffer));
+  const XXH64_hash_t digest = XXH64(buffer.data(), buffer.size(), 0);
+  std::random_device random_device;
+  const std::string tmp_path = FilePath() + ".tmp" + std::to_string(random_device());
+  {
+    PersistentOutStream out_stream(LocalFS(), tmp_path);
+    out_stream.Write(reinterpret_cast<const char*>(&digest), kDigestByte);
+    out_stream.Write(buffer.data(), buffer.size());
+  }
+  LocalFS()->RenameFile(tmp_path, FilePath());
+}
+
+}  // namespace oneflow
@@ -0,0 +1,60 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_PLAN_CACHE_H_
+#define ONEFLOW_CORE_JOB_PLAN_CACHE_H_
+
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/job/job.pb.h"
+#include "oneflow/core/job/plan.pb.h"
+
+namespace oneflow {
+
+// 128-bit FNV-1a digest of parts in hex. Every part is length-prefixed so moving bytes across
+// part boundaries changes the digest.
+std::string GenPlanCacheKey(const std::vector<std::string>& parts);
+
+// On-disk cache of merged plans keyed by GenKey. Entries are written to a temporary file and
+// renamed, concurrent sessions sharing a cache dir never read a partial plan. Every entry holds a
+// digest of its plan, a damaged one is ignored.
+class PlanCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PlanCache);
+  PlanCache(const std::string& cache_dir, const std::string& key);
+  ~PlanCache() = default;
+
+  // digests the jobs, the env, the session resource and io conf, the available memory and the
+  // build, i.e. everything the compilation reads, so a hit replaces it entirely
+  static std::string GenKey(const PbRpf<Job>& jobs);
+
+  const std::string& key() const { return key_; }
+  // false if there is no entry or it is damaged
+  bool TryLoad(Plan* plan) const;
+  // only warns if the entry can not be written, the plan is still used
+  void Store(const Plan& plan) const;
+
+  // the experiment run tunes the plan with act events of this very run, it is never cached
+  static bool IsEnabled(const PbRpf<Job>& jobs);
+
+ private:
+  std::string FilePath() const;
+
+  std::string cache_dir_;
+  std::string key_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_PLAN_CACHE_H_
@@ -0,0 +1,117 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/plan_cache.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+Plan GenTestPlan() {
+  Plan plan;
+  plan.mutable_block_chunk_list();
+  (*plan.mutable_net_topo()->mutable_peer_machine_ids())[0].add_machine_id(1);
+  plan.mutable_job_confs();
+  plan.mutable_collective_boxing_plan();
+  plan.add_task()->set_task_id(7);
+  return plan;
+}
+
+void WriteFile(const std::string& path, const std::string& content) {
+  std::unique_ptr<fs::WritableFile> file;
+  LocalFS()->NewWritableFile(path, &file);
+  file->Append(content.data(), content.size());
+  file->Close();
+}
+
+std::string ReadFile(const std::string& path) {
+  std::unique_ptr<fs::RandomAccessFile> file;
+  LocalFS()->NewRandomAccessFile(path, &file);
+  std::string content(LocalFS()->GetFileSize(path), '\0');
+  file->Read(0, content.size(), &content[0]);
+  return content;
+}
+
+class PlanCacheDir : public testing::Test {
+ protected:
+  void SetUp() override {
+    cache_dir_ = JoinPath(GetCwd(), "plan_cache_test_dir");
+    if (LocalFS()->IsDirectory(cache_dir_)) { LocalFS()->RecursivelyDeleteDir(cache_dir_); }
+    LocalFS()->RecursivelyCreateDir(cache_dir_);
+  }
+  void TearDown() override { LocalFS()->RecursivelyDeleteDir(cache_dir_); }
+
+  std::string cache_dir_;
+};
+
+}  // namespace
+
+TEST(PlanCache, key) {
+  // no part at all digests to the FNV-1a 128 offset basis
+  ASSERT_EQ(GenPlanCacheKey({}), "6c62272e07bb014262b821756295c58d");
+  const std::string key = GenPlanCacheKey({"job", "resource"});
+  ASSERT_EQ(key.size(), 32);
+  ASSERT_EQ(key, GenPlanCacheKey({"job", "resource"}));
+  ASSERT_NE(key, GenPlanCacheKey({"job", "resourcf"}));
+  ASSERT_NE(key, GenPlanCacheKey({"resource", "job"}));
+  ASSERT_NE(GenPlanCacheKey({"ab", "c"}), GenPlanCacheKey({"a", "bc"}));
+  ASSERT_NE(GenPlanCacheKey({}), GenPlanCacheKey({""}));
+}
+
+TEST_F(PlanCacheDir, store_and_load) {
+  const PlanCache plan_cache(cache_dir_, GenPlanCacheKey({"job"}));
+  Plan plan;
+  ASSERT_FALSE(plan_cache.TryLoad(&plan));
+  plan_cache.Store(GenTestPlan());
+  ASSERT_TRUE(plan_cache.TryLoad(&plan));
+  ASSERT_EQ(plan.SerializeAsString(), GenTestPlan().SerializeAsString());
+  // another key misses
+  Plan other_plan;
+  ASSERT_FALSE(PlanCache(cache_dir_, GenPlanCacheKey({"other job"})).TryLoad(&other_plan));
+}
+
+TEST_F(PlanCacheDir, damaged_entry) {
+  const PlanCache plan_cache(cache_dir_, GenPlanCacheKey({"job"}));
+  plan_cache.Store(GenTestPlan());
+  const std::string path = JoinPath(cache_dir_, plan_cache.key() + ".plan");
+  const std::string content = ReadFile(path);
+  Plan plan;
+  // a flipped byte, a truncated entry and an empty one are ignored
+  std::string flipped = content;
+  flipped.back() ^= 1;
+  WriteFile(path, flipped);
+  ASSERT_FALSE(plan_cache.TryLoad(&plan));
+  WriteFile(path, content.substr(0, content.size() - 1));
+  ASSERT_FALSE(plan_cache.TryLoad(&plan));
+  WriteFile(path, "");
+  ASSERT_FALSE(plan_cache.TryLoad(&plan));
+  // a new entry replaces the damaged one
+  plan_cache.Store(GenTestPlan());
+  ASSERT_TRUE(plan_cache.TryLoad(&plan));
+}
+
+TEST(PlanCache, unwritable_dir) {
+  const PlanCache plan_cache(JoinPath(GetCwd(), "plan_cache_test_missing_dir"),
+                             GenPlanCacheKey({"job"}));
+  // only warns
+  plan_cache.Store(GenTestPlan());
+  Plan plan;
+  ASSERT_FALSE(plan_cache.TryLoad(&plan));
+}
+
+}  // namespace oneflow
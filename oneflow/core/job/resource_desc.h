@@ -42,17 +42,23 @@ class ResourceDesc final {
   size_t reserved_host_mem_byte() const { return resource_.reserved_host_mem_mbyte() * kMB; }
   size_t reserved_device_mem_byte() const { return resource_.reserved_device_mem_mbyte() * kMB; }
   bool use_rdma() const { return resource_.use_rdma(); }
+  bool use_shm_comm_net() const { return resource_.use_shm_comm_net(); }
   bool enable_numa_aware_cuda_malloc_host() const {
     return resource_.enable_numa_aware_cuda_malloc_host();
   }
   bool thread_enable_local_message_queue() const {
     return resource_.thread_enable_local_message_queue();
   }
+  bool thread_enable_lock_free_mailbox() const {
+    return resource_.thread_enable_lock_free_mailbox();
+  }
+  size_t thread_mailbox_capacity() const { return resource_.thread_mailbox_capacity(); }
   bool enable_thread_local_cache() const { return resource_.enable_thread_local_cache(); }
   size_t thread_local_cache_max_size() const { return resource_.thread_local_cache_max_size(); }
   int32_t ComputeThreadPoolSize() const;
   bool enable_debug_mode() const;
   CollectiveBoxingConf collective_boxing_conf() const;
+  const EpollCommNetConf& epoll_comm_net_conf() const { return resource_.epoll_comm_net_conf(); }
   bool nccl_use_compute_stream() const;
 
   void SetMachineNum(int32_t val) { resource_.set_machine_num(val); }
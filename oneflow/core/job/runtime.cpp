@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
 #include "oneflow/core/comm_network/ibverbs/ibverbs_comm_network.h"
+#include "oneflow/core/comm_network/shm/shm_comm_network.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/resource_desc.h"
@@ -107,6 +108,9 @@ void Runtime::NewAllGlobal(const Plan& plan, size_t total_piece_num, bool is_exp
     // NOTE(chengcheng): Global<EpollCommNet> will new in any case.
     // if use RDMA,
     //   The Global<CommNet> is set allocated by new Global<IBVerbsCommNet>
+    // else if use shared memory,
+    //   The Global<CommNet> is set allocated by Global<ShmCommNet>, which sends to the peers
+    //   on other hosts through Global<EpollCommNet>
     // else,
     //   The Global<CommNet> is set allocated by Global<EpollCommNet>
     Global<EpollCommNet>::New();
@@ -117,6 +121,9 @@ void Runtime::NewAllGlobal(const Plan& plan, size_t total_piece_num, bool is_exp
 #else
       LOG(FATAL) << "RDMA components not found";
 #endif
+    } else if (Global<ResourceDesc, ForSession>::Get()->use_shm_comm_net()) {
+      Global<ShmCommNet>::New();
+      Global<CommNet>::SetAllocated(Global<ShmCommNet>::Get());
     } else {
       Global<CommNet>::SetAllocated(Global<EpollCommNet>::Get());
     }
@@ -155,6 +162,11 @@ void Runtime::DeleteAllGlobal() {
 #else
       LOG(FATAL) << "RDMA components not found";
 #endif
+    } else if (Global<ResourceDesc, ForSession>::Get()->use_shm_comm_net()) {
+      CHECK(Global<ShmCommNet>::Get() == static_cast<ShmCommNet*>(Global<CommNet>::Get()));
+      // NOTE: Global<CommNet> is the same object as Global<ShmCommNet>, and it must be deleted
+      // before the Global<EpollCommNet> it forwards to.
+      Global<ShmCommNet>::Delete();
     } else {
       CHECK(Global<EpollCommNet>::Get() == static_cast<EpollCommNet*>(Global<CommNet>::Get()));
       // NOTE(chengcheng): it means that Global<CommNet>::SetAllocated(Global<EpollCommNet>::Get())
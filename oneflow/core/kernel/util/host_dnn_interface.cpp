@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/kernel/util/host_dnn_interface.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -22,26 +23,34 @@ namespace {
 template<typename T>
 static void ReluImpl(DeviceCtx* ctx, const int64_t n, const T* x, T* y) {
   T zero = GetZeroVal<T>();
-  for (int64_t i = 0; i != n; ++i) { y[i] = std::max(x[i], zero); }
+  ParallelFor(0, n, kElemwiseParallelForGrain, [x, y, zero](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) { y[i] = std::max(x[i], zero); }
+  });
 }
 
 template<typename T>
 static void ReluBackwardImpl(DeviceCtx* ctx, const int64_t n, const T* x, const T* y, const T* dy,
                              T* dx) {
   T zero = GetZeroVal<T>();
-  for (int64_t i = 0; i != n; ++i) { dx[i] = (y[i] > zero) * dy[i]; }
+  ParallelFor(0, n, kElemwiseParallelForGrain, [y, dy, dx, zero](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) { dx[i] = (y[i] > zero) * dy[i]; }
+  });
 }
 
 template<typename T>
 static void SigmoidImpl(DeviceCtx* ctx, int64_t n, const T* x, T* y) {
   T half = static_cast<T>(0.5);
-  for (int64_t i = 0; i != n; ++i) { y[i] = half * std::tanh(half * x[i]) + half; }
+  ParallelFor(0, n, kElemwiseParallelForGrain, [x, y, half](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) { y[i] = half * std::tanh(half * x[i]) + half; }
+  });
 }
 
 template<typename T>
 static void SigmoidBackwardImpl(DeviceCtx* ctx, const int64_t n, const T* x, const T* y,
                                 const T* dy, T* dx) {
-  for (int64_t i = 0; i != n; ++i) { dx[i] = y[i] * (1 - y[i]) * dy[i]; }
+  ParallelFor(0, n, kElemwiseParallelForGrain, [y, dy, dx](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) { dx[i] = y[i] * (1 - y[i]) * dy[i]; }
+  });
 }
 
 }  // namespace
@@ -0,0 +1,51 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ndarray/ndarray_reduce_test_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(NdarrayReduce, benchmark) {
+  // loss, row reduce of logits, bias grad of a dense layer, channels last and channels first
+  // batch norm statistics, one case per fast path
+  const std::vector<ReduceCase> cases = {
+      {Shape({1 << 24}), Shape({1})},
+      {Shape({4096, 1000}), Shape({4096, 1})},
+      {Shape({8192, 1024}), Shape({1, 1024})},
+      {Shape({32, 56, 56, 64}), Shape({32, 1, 1, 64})},
+      {Shape({32, 64, 56, 56}), Shape({1, 64, 1, 1})},
+  };
+  for (const ReduceCase& test_case : cases) {
+    const int64_t x_elem_num = test_case.x_shape.elem_cnt();
+    std::mt19937 gen(0);
+    const std::vector<float> x = RandomVector<float>(x_elem_num, &gen);
+    std::vector<float> y(test_case.y_shape.elem_cnt());
+    std::vector<float> tmp(x_elem_num);
+    const int64_t iter_num = std::max<int64_t>(1e8 / x_elem_num, 1);
+    const double default_ms = AverageMilliseconds(
+        iter_num, [&]() { DefaultReduce<float, BinaryFuncSum>(test_case, x, &y, &tmp); });
+    const double fast_ms = AverageMilliseconds(
+        iter_num, [&]() { Reduce<float, BinaryFuncSum>(test_case, x, &y, &tmp); });
+    LOG(INFO) << test_case.x_shape.ToString() << " -> " << test_case.y_shape.ToString()
+              << " default " << default_ms << " ms, fast path " << fast_ms << " ms";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
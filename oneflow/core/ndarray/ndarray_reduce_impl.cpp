@@ -17,26 +17,278 @@ limitations under the License.
 #include "oneflow/core/common/preprocessor.h"
 #include "oneflow/core/ndarray/ndarray_reduce_impl.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
-#define SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(struct_name)                                            \
-  template<typename T, template<typename> class binary_func>                                       \
-  struct struct_name<DeviceType::kCPU, T, binary_func> final {                                     \
-    static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {              \
-      return false;                                                                                \
-    }                                                                                              \
-    static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x, \
-                       const XpuVarNdarray<T>& tmp_storage) {                                      \
-      UNIMPLEMENTED();                                                                             \
-    }                                                                                              \
-  }
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayScalarReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixRowReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixColReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeYReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeXZReduce);
-#undef SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL
+namespace {
+
+// independent accumulators of a contiguous run, the compiler keeps them in a vector register
+// instead of reducing serially
+constexpr int64_t kLaneNum = 16;
+// contiguous runs up to this length are reduced in lanes, longer ones are split in halves so
+// that the rounding error of a sum grows with log(n) instead of n
+constexpr int64_t kLeafSize = 1024;
+// rows of a column reduce that are folded into the accumulators one after another
+constexpr int64_t kLeafRowNum = 16;
+// columns of a column reduce handled by one task, their accumulators stay in L1
+constexpr int64_t kColBlockSize = 128;
+
+int64_t ReduceTaskNum() {
+  const ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  // a few tasks per thread lets the pool rebalance
+  return thread_pool == nullptr ? 1 : thread_pool->thread_num() * 4;
+}
+
+template<typename T, template<typename> class binary_func>
+T ReduceContiguous(const T* x, int64_t n) {
+  if (n > kLeafSize) {
+    const int64_t half = n / 2 / kLaneNum * kLaneNum;
+    return binary_func<T>::Invoke(ReduceContiguous<T, binary_func>(x, half),
+                                  ReduceContiguous<T, binary_func>(x + half, n - half));
+  }
+  const T unit = UnitOfBinaryFunc<T, binary_func>::Val();
+  T lane[kLaneNum];
+  std::fill(lane, lane + kLaneNum, unit);
+  const int64_t lane_end = n / kLaneNum * kLaneNum;
+  for (int64_t i = 0; i < lane_end; i += kLaneNum) {
+    FOR_RANGE(int64_t, j, 0, kLaneNum) { lane[j] = binary_func<T>::Invoke(lane[j], x[i + j]); }
+  }
+  T ret = unit;
+  FOR_RANGE(int64_t, j, 0, kLaneNum) { ret = binary_func<T>::Invoke(ret, lane[j]); }
+  FOR_RANGE(int64_t, i, lane_end, n) { ret = binary_func<T>::Invoke(ret, x[i]); }
+  return ret;
+}
+
+// y[k] = x[0][k] op x[1][k] op ... op x[row_num - 1][k] for k < col_num <= kColBlockSize, the
+// rows of x are row_stride elements apart and are combined pairwise
+template<typename T, template<typename> class binary_func>
+void ReduceRows(const T* x, int64_t row_stride, int64_t row_num, int64_t col_num, T* y) {
+  if (row_num > kLeafRowNum) {
+    const int64_t half = row_num / 2;
+    T buf[kColBlockSize];
+    ReduceRows<T, binary_func>(x, row_stride, half, col_num, y);
+    ReduceRows<T, binary_func>(x + half * row_stride, row_stride, row_num - half, col_num, buf);
+    FOR_RANGE(int64_t, k, 0, col_num) { y[k] = binary_func<T>::Invoke(y[k], buf[k]); }
+    return;
+  }
+  std::copy(x, x + col_num, y);
+  FOR_RANGE(int64_t, r, 1, row_num) {
+    const T* row = x + r * row_stride;
+    FOR_RANGE(int64_t, k, 0, col_num) { y[k] = binary_func<T>::Invoke(y[k], row[k]); }
+  }
+}
+
+// Reduces the rows of x[row_num, inner] which are row_stride elements apart to one value: every
+// row is reduced in place and the row results are combined pairwise.
+template<typename T, template<typename> class binary_func>
+T ReduceRowsToScalar(const T* x, int64_t row_stride, int64_t row_num, int64_t inner) {
+  if (row_num > 1 && row_num * inner > kLeafSize) {
+    const int64_t half = row_num / 2;
+    return binary_func<T>::Invoke(
+        ReduceRowsToScalar<T, binary_func>(x, row_stride, half, inner),
+        ReduceRowsToScalar<T, binary_func>(x + half * row_stride, row_stride, row_num - half,
+                                           inner));
+  }
+  T ret = UnitOfBinaryFunc<T, binary_func>::Val();
+  FOR_RANGE(int64_t, r, 0, row_num) {
+    ret = binary_func<T>::Invoke(ret, ReduceContiguous<T, binary_func>(x + r * row_stride, inner));
+  }
+  return ret;
+}
+
+// The partial results below live in vectors of their own instead of tmp_storage: some callers
+// pass the same buffer as x and tmp_storage.
+
+// y[o] = reduce of x[o, :] for x[outer, inner]
+template<typename T, template<typename> class binary_func>
+void ReduceInnerAxis(const T* x, int64_t outer, int64_t inner, T* y) {
+  if (outer == 0) { return; }
+  const int64_t task_num = ReduceTaskNum();
+  if (outer >= task_num || inner <= kElemwiseParallelForGrain) {
+    const int64_t grain =
+        std::max<int64_t>(kElemwiseParallelForGrain / std::max<int64_t>(inner, 1), 1);
+    ParallelFor(0, outer, grain, [&](int64_t row_begin, int64_t row_end) {
+      FOR_RANGE(int64_t, r, row_begin, row_end) {
+        y[r] = ReduceContiguous<T, binary_func>(x + r * inner, inner);
+      }
+    });
+    return;
+  }
+  // too few rows to keep the threads busy, every row is split into parts
+  const int64_t part_num = std::min(task_num / outer + 1, inner / kElemwiseParallelForGrain);
+  std::vector<T> partial(outer * part_num);
+  ParallelFor(0, outer * part_num, 1, [&](int64_t task_begin, int64_t task_end) {
+    FOR_RANGE(int64_t, task, task_begin, task_end) {
+      const int64_t part = task % part_num;
+      const int64_t begin = inner * part / part_num;
+      const int64_t end = inner * (part + 1) / part_num;
+      partial[task] =
+          ReduceContiguous<T, binary_func>(x + task / part_num * inner + begin, end - begin);
+    }
+  });
+  FOR_RANGE(int64_t, r, 0, outer) {
+    y[r] = ReduceContiguous<T, binary_func>(partial.data() + r * part_num, part_num);
+  }
+}
+
+// y[o, i] = reduce of x[o, :, i] for x[outer, mid, inner]
+template<typename T, template<typename> class binary_func>
+void ReduceMiddleAxis(const T* x, int64_t outer, int64_t mid, int64_t inner, T* y) {
+  if (outer * inner == 0) { return; }
+  if (mid == 0) {
+    std::fill(y, y + outer * inner, UnitOfBinaryFunc<T, binary_func>::Val());
+    return;
+  }
+  const int64_t col_block_num = (inner + kColBlockSize - 1) / kColBlockSize;
+  const int64_t block_num = outer * col_block_num;
+  const int64_t task_num = ReduceTaskNum();
+  const int64_t block_width = std::min(inner, kColBlockSize);
+  auto ReduceBlock = [&](int64_t block, int64_t row_begin, int64_t row_end, T* dst) {
+    const int64_t o = block / col_block_num;
+    const int64_t col = block % col_block_num * kColBlockSize;
+    ReduceRows<T, binary_func>(x + (o * mid + row_begin) * inner + col, inner,
+                               row_end - row_begin, std::min(inner - col, kColBlockSize),
+                               dst + o * inner + col);
+  };
+  // too few column blocks to keep the threads busy, the reduced axis is split into parts
+  const int64_t part_num =
+      block_num >= task_num
+          ? 1
+          : std::max<int64_t>(
+                std::min(task_num / block_num + 1, mid * block_width / kElemwiseParallelForGrain),
+                1);
+  if (part_num == 1) {
+    const int64_t grain = std::max<int64_t>(kElemwiseParallelForGrain / (mid * block_width), 1);
+    ParallelFor(0, block_num, grain, [&](int64_t block_begin, int64_t block_end) {
+      FOR_RANGE(int64_t, block, block_begin, block_end) { ReduceBlock(block, 0, mid, y); }
+    });
+    return;
+  }
+  const int64_t y_elem_num = outer * inner;
+  std::vector<T> partial(part_num * y_elem_num);
+  ParallelFor(0, part_num * block_num, 1, [&](int64_t task_begin, int64_t task_end) {
+    FOR_RANGE(int64_t, task, task_begin, task_end) {
+      const int64_t part = task / block_num;
+      ReduceBlock(task % block_num, mid * part / part_num, mid * (part + 1) / part_num,
+                  partial.data() + part * y_elem_num);
+    }
+  });
+  ParallelFor(0, y_elem_num, kElemwiseParallelForGrain / part_num, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      T ret = partial[i];
+      FOR_RANGE(int64_t, part, 1, part_num) {
+        ret = binary_func<T>::Invoke(ret, partial[part * y_elem_num + i]);
+      }
+      y[i] = ret;
+    }
+  });
+}
+
+// y[m] = reduce of x[:, m, :] for x[outer, mid, inner]
+template<typename T, template<typename> class binary_func>
+void ReduceOuterAndInnerAxes(const T* x, int64_t outer, int64_t mid, int64_t inner, T* y) {
+  if (mid == 0) { return; }
+  const int64_t task_num = ReduceTaskNum();
+  // too few kept elements to keep the threads busy, the outer axis is split into parts
+  const int64_t part_num =
+      mid >= task_num
+          ? 1
+          : std::max<int64_t>(
+                std::min(task_num / mid + 1, outer * inner / kElemwiseParallelForGrain), 1);
+  const int64_t row_stride = mid * inner;
+  std::vector<T> partial(part_num == 1 ? 0 : mid * part_num);
+  T* dst = part_num == 1 ? y : partial.data();
+  const int64_t elem_num_per_task = std::max<int64_t>(outer * inner / part_num, 1);
+  const int64_t grain = std::max<int64_t>(kElemwiseParallelForGrain / elem_num_per_task, 1);
+  ParallelFor(0, mid * part_num, grain, [&](int64_t task_begin, int64_t task_end) {
+    FOR_RANGE(int64_t, task, task_begin, task_end) {
+      const int64_t m = task / part_num;
+      const int64_t part = task % part_num;
+      const int64_t begin = outer * part / part_num;
+      const int64_t end = outer * (part + 1) / part_num;
+      dst[task] = ReduceRowsToScalar<T, binary_func>(x + begin * row_stride + m * inner, row_stride,
+                                                     end - begin, inner);
+    }
+  });
+  if (part_num == 1) { return; }
+  FOR_RANGE(int64_t, m, 0, mid) {
+    y[m] = ReduceContiguous<T, binary_func>(partial.data() + m * part_num, part_num);
+  }
+}
+
+}  // namespace
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayScalarReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    return y.shape().ElemNum() == 1;
+  }
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    ReduceInnerAxis<T, binary_func>(x.ptr(), 1, x.shape().ElemNum(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixRowReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1;
+  }
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    ReduceInnerAxis<T, binary_func>(x.ptr(), x.shape().At(0), x.shape().At(1), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixColReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1);
+  }
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    ReduceMiddleAxis<T, binary_func>(x.ptr(), 1, x.shape().At(0), x.shape().At(1), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeYReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1
+           && x.shape().At(2) == y.shape().At(2);
+  }
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    ReduceMiddleAxis<T, binary_func>(x.ptr(), x.shape().At(0), x.shape().At(1), x.shape().At(2),
+                                     y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeXZReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1) && y.shape().At(2) == 1;
+  }
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    ReduceOuterAndInnerAxes<T, binary_func>(x.ptr(), x.shape().At(0), x.shape().At(1),
+                                            x.shape().At(2), y.ptr());
+  }
+};
 
 #define INSTANTIATE_NDARRAY_REDUCE_IMPL(dtype, binary_func)                                       \
   template struct NdarrayScalarReduce<DeviceType::kCPU, OF_PP_PAIR_FIRST(dtype), binary_func>;    \
@@ -0,0 +1,90 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ndarray/ndarray_reduce_test_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+std::vector<ReduceCase> TestCases() {
+  // every fast path with lane tails and column block tails, the later ones are large enough
+  // for the reduced axes to be split over threads
+  return {
+      {Shape({1, 7}), Shape({1, 1})},
+      {Shape({7, 5}), Shape({1, 1})},
+      {Shape({3, 1000}), Shape({3, 1})},
+      {Shape({1000, 3}), Shape({1, 3})},
+      {Shape({5, 17, 129}), Shape({5, 1, 129})},
+      {Shape({4, 3, 5, 7}), Shape({1, 3, 1, 1})},
+      {Shape({2, 3, 4, 5}), Shape({1, 3, 1, 5})},
+      {Shape({300000}), Shape({1})},
+      {Shape({2, 100000}), Shape({2, 1})},
+      {Shape({20000, 65}), Shape({1, 65})},
+      {Shape({2, 30000, 3}), Shape({2, 1, 3})},
+      {Shape({8, 3, 100, 100}), Shape({1, 3, 1, 1})},
+  };
+}
+
+template<typename T, template<typename> class binary_func>
+void TestReduce(const ReduceCase& test_case, double rel_err) {
+  const int64_t x_elem_num = test_case.x_shape.elem_cnt();
+  const int64_t y_elem_num = test_case.y_shape.elem_cnt();
+  std::mt19937 gen(static_cast<uint32_t>(x_elem_num));
+  const std::vector<T> x = RandomVector<T>(x_elem_num, &gen);
+  std::vector<double> x_double(x.begin(), x.end());
+  std::vector<double> ref(y_elem_num);
+  std::vector<double> ref_tmp(x_elem_num);
+  DefaultReduce<double, binary_func>(test_case, x_double, &ref, &ref_tmp);
+  std::vector<T> y(y_elem_num);
+  std::vector<T> tmp(x_elem_num);
+  Reduce<T, binary_func>(test_case, x, &y, &tmp);
+  const double elem_num_per_y = static_cast<double>(x_elem_num) / y_elem_num;
+  FOR_RANGE(int64_t, i, 0, y_elem_num) {
+    ASSERT_NEAR(ref[i], y[i], rel_err * elem_num_per_y) << test_case.x_shape.ToString();
+  }
+  // some callers pass the same buffer as x and tmp_storage
+  std::vector<T> x_and_tmp(x);
+  std::vector<T> aliased_y(y_elem_num);
+  NdarrayReduce<DeviceType::kCPU, T, binary_func>::Reduce(
+      nullptr, XpuVarNdarray<T>(test_case.y_shape, aliased_y.data()),
+      XpuVarNdarray<const T>(test_case.x_shape, x_and_tmp.data()),
+      XpuVarNdarray<T>(test_case.x_shape, x_and_tmp.data()));
+  ASSERT_EQ(aliased_y, y);
+}
+
+void TestAllCases() {
+  for (const ReduceCase& test_case : TestCases()) {
+    TestReduce<float, BinaryFuncSum>(test_case, 1e-6);
+    TestReduce<double, BinaryFuncSum>(test_case, 1e-14);
+    TestReduce<float, BinaryFuncMax>(test_case, 0);
+    TestReduce<int32_t, BinaryFuncMin>(test_case, 0);
+  }
+}
+
+}  // namespace
+
+TEST(NdarrayReduce, fast_paths) { TestAllCases(); }
+
+class NdarrayReduceMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(NdarrayReduceMultiThread, fast_paths) { TestAllCases(); }
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,65 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_NDARRAY_NDARRAY_REDUCE_TEST_UTIL_H_
+#define ONEFLOW_CORE_NDARRAY_NDARRAY_REDUCE_TEST_UTIL_H_
+
+#include <random>
+#include "oneflow/core/ndarray/ndarray_reduce.h"
+
+namespace oneflow {
+
+namespace test {
+
+// helpers shared by the ndarray_reduce test and benchmark
+
+struct ReduceCase {
+  Shape x_shape;
+  Shape y_shape;
+};
+
+template<typename T>
+std::vector<T> RandomVector(int64_t n, std::mt19937* gen) {
+  const double scale = std::is_integral<T>::value ? 1000 : 1;
+  std::uniform_real_distribution<double> dis(-scale, scale);
+  std::vector<T> vec(n);
+  for (T& val : vec) { val = static_cast<T>(dis(*gen)); }
+  return vec;
+}
+
+template<typename T, template<typename> class binary_func>
+void Reduce(const ReduceCase& test_case, const std::vector<T>& x, std::vector<T>* y,
+            std::vector<T>* tmp) {
+  NdarrayReduce<DeviceType::kCPU, T, binary_func>::Reduce(
+      nullptr, XpuVarNdarray<T>(test_case.y_shape, y->data()),
+      XpuVarNdarray<const T>(test_case.x_shape, x.data()),
+      XpuVarNdarray<T>(test_case.x_shape, tmp->data()));
+}
+
+// the generic path every reduce took before, one pass over the tensor per reduced axis
+template<typename T, template<typename> class binary_func>
+void DefaultReduce(const ReduceCase& test_case, const std::vector<T>& x, std::vector<T>* y,
+                   std::vector<T>* tmp) {
+  NdarrayDefaultReduce<DeviceType::kCPU, T, binary_func>::Reduce(
+      nullptr, XpuVarNdarray<T>(test_case.y_shape, y->data()),
+      XpuVarNdarray<const T>(test_case.x_shape, x.data()),
+      XpuVarNdarray<T>(test_case.x_shape, tmp->data()));
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_NDARRAY_NDARRAY_REDUCE_TEST_UTIL_H_
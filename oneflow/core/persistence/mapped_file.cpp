@@ -0,0 +1,56 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/mapped_file.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+MappedFile::MappedFile(const std::string& file_path)
+    : file_path_(file_path), data_(nullptr), size_(0) {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  PCHECK(fd != -1) << "Fail to open " << file_path;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0) << file_path;
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* ptr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    PCHECK(ptr != MAP_FAILED) << "Fail to mmap " << file_path;
+    data_ = static_cast<char*>(ptr);
+  }
+  PCHECK(close(fd) == 0);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) { PCHECK(munmap(data_, size_) == 0); }
+}
+
+void MappedFile::AdviseRandom() const {
+  if (data_ != nullptr) { madvise(data_, size_, MADV_RANDOM); }
+}
+
+void MappedFile::AdviseSequential() const {
+  if (data_ != nullptr) { madvise(data_, size_, MADV_SEQUENTIAL); }
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
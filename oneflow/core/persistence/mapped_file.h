@@ -0,0 +1,51 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_MAPPED_FILE_H_
+#define ONEFLOW_CORE_PERSISTENCE_MAPPED_FILE_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/platform.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+// A local file mapped copy-on-write: callers may scribble on the pages, the file never changes.
+class MappedFile final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MappedFile);
+  explicit MappedFile(const std::string& file_path);
+  ~MappedFile();
+
+  const std::string& file_path() const { return file_path_; }
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // hints the kernel about the access pattern of the whole mapping
+  void AdviseRandom() const;
+  void AdviseSequential() const;
+
+ private:
+  std::string file_path_;
+  char* data_;
+  size_t size_;
+};
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_MAPPED_FILE_H_
@@ -37,6 +37,17 @@ size_t GetBufferSize(int64_t session_id) {
   }
 }
 
+size_t GetReadaheadDepth(int64_t session_id) {
+  return Global<const IOConf>::Get(session_id)->persistence_readahead_depth();
+}
+
+size_t GetReadaheadBufferSize(int64_t session_id) {
+  const int64_t buffer_size =
+      Global<const IOConf>::Get(session_id)->persistence_readahead_buf_byte();
+  CHECK_GT(buffer_size, 0);
+  return buffer_size;
+}
+
 }  // namespace
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -61,7 +72,14 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
   } else {
     stream_scanner_.reset(new AcyclicStreamScanner(fs, streams, offset));
   }
-  buffer_.resize(GetBufferSize(session_id) + 1);
+  const size_t readahead_depth = GetReadaheadDepth(session_id);
+  if (readahead_depth > 0) {
+    readahead_scanner_.reset(new ReadaheadStreamScanner(
+        std::move(stream_scanner_), readahead_depth, GetReadaheadBufferSize(session_id)));
+    buffer_.resize(1);
+  } else {
+    buffer_.resize(GetBufferSize(session_id) + 1);
+  }
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data();
   *cur_buf_end_ = '\0';
@@ -122,6 +140,15 @@ int32_t PersistentInStream::ReadFully(char* s, size_t n) {
 
 void PersistentInStream::UpdateBuffer() {
   CHECK_EQ(cur_buf_begin_, cur_buf_end_);
+  if (readahead_scanner_) {
+    char* data = nullptr;
+    uint64_t n = readahead_scanner_->NextBuffer(&data);
+    // the previous buffer is released now, park on the empty local one at eof
+    if (n == 0) { data = buffer_.data(); }
+    cur_buf_begin_ = data;
+    cur_buf_end_ = data + n;
+    return;
+  }
   uint64_t n = stream_scanner_->UpdateBuffer(&buffer_);
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data() + n;
@@ -129,6 +156,8 @@ void PersistentInStream::UpdateBuffer() {
 }
 
 bool PersistentInStream::IsEof() const {
-  return cur_buf_begin_ == cur_buf_end_ && stream_scanner_->IsEof();
+  if (cur_buf_begin_ != cur_buf_end_) { return false; }
+  if (readahead_scanner_) { return readahead_scanner_->IsEof(); }
+  return stream_scanner_->IsEof();
 }
 }  // namespace oneflow
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/persistence/file_system.h"
 #include "oneflow/core/persistence/stream_scanner.h"
+#include "oneflow/core/persistence/readahead_stream_scanner.h"
 
 namespace oneflow {
 
@@ -49,6 +50,8 @@ class PersistentInStream {
   void UpdateBuffer();
 
   std::unique_ptr<StreamScanner> stream_scanner_;
+  // set instead of stream_scanner_ when IOConf asks for readahead
+  std::unique_ptr<ReadaheadStreamScanner> readahead_scanner_;
 
   std::vector<char> buffer_;
   char* cur_buf_begin_;
@@ -0,0 +1,67 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/persistent_in_stream_test_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <fcntl.h>
+
+namespace oneflow {
+
+namespace {
+
+// flushes the files and evicts them from the page cache so that reads hit the disk
+void DropPageCache(const std::vector<std::string>& file_paths) {
+  for (const std::string& file_path : file_paths) {
+    int fd = open(file_path.c_str(), O_RDONLY);
+    PCHECK(fd != -1);
+    PCHECK(fdatasync(fd) == 0);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    PCHECK(close(fd) == 0);
+  }
+}
+
+}  // namespace
+
+// Set ONEFLOW_TEST_PERSISTENCE_BENCHMARK_BYTE to read a multi-GB record set.
+TEST(PersistentInStream, readahead_benchmark) {
+  const char* byte_env = std::getenv("ONEFLOW_TEST_PERSISTENCE_BENCHMARK_BYTE");
+  const int64_t total_byte = byte_env == nullptr ? (256LL << 20) : std::stoll(byte_env);
+  const int64_t file_num = 8;
+  fs::PosixFileSystem file_system;
+  const std::string dir = MakeTestDir(&file_system, "tmp_persistent_in_stream_benchmark");
+  const std::vector<std::string> file_paths =
+      WriteRecordFiles(&file_system, dir, file_num, total_byte / file_num, 128 * 1024);
+  auto Measure = [&](const std::string& name, uint32_t depth, uint64_t buf_byte) {
+    ResetIOConf(depth, buf_byte);
+    DropPageCache(file_paths);
+    auto start = std::chrono::steady_clock::now();
+    const int64_t record_num = ReadRecords(&file_system, file_paths, false, INT64_MAX).size();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG(INFO) << name << ": " << record_num << " records, "
+              << total_byte / elapsed.count() / (1 << 20) << " MB/s";
+  };
+  Measure("inline 32KB buffer", 0, 1);
+  Measure("readahead 4 x 8MB", 4, 8 << 20);
+  Measure("readahead 8 x 16MB", 8, 16 << 20);
+  Global<const IOConf>::Delete();
+  file_system.RecursivelyDeleteDir(dir);
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -0,0 +1,50 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/persistent_in_stream_test_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+TEST(PersistentInStream, readahead_reads_same_records) {
+  fs::PosixFileSystem file_system;
+  const std::string dir = MakeTestDir(&file_system, "tmp_persistent_in_stream_test");
+  // buffers smaller than a record and files that end mid buffer
+  const std::vector<std::string> file_paths =
+      WriteRecordFiles(&file_system, dir, 3, 100 * 1000, 1000 - sizeof(int64_t) - 7);
+  ResetIOConf(0, 1);
+  const std::vector<uint64_t> expected = ReadRecords(&file_system, file_paths, false, INT64_MAX);
+  const std::vector<uint64_t> expected_cyclic =
+      ReadRecords(&file_system, file_paths, true, 3 * expected.size() + 5);
+  ASSERT_FALSE(expected.empty());
+  for (uint32_t depth : {1, 2, 4}) {
+    for (uint64_t buf_byte : {uint64_t(100), uint64_t(4096), uint64_t(1 << 20)}) {
+      ResetIOConf(depth, buf_byte);
+      ASSERT_EQ(ReadRecords(&file_system, file_paths, false, INT64_MAX), expected);
+      ASSERT_EQ(ReadRecords(&file_system, file_paths, true, expected_cyclic.size()),
+                expected_cyclic);
+      // a reader that stops early must not hang the I/O thread
+      ASSERT_EQ(ReadRecords(&file_system, file_paths, false, 1).size(), 1);
+    }
+  }
+  Global<const IOConf>::Delete();
+  file_system.RecursivelyDeleteDir(dir);
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
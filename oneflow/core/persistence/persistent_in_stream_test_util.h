@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_PERSISTENT_IN_STREAM_TEST_UTIL_H_
+#define ONEFLOW_CORE_PERSISTENCE_PERSISTENT_IN_STREAM_TEST_UTIL_H_
+
+#include "oneflow/core/persistence/persistent_in_stream.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/job/job_set.pb.h"
+
+namespace oneflow {
+
+// helpers shared by the persistent_in_stream test and benchmark
+
+// records are laid out like OFRecord files: int64 byte size, then the bytes
+inline std::vector<std::string> WriteRecordFiles(fs::FileSystem* file_system,
+                                                 const std::string& dir, int64_t file_num,
+                                                 int64_t file_byte, int64_t record_byte) {
+  std::vector<std::string> file_paths;
+  std::string record(record_byte, '\0');
+  FOR_RANGE(int64_t, i, 0, file_num) {
+    const std::string file_path = JoinPath(dir, "part-" + std::to_string(i));
+    std::unique_ptr<fs::WritableFile> file;
+    file_system->NewWritableFile(file_path, &file);
+    int64_t record_id = 0;
+    for (int64_t written = 0; written < file_byte; written += sizeof(int64_t) + record_byte) {
+      FOR_RANGE(int64_t, j, 0, record_byte) { record[j] = static_cast<char>(i + record_id + j); }
+      file->Append(reinterpret_cast<const char*>(&record_byte), sizeof(int64_t));
+      file->Append(record.data(), record.size());
+      record_id += 1;
+    }
+    file->Close();
+    file_paths.push_back(file_path);
+  }
+  return file_paths;
+}
+
+// stands in for record parsing so that there is work to overlap with I/O
+inline uint64_t Checksum(const std::vector<char>& record) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : record) { hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL; }
+  return hash;
+}
+
+inline void ResetIOConf(uint32_t readahead_depth, uint64_t readahead_buf_byte) {
+  if (Global<const IOConf>::Get() != nullptr) { Global<const IOConf>::Delete(); }
+  IOConf io_conf;
+  io_conf.set_persistence_readahead_depth(readahead_depth);
+  io_conf.set_persistence_readahead_buf_byte(readahead_buf_byte);
+  Global<const IOConf>::New(io_conf);
+}
+
+// reads records until eof or until record_num records, returns their checksums
+inline std::vector<uint64_t> ReadRecords(fs::FileSystem* file_system,
+                                         const std::vector<std::string>& file_paths, bool cyclic,
+                                         int64_t record_num) {
+  PersistentInStream in_stream(file_system, file_paths, cyclic, false);
+  std::vector<uint64_t> checksums;
+  std::vector<char> record;
+  int64_t record_byte = 0;
+  while (static_cast<int64_t>(checksums.size()) < record_num
+         && in_stream.ReadFully(reinterpret_cast<char*>(&record_byte), sizeof(int64_t)) == 0) {
+    record.resize(record_byte);
+    CHECK_EQ(in_stream.ReadFully(record.data(), record_byte), 0);
+    checksums.push_back(Checksum(record));
+  }
+  return checksums;
+}
+
+inline std::string MakeTestDir(fs::FileSystem* file_system, const std::string& name) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string dir = JoinPath(current_dir, name);
+  if (file_system->IsDirectory(dir)) { file_system->RecursivelyDeleteDir(dir); }
+  file_system->CreateDir(dir);
+  return dir;
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_PERSISTENT_IN_STREAM_TEST_UTIL_H_
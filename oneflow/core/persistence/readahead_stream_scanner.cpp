@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/readahead_stream_scanner.h"
+
+namespace oneflow {
+
+ReadaheadStreamScanner::ReadaheadStreamScanner(std::unique_ptr<StreamScanner>&& scanner,
+                                               size_t depth, size_t buf_size)
+    : scanner_(std::move(scanner)),
+      buffers_(depth + 1),
+      valid_sizes_(depth + 1, 0),
+      read_idx_(0),
+      ready_cnt_(0),
+      is_reader_holding_(false),
+      is_scanner_eof_(false),
+      is_stopped_(false) {
+  CHECK_GT(depth, 0);
+  CHECK_GT(buf_size, 0);
+  for (std::vector<char>& buffer : buffers_) { buffer.resize(buf_size + 1); }
+  io_thread_ = std::thread([this]() { IoLoop(); });
+}
+
+ReadaheadStreamScanner::~ReadaheadStreamScanner() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_stopped_ = true;
+    cond_.notify_all();
+  }
+  io_thread_.join();
+}
+
+void ReadaheadStreamScanner::IoLoop() {
+  const size_t buffer_num = buffers_.size();
+  size_t write_idx = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [&]() {
+        return is_stopped_ || ready_cnt_ + (is_reader_holding_ ? 1 : 0) < buffer_num;
+      });
+      if (is_stopped_) { return; }
+    }
+    // the free buffer is not touched by the reader, fill it without the lock
+    std::vector<char>* buffer = &buffers_.at(write_idx);
+    const uint64_t n = scanner_->UpdateBuffer(buffer);
+    buffer->at(n) = '\0';
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (n == 0) {
+      is_scanner_eof_ = true;
+      cond_.notify_all();
+      return;
+    }
+    valid_sizes_.at(write_idx) = n;
+    write_idx = (write_idx + 1) % buffer_num;
+    ready_cnt_ += 1;
+    cond_.notify_all();
+  }
+}
+
+uint64_t ReadaheadStreamScanner::NextBuffer(char** data) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (is_reader_holding_) {
+    is_reader_holding_ = false;
+    read_idx_ = (read_idx_ + 1) % buffers_.size();
+    cond_.notify_all();
+  }
+  cond_.wait(lock, [this]() { return ready_cnt_ > 0 || is_scanner_eof_; });
+  if (ready_cnt_ == 0) { return 0; }
+  ready_cnt_ -= 1;
+  is_reader_holding_ = true;
+  *data = buffers_.at(read_idx_).data();
+  return valid_sizes_.at(read_idx_);
+}
+
+bool ReadaheadStreamScanner::IsEof() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this]() { return ready_cnt_ > 0 || is_scanner_eof_; });
+  return ready_cnt_ == 0;
+}
+
+}  // namespace oneflow
@@ -0,0 +1,56 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_READAHEAD_STREAM_SCANNER_H_
+#define ONEFLOW_CORE_PERSISTENCE_READAHEAD_STREAM_SCANNER_H_
+
+#include "oneflow/core/persistence/stream_scanner.h"
+
+namespace oneflow {
+
+// Runs a StreamScanner on a background I/O thread that fills up to depth buffers ahead of the
+// one the reader holds. The scanner walks from one file to the next by itself, so the head of the next file
+// is read while the reader still parses the tail of the current one.
+class ReadaheadStreamScanner final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ReadaheadStreamScanner);
+  ReadaheadStreamScanner(std::unique_ptr<StreamScanner>&& scanner, size_t depth, size_t buf_size);
+  ~ReadaheadStreamScanner();
+
+  // Releases the buffer returned by the previous call and points *data at the next filled one,
+  // which stays valid until the next call and is followed by a '\0'. Returns its size, 0 on eof.
+  uint64_t NextBuffer(char** data);
+  bool IsEof();
+
+ private:
+  void IoLoop();
+
+  std::unique_ptr<StreamScanner> scanner_;
+  std::vector<std::vector<char>> buffers_;
+  std::vector<uint64_t> valid_sizes_;
+  // buffers_[read_idx_] is held by the reader if is_reader_holding_
+  size_t read_idx_;
+  size_t ready_cnt_;
+  bool is_reader_holding_;
+  bool is_scanner_eof_;
+  bool is_stopped_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread io_thread_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_READAHEAD_STREAM_SCANNER_H_
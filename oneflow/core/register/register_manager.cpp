@@ -22,6 +22,7 @@ limitations under the License.
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/memory/memory_case.pb.h"
 #include "oneflow/core/memory/memory_allocator.h"
+#include "oneflow/core/comm_network/shm/shm_comm_network.h"
 
 namespace oneflow {
 
@@ -31,6 +32,18 @@ void CheckBlobInRegstNotDisabled(const RegstDescProto& regst_desc) {
   CHECK(regst_desc.regst_desc_type().has_data_regst_desc());
 }
 
+char* AllocateChunkMem(const MemoryCase& mem_case, int64_t size) {
+#ifdef OF_PLATFORM_POSIX
+  ShmCommNet* shm_comm_net = Global<ShmCommNet>::Get();
+  if (shm_comm_net != nullptr && shm_comm_net->has_local_peer() && mem_case.has_host_mem()
+      && mem_case.host_mem().used_by_network()) {
+    // local peers copy the regsts straight out of this memory
+    return shm_comm_net->AllocateSharedHostMem(mem_case, size);
+  }
+#endif
+  return Global<MemoryAllocator>::Get()->Allocate(mem_case, size);
+}
+
 struct PackedChunkInfo {
   MemoryCase mem_case;
   int64_t size;
@@ -50,7 +63,7 @@ RegstMgr::RegstMgr(const Plan& plan) {
   for (const ChunkProto& chunk : plan.block_chunk_list().chunk()) {
     if (chunk.machine_id() != this_machine_id) { continue; }
     if (chunk.mem_size() == 0) { continue; }
-    char* chunk_ptr = Global<MemoryAllocator>::Get()->Allocate(chunk.mem_case(), chunk.mem_size());
+    char* chunk_ptr = AllocateChunkMem(chunk.mem_case(), chunk.mem_size());
     CHECK(chunk_id2ptr.emplace(chunk.chunk_id(), chunk_ptr).second);
   }
 
@@ -80,8 +93,7 @@ RegstMgr::RegstMgr(const Plan& plan) {
 
   for (auto& pair : zone_id2packed_chunk) {
     PackedChunkInfo* packed_chunk = &pair.second;
-    char* ptr =
-        Global<MemoryAllocator>::Get()->Allocate(packed_chunk->mem_case, packed_chunk->size);
+    char* ptr = AllocateChunkMem(packed_chunk->mem_case, packed_chunk->size);
     // sort blocks as thrd id
     std::vector<const MemBlockProto*>* blocks = &(packed_chunk->blocks);
     std::sort(blocks->begin(), blocks->end(),
@@ -17,14 +17,23 @@ limitations under the License.
 #include "oneflow/core/job/runtime_context.h"
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/actor/actor.h"
-#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/resource_desc.h"
 
 namespace oneflow {
 
+Thread::Thread() {
+  const ResourceDesc* resource_desc = Global<ResourceDesc, ForSession>::Get();
+  enable_local_message_queue_ = resource_desc->thread_enable_local_message_queue();
+  if (resource_desc->thread_enable_lock_free_mailbox()) {
+    msg_mailbox_.reset(new MpscMailbox<ActorMsg>(resource_desc->thread_mailbox_capacity()));
+  }
+}
+
 Thread::~Thread() {
   actor_thread_.join();
   CHECK(id2task_.empty());
   msg_channel_.Close();
+  if (msg_mailbox_) { msg_mailbox_->Close(); }
 }
 
 void Thread::AddTask(const TaskProto& task) {
@@ -33,19 +42,35 @@ void Thread::AddTask(const TaskProto& task) {
 }
 
 void Thread::EnqueueActorMsg(const ActorMsg& msg) {
-  if (Global<ResourceDesc, ForSession>::Get()->thread_enable_local_message_queue()
-      && std::this_thread::get_id() == actor_thread_.get_id()) {
+  const bool is_actor_thread = std::this_thread::get_id() == actor_thread_.get_id();
+  if (enable_local_message_queue_ && is_actor_thread) {
     local_msg_queue_.push(msg);
+  } else if (msg_mailbox_) {
+    if (is_actor_thread) {
+      // the consumer must never block on its own mailbox, spill to the local queue when full
+      ChannelStatus status = kChannelStatusSuccess;
+      if (!local_msg_queue_.empty() || !msg_mailbox_->TrySend(msg, &status)) {
+        local_msg_queue_.push(msg);
+      }
+    } else {
+      msg_mailbox_->Send(msg);
+    }
   } else {
     msg_channel_.Send(msg);
   }
 }
 
+ChannelStatus Thread::ReceiveManyMsg() {
+  if (msg_mailbox_) {
+    return msg_mailbox_->ReceiveMany(&local_msg_queue_);
+  } else {
+    return msg_channel_.ReceiveMany(&local_msg_queue_);
+  }
+}
+
 void Thread::PollMsgChannel(const ThreadCtx& thread_ctx) {
   while (true) {
-    if (local_msg_queue_.empty()) {
-      CHECK_EQ(msg_channel_.ReceiveMany(&local_msg_queue_), kChannelStatusSuccess);
-    }
+    if (local_msg_queue_.empty()) { CHECK_EQ(ReceiveManyMsg(), kChannelStatusSuccess); }
     ActorMsg msg = std::move(local_msg_queue_.front());
     local_msg_queue_.pop();
     if (msg.msg_type() == ActorMsgType::kCmdMsg) {
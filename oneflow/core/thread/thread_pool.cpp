@@ -17,28 +17,191 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+thread_local const ThreadPool* cur_thread_pool = nullptr;
+thread_local int32_t cur_worker_id = -1;
+
+}  // namespace
+
+struct ThreadPool::ChunkedLoop {
+  ChunkedLoop(size_t num, size_t chunk_size, ChunkFn DoChunk, void* ctx)
+      : num(num),
+        chunk_size(chunk_size),
+        chunk_num((num + chunk_size - 1) / chunk_size),
+        DoChunk(DoChunk),
+        ctx(ctx),
+        next_begin(0),
+        helper_cnt(0) {}
+
+  const size_t num;
+  const size_t chunk_size;
+  const size_t chunk_num;
+  const ChunkFn DoChunk;
+  void* const ctx;
+  std::atomic<size_t> next_begin;
+  // guarded by chunked_loops_mutex_
+  int32_t helper_cnt;
+};
+
 ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    : threads_(thread_num),
+      work_cnt_(0),
+      pending_work_cnt_(0),
+      joinable_loop_cnt_(0),
+      idle_worker_cnt_(0),
+      is_stopped_(false) {
+  FOR_RANGE(int32_t, i, 0, thread_num) { work_queues_.emplace_back(new WorkQueue()); }
+  chunked_loops_.reserve(thread_num + 1);
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    threads_[i] = std::thread([this, i]() { WorkerLoop(i); });
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
+  {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    is_stopped_ = true;
+    idle_cond_.notify_all();
+  }
+  for (std::thread& thread : threads_) { thread.join(); }
+}
+
+void ThreadPool::PushWork(int32_t queue_id, bool is_local, std::function<void()>&& work) {
+  {
+    WorkQueue* queue = work_queues_.at(queue_id).get();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    (is_local ? queue->local_works : queue->works).push_back(std::move(work));
+  }
+  pending_work_cnt_.fetch_add(1, std::memory_order_seq_cst);
+  if (idle_worker_cnt_.load(std::memory_order_seq_cst) > 0) {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cond_.notify_one();
+  }
+}
+
+bool ThreadPool::TryPopOrSteal(int32_t queue_id, std::function<void()>* work) {
+  if (pending_work_cnt_.load(std::memory_order_acquire) <= 0) { return false; }
+  {
+    WorkQueue* queue = work_queues_.at(queue_id).get();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue->local_works.empty()) {
+      *work = std::move(queue->local_works.back());
+      queue->local_works.pop_back();
+      pending_work_cnt_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+    if (!queue->works.empty()) {
+      *work = std::move(queue->works.front());
+      queue->works.pop_front();
+      pending_work_cnt_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  const int32_t queue_num = work_queues_.size();
+  FOR_RANGE(int32_t, i, 1, queue_num) {
+    WorkQueue* victim = work_queues_.at((queue_id + i) % queue_num).get();
+    std::unique_lock<std::mutex> lock(victim->mutex, std::try_to_lock);
+    if (!lock.owns_lock()) { continue; }
+    std::deque<std::function<void()>>* works =
+        victim->works.empty() ? &victim->local_works : &victim->works;
+    if (works->empty()) { continue; }
+    *work = std::move(works->front());
+    works->pop_front();
+    pending_work_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id) {
+  cur_thread_pool = this;
+  cur_worker_id = worker_id;
+  std::function<void()> work;
+  while (true) {
+    if (TryHelpChunkedLoop()) { continue; }
+    if (TryPopOrSteal(worker_id, &work)) {
+      work();
+      work = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_worker_cnt_.fetch_add(1, std::memory_order_seq_cst);
+    idle_cond_.wait(lock, [this]() {
+      return pending_work_cnt_.load(std::memory_order_seq_cst) > 0
+             || joinable_loop_cnt_.load(std::memory_order_seq_cst) > 0 || is_stopped_;
+    });
+    idle_worker_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    if (is_stopped_ && pending_work_cnt_.load(std::memory_order_seq_cst) <= 0) { break; }
   }
 }
 
 void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+  std::function<void()> work_copy(work);
+  if (cur_thread_pool == this) {
+    PushWork(cur_worker_id, true, std::move(work_copy));
+  } else {
+    const size_t queue_id = work_cnt_.fetch_add(1, std::memory_order_relaxed) % threads_.size();
+    PushWork(queue_id, false, std::move(work_copy));
+  }
+}
+
+void ThreadPool::RunChunks(ChunkedLoop* loop) {
+  while (true) {
+    const size_t begin = loop->next_begin.fetch_add(loop->chunk_size, std::memory_order_relaxed);
+    if (begin >= loop->num) { break; }
+    // exactly one thread claims the last chunk, idle workers stop looking for this loop as soon
+    // as nothing is left to claim instead of when the chunks in flight finish
+    if (begin == (loop->chunk_num - 1) * loop->chunk_size) {
+      joinable_loop_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    loop->DoChunk(loop->ctx, begin, std::min(begin + loop->chunk_size, loop->num));
+  }
+}
+
+bool ThreadPool::TryHelpChunkedLoop() {
+  if (joinable_loop_cnt_.load(std::memory_order_acquire) <= 0) { return false; }
+  ChunkedLoop* loop = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(chunked_loops_mutex_);
+    for (ChunkedLoop* cur : chunked_loops_) {
+      if (cur->next_begin.load(std::memory_order_relaxed) < cur->num) {
+        loop = cur;
+        break;
+      }
+    }
+    if (loop == nullptr) { return false; }
+    loop->helper_cnt += 1;
+  }
+  RunChunks(loop);
+  std::unique_lock<std::mutex> lock(chunked_loops_mutex_);
+  loop->helper_cnt -= 1;
+  if (loop->helper_cnt == 0) { chunked_loops_cond_.notify_all(); }
+  return true;
+}
+
+void ThreadPool::RunChunkedLoop(size_t num, size_t chunk_size, ChunkFn DoChunk, void* ctx) {
+  if (num == 0) { return; }
+  chunk_size = std::max<size_t>(chunk_size, 1);
+  if (num <= chunk_size || threads_.empty()) {
+    DoChunk(ctx, 0, num);
+    return;
+  }
+  ChunkedLoop loop(num, chunk_size, DoChunk, ctx);
+  joinable_loop_cnt_.fetch_add(1, std::memory_order_seq_cst);
+  {
+    std::unique_lock<std::mutex> lock(chunked_loops_mutex_);
+    chunked_loops_.push_back(&loop);
+  }
+  if (idle_worker_cnt_.load(std::memory_order_seq_cst) > 0) {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cond_.notify_all();
+  }
+  RunChunks(&loop);
+  // all chunks are claimed now, wait for the helpers still running theirs
+  std::unique_lock<std::mutex> lock(chunked_loops_mutex_);
+  chunked_loops_.erase(std::find(chunked_loops_.begin(), chunked_loops_.end(), &loop));
+  chunked_loops_cond_.wait(lock, [&loop]() { return loop.helper_cnt == 0; });
 }
 
 }  // namespace oneflow
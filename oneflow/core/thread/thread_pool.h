@@ -17,10 +17,12 @@ limitations under the License.
 #define ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 
 #include "oneflow/core/common/util.h"
-#include "oneflow/core/common/channel.h"
 
 namespace oneflow {
 
+// Work-stealing pool: every worker owns a queue of the work added from outside the pool, which
+// runs in arrival order, and a deque of the work it added itself, which it pops LIFO while it is
+// warm in cache. A worker that runs dry steals the oldest work of the others.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
@@ -31,13 +33,81 @@ class ThreadPool final {
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
 
+  // Runs DoChunk(begin, end) on chunks of [0, num) with at most chunk_size elements each.
+  // Idle workers grab chunks dynamically and the caller works on chunks too instead of
+  // sleeping. Returns after all chunks are done. Neither DoChunk nor the loop state is copied
+  // to the heap.
+  template<typename DoChunkT>
+  void ForEachChunk(size_t num, size_t chunk_size, const DoChunkT& DoChunk) {
+    RunChunkedLoop(num, chunk_size, &InvokeChunk<DoChunkT>,
+                   const_cast<void*>(static_cast<const void*>(&DoChunk)));
+  }
+
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
+  struct WorkQueue {
+    std::mutex mutex;
+    // added from outside the pool
+    std::deque<std::function<void()>> works;
+    // added by the worker owning the queue
+    std::deque<std::function<void()>> local_works;
+  };
+  using ChunkFn = void (*)(void* ctx, size_t begin, size_t end);
+  struct ChunkedLoop;
+
+  template<typename DoChunkT>
+  static void InvokeChunk(void* ctx, size_t begin, size_t end) {
+    (*static_cast<const DoChunkT*>(ctx))(begin, end);
+  }
+
+  void RunChunkedLoop(size_t num, size_t chunk_size, ChunkFn DoChunk, void* ctx);
+  void PushWork(int32_t queue_id, bool is_local, std::function<void()>&& work);
+  bool TryPopOrSteal(int32_t queue_id, std::function<void()>* work);
+  bool TryHelpChunkedLoop();
+  void RunChunks(ChunkedLoop* loop);
+  void WorkerLoop(int32_t worker_id);
+
+  std::vector<std::unique_ptr<WorkQueue>> work_queues_;
   std::vector<std::thread> threads_;
 
   std::atomic<size_t> work_cnt_;
+  std::atomic<int64_t> pending_work_cnt_;
+  // chunked loops live on their callers' stacks and are only reachable through this list
+  std::vector<ChunkedLoop*> chunked_loops_;
+  std::mutex chunked_loops_mutex_;
+  std::condition_variable chunked_loops_cond_;
+  std::atomic<int64_t> joinable_loop_cnt_;
+  std::atomic<int32_t> idle_worker_cnt_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cond_;
+  bool is_stopped_;
 };
 
+static const int64_t kElemwiseParallelForGrain = 32 * 1024;
+
+// Calls DoRange(range_begin, range_end) on contiguous sub-ranges of [begin, end), each holding
+// at least grain elements unless it is the last one. Runs inline when the range is not worth
+// splitting. Nothing is type-erased or heap allocated.
+template<typename DoRangeT>
+void ParallelFor(int64_t begin, int64_t end, int64_t grain, DoRangeT&& DoRange) {
+  if (end <= begin) { return; }
+  const int64_t num = end - begin;
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  grain = std::max<int64_t>(grain, 1);
+  if (num <= grain || thread_pool == nullptr) {
+    DoRange(begin, end);
+    return;
+  }
+  // a few chunks per thread lets the pool rebalance when the threads run at different speeds
+  static const int64_t kChunkNumPerThread = 4;
+  const int64_t chunk_size =
+      std::max<int64_t>(grain, num / (thread_pool->thread_num() * kChunkNumPerThread));
+  thread_pool->ForEachChunk(num, chunk_size,
+                            [&DoRange, begin](size_t chunk_begin, size_t chunk_end) {
+                              DoRange(begin + static_cast<int64_t>(chunk_begin),
+                                      begin + static_cast<int64_t>(chunk_end));
+                            });
+}
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_THREAD_THREAD_POOL_H_
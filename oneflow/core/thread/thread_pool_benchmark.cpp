@@ -0,0 +1,93 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cmath>
+#include "oneflow/core/thread/thread_pool_test_util.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+namespace oneflow {
+
+namespace {
+
+// the first 1/8 of the items are 32x more expensive than the rest
+double SkewedWork(size_t i, size_t num) {
+  const int64_t iter_num = i < num / 8 ? 32 * 1024 : 1024;
+  double sum = 0;
+  FOR_RANGE(int64_t, j, 0, iter_num) { sum += std::sqrt(static_cast<double>(i + j)); }
+  return sum;
+}
+
+}  // namespace
+
+TEST(ThreadPool, skewed_loop_benchmark) {
+  const int32_t thread_num = std::max<int32_t>(std::thread::hardware_concurrency(), 2);
+  ThreadPool thread_pool(thread_num);
+  const size_t num = 2048;
+  std::vector<double> static_out(num);
+  std::vector<double> stealing_out(num);
+
+  auto static_start = std::chrono::steady_clock::now();
+  BalancedSplitter bs(num, thread_num);
+  BlockingCounter bc(thread_num);
+  FOR_RANGE(int32_t, range_id, 0, thread_num) {
+    thread_pool.AddWork([&, range_id]() {
+      FOR_RANGE(size_t, i, bs.At(range_id).begin(), bs.At(range_id).end()) {
+        static_out.at(i) = SkewedWork(i, num);
+      }
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  std::chrono::duration<double, std::milli> static_ms =
+      std::chrono::steady_clock::now() - static_start;
+
+  auto stealing_start = std::chrono::steady_clock::now();
+  thread_pool.ForEachChunk(num, num / (thread_num * 4), [&](size_t begin, size_t end) {
+    FOR_RANGE(size_t, i, begin, end) { stealing_out.at(i) = SkewedWork(i, num); }
+  });
+  std::chrono::duration<double, std::milli> stealing_ms =
+      std::chrono::steady_clock::now() - stealing_start;
+
+  ASSERT_EQ(static_out, stealing_out);
+  LOG(INFO) << "skewed loop with " << thread_num << " threads, static split: " << static_ms.count()
+            << " ms, work stealing: " << stealing_ms.count() << " ms";
+}
+
+TEST(ThreadPool, parallel_for_scaling_benchmark) {
+  const int64_t n = 1 << 22;
+  std::vector<float> x(n);
+  std::vector<float> y(n);
+  FOR_RANGE(int64_t, i, 0, n) { x.at(i) = static_cast<float>(i % 1000) / 1000; }
+  const float* x_ptr = x.data();
+  float* y_ptr = y.data();
+  const int32_t max_thread_num = std::max<int32_t>(std::thread::hardware_concurrency(), 2);
+  for (int32_t thread_num = 1; thread_num <= max_thread_num; thread_num *= 2) {
+    std::chrono::duration<double, std::milli> elapsed;
+    {
+      ScopedGlobalThreadPool thread_pool(thread_num);
+      auto start = std::chrono::steady_clock::now();
+      ParallelFor(0, n, kElemwiseParallelForGrain, [x_ptr, y_ptr](int64_t begin, int64_t end) {
+        FOR_RANGE(int64_t, i, begin, end) { y_ptr[i] = std::exp(x_ptr[i]); }
+      });
+      elapsed = std::chrono::steady_clock::now() - start;
+    }
+    FOR_RANGE(int64_t, i, 0, n) { ASSERT_EQ(y.at(i), std::exp(x.at(i))); }
+    LOG(INFO) << "ParallelFor exp over " << n << " floats with " << thread_num
+              << " threads: " << elapsed.count() << " ms";
+  }
+}
+
+}  // namespace oneflow
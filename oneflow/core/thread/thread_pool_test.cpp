@@ -0,0 +1,81 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+namespace oneflow {
+
+TEST(ThreadPool, add_work) {
+  ThreadPool thread_pool(4);
+  const int work_num = 1000;
+  std::atomic<int> cnt(0);
+  BlockingCounter bc(work_num);
+  FOR_RANGE(int, i, 0, work_num) {
+    thread_pool.AddWork([&]() {
+      cnt.fetch_add(1);
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  ASSERT_EQ(cnt.load(), work_num);
+}
+
+TEST(ThreadPool, single_thread_runs_in_order) {
+  // the single thread pools of the lazy runtime and the vm rely on the order work is added in
+  ThreadPool thread_pool(1);
+  const int work_num = 1000;
+  std::vector<int> order;
+  std::mutex first_work_mutex;
+  std::unique_lock<std::mutex> first_work_lock(first_work_mutex);
+  BlockingCounter bc(work_num);
+  FOR_RANGE(int, i, 0, work_num) {
+    thread_pool.AddWork([&, i]() {
+      // holds the worker until all the work is queued
+      if (i == 0) { std::unique_lock<std::mutex> lock(first_work_mutex); }
+      order.push_back(i);
+      bc.Decrease();
+    });
+  }
+  first_work_lock.unlock();
+  bc.WaitUntilCntEqualZero();
+  ASSERT_EQ(order.size(), work_num);
+  FOR_RANGE(int, i, 0, work_num) { ASSERT_EQ(order.at(i), i); }
+}
+
+TEST(ThreadPool, for_each_chunk_visits_each_index_once) {
+  ThreadPool thread_pool(4);
+  FOR_RANGE(size_t, chunk_size, 1, 9) {
+    const size_t num = 1003;
+    std::vector<std::atomic<int>> visits(num);
+    for (auto& visit : visits) { visit.store(0); }
+    thread_pool.ForEachChunk(num, chunk_size, [&](size_t begin, size_t end) {
+      ASSERT_LE(end - begin, chunk_size);
+      FOR_RANGE(size_t, i, begin, end) { visits.at(i).fetch_add(1); }
+    });
+    for (auto& visit : visits) { ASSERT_EQ(visit.load(), 1); }
+  }
+}
+
+TEST(ThreadPool, nested_for_each_chunk) {
+  ThreadPool thread_pool(2);
+  std::atomic<int64_t> sum(0);
+  thread_pool.ForEachChunk(8, 1, [&](size_t, size_t) {
+    thread_pool.ForEachChunk(100, 10, [&](size_t begin, size_t end) { sum += end - begin; });
+  });
+  ASSERT_EQ(sum.load(), 800);
+}
+
+}  // namespace oneflow
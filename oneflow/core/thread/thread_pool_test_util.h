@@ -0,0 +1,62 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_THREAD_THREAD_POOL_TEST_UTIL_H_
+#define ONEFLOW_CORE_THREAD_THREAD_POOL_TEST_UTIL_H_
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+// helpers shared by the tests and benchmarks of the CPU paths that split work over
+// Global<ThreadPool>
+
+// owns Global<ThreadPool> for its lifetime, so an early return can not leak it into the next test
+class ScopedGlobalThreadPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ScopedGlobalThreadPool);
+  explicit ScopedGlobalThreadPool(int32_t thread_num) { Global<ThreadPool>::New(thread_num); }
+  ~ScopedGlobalThreadPool() { Global<ThreadPool>::Delete(); }
+};
+
+// runs each TEST_F with a 4 thread Global<ThreadPool>, a failing ASSERT still deletes it
+class GlobalThreadPoolTest : public testing::Test {
+ protected:
+  void SetUp() override { thread_pool_.reset(new ScopedGlobalThreadPool(4)); }
+  void TearDown() override { thread_pool_.reset(); }
+
+ private:
+  std::unique_ptr<ScopedGlobalThreadPool> thread_pool_;
+};
+
+inline int32_t HardwareThreadNum() {
+  return std::max<int32_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// the first call warms up the caches and is not timed
+template<typename DoEachFn>
+double AverageMilliseconds(int64_t iter_num, const DoEachFn& DoEach) {
+  DoEach();
+  auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, iter_num) { DoEach(); }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iter_num;
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_THREAD_THREAD_POOL_TEST_UTIL_H_
@@ -13,18 +13,496 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
-#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <set>
 #include "oneflow/core/vm/cpu_allocator.h"
-#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/platform.h"
+
+#ifdef OF_PLATFORM_POSIX
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
 
 namespace oneflow {
 namespace vm {
 
+namespace {
+
+const size_t kClassNumPerDoubling = 4;
+// small blocks start on a cache line
+const size_t kSmallAlignByte = 64;
+const size_t kThreadCacheBytePerClass = 256 << 10;
+const size_t kMaxThreadCacheBlockNumPerClass = 64;
+const size_t kSlabByte = 256 << 10;
+const int64_t kCounterFlushInterval = 256;
+// large pieces are multiples of this, so every piece of a page aligned block is aligned too
+const size_t kLargeAlignByte = 512;
+// a piece is split only if the rest is at least this large
+const size_t kMinSplitByte = 4 << 10;
+const size_t kMinBlockByte = 2 << 20;
+// a new block is as large as the arena so far up to this size, larger requests get a block of
+// their own size so that one piece in use does not pin a lot of free memory
+const size_t kMaxBlockGrowthByte = 16 << 20;
+// a block that becomes wholly free goes back to the system while an arena caches more free bytes
+const size_t kMaxCachedFreeByte = 256 << 20;
+const size_t kPageByte = 4096;
+// bin i holds the free pieces of [512 << i, 512 << (i + 1)) bytes, the last one all larger ones
+const int32_t kBinNum = 24;
+
+// the NUMA node of every cpu, empty if the kernel does not tell
+std::vector<int32_t> GetNumaNode4Cpu() {
+  std::vector<int32_t> numa_node4cpu;
+#ifdef OF_PLATFORM_POSIX
+  for (int32_t cpu = 0;; ++cpu) {
+    DIR* dir = opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+    if (dir == nullptr) { break; }
+    int32_t numa_node = 0;
+    while (const dirent* entry = readdir(dir)) {
+      if (std::strncmp(entry->d_name, "node", 4) == 0 && std::isdigit(entry->d_name[4])) {
+        numa_node = std::atoi(entry->d_name + 4);
+        break;
+      }
+    }
+    PCHECK(closedir(dir) == 0);
+    numa_node4cpu.push_back(numa_node);
+  }
+#endif
+  return numa_node4cpu;
+}
+
+// returns nullptr if the system is out of memory
+char* SystemAllocate(size_t size, bool prefault) {
+#ifdef OF_PLATFORM_POSIX
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) { return nullptr; }
+  if (prefault) {
+    // the first touch faults the pages in on the NUMA node of the allocating thread, once for
+    // the lifetime of the block instead of once per op
+    volatile char* pages = static_cast<char*>(ptr);
+    for (size_t offset = 0; offset < size; offset += kPageByte) { pages[offset] = 0; }
+  }
+  return static_cast<char*>(ptr);
+#else
+  return static_cast<char*>(std::malloc(size));
+#endif
+}
+
+void SystemDeallocate(char* ptr, size_t size) {
+#ifdef OF_PLATFORM_POSIX
+  PCHECK(munmap(ptr, size) == 0);
+#else
+  std::free(ptr);
+#endif
+}
+
+}  // namespace
+
+const size_t CpuAllocator::kMaxSmallByte;
+
+// A Piece is a contiguous part of a block, either free or in use. prev and next are the pieces
+// next to it in the same block, free neighbours are always merged.
+struct CpuAllocator::Piece final {
+  char* ptr = nullptr;
+  size_t size = 0;
+  bool is_free = false;
+  Piece* prev = nullptr;
+  Piece* next = nullptr;
+};
+
+// The blocks of one NUMA node and their pieces.
+struct CpuAllocator::Arena final {
+  struct PieceCmp {
+    bool operator()(const Piece* lhs, const Piece* rhs) const {
+      if (lhs->size != rhs->size) { return lhs->size < rhs->size; }
+      return lhs->ptr < rhs->ptr;
+    }
+  };
+
+  Arena() : bins(kBinNum), reserved_byte(0), free_byte(0) {}
+
+  static int32_t BinNum4Size(size_t size) {
+    const uint64_t value = std::max(size, kLargeAlignByte) / kLargeAlignByte;
+    return std::min(kBinNum - 1, static_cast<int32_t>(63 ^ __builtin_clzll(value)));
+  }
+
+  void InsertFreePiece(Piece* piece) {
+    CHECK(piece->is_free);
+    CHECK(bins.at(BinNum4Size(piece->size)).insert(piece).second);
+    free_byte += piece->size;
+  }
+
+  void RemoveFreePiece(Piece* piece) {
+    CHECK(piece->is_free);
+    CHECK_EQ(bins.at(BinNum4Size(piece->size)).erase(piece), 1);
+    free_byte -= piece->size;
+  }
+
+  Piece* NewPiece(char* ptr, size_t size) {
+    std::unique_ptr<Piece>* piece = &ptr2piece[ptr];
+    CHECK(!*piece);
+    piece->reset(new Piece());
+    (*piece)->ptr = ptr;
+    (*piece)->size = size;
+    return piece->get();
+  }
+
+  void AddBlock(char* ptr, size_t size) {
+    Piece* piece = NewPiece(ptr, size);
+    piece->is_free = true;
+    InsertFreePiece(piece);
+    reserved_byte += size;
+  }
+
+  // the best fit free piece of at least size bytes, nullptr if there is none
+  Piece* FindPiece(size_t size) {
+    Piece key;
+    key.size = size;
+    for (int32_t bin_num = BinNum4Size(size); bin_num < kBinNum; ++bin_num) {
+      std::set<Piece*, PieceCmp>* bin = &bins.at(bin_num);
+      auto it = bin->lower_bound(&key);
+      if (it == bin->end()) { continue; }
+      Piece* piece = *it;
+      bin->erase(it);
+      free_byte -= piece->size;
+      piece->is_free = false;
+      if (piece->size - size >= kMinSplitByte) {
+        Piece* rest = NewPiece(piece->ptr + size, piece->size - size);
+        rest->is_free = true;
+        rest->prev = piece;
+        rest->next = piece->next;
+        if (piece->next != nullptr) { piece->next->prev = rest; }
+        piece->next = rest;
+        piece->size = size;
+        InsertFreePiece(rest);
+      }
+      return piece;
+    }
+    return nullptr;
+  }
+
+  // returns the free piece piece was merged into
+  Piece* FreePiece(Piece* piece) {
+    CHECK(!piece->is_free) << "double free of " << static_cast<void*>(piece->ptr);
+    piece->is_free = true;
+    Piece* next = piece->next;
+    if (next != nullptr && next->is_free) {
+      RemoveFreePiece(next);
+      piece->size += next->size;
+      piece->next = next->next;
+      if (next->next != nullptr) { next->next->prev = piece; }
+      ptr2piece.erase(next->ptr);
+    }
+    Piece* prev = piece->prev;
+    if (prev != nullptr && prev->is_free) {
+      RemoveFreePiece(prev);
+      prev->size += piece->size;
+      prev->next = piece->next;
+      if (piece->next != nullptr) { piece->next->prev = prev; }
+      ptr2piece.erase(piece->ptr);
+      piece = prev;
+    }
+    InsertFreePiece(piece);
+    return piece;
+  }
+
+  static bool IsWholeBlock(const Piece* piece) {
+    return piece->prev == nullptr && piece->next == nullptr;
+  }
+
+  void RemoveBlock(Piece* piece) {
+    CHECK(IsWholeBlock(piece));
+    RemoveFreePiece(piece);
+    reserved_byte -= piece->size;
+    ptr2piece.erase(piece->ptr);
+  }
+
+  // moves the blocks that are one free piece to blocks_to_release
+  void TakeFreeBlocks(std::vector<std::pair<char*, size_t>>* blocks_to_release) {
+    for (std::set<Piece*, PieceCmp>& bin : bins) {
+      for (auto it = bin.begin(); it != bin.end();) {
+        Piece* piece = *it;
+        // RemoveBlock erases piece from bin
+        ++it;
+        if (!IsWholeBlock(piece)) { continue; }
+        blocks_to_release->emplace_back(piece->ptr, piece->size);
+        RemoveBlock(piece);
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<std::set<Piece*, PieceCmp>> bins;
+  // all pieces, free or in use, by address
+  HashMap<char*, std::unique_ptr<Piece>> ptr2piece;
+  size_t reserved_byte;
+  // bytes of the pieces in bins
+  size_t free_byte;
+};
+
+struct CpuAllocator::ThreadCache final {
+  explicit ThreadCache(CpuAllocator* allocator)
+      : allocator(allocator),
+        free_lists(allocator->class_sizes_.size()),
+        small_alloc_cnt(0),
+        small_hit_cnt(0),
+        in_use_byte(0) {}
+  // a finished thread hands its blocks to the threads still running
+  ~ThreadCache() {
+    FOR_RANGE(size_t, class_id, 0, free_lists.size()) {
+      std::vector<char*>* free_list = &free_lists.at(class_id);
+      if (free_list->empty()) { continue; }
+      CentralList* central_list = allocator->central_lists_.at(class_id).get();
+      std::unique_lock<std::mutex> lock(central_list->mutex);
+      central_list->blocks.insert(central_list->blocks.end(), free_list->begin(),
+                                  free_list->end());
+    }
+    allocator->FlushCounters(this);
+  }
+
+  CpuAllocator* allocator;
+  std::vector<std::vector<char*>> free_lists;
+  int64_t small_alloc_cnt;
+  int64_t small_hit_cnt;
+  int64_t in_use_byte;
+};
+
+CpuAllocator::CpuAllocator()
+    : Allocator(),
+      numa_node4cpu_(GetNumaNode4Cpu()),
+      alloc_cnt_(0),
+      small_alloc_cnt_(0),
+      small_hit_cnt_(0),
+      in_use_byte_(0),
+      small_reserved_byte_(0) {
+  for (size_t base = kSmallAlignByte; base < kMaxSmallByte; base *= 2) {
+    FOR_RANGE(size_t, i, 0, kClassNumPerDoubling) {
+      const size_t class_size = RoundUp(base + i * base / kClassNumPerDoubling, kSmallAlignByte);
+      if (class_sizes_.empty() || class_size > class_sizes_.back()) {
+        class_sizes_.push_back(class_size);
+      }
+    }
+  }
+  class_sizes_.push_back(kMaxSmallByte);
+  FOR_RANGE(size_t, i, 0, class_sizes_.size()) { central_lists_.emplace_back(new CentralList()); }
+  int32_t numa_node_num = 1;
+  for (int32_t numa_node : numa_node4cpu_) {
+    numa_node_num = std::max(numa_node_num, numa_node + 1);
+  }
+  FOR_RANGE(int32_t, i, 0, numa_node_num) { arenas_.emplace_back(new Arena()); }
+}
+
+int32_t CpuAllocator::ClassId4Size(size_t size) const {
+  auto it = std::lower_bound(class_sizes_.begin(), class_sizes_.end(), size);
+  if (it == class_sizes_.end()) { return -1; }
+  return it - class_sizes_.begin();
+}
+
+size_t CpuAllocator::ThreadCacheCapacity(int32_t class_id) const {
+  return std::max<size_t>(
+      std::min(kMaxThreadCacheBlockNumPerClass, kThreadCacheBytePerClass / class_sizes_[class_id]),
+      1);
+}
+
+CpuAllocator::ThreadCache* CpuAllocator::GetThreadCache() {
+  thread_local ThreadCache cache(this);
+  return &cache;
+}
+
+void CpuAllocator::FlushCounters(ThreadCache* cache) {
+  small_alloc_cnt_.fetch_add(cache->small_alloc_cnt, std::memory_order_relaxed);
+  small_hit_cnt_.fetch_add(cache->small_hit_cnt, std::memory_order_relaxed);
+  in_use_byte_.fetch_add(cache->in_use_byte, std::memory_order_relaxed);
+  alloc_cnt_.fetch_add(cache->small_alloc_cnt, std::memory_order_relaxed);
+  cache->small_alloc_cnt = 0;
+  cache->small_hit_cnt = 0;
+  cache->in_use_byte = 0;
+}
+
+CpuAllocator::Arena* CpuAllocator::LocalArena() {
+  if (arenas_.size() == 1) { return arenas_.front().get(); }
+#ifdef OF_PLATFORM_POSIX
+  const int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < numa_node4cpu_.size()) { return arenas_.at(numa_node4cpu_.at(cpu)).get(); }
+#endif
+  return arenas_.front().get();
+}
+
+char* CpuAllocator::AllocateSmall(ThreadCache* cache, int32_t class_id) {
+  std::vector<char*>* free_list = &cache->free_lists.at(class_id);
+  cache->small_alloc_cnt += 1;
+  if (free_list->empty()) {
+    CentralList* central_list = central_lists_.at(class_id).get();
+    std::unique_lock<std::mutex> lock(central_list->mutex);
+    if (central_list->blocks.empty()) {
+      // carve a new slab into blocks of this class, slabs are blocks of their own so that they
+      // do not pin the blocks of the large pieces
+      const size_t class_size = class_sizes_.at(class_id);
+      char* slab = SystemAllocate(kSlabByte, true);
+      CHECK(slab != nullptr) << "Out of host memory when allocating a slab";
+      small_reserved_byte_.fetch_add(kSlabByte, std::memory_order_relaxed);
+      for (int64_t i = kSlabByte / class_size - 1; i >= 0; --i) {
+        central_list->blocks.push_back(slab + i * class_size);
+      }
+    } else {
+      cache->small_hit_cnt += 1;
+    }
+    // refill half of the thread cache in one go
+    const size_t refill_num =
+        std::min(central_list->blocks.size(), (ThreadCacheCapacity(class_id) + 1) / 2);
+    free_list->insert(free_list->end(), central_list->blocks.end() - refill_num,
+                      central_list->blocks.end());
+    central_list->blocks.resize(central_list->blocks.size() - refill_num);
+  } else {
+    cache->small_hit_cnt += 1;
+  }
+  char* ptr = free_list->back();
+  free_list->pop_back();
+  if (cache->small_alloc_cnt >= kCounterFlushInterval) { FlushCounters(cache); }
+  return ptr;
+}
+
+void CpuAllocator::DeallocateSmall(ThreadCache* cache, int32_t class_id, char* ptr) {
+  std::vector<char*>* free_list = &cache->free_lists.at(class_id);
+  free_list->push_back(ptr);
+  const size_t capacity = ThreadCacheCapacity(class_id);
+  if (free_list->size() > capacity) {
+    // keep half so that alternating frees and allocations stay thread local
+    const size_t spill_num = free_list->size() - capacity / 2;
+    CentralList* central_list = central_lists_.at(class_id).get();
+    std::unique_lock<std::mutex> lock(central_list->mutex);
+    central_list->blocks.insert(central_list->blocks.end(), free_list->end() - spill_num,
+                                free_list->end());
+    free_list->resize(free_list->size() - spill_num);
+  }
+}
+
+char* CpuAllocator::AllocateLarge(Arena* arena, size_t size) {
+  const size_t aligned_size = RoundUp(size, kLargeAlignByte);
+  size_t block_byte = 0;
+  {
+    std::unique_lock<std::mutex> lock(arena->mutex);
+    Piece* piece = arena->FindPiece(aligned_size);
+    if (piece != nullptr) { return piece->ptr; }
+    // blocks grow with the arena so that their number stays logarithmic in the reserved bytes
+    const size_t growth_byte = std::min(arena->reserved_byte, kMaxBlockGrowthByte);
+    block_byte = RoundUp(std::max(aligned_size, growth_byte), kMinBlockByte);
+  }
+  // the pages of a large block are not touched here, the kernel writing a piece faults them in
+  // on its own NUMA node and pages never handed out are never committed
+  char* block = SystemAllocate(block_byte, false);
+  if (block == nullptr) {
+    block_byte = RoundUp(aligned_size, kPageByte);
+    block = SystemAllocate(block_byte, false);
+  }
+  if (block == nullptr) {
+    LOG(WARNING) << "CpuAllocator releases its free blocks to allocate " << size << " bytes";
+    ReleaseFreeBlocks();
+    block = SystemAllocate(block_byte, false);
+  }
+  CHECK(block != nullptr) << "Out of host memory when allocating " << size << " bytes";
+  std::unique_lock<std::mutex> lock(arena->mutex);
+  arena->AddBlock(block, block_byte);
+  Piece* piece = arena->FindPiece(aligned_size);
+  CHECK_NOTNULL(piece);
+  return piece->ptr;
+}
+
+void CpuAllocator::DeallocateLarge(char* ptr) {
+  auto TryDeallocate = [ptr](Arena* arena) {
+    std::pair<char*, size_t> block_to_release(nullptr, 0);
+    {
+      std::unique_lock<std::mutex> lock(arena->mutex);
+      auto it = arena->ptr2piece.find(ptr);
+      if (it == arena->ptr2piece.end()) { return false; }
+      Piece* piece = arena->FreePiece(it->second.get());
+      if (Arena::IsWholeBlock(piece) && arena->free_byte > kMaxCachedFreeByte) {
+        block_to_release = std::make_pair(piece->ptr, piece->size);
+        arena->RemoveBlock(piece);
+      }
+    }
+    if (block_to_release.first != nullptr) {
+      SystemDeallocate(block_to_release.first, block_to_release.second);
+    }
+    return true;
+  };
+  // memory is mostly freed on the node that allocated it
+  Arena* local_arena = LocalArena();
+  if (TryDeallocate(local_arena)) { return; }
+  for (const auto& arena : arenas_) {
+    if (arena.get() != local_arena && TryDeallocate(arena.get())) { return; }
+  }
+  LOG(FATAL) << "CpuAllocator deallocates " << static_cast<void*>(ptr)
+             << " which it did not allocate";
+}
+
 void CpuAllocator::Allocate(char** mem_ptr, std::size_t size) {
-  *mem_ptr = reinterpret_cast<char*>(std::malloc(size));
+  if (size == 0) {
+    *mem_ptr = nullptr;
+    return;
+  }
+  const int32_t class_id = ClassId4Size(size);
+  if (class_id == -1) {
+    *mem_ptr = AllocateLarge(LocalArena(), size);
+    alloc_cnt_.fetch_add(1, std::memory_order_relaxed);
+    in_use_byte_.fetch_add(size, std::memory_order_relaxed);
+  } else {
+    ThreadCache* cache = GetThreadCache();
+    cache->in_use_byte += size;
+    *mem_ptr = AllocateSmall(cache, class_id);
+  }
+}
+
+void CpuAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  if (mem_ptr == nullptr) { return; }
+  const int32_t class_id = ClassId4Size(size);
+  if (class_id == -1) {
+    DeallocateLarge(mem_ptr);
+    in_use_byte_.fetch_sub(size, std::memory_order_relaxed);
+  } else {
+    ThreadCache* cache = GetThreadCache();
+    cache->in_use_byte -= size;
+    DeallocateSmall(cache, class_id, mem_ptr);
+  }
 }
 
-void CpuAllocator::Deallocate(char* mem_ptr, std::size_t size) { std::free(mem_ptr); }
+CpuAllocator::Stats CpuAllocator::GetStats() const {
+  Stats stats;
+  stats.alloc_cnt = alloc_cnt_.load(std::memory_order_relaxed);
+  stats.small_alloc_cnt = small_alloc_cnt_.load(std::memory_order_relaxed);
+  stats.small_hit_cnt = small_hit_cnt_.load(std::memory_order_relaxed);
+  stats.in_use_byte = in_use_byte_.load(std::memory_order_relaxed);
+  stats.reserved_byte = small_reserved_byte_.load(std::memory_order_relaxed);
+  size_t free_byte = 0;
+  size_t largest_free_byte = 0;
+  for (const auto& arena : arenas_) {
+    std::unique_lock<std::mutex> lock(arena->mutex);
+    stats.reserved_byte += arena->reserved_byte;
+    free_byte += arena->free_byte;
+    for (auto bin = arena->bins.rbegin(); bin != arena->bins.rend(); ++bin) {
+      if (bin->empty()) { continue; }
+      largest_free_byte = std::max(largest_free_byte, (*bin->rbegin())->size);
+      break;
+    }
+  }
+  stats.cached_byte = std::max<int64_t>(stats.reserved_byte - stats.in_use_byte, 0);
+  stats.fragmentation =
+      free_byte == 0 ? 0 : 1 - static_cast<double>(largest_free_byte) / free_byte;
+  stats.numa_node_num = arenas_.size();
+  return stats;
+}
+
+void CpuAllocator::ReleaseFreeBlocks() {
+  for (const auto& arena : arenas_) {
+    std::vector<std::pair<char*, size_t>> blocks_to_release;
+    {
+      std::unique_lock<std::mutex> lock(arena->mutex);
+      arena->TakeFreeBlocks(&blocks_to_release);
+    }
+    for (const auto& block : blocks_to_release) { SystemDeallocate(block.first, block.second); }
+  }
+}
 
 COMMAND(Global<CpuAllocator>::SetAllocated(new CpuAllocator()));
 
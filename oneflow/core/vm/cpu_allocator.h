@@ -18,17 +18,89 @@ limitations under the License.
 
 #include <cstdint>
 #include "oneflow/core/vm/allocator.h"
+#include "oneflow/core/common/util.h"
 
 namespace oneflow {
 namespace vm {
 
+// Caching allocator of host memory for the eager CPU streams and the blob headers.
+//
+// Memory is taken from the system in large blocks which are kept for reuse instead of being
+// returned after every op. Pages are faulted in once by the first thread writing them, so they
+// sit on the NUMA node of that thread.
+//  - Sizes up to kMaxSmallByte are rounded up to one of four classes per power of two. Freed
+//    blocks go to a per-thread free list first and spill over to a central list per class, so
+//    the hot path takes no lock. Small blocks are carved out of slabs which are never released.
+//  - Larger sizes are best fit pieces of the blocks of the calling thread's NUMA node. Pieces
+//    are split and merged with their free neighbours in bins like CudaAllocator does. Blocks
+//    that become wholly free are released while an arena caches more than a bounded amount.
+//
+// Deallocate must be called with the size passed to Allocate. Thread caches belong to the
+// allocator that created them, so there is one CpuAllocator per process, Global<CpuAllocator>.
 class CpuAllocator final : public Allocator {
  public:
-  explicit CpuAllocator() = default;
-  ~CpuAllocator() override = default;
+  OF_DISALLOW_COPY_AND_MOVE(CpuAllocator);
+  CpuAllocator();
 
   void Allocate(char** mem_ptr, std::size_t size) override;
   void Deallocate(char* mem_ptr, std::size_t size) override;
+
+  struct Stats {
+    int64_t alloc_cnt;
+    // served by a thread cache or a central list without taking a new block from the system
+    int64_t small_hit_cnt;
+    int64_t small_alloc_cnt;
+    // bytes requested by Allocate and not deallocated yet
+    int64_t in_use_byte;
+    // bytes of the blocks taken from the system
+    int64_t reserved_byte;
+    // reserved bytes not in use: free pieces, cached small blocks and size class rounding
+    int64_t cached_byte;
+    // 1 - largest free piece / bytes of all free pieces, 0 if the free large memory is contiguous
+    double fragmentation;
+    int32_t numa_node_num;
+  };
+  // counters of running threads are flushed every few hundred allocations
+  Stats GetStats() const;
+  // returns all the blocks without a piece in use to the system, cached small blocks stay
+  void ReleaseFreeBlocks();
+
+  static const size_t kMaxSmallByte = 32 << 10;
+
+ private:
+  // never destroyed, thread caches may return blocks during process exit
+  ~CpuAllocator() override = default;
+
+  struct Piece;
+  struct Arena;
+  struct CentralList {
+    std::mutex mutex;
+    std::vector<char*> blocks;
+  };
+  struct ThreadCache;
+
+  // -1 if size is larger than the largest class
+  int32_t ClassId4Size(size_t size) const;
+  size_t ThreadCacheCapacity(int32_t class_id) const;
+  ThreadCache* GetThreadCache();
+  char* AllocateSmall(ThreadCache* cache, int32_t class_id);
+  void DeallocateSmall(ThreadCache* cache, int32_t class_id, char* ptr);
+  void FlushCounters(ThreadCache* cache);
+
+  Arena* LocalArena();
+  char* AllocateLarge(Arena* arena, size_t size);
+  void DeallocateLarge(char* ptr);
+
+  std::vector<size_t> class_sizes_;
+  std::vector<std::unique_ptr<CentralList>> central_lists_;
+  std::vector<int32_t> numa_node4cpu_;
+  std::vector<std::unique_ptr<Arena>> arenas_;
+
+  std::atomic<int64_t> alloc_cnt_;
+  std::atomic<int64_t> small_alloc_cnt_;
+  std::atomic<int64_t> small_hit_cnt_;
+  std::atomic<int64_t> in_use_byte_;
+  std::atomic<int64_t> small_reserved_byte_;
 };
 
 }  // namespace vm
@@ -0,0 +1,80 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/cpu_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+// one eager op: a header and a body for its output, the body is written by the kernel, and the
+// input of the previous op is released
+template<typename AllocateFn, typename DeallocateFn>
+double MicrosecondsPerOp(const std::vector<size_t>& body_sizes, const AllocateFn& Allocate,
+                         const DeallocateFn& Deallocate) {
+  const size_t header_size = 96;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<char*> prev_op(2, nullptr);
+  size_t prev_body_size = 0;
+  for (size_t body_size : body_sizes) {
+    char* header = Allocate(header_size);
+    char* body = Allocate(body_size);
+    std::memset(header, 0, header_size);
+    std::memset(body, 1, body_size);
+    if (prev_op.at(0) != nullptr) {
+      Deallocate(prev_op.at(0), header_size);
+      Deallocate(prev_op.at(1), prev_body_size);
+    }
+    prev_op = {header, body};
+    prev_body_size = body_size;
+  }
+  Deallocate(prev_op.at(0), header_size);
+  Deallocate(prev_op.at(1), prev_body_size);
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / body_sizes.size();
+}
+
+}  // namespace
+
+TEST(CpuAllocator, eager_op_benchmark) {
+  CpuAllocator* allocator = Global<CpuAllocator>::Get();
+  std::mt19937 gen(0);
+  // the outputs of a small conv net on one image: mostly small and mid sized, a few large
+  const std::vector<size_t> size_choices = {256, 4 << 10, 64 << 10, 512 << 10, 4 << 20, 16 << 20};
+  std::vector<size_t> body_sizes(5000);
+  for (size_t& size : body_sizes) { size = size_choices.at(gen() % size_choices.size()); }
+  const double malloc_us = MicrosecondsPerOp(
+      body_sizes, [](size_t size) { return static_cast<char*>(std::malloc(size)); },
+      [](char* ptr, size_t size) { std::free(ptr); });
+  const double allocator_us = MicrosecondsPerOp(
+      body_sizes,
+      [allocator](size_t size) {
+        char* ptr = nullptr;
+        allocator->Allocate(&ptr, size);
+        return ptr;
+      },
+      [allocator](char* ptr, size_t size) { allocator->Deallocate(ptr, size); });
+  const CpuAllocator::Stats stats = allocator->GetStats();
+  const double small_hit_rate =
+      static_cast<double>(stats.small_hit_cnt) / std::max<int64_t>(stats.small_alloc_cnt, 1);
+  LOG(INFO) << "eager op latency: malloc " << malloc_us << " us, CpuAllocator " << allocator_us
+            << " us; in use " << stats.in_use_byte << " B, reserved " << stats.reserved_byte
+            << " B, cached " << stats.cached_byte << " B, fragmentation " << stats.fragmentation
+            << ", small hit rate " << small_hit_rate;
+}
+
+}  // namespace vm
+}  // namespace oneflow
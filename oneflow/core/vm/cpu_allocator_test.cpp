@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/cpu_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+struct Allocation {
+  char* ptr;
+  size_t size;
+};
+
+// byte sizes of blob headers, small tensors and activations
+size_t RandomSize(std::mt19937* gen) {
+  switch ((*gen)() % 3) {
+    case 0: return 1 + (*gen)() % 512;
+    case 1: return 1 + (*gen)() % CpuAllocator::kMaxSmallByte;
+    default: return 1 + (*gen)() % (2 << 20);
+  }
+}
+
+Allocation AllocateAndFill(Allocator* allocator, size_t size) {
+  Allocation allocation{nullptr, size};
+  allocator->Allocate(&allocation.ptr, size);
+  CHECK_NOTNULL(allocation.ptr);
+  const uintptr_t align = size <= CpuAllocator::kMaxSmallByte ? 64 : 512;
+  CHECK_EQ(reinterpret_cast<uintptr_t>(allocation.ptr) % align, 0);
+  std::memset(allocation.ptr, static_cast<int>(size & 0xff), size);
+  return allocation;
+}
+
+// fails if another allocation overlapped this one
+void CheckAndDeallocate(Allocator* allocator, const Allocation& allocation) {
+  const char expected = static_cast<char>(allocation.size & 0xff);
+  CHECK_EQ(allocation.ptr[0], expected);
+  CHECK_EQ(allocation.ptr[allocation.size / 2], expected);
+  CHECK_EQ(allocation.ptr[allocation.size - 1], expected);
+  allocator->Deallocate(allocation.ptr, allocation.size);
+}
+
+}  // namespace
+
+TEST(CpuAllocator, allocate_and_reuse) {
+  CpuAllocator* allocator = Global<CpuAllocator>::Get();
+  std::mt19937 gen(0);
+  std::vector<Allocation> allocations;
+  FOR_RANGE(int, i, 0, 2000) {
+    allocations.push_back(AllocateAndFill(allocator, RandomSize(&gen)));
+  }
+  std::shuffle(allocations.begin(), allocations.end(), gen);
+  for (const Allocation& allocation : allocations) { CheckAndDeallocate(allocator, allocation); }
+  char* ptr = nullptr;
+  allocator->Allocate(&ptr, 0);
+  ASSERT_TRUE(ptr == nullptr);
+  // freed memory is reused instead of taken from the system again
+  const CpuAllocator::Stats stats = allocator->GetStats();
+  char* large = nullptr;
+  allocator->Allocate(&large, 3 << 20);
+  allocator->Deallocate(large, 3 << 20);
+  char* large_again = nullptr;
+  allocator->Allocate(&large_again, 3 << 20);
+  ASSERT_EQ(large, large_again);
+  allocator->Deallocate(large_again, 3 << 20);
+  ASSERT_EQ(allocator->GetStats().reserved_byte, stats.reserved_byte);
+  ASSERT_GT(stats.numa_node_num, 0);
+  // the free pieces merged back into whole blocks which go back to the system
+  allocator->ReleaseFreeBlocks();
+  const CpuAllocator::Stats released = allocator->GetStats();
+  ASSERT_LT(released.reserved_byte, stats.reserved_byte);
+  ASSERT_EQ(released.fragmentation, 0);
+}
+
+TEST(CpuAllocator, release_above_cached_limit) {
+  CpuAllocator* allocator = Global<CpuAllocator>::Get();
+  // larger than a grown block, every one gets a block of its own
+  const size_t size = 64 << 20;
+  std::vector<char*> ptrs(8, nullptr);
+  for (char*& ptr : ptrs) { allocator->Allocate(&ptr, size); }
+  const CpuAllocator::Stats stats = allocator->GetStats();
+  for (char* ptr : ptrs) { allocator->Deallocate(ptr, size); }
+  // the blocks freed last went back to the system, the cached free bytes stay bounded
+  const CpuAllocator::Stats freed = allocator->GetStats();
+  ASSERT_LE(freed.reserved_byte, stats.reserved_byte - 2 * size);
+  ASSERT_LE(freed.cached_byte, stats.cached_byte + (256 << 20));
+}
+
+TEST(CpuAllocator, multi_thread) {
+  CpuAllocator* allocator = Global<CpuAllocator>::Get();
+  const int32_t thread_num = 4;
+  // every thread frees what the next one allocated
+  std::vector<std::vector<Allocation>> handoffs(thread_num);
+  std::vector<std::mutex> handoff_mutexes(thread_num);
+  std::vector<std::thread> threads;
+  FOR_RANGE(int32_t, t, 0, thread_num) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      std::vector<Allocation> owned;
+      FOR_RANGE(int, i, 0, 5000) {
+        if (owned.size() < 64) {
+          owned.push_back(AllocateAndFill(allocator, RandomSize(&gen)));
+        } else {
+          // the next thread may have finished already, its inbox is bounded
+          const int32_t next = (t + 1) % thread_num;
+          std::unique_lock<std::mutex> lock(handoff_mutexes.at(next));
+          if (handoffs.at(next).size() < 64) {
+            handoffs.at(next).push_back(owned.back());
+          } else {
+            CheckAndDeallocate(allocator, owned.back());
+          }
+          owned.pop_back();
+        }
+        std::vector<Allocation> to_free;
+        {
+          std::unique_lock<std::mutex> lock(handoff_mutexes.at(t));
+          to_free.swap(handoffs.at(t));
+        }
+        for (const Allocation& allocation : to_free) { CheckAndDeallocate(allocator, allocation); }
+      }
+      for (const Allocation& allocation : owned) { CheckAndDeallocate(allocator, allocation); }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  for (const auto& handoff : handoffs) {
+    for (const Allocation& allocation : handoff) { CheckAndDeallocate(allocator, allocation); }
+  }
+  // the finished threads flushed their counters
+  const CpuAllocator::Stats stats = allocator->GetStats();
+  ASSERT_GT(stats.small_hit_cnt, stats.small_alloc_cnt / 2);
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -270,6 +270,24 @@ def use_rdma(val=True):
     sess.config_proto.resource.use_rdma = val
 
 
+@oneflow_export("config.use_shm_comm_net")
+def api_use_shm_comm_net(val: bool = True) -> None:
+    r"""Whether processes on the same node exchange data through shared memory or not.
+          Processes on other nodes are still reached in epoll mode.
+
+    Args:
+        val (bool, optional):  Defaults to True.
+    """
+    return enable_if.unique([use_shm_comm_net, do_nothing])(val=val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def use_shm_comm_net(val=True):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is bool
+    sess.config_proto.resource.use_shm_comm_net = val
+
+
 @oneflow_export("config.thread_enable_local_message_queue")
 def api_thread_enable_local_message_queue(val: bool) -> None:
     """Whether or not enable thread using local  message queue.
@@ -287,6 +305,43 @@ def thread_enable_local_message_queue(val):
     sess.config_proto.resource.thread_enable_local_message_queue = val
 
 
+@oneflow_export("config.thread_enable_lock_free_mailbox")
+def api_thread_enable_lock_free_mailbox(val: bool) -> None:
+    r"""Whether or not actor threads receive messages through a lock-free mailbox
+          instead of the mutex based channel.
+
+    Args:
+        val (bool):  True or False
+    """
+    return enable_if.unique([thread_enable_lock_free_mailbox, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def thread_enable_lock_free_mailbox(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is bool
+    sess.config_proto.resource.thread_enable_lock_free_mailbox = val
+
+
+@oneflow_export("config.thread_mailbox_capacity")
+def api_thread_mailbox_capacity(val: int) -> None:
+    r"""Set the number of messages the lock-free ring of each actor thread mailbox holds.
+          Messages beyond it spill into a locked overflow list, senders never block.
+          Only takes effect when lock-free mailbox is enabled.
+
+    Args:
+        val (int): capacity, rounded up to a power of two
+    """
+    return enable_if.unique([thread_mailbox_capacity, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def thread_mailbox_capacity(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.thread_mailbox_capacity = val
+
+
 @oneflow_export("config.enable_debug_mode")
 def api_enable_debug_mode(val: bool) -> None:
     r"""Whether use debug mode or not.
@@ -338,6 +393,61 @@ def persistence_buf_byte(val):
     sess.config_proto.io_conf.persistence_buf_byte = val
 
 
+@oneflow_export("config.persistence_readahead_depth")
+def api_persistence_readahead_depth(val: int) -> None:
+    r"""Set up the number of buffers a background thread reads ahead of persistent input streams.
+    0 disables readahead.
+
+    Args:
+        val (int): e.g. 4
+    """
+    return enable_if.unique([persistence_readahead_depth, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def persistence_readahead_depth(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int and val >= 0
+    sess.config_proto.io_conf.persistence_readahead_depth = val
+
+
+@oneflow_export("config.persistence_readahead_buf_byte")
+def api_persistence_readahead_buf_byte(val: int) -> None:
+    r"""Set up the size of each readahead buffer for persistent input streams.
+
+    Args:
+        val (int): e.g. 8388608(bytes)
+    """
+    return enable_if.unique([persistence_readahead_buf_byte, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def persistence_readahead_buf_byte(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int and val > 0
+    sess.config_proto.io_conf.persistence_readahead_buf_byte = val
+
+
+@oneflow_export("config.plan_cache_dir")
+def api_plan_cache_dir(val: str) -> None:
+    r"""Set up a local directory caching compiled plans. A session whose jobs and config match a
+    cached plan skips compilation. Variables without an explicit random seed are initialized with
+    the seeds drawn when the plan was cached. Clear the directory after changing custom op
+    libraries. An empty string disables the cache.
+
+    Args:
+        val (str): e.g. "/tmp/oneflow_plan_cache"
+    """
+    return enable_if.unique([plan_cache_dir, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def plan_cache_dir(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is str
+    sess.config_proto.io_conf.plan_cache_dir = val
+
+
 @oneflow_export("config.legacy_model_io_enabled")
 def api_legacy_model_io_enabled():
     sess = session_ctx.GetDefaultSession()
@@ -430,6 +540,76 @@ def num_callback_threads(val):
     sess.config_proto.resource.collective_boxing_conf.num_callback_threads = val
 
 
+@oneflow_export("config.comm_net.enable_zero_copy")
+def api_comm_net_enable_zero_copy(val: bool = True) -> None:
+    r"""Whether or not send large regst bodies with MSG_ZEROCOPY in epoll comm net.
+          It needs linux kernel 4.14 or later.
+
+    Args:
+        val (bool, optional): True or False. Defaults to True.
+    """
+    return enable_if.unique([comm_net_enable_zero_copy, do_nothing])(val=val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def comm_net_enable_zero_copy(val=True):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is bool
+    sess.config_proto.resource.epoll_comm_net_conf.enable_zero_copy = val
+
+
+@oneflow_export("config.comm_net.zero_copy_min_body_byte")
+def api_comm_net_zero_copy_min_body_byte(val: int) -> None:
+    r"""Set the minimum regst body size sent with MSG_ZEROCOPY.
+
+    Args:
+        val (int): size in bytes
+    """
+    return enable_if.unique([comm_net_zero_copy_min_body_byte, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def comm_net_zero_copy_min_body_byte(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_comm_net_conf.zero_copy_min_body_byte = val
+
+
+@oneflow_export("config.comm_net.connection_num_per_peer")
+def api_comm_net_connection_num_per_peer(val: int) -> None:
+    r"""Set up the number of tcp connections to each peer in epoll mode network.
+          The first connection carries actor messages, the others carry regst bodies.
+
+    Args:
+        val (int): number of connections
+    """
+    return enable_if.unique([comm_net_connection_num_per_peer, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def comm_net_connection_num_per_peer(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_comm_net_conf.connection_num_per_peer = val
+
+
+@oneflow_export("config.comm_net.stripe_min_body_byte")
+def api_comm_net_stripe_min_body_byte(val: int) -> None:
+    r"""Set the minimum regst body size striped over all body connections of a peer.
+
+    Args:
+        val (int): size in bytes
+    """
+    return enable_if.unique([comm_net_stripe_min_body_byte, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def comm_net_stripe_min_body_byte(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_comm_net_conf.stripe_min_body_byte = val
+
+
 @oneflow_export("config.enable_tensor_float_32_compute")
 def api_enable_tensor_float_32_compute(val: bool = True) -> None:
     r"""Whether or not to enable Tensor-float-32 on supported GPUs
@@ -355,10 +355,37 @@ def policy_time_line(func_desc):
     return "use_time_line_algo"
 
 
+@oneflow_function_config("static_mem_alloc_policy_white_list.policy_strip_packing")
+def policy_strip_packing(func_desc):
+    r"""A static memory allocation policy called: strip_packing
+
+    Args:
+        func_desc ([type]): [description]
+
+    Returns:
+        [type]: [description]
+    """
+    return "use_strip_packing_algo"
+
+
+@oneflow_function_config("static_mem_alloc_strip_packing_max_visit_num")
+def set_static_mem_alloc_strip_packing_max_visit_num(func_desc, value):
+    r"""Set how many mutual exclusions the strip_packing policy looks at to find a smaller memory block, e.g. 16000000
+
+    Args:
+        func_desc ([type]): [description]
+        value ([type]): [description]
+    """
+    func_desc.job_config_proto.mutable_memory_allocation_algorithm_conf().set_strip_packing_algo_max_visit_num(
+        value
+    )
+
+
 @oneflow_function_config("static_mem_alloc_algo_white_list.show")
 def show_static_mem_alloc_algo_white_list(func_desc):
     r"""Show configuration of  static memory allocation policy,
-          including: "use_mem_size_first_algo", "use_mutual_exclusion_first_algo", "use_time_line_algo"
+          including: "use_mem_size_first_algo", "use_mutual_exclusion_first_algo", "use_time_line_algo",
+          "use_strip_packing_algo"
 
     Args:
         func_desc ([type]): [description]
@@ -370,6 +397,7 @@ def show_static_mem_alloc_algo_white_list(func_desc):
         "use_mem_size_first_algo",
         "use_mutual_exclusion_first_algo",
         "use_time_line_algo",
+        "use_strip_packing_algo",
     ]
 
 
@@ -406,6 +434,18 @@ def set_cudnn_conv_force_fwd_algo(func_desc, value):
     func_desc.job_config_proto.set_cudnn_conv_force_fwd_algo(value)
 
 
+@oneflow_function_config("cpu_conv_force_fwd_algo")
+def set_cpu_conv_force_fwd_algo(func_desc, value):
+    r"""Force the algorithm of cpu conv forward, 0: im2col_gemm, 1: gemm_1x1,
+    3: winograd_f2x3, 4: winograd_f4x3
+
+    Args:
+        func_desc ([type]): [description]
+        value ([type]): [description]
+    """
+    func_desc.job_config_proto.set_cpu_conv_force_fwd_algo(value)
+
+
 @oneflow_function_config("cudnn_conv_force_bwd_data_algo")
 def set_cudnn_conv_force_bwd_data_algo(func_desc, value):
     r"""Set value to cudnn conv_force_backward_data algorithm
@@ -275,6 +275,11 @@ def ofrecord_reader(
     shuffle_buffer_size: int = 1024,
     shuffle_after_epoch: bool = False,
     name: Optional[str] = None,
+    use_mmap: bool = False,
+    loader_thread_num: int = 1,
+    batch_queue_depth: int = 4,
+    deterministic: bool = True,
+    shuffle_mode: str = "instance",
 ) -> oneflow_api.BlobDesc:
     r"""Get ofrecord object from ofrecord dataset.
 
@@ -288,6 +293,11 @@ def ofrecord_reader(
         shuffle_buffer_size (int, optional): Shuffle buffer size. Defaults to 1024.
         shuffle_after_epoch (bool, optional): Shuffled or not after each epoch. Defaults to False.
         name (Optional[str], optional): Optional name. Defaults to None.
+        use_mmap (bool, optional): Map the part files into memory and hand out records without copying them. With shuffle_after_epoch, all records of the rank are shuffled instead of the file order. Only for data on a local file system. Defaults to False.
+        loader_thread_num (int, optional): Number of threads loading batches, each from its own subset of the part files of the rank. Defaults to 1.
+        batch_queue_depth (int, optional): Number of loaded batches queued ahead of the consumer. Defaults to 4.
+        deterministic (bool, optional): With several loader threads, take their batches round robin so the output order is reproducible. Defaults to True.
+        shuffle_mode (str, optional): How random_shuffle shuffles. "instance" shuffles within a buffer of shuffle_buffer_size records. "global" reads the records of all part files in a new random order every epoch, split over all ranks and loader threads, holding only an index of the records in memory. The index is kept in a sidecar "<part file>.index" when the directory is writable. Defaults to "instance".
 
     Returns:
         oneflow_api.BlobDesc: The result Blob
@@ -347,9 +357,14 @@ def ofrecord_reader(
         .Attr("batch_size", batch_size)
         .Attr("part_name_prefix", part_name_prefix)
         .Attr("random_shuffle", random_shuffle)
+        .Attr("shuffle_mode", shuffle_mode)
         .Attr("shuffle_buffer_size", shuffle_buffer_size)
         .Attr("shuffle_after_epoch", shuffle_after_epoch)
         .Attr("part_name_suffix_length", part_name_suffix_length)
+        .Attr("use_mmap", use_mmap)
+        .Attr("loader_thread_num", loader_thread_num)
+        .Attr("batch_queue_depth", batch_queue_depth)
+        .Attr("deterministic", deterministic)
         .Build()
         .InferAndTryRun()
         .RemoteBlobList()[0]
@@ -463,6 +478,10 @@ def onerec_reader(
     shuffle_after_epoch=False,
     verify_example=True,
     name=None,
+    loader_thread_num=1,
+    batch_queue_depth=4,
+    deterministic=True,
+    verify_checksum=True,
 ):
     assert isinstance(files, (list, tuple))
 
@@ -480,6 +499,10 @@ def onerec_reader(
         .Attr("shuffle_buffer_size", shuffle_buffer_size)
         .Attr("shuffle_after_epoch", shuffle_after_epoch)
         .Attr("verify_example", verify_example)
+        .Attr("verify_checksum", verify_checksum)
+        .Attr("loader_thread_num", loader_thread_num)
+        .Attr("batch_queue_depth", batch_queue_depth)
+        .Attr("deterministic", deterministic)
         .Build()
         .InferAndTryRun()
         .RemoteBlobList()[0]
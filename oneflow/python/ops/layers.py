@@ -847,37 +847,7 @@ def layer_norm(
                 reuse=False,
             )
 
-    if flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu":
-        if begin_norm_axis < 0:
-            begin_norm_axis = begin_norm_axis + len(inputs.shape)
-
-        reduce_axis = []
-        for dim in range(len(inputs.shape)):
-            if dim >= begin_norm_axis:
-                reduce_axis.append(dim)
-        mean, variance = flow.nn.moments(inputs, reduce_axis, keepdims=True)
-
-        axis = begin_norm_axis
-        normalized = flow.nn.batch_normalization(
-            x=inputs,
-            mean=mean,
-            variance=variance,
-            variance_epsilon=epsilon,
-            axis=axis,
-            name=name,
-        )
-        nd_params_shape = [1] * (len(inputs.shape) - len(param_shape)) + list(
-            param_shape
-        )
-        affined = normalized
-        if gamma:
-            gamma = flow.reshape(gamma, nd_params_shape)
-            affined *= gamma
-        if beta:
-            beta = flow.reshape(beta, nd_params_shape)
-            affined += beta
-        return affined
-    elif flow.current_scope().device_parallel_desc_symbol.device_tag == "gpu":
+    if flow.current_scope().device_parallel_desc_symbol.device_tag in ["cpu", "gpu"]:
         op_builder = (
             flow.user_op_builder(name)
             .Op("layer_norm")
@@ -1162,65 +1132,24 @@ def batch_normalization(
         moving_variance_initializer,
     )
 
-    if flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu":
-        if training:
-            reduce_axis = []
-            for dim in range(len(inputs.shape)):
-                if dim != axis:
-                    reduce_axis.append(dim)
-            mean, variance = flow.nn.moments(inputs, reduce_axis, keepdims=False)
-
-            def update_moving(moving, this_batch):
-                moving_identity = flow.identity(moving)
-                flow.assign(
-                    moving, momentum * moving_identity + (1 - momentum) * this_batch
-                )
-
-            update_moving(moving_mean, mean)
-            update_moving(moving_variance, variance)
-
-            return flow.nn.batch_normalization(
-                x=inputs,
-                mean=mean,
-                variance=variance,
-                offset=beta,
-                scale=gamma,
-                variance_epsilon=epsilon,
-                axis=axis,
-                name=name,
-            )
-        else:
-            mean = moving_mean
-            variance = moving_variance
-            return flow.nn.batch_normalization(
-                x=inputs,
-                mean=mean,
-                variance=variance,
-                offset=beta,
-                scale=gamma,
-                variance_epsilon=epsilon,
-                axis=axis,
-                name=name,
-            )
-    else:
-        builder = (
-            flow.user_op_builder(name)
-            .Op("normalization")
-            .Input("x", [inputs])
-            .Input("moving_mean", [moving_mean])
-            .Input("moving_variance", [moving_variance])
-            .Input("gamma", [gamma])
-            .Input("beta", [beta])
-            .Output("y")
-            .Attr("axis", axis)
-            .Attr("epsilon", epsilon)
-            .Attr("training", training)
-            .Attr("momentum", momentum)
-        )
-        if trainable and training:
-            builder = builder.Output("mean").Output("inv_variance")
+    builder = (
+        flow.user_op_builder(name)
+        .Op("normalization")
+        .Input("x", [inputs])
+        .Input("moving_mean", [moving_mean])
+        .Input("moving_variance", [moving_variance])
+        .Input("gamma", [gamma])
+        .Input("beta", [beta])
+        .Output("y")
+        .Attr("axis", axis)
+        .Attr("epsilon", epsilon)
+        .Attr("training", training)
+        .Attr("momentum", momentum)
+    )
+    if trainable and training:
+        builder = builder.Output("mean").Output("inv_variance")
 
-        return builder.Build().InferAndTryRun().RemoteBlobList()[0]
+    return builder.Build().InferAndTryRun().RemoteBlobList()[0]
 
 
 @oneflow_export("layers.batch_normalization_add_relu")
@@ -1272,10 +1201,7 @@ def batch_normalization_add_relu(
     if not flow.current_global_function_desc().IsTrainable() or not trainable:
         training = False
 
-    if (
-        not training
-        or flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu"
-    ):
+    if not training:
         out = flow.layers.batch_normalization(
             inputs,
             axis=axis,
@@ -1472,8 +1398,13 @@ def upsample(
         raise ValueError('data_format must be "NHWC" or "NCHW".')
 
     need_transpose = 0
+    channels_last = False
     if data_format.upper() == "NHWC":
-        need_transpose = 1
+        # only the cpu kernels read NHWC directly
+        if flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu":
+            channels_last = True
+        else:
+            need_transpose = 1
 
     if need_transpose:
         x = flow.transpose(x, perm=[0, 3, 1, 2])
@@ -1485,7 +1416,7 @@ def upsample(
         .Output("y")
         .Attr("height_scale", float(height_scale))
         .Attr("width_scale", float(width_scale))
-        .Attr("data_format", "channels_first")
+        .Attr("data_format", "channels_last" if channels_last else "channels_first")
         .Attr("interpolation", interpolation)
         .Build()
     )
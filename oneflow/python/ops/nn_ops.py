@@ -1116,19 +1116,9 @@ def batch_normalization(
 
     params_shape = [x.shape[axis]]
 
-    if flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu":
-        if len(mean.shape) == 1:
-            nd_params_shape = [1] * len(x.shape)
-            nd_params_shape[axis] = params_shape[0]
-            mean = flow.reshape(mean, nd_params_shape)
-            variance = flow.reshape(variance, nd_params_shape)
-            if scale:
-                scale = flow.reshape(scale, nd_params_shape)
-            if offset:
-                offset = flow.reshape(offset, nd_params_shape)
-        elif len(mean.shape) == len(x.shape):
-            pass
-        else:
+    device_tag = flow.current_scope().device_parallel_desc_symbol.device_tag
+    if device_tag == "cpu" and len(mean.shape) != 1:
+        if len(mean.shape) != len(x.shape):
             raise ValueError(
                 "shape of mean and variance should be 1D or has number of axes and x's"
             )
@@ -1141,7 +1131,7 @@ def batch_normalization(
         if offset:
             affined += offset
         return affined
-    elif flow.current_scope().device_parallel_desc_symbol.device_tag == "gpu":
+    elif device_tag in ["cpu", "gpu"]:
         params_dtype = flow.float32 if x.dtype == flow.float16 else x.dtype
         if scale is None:
             scale = flow.constant(
@@ -1225,37 +1215,7 @@ def layer_norm(
     if name is None:
         name = id_util.UniqueStr("LayerNorm_")
 
-    if flow.current_scope().device_parallel_desc_symbol.device_tag == "cpu":
-        if begin_norm_axis < 0:
-            begin_norm_axis = begin_norm_axis + len(inputs.shape)
-
-        reduce_axis = []
-        for dim in range(len(inputs.shape)):
-            if dim >= begin_norm_axis:
-                reduce_axis.append(dim)
-        mean, variance = flow.nn.moments(inputs, reduce_axis, keepdims=True)
-
-        axis = begin_norm_axis
-        normalized = flow.nn.batch_normalization(
-            x=inputs,
-            mean=mean,
-            variance=variance,
-            variance_epsilon=epsilon,
-            axis=axis,
-            name=name,
-        )
-        nd_params_shape = [1] * (len(inputs.shape) - len(param_shape)) + list(
-            param_shape
-        )
-        affined = normalized
-        if gamma:
-            gamma = flow.reshape(gamma, nd_params_shape)
-            affined *= gamma
-        if beta:
-            beta = flow.reshape(beta, nd_params_shape)
-            affined += beta
-        return affined
-    elif flow.current_scope().device_parallel_desc_symbol.device_tag == "gpu":
+    if flow.current_scope().device_parallel_desc_symbol.device_tag in ["cpu", "gpu"]:
         op_builder = (
             flow.user_op_builder(name)
             .Op("layer_norm")
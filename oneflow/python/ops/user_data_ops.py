@@ -884,6 +884,162 @@ class ImageRandomCropModule(module_util.Module):
         )
 
 
+@oneflow_export("image.decode_random_crop_resize_normalize")
+def api_image_decode_random_crop_resize_normalize(
+    input_blob: oneflow_api.BlobDesc,
+    target_height: int,
+    target_width: int,
+    mirror_blob: Optional[oneflow_api.BlobDesc] = None,
+    color_space: str = "BGR",
+    output_layout: str = "NCHW",
+    mean: Sequence[float] = [0.0],
+    std: Sequence[float] = [1.0],
+    num_attempts: int = 10,
+    seed: Optional[int] = None,
+    random_area: Sequence[float] = None,
+    random_aspect_ratio: Sequence[float] = None,
+    name: str = "ImageDecodeRandomCropResizeNormalize",
+) -> oneflow_api.BlobDesc:
+    """This operator decodes encoded images, crops each one randomly, resizes the crops to
+    (target_height, target_width) bilinearly, flips them horizontally when `mirror_blob` says so
+    and normalizes them into a float batch, all in a single CPU kernel. It is the fused form of
+    `image_decode`, `image_random_crop`, `image_resize` and `crop_mirror_normalize`.
+
+    JPEG images only decode the rows and columns covered by the crop window and are scaled down
+    in the DCT domain as far as the crop still covers the target size, so the result differs
+    slightly from the unfused pipeline. Other formats take a full decode.
+
+    Args:
+        input_blob (oneflow_api.BlobDesc): The encoded images, a 1-d `tensor_buffer` Blob.
+        target_height (int): The output image height.
+        target_width (int): The output image width.
+        mirror_blob (Optional[oneflow_api.BlobDesc], optional): int8 flags for horizontal flip, e.g. the output of `flow.random.CoinFlip`. Defaults to None.
+        color_space (str, optional): One of "BGR", "RGB" and "GRAY". Defaults to "BGR".
+        output_layout (str, optional): "NCHW" or "NHWC". Defaults to "NCHW".
+        mean (Sequence[float], optional): The mean value for normalization. Defaults to [0.0].
+        std (Sequence[float], optional): The standard deviation values for normalization. Defaults to [1.0].
+        num_attempts (int, optional): The maximum number of random cropping attempts. Defaults to 10.
+        seed (Optional[int], optional): The random seed. Defaults to None.
+        random_area (Sequence[float], optional): The random cropping area. Defaults to [0.08, 1.0].
+        random_aspect_ratio (Sequence[float], optional): The random aspect ratio. Defaults to [0.75, 1.333333].
+        name (str, optional): The name for the operation. Defaults to "ImageDecodeRandomCropResizeNormalize".
+
+    Returns:
+        oneflow_api.BlobDesc: The float image batch.
+
+    For example:
+
+    .. code-block:: python
+
+        import oneflow as flow
+        import oneflow.typing as tp
+
+
+        @flow.global_function(type="predict")
+        def train_input_job() -> tp.Numpy:
+            batch_size = 32
+            ofrecord = flow.data.ofrecord_reader(
+                "./imgdataset", batch_size=batch_size, data_part_num=1,
+            )
+            encoded = flow.data.OFRecordBytesDecoder(ofrecord, "encoded")
+            rng = flow.random.CoinFlip(batch_size=batch_size)
+            return flow.image.decode_random_crop_resize_normalize(
+                encoded,
+                target_height=224,
+                target_width=224,
+                mirror_blob=rng,
+                color_space="RGB",
+                mean=[123.68, 116.779, 103.939],
+                std=[58.393, 57.12, 57.375],
+            )
+
+        # images.shape (32, 3, 224, 224)
+        images = train_input_job()
+
+    """
+    assert isinstance(name, str)
+    if seed is not None:
+        assert name is not None
+    if random_area is None:
+        random_area = [0.08, 1.0]
+    if random_aspect_ratio is None:
+        random_aspect_ratio = [0.75, 1.333333]
+    module = flow.find_or_create_module(
+        name,
+        lambda: ImageDecodeRandomCropResizeNormalizeModule(
+            target_height=target_height,
+            target_width=target_width,
+            has_mirror=mirror_blob is not None,
+            color_space=color_space,
+            output_layout=output_layout,
+            mean=mean,
+            std=std,
+            num_attempts=num_attempts,
+            random_seed=seed,
+            random_area=random_area,
+            random_aspect_ratio=random_aspect_ratio,
+            name=name,
+        ),
+    )
+    return module(input_blob, mirror_blob)
+
+
+class ImageDecodeRandomCropResizeNormalizeModule(module_util.Module):
+    def __init__(
+        self,
+        target_height: int,
+        target_width: int,
+        has_mirror: bool,
+        color_space: str,
+        output_layout: str,
+        mean: Sequence[float],
+        std: Sequence[float],
+        num_attempts: int,
+        random_seed: Optional[int],
+        random_area: Sequence[float],
+        random_aspect_ratio: Sequence[float],
+        name: str,
+    ):
+        module_util.Module.__init__(self, name)
+        seed, has_seed = flow.random.gen_seed(random_seed)
+        self.op_module_builder = flow.user_op_module_builder(
+            "image_decode_random_crop_resize_normalize"
+        ).InputSize("in", 1)
+        if has_mirror:
+            self.op_module_builder = self.op_module_builder.InputSize("mirror", 1)
+        self.op_module_builder = (
+            self.op_module_builder.Output("out")
+            .Attr("target_height", target_height)
+            .Attr("target_width", target_width)
+            .Attr("color_space", color_space)
+            .Attr("output_layout", output_layout)
+            .Attr("mean", mean)
+            .Attr("std", std)
+            .Attr("num_attempts", num_attempts)
+            .Attr("random_area", random_area)
+            .Attr("random_aspect_ratio", random_aspect_ratio)
+            .Attr("has_seed", has_seed)
+            .Attr("seed", seed)
+            .CheckAndComplete()
+        )
+        self.op_module_builder.user_op_module.InitOpKernel()
+
+    def forward(
+        self,
+        input: oneflow_api.BlobDesc,
+        mirror: Optional[oneflow_api.BlobDesc] = None,
+    ):
+        if self.call_seq_no == 0:
+            name = self.module_name
+        else:
+            name = id_util.UniqueStr("ImageDecodeRandomCropResizeNormalize_")
+
+        op = self.op_module_builder.OpName(name).Input("in", [input])
+        if mirror is not None:
+            op = op.Input("mirror", [mirror])
+        return op.Build().InferAndTryRun().SoleOutputBlob()
+
+
 @oneflow_export("random.CoinFlip", "random.coin_flip")
 def api_coin_flip(
     batch_size: int = 1,
@@ -2350,3 +2506,38 @@ def OneRecDecoder(
         .InferAndTryRun()
         .RemoteBlobList()[0]
     )
+
+
+@oneflow_export("data.onerec_batch_decoder")
+def onerec_batch_decoder(input_blob, keys, dtypes, shapes, is_dynamic=False, name=None):
+    r"""Decodes several fields of a batch of OneRec examples at once. Each record is walked
+    once for all keys, and each field is copied into its own contiguous output blob.
+    Fields that need reshape or batch_padding are decoded with onerec_decoder instead.
+
+    Args:
+        input_blob: The batch of examples from onerec_reader.
+        keys (Sequence[str]): The names of the fields.
+        dtypes (Sequence[flow.dtype]): The data type of each field.
+        shapes (Sequence[Sequence[int]]): The static shape of one instance of each field.
+        is_dynamic (bool, optional): Whether the outputs have dynamic shapes. Defaults to False.
+        name (Optional[str], optional): The name for the operation. Defaults to None.
+
+    Returns:
+        List[oneflow_api.BlobDesc]: One blob per key.
+    """
+    assert len(keys) == len(dtypes) == len(shapes)
+    if name is None:
+        name = id_util.UniqueStr("OneRecBatchDecoder_")
+    return (
+        flow.user_op_builder(name)
+        .Op("onerec_batch_decoder")
+        .Input("in", [input_blob])
+        .Output("out", len(keys))
+        .Attr("keys", list(keys))
+        .Attr("data_types", list(dtypes))
+        .Attr("static_shapes", [list(shape) for shape in shapes])
+        .Attr("is_dynamic", is_dynamic)
+        .Build()
+        .InferAndTryRun()
+        .RemoteBlobList()
+    )
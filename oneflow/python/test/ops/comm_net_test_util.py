@@ -0,0 +1,40 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import numpy as np
+import oneflow as flow
+import oneflow.typing as oft
+
+
+def run_relu_round_trip(test_case, shape):
+    func_config = flow.FunctionConfig()
+    func_config.default_logical_view(flow.scope.consistent_view())
+    func_config.default_data_type(flow.float)
+
+    @flow.global_function(function_config=func_config)
+    def ReluJob(x: oft.Numpy.Placeholder(shape)):
+        with flow.scope.placement("cpu", "0:0"):
+            out0 = flow.math.relu(x)
+        with flow.scope.placement("cpu", "1:0"):
+            out1 = flow.math.relu(out0)
+        with flow.scope.placement("cpu", "0:0"):
+            out2 = flow.math.relu(out1)
+        return out2
+
+    for i in range(3):
+        x = np.random.uniform(low=-1, high=1, size=shape).astype(np.float32)
+        ret = ReluJob(x).get().numpy()
+        test_case.assertTrue(np.array_equal(ret, np.maximum(x, 0)))
+
@@ -0,0 +1,34 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import oneflow as flow
+import unittest
+from comm_net_test_util import run_relu_round_trip
+
+
+@flow.unittest.skip_unless_2n1d()
+class TestCommNetMultiConnection(flow.unittest.TestCase):
+    def test_striped_body(test_case):
+        flow.config.comm_net.connection_num_per_peer(4)
+        flow.config.comm_net.stripe_min_body_byte(1024)
+        run_relu_round_trip(test_case, (1024, 1023))
+
+    def test_small_body(test_case):
+        flow.config.comm_net.connection_num_per_peer(3)
+        run_relu_round_trip(test_case, (10, 2))
+
+
+if __name__ == "__main__":
+    unittest.main()
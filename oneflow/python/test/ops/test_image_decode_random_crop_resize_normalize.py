@@ -0,0 +1,116 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+import cv2
+import numpy as np
+import oneflow as flow
+import oneflow.typing as oft
+
+
+def _of_decode_random_crop_resize_normalize(
+    images_bytes, mirror, target_size, color_space, output_layout
+):
+    static_shape = (len(images_bytes), max([len(bys) for bys in images_bytes]))
+
+    flow.clear_default_session()
+    func_config = flow.FunctionConfig()
+    func_config.default_data_type(flow.float)
+    func_config.default_logical_view(flow.scope.mirrored_view())
+
+    @flow.global_function(function_config=func_config)
+    def decode_job(
+        images_def: oft.ListListNumpy.Placeholder(shape=static_shape, dtype=flow.int8),
+        mirror_def: oft.ListNumpy.Placeholder(shape=(len(images_bytes),), dtype=flow.int8),
+    ) -> oft.ListNumpy:
+        images_buffer = flow.tensor_list_to_tensor_buffer(images_def)
+        return flow.image.decode_random_crop_resize_normalize(
+            images_buffer,
+            target_height=target_size[0],
+            target_width=target_size[1],
+            mirror_blob=mirror_def,
+            color_space=color_space,
+            output_layout=output_layout,
+            # with the whole area every crop is the full image
+            random_area=[1.0, 1.0],
+            random_aspect_ratio=[0.01, 100.0],
+            seed=0,
+        )
+
+    images_np_arr = [
+        np.frombuffer(bys, dtype=np.byte).reshape(1, -1) for bys in images_bytes
+    ]
+    mirror_np_arr = np.array(mirror, dtype=np.int8)
+    return decode_job([images_np_arr], [mirror_np_arr])[0]
+
+
+def _read_images_bytes(image_files, ext):
+    images_bytes = []
+    for image_file in image_files:
+        if ext == ".jpg":
+            with open(image_file, "rb") as f:
+                images_bytes.append(f.read())
+        else:
+            image = cv2.imread(image_file, cv2.IMREAD_COLOR)
+            images_bytes.append(cv2.imencode(ext, image)[1].tobytes())
+    return images_bytes
+
+
+def _compare_with_cv(test_case, image_files, ext, target_size, color_space):
+    images_bytes = _read_images_bytes(image_files, ext)
+    batch_size = len(images_bytes)
+    nchw = _of_decode_random_crop_resize_normalize(
+        images_bytes, [0] * batch_size, target_size, color_space, "NCHW"
+    )
+    nhwc = _of_decode_random_crop_resize_normalize(
+        images_bytes, [0] * batch_size, target_size, color_space, "NHWC"
+    )
+    mirrored = _of_decode_random_crop_resize_normalize(
+        images_bytes, [1] * batch_size, target_size, color_space, "NHWC"
+    )
+    test_case.assertTrue(np.array_equal(nchw, np.transpose(nhwc, (0, 3, 1, 2))))
+    test_case.assertTrue(np.array_equal(mirrored, nhwc[:, :, ::-1, :]))
+    for image_bytes, of_image in zip(images_bytes, nhwc):
+        flag = cv2.IMREAD_COLOR if color_space != "GRAY" else cv2.IMREAD_GRAYSCALE
+        cv_image = cv2.imdecode(np.frombuffer(image_bytes, dtype=np.uint8), flag)
+        if color_space == "RGB":
+            cv_image = cv2.cvtColor(cv_image, cv2.COLOR_BGR2RGB)
+        cv_image = cv2.resize(
+            cv_image, (target_size[1], target_size[0]), interpolation=cv2.INTER_AREA
+        ).reshape(of_image.shape)
+        # JPEGs are downscaled in the DCT domain, only the overall error is bounded
+        diff = np.abs(of_image - cv_image.astype(np.float32))
+        test_case.assertLess(np.mean(diff), 4.0)
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestImageDecodeRandomCropResizeNormalize(flow.unittest.TestCase):
+    image_files = [
+        "/dataset/mscoco_2017/val2017/000000000139.jpg",
+        "/dataset/mscoco_2017/val2017/000000000632.jpg",
+    ]
+
+    def test_jpeg(test_case):
+        for color_space in ["BGR", "RGB", "GRAY"]:
+            _compare_with_cv(
+                test_case, test_case.image_files, ".jpg", (224, 224), color_space
+            )
+
+    def test_png(test_case):
+        _compare_with_cv(test_case, test_case.image_files, ".png", (160, 256), "BGR")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -63,11 +63,14 @@ def compare_with_tensorflow(
     data_format="NCHW",
     padding="VALID",
     stride=1,
+    cpu_conv_algo=None,
 ):
     assert device_type in ["gpu", "cpu"]
     flow.clear_default_session()
     func_config = flow.FunctionConfig()
     func_config.default_data_type(flow.float)
+    if cpu_conv_algo is not None:
+        func_config.cpu_conv_force_fwd_algo(cpu_conv_algo)
     if data_format == "NCHW":
         xy_data_transpose = (0, 2, 3, 1)
         weight_data_transpose = (2, 3, 1, 0)
@@ -196,6 +199,21 @@ class TestNnConv2d(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             compare_with_tensorflow(*arg)
 
+    def test_cpu_conv_algos(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["device_type"] = ["cpu"]
+        arg_dict["x_shape"] = [(2, 16, 15, 15)]
+        arg_dict["filters"] = [24]
+        arg_dict["kernel_size"] = [1, 3]
+        arg_dict["groups"] = [1]
+        arg_dict["data_format"] = ["NCHW"]
+        arg_dict["padding"] = ["VALID", "SAME"]
+        arg_dict["stride"] = [1]
+        # im2col_gemm, gemm_1x1, winograd_f2x3 and winograd_f4x3
+        arg_dict["cpu_conv_algo"] = [0, 1, 3, 4]
+        for arg in GenArgList(arg_dict):
+            compare_with_tensorflow(*arg)
+
     def test_cpu3(test_case):
         return
         arg_dict = OrderedDict()
@@ -0,0 +1,148 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import struct
+import tempfile
+import unittest
+
+import numpy as np
+import oneflow as flow
+import oneflow.core.record.record_pb2 as record_pb
+import oneflow.typing as tp
+
+
+def _write_part_files(data_dir, part_num, record_num_per_part):
+    for part_id in range(part_num):
+        with open(os.path.join(data_dir, "part-{}".format(part_id)), "wb") as f:
+            for i in range(record_num_per_part):
+                value = part_id * record_num_per_part + i
+                record = record_pb.OFRecord()
+                record.feature["x"].int32_list.value.extend([value, value * 2, value * 3])
+                serialized = record.SerializeToString()
+                f.write(struct.pack("q", len(serialized)))
+                f.write(serialized)
+
+
+def _read_values(data_dir, part_num, batch_size, batch_num, **reader_kwargs):
+    flow.clear_default_session()
+    func_config = flow.FunctionConfig()
+    func_config.default_data_type(flow.float)
+
+    @flow.global_function(function_config=func_config)
+    def ReaderJob() -> tp.Numpy:
+        with flow.scope.placement("cpu", "0:0"):
+            ofrecord = flow.data.ofrecord_reader(
+                data_dir,
+                batch_size=batch_size,
+                data_part_num=part_num,
+                **reader_kwargs
+            )
+            return flow.data.OFRecordRawDecoder(ofrecord, "x", shape=(3,), dtype=flow.int32)
+
+    return np.concatenate([ReaderJob() for _ in range(batch_num)])
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestOFRecordReaderMmap(flow.unittest.TestCase):
+    def test_same_records_as_stream(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_part_files(data_dir, 3, 50)
+            expected = _read_values(data_dir, 3, 10, 20)
+            values = _read_values(data_dir, 3, 10, 20, use_mmap=True)
+            test_case.assertTrue(np.array_equal(values, expected))
+
+    def test_shuffle_after_epoch_visits_every_record(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_part_files(data_dir, 3, 50)
+            values = _read_values(
+                data_dir, 3, 10, 15, use_mmap=True, shuffle_after_epoch=True
+            )
+            test_case.assertTrue(np.array_equal(values[:, 1], values[:, 0] * 2))
+            test_case.assertEqual(sorted(values[:, 0].tolist()), list(range(150)))
+            test_case.assertNotEqual(values[:, 0].tolist(), list(range(150)))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestOFRecordReaderLoaderThreads(flow.unittest.TestCase):
+    def test_deterministic_order(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_part_files(data_dir, 4, 30)
+            for use_mmap in [False, True]:
+                runs = [
+                    _read_values(
+                        data_dir,
+                        4,
+                        10,
+                        12,
+                        use_mmap=use_mmap,
+                        loader_thread_num=3,
+                        batch_queue_depth=2,
+                    )
+                    for _ in range(2)
+                ]
+                test_case.assertTrue(np.array_equal(runs[0], runs[1]))
+                test_case.assertTrue(np.array_equal(runs[0][:, 1], runs[0][:, 0] * 2))
+
+    def test_unordered_merge(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_part_files(data_dir, 4, 30)
+            values = _read_values(
+                data_dir, 4, 10, 12, loader_thread_num=4, deterministic=False
+            )
+            test_case.assertTrue(np.array_equal(values[:, 2], values[:, 0] * 3))
+            test_case.assertTrue(set(values[:, 0].tolist()) <= set(range(120)))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestOFRecordReaderGlobalShuffle(flow.unittest.TestCase):
+    def test_every_record_once_per_epoch(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_part_files(data_dir, 3, 50)
+            values = _read_values(
+                data_dir,
+                3,
+                10,
+                30,
+                random_shuffle=True,
+                shuffle_mode="global",
+                loader_thread_num=3,
+            )
+            test_case.assertTrue(np.array_equal(values[:, 2], values[:, 0] * 3))
+            for epoch in [values[:150], values[150:]]:
+                test_case.assertEqual(sorted(epoch[:, 0].tolist()), list(range(150)))
+            # records of different part files are mixed within a batch
+            test_case.assertGreater(len(set((values[:10, 0] // 50).tolist())), 1)
+            test_case.assertNotEqual(
+                values[:150, 0].tolist(), values[150:, 0].tolist()
+            )
+            for part_id in range(3):
+                index_path = os.path.join(data_dir, "part-{}.index".format(part_id))
+                test_case.assertTrue(os.path.exists(index_path))
+            # a second run reads the sidecar index and sees the same order
+            rerun = _read_values(
+                data_dir,
+                3,
+                10,
+                30,
+                random_shuffle=True,
+                shuffle_mode="global",
+                loader_thread_num=3,
+            )
+            test_case.assertTrue(np.array_equal(rerun, values))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,304 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+from typing import Tuple
+
+import numpy as np
+import oneflow as flow
+import oneflow.typing as tp
+
+_MASK64 = (1 << 64) - 1
+_PRIME64_1 = 11400714785074694791
+_PRIME64_2 = 14029467366897019727
+_PRIME64_3 = 1609587929392839161
+_PRIME64_4 = 9650029242287828579
+_PRIME64_5 = 2870177450012600261
+
+
+def _rotl64(x, r):
+    return ((x << r) | (x >> (64 - r))) & _MASK64
+
+
+def _xxh64_round(acc, value):
+    acc = (acc + value * _PRIME64_2) & _MASK64
+    return (_rotl64(acc, 31) * _PRIME64_1) & _MASK64
+
+
+def _xxh64(data, seed=0):
+    length = len(data)
+    pos = 0
+    if length >= 32:
+        v = [
+            (seed + _PRIME64_1 + _PRIME64_2) & _MASK64,
+            (seed + _PRIME64_2) & _MASK64,
+            seed,
+            (seed - _PRIME64_1) & _MASK64,
+        ]
+        while pos + 32 <= length:
+            lanes = struct.unpack_from("<4Q", data, pos)
+            v = [_xxh64_round(acc, lane) for acc, lane in zip(v, lanes)]
+            pos += 32
+        h = (
+            _rotl64(v[0], 1) + _rotl64(v[1], 7) + _rotl64(v[2], 12) + _rotl64(v[3], 18)
+        ) & _MASK64
+        for acc in v:
+            h ^= _xxh64_round(0, acc)
+            h = (h * _PRIME64_1 + _PRIME64_4) & _MASK64
+    else:
+        h = (seed + _PRIME64_5) & _MASK64
+    h = (h + length) & _MASK64
+    while pos + 8 <= length:
+        h ^= _xxh64_round(0, struct.unpack_from("<Q", data, pos)[0])
+        h = (_rotl64(h, 27) * _PRIME64_1 + _PRIME64_4) & _MASK64
+        pos += 8
+    if pos + 4 <= length:
+        h ^= (struct.unpack_from("<I", data, pos)[0] * _PRIME64_1) & _MASK64
+        h = (_rotl64(h, 23) * _PRIME64_2 + _PRIME64_3) & _MASK64
+        pos += 4
+    while pos < length:
+        h ^= (data[pos] * _PRIME64_5) & _MASK64
+        h = (_rotl64(h, 11) * _PRIME64_1) & _MASK64
+        pos += 1
+    h ^= h >> 33
+    h = (h * _PRIME64_2) & _MASK64
+    h ^= h >> 29
+    h = (h * _PRIME64_3) & _MASK64
+    return h ^ (h >> 32)
+
+
+class _FlatBufferWriter(object):
+    """Writes a flatbuffer front to back, so that every offset points forward to an object
+    written after the one holding it."""
+
+    def __init__(self, identifier):
+        self.buf = bytearray(struct.pack("<I4s", 0, identifier))
+
+    def finish(self, root_pos):
+        struct.pack_into("<I", self.buf, 0, root_pos)
+        return bytes(self.buf)
+
+    def _pad(self, alignment, extra=0):
+        while (len(self.buf) + extra) % alignment != 0:
+            self.buf.append(0)
+
+    def _patch_offset(self, field_pos, target_pos):
+        struct.pack_into("<I", self.buf, field_pos, target_pos - field_pos)
+
+    def table(self, fields):
+        # one entry per field id: None when absent, an int for a ubyte field, or a function
+        # that writes the referenced object and returns its position
+        field_offsets = [0] * len(fields)
+        table_size = 4
+        for i, field in enumerate(fields):
+            if callable(field):
+                field_offsets[i] = table_size
+                table_size += 4
+        for i, field in enumerate(fields):
+            if isinstance(field, int):
+                field_offsets[i] = table_size
+                table_size += 1
+        self._pad(2)
+        vtable_pos = len(self.buf)
+        self.buf += struct.pack("<HH", 4 + 2 * len(fields), table_size)
+        self.buf += struct.pack("<{}H".format(len(fields)), *field_offsets)
+        self._pad(4)
+        table_pos = len(self.buf)
+        self.buf += struct.pack("<i", table_pos - vtable_pos)
+        self.buf += bytes(table_size - 4)
+        for field, offset in zip(fields, field_offsets):
+            if isinstance(field, int):
+                struct.pack_into("<B", self.buf, table_pos + offset, field)
+        for field, offset in zip(fields, field_offsets):
+            if callable(field):
+                self._patch_offset(table_pos + offset, field())
+        return table_pos
+
+    def vector(self, fmt, values):
+        self._pad(max(struct.calcsize(fmt), 4), 4)
+        pos = len(self.buf)
+        self.buf += struct.pack("<I{}{}".format(len(values), fmt), len(values), *values)
+        return pos
+
+    def string(self, s):
+        self._pad(4)
+        pos = len(self.buf)
+        self.buf += struct.pack("<I", len(s)) + s.encode() + b"\0"
+        return pos
+
+    def table_vector(self, writers):
+        self._pad(4)
+        pos = len(self.buf)
+        self.buf += struct.pack("<I", len(writers)) + bytes(4 * len(writers))
+        for i, write in enumerate(writers):
+            self._patch_offset(pos + 4 + 4 * i, write())
+        return pos
+
+
+# onerec.example.TensorData union types and the list format of their values
+_TENSOR_DATA = {
+    np.dtype(np.int32): (3, "i"),
+    np.dtype(np.int64): (4, "q"),
+    np.dtype(np.float32): (5, "f"),
+}
+
+
+def _make_example(features):
+    writer = _FlatBufferWriter(b"1REC")
+
+    def TensorWriter(value):
+        data_type, fmt = _TENSOR_DATA[value.dtype]
+        return lambda: writer.table(
+            [
+                lambda: writer.vector("i", list(value.shape)),
+                data_type,
+                lambda: writer.table(
+                    [lambda: writer.vector(fmt, value.flatten().tolist())]
+                ),
+            ]
+        )
+
+    def FeatureWriter(name, value):
+        return lambda: writer.table([lambda: writer.string(name), TensorWriter(value)])
+
+    # features are looked up by binary search and must be sorted by name
+    feature_writers = [FeatureWriter(name, features[name]) for name in sorted(features)]
+    root = writer.table([lambda: writer.table_vector(feature_writers)])
+    return writer.finish(root)
+
+
+_MAGIC_NUMBER = 0x24434552454E4F5E
+
+
+def _make_frame(payload, bad_checksum=False):
+    header = struct.pack("<qii", _MAGIC_NUMBER, 0, len(payload))
+    # digests are stored big endian
+    header += struct.pack(">Q", _xxh64(header))
+    padding = bytes(-len(payload) % 8)
+    digest = _xxh64(payload)
+    if bad_checksum:
+        digest ^= 1
+    return header + payload + padding + struct.pack(">Q", digest)
+
+
+def _expected_features(record_id):
+    return {
+        "a": np.array([record_id, 2 * record_id, 3 * record_id], dtype=np.int32),
+        "b": (np.arange(4, dtype=np.float32).reshape(2, 2) * 0.5 + record_id),
+        "c": np.array([record_id * 10000000000], dtype=np.int64),
+        # decoded by no job, its only role is to be skipped by the key search
+        "unused": np.array([-1], dtype=np.int32),
+    }
+
+
+def _write_onerec_file(file_path, record_num, bad_checksum_record_ids=()):
+    with open(file_path, "wb") as f:
+        for i in range(record_num):
+            payload = _make_example(_expected_features(i))
+            f.write(_make_frame(payload, i in bad_checksum_record_ids))
+
+
+_KEYS = ["a", "b", "c"]
+_DTYPES = [flow.int32, flow.float, flow.int64]
+_SHAPES = [(3,), (2, 2), (1,)]
+
+
+# returns the batches of every key, decoded by onerec_batch_decoder and by onerec_decoder
+def _decode(file_path, batch_size, batch_num, verify_checksum):
+    flow.clear_default_session()
+    func_config = flow.FunctionConfig()
+    func_config.default_data_type(flow.float)
+
+    @flow.global_function(function_config=func_config)
+    def DecodeJob() -> (
+        Tuple[tp.Numpy, tp.Numpy, tp.Numpy, tp.Numpy, tp.Numpy, tp.Numpy]
+    ):
+        with flow.scope.placement("cpu", "0:0"):
+            records = flow.data.onerec_reader(
+                [file_path], batch_size=batch_size, verify_checksum=verify_checksum
+            )
+            batch_decoded = flow.data.onerec_batch_decoder(
+                records, _KEYS, _DTYPES, _SHAPES
+            )
+            per_key_decoded = [
+                flow.data.onerec_decoder(records, key, dtype, shape)
+                for key, dtype, shape in zip(_KEYS, _DTYPES, _SHAPES)
+            ]
+            return tuple(batch_decoded) + tuple(per_key_decoded)
+
+    batches = [DecodeJob() for _ in range(batch_num)]
+    key_num = len(_KEYS)
+    batch_decoded = [np.concatenate([b[k] for b in batches]) for k in range(key_num)]
+    per_key_decoded = [
+        np.concatenate([b[key_num + k] for b in batches]) for k in range(key_num)
+    ]
+    return batch_decoded, per_key_decoded
+
+
+def _check_decoded(test_case, batch_decoded, per_key_decoded, record_num):
+    for k, key in enumerate(_KEYS):
+        expected = np.stack([_expected_features(i)[key] for i in range(record_num)])
+        for decoded in [batch_decoded[k], per_key_decoded[k]]:
+            test_case.assertEqual(decoded.shape, (record_num,) + _SHAPES[k])
+            test_case.assertEqual(decoded.dtype, expected.dtype)
+            test_case.assertTrue(np.array_equal(decoded, expected))
+        test_case.assertTrue(np.array_equal(batch_decoded[k], per_key_decoded[k]))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestOneRecBatchDecoder(flow.unittest.TestCase):
+    def test_same_as_onerec_decoder(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            file_path = os.path.join(data_dir, "part-0.onerec")
+            _write_onerec_file(file_path, 12)
+            for verify_checksum in [True, False]:
+                batch_decoded, per_key_decoded = _decode(
+                    file_path, 4, 3, verify_checksum
+                )
+                _check_decoded(test_case, batch_decoded, per_key_decoded, 12)
+
+    def test_bad_checksum_without_verification(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            file_path = os.path.join(data_dir, "part-0.onerec")
+            # only the payload digest is wrong, the payload itself decodes fine
+            _write_onerec_file(file_path, 12, bad_checksum_record_ids=[5])
+            batch_decoded, per_key_decoded = _decode(file_path, 4, 3, False)
+            _check_decoded(test_case, batch_decoded, per_key_decoded, 12)
+
+    def test_bad_checksum_with_verification(test_case):
+        with tempfile.TemporaryDirectory() as data_dir:
+            file_path = os.path.join(data_dir, "part-0.onerec")
+            _write_onerec_file(file_path, 12, bad_checksum_record_ids=[5])
+            # a bad digest fails a CHECK in the reader, which aborts the process
+            module_dir, module_file = os.path.split(os.path.abspath(__file__))
+            script = "import sys; sys.path.insert(0, {!r}); import {} as t; t._decode({!r}, 4, 3, True)".format(
+                module_dir, os.path.splitext(module_file)[0], file_path
+            )
+            result = subprocess.run(
+                [sys.executable, "-c", script],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+            )
+            test_case.assertNotEqual(result.returncode, 0)
+            test_case.assertIn(b"bad payload digest", result.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
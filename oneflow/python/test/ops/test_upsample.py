@@ -84,7 +84,7 @@ def compare_with_tensorflow(
 class TestUpsample(flow.unittest.TestCase):
     def test_upsample(test_case):
         arg_dict = OrderedDict()
-        arg_dict["device_type"] = ["gpu"]
+        arg_dict["device_type"] = ["cpu", "gpu"]
         arg_dict["input_shape"] = [(2, 11, 12, 13)]
         arg_dict["dtype"] = ["float32", "double"]
         arg_dict["size"] = [(2, 2), 3, (1, 2)]
@@ -17,9 +17,11 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_DATA_READER_H_
 
 #include "oneflow/core/common/buffer.h"
+#include "oneflow/core/common/tensor_buffer_pool.h"
 #include "oneflow/core/framework/op_kernel.h"
 #include "oneflow/user/data/dataset.h"
 #include "oneflow/user/data/parser.h"
+#include <numeric>
 
 namespace oneflow {
 namespace data {
@@ -31,58 +33,158 @@ class DataReader {
  public:
   using LoadTargetPtr = std::shared_ptr<LoadTarget>;
   using LoadTargetPtrList = std::vector<LoadTargetPtr>;
-  DataReader(user_op::KernelInitContext* ctx)
-      : is_closed_(false), batch_buffer_(kDataReaderBatchBufferSize) {}
+  DataReader(user_op::KernelInitContext* ctx) : DataReader(ctx, kDataReaderBatchBufferSize) {}
+  DataReader(user_op::KernelInitContext* ctx, int32_t batch_buffer_size)
+      : is_closed_(false),
+        batch_buffer_size_(batch_buffer_size),
+        batch_buffer_(batch_buffer_size),
+        deterministic_(true) {
+    CHECK_GT(batch_buffer_size, 0);
+  }
   virtual ~DataReader() {
     Close();
-    if (load_thrd_.joinable()) { load_thrd_.join(); }
+    for (std::thread& load_thrd : load_thrds_) {
+      if (load_thrd.joinable()) { load_thrd.join(); }
+    }
+    // the finished load threads have handed their cached blocks to the central lists
+    TensorBufferPool::Get()->ReleaseCentralCache();
   }
 
   void Read(user_op::KernelComputeContext* ctx) {
-    CHECK(load_thrd_.joinable()) << "You should call StartLoadThread before read data";
+    CHECK(!load_thrds_.empty()) << "You should call StartLoadThread before read data";
     auto batch_data = FetchBatchData();
     parser_->Parse(batch_data, ctx);
   }
 
   void Close() {
     is_closed_.store(true);
-    bool buffer_drained = false;
-    while (!buffer_drained) {
-      std::shared_ptr<LoadTargetPtrList> abandoned_batch_data(nullptr);
-      auto status = batch_buffer_.TryReceive(&abandoned_batch_data);
-      CHECK_NE(status, BufferStatus::kBufferStatusErrorClosed);
-      buffer_drained = (status == BufferStatus::kBufferStatusEmpty);
+    DrainAndClose(&batch_buffer_);
+    for (auto& shard_batch_buffer : shard_batch_buffers_) {
+      DrainAndClose(shard_batch_buffer.get());
     }
-    batch_buffer_.Close();
   }
 
  protected:
   void StartLoadThread() {
-    if (load_thrd_.joinable()) { return; }
-    load_thrd_ = std::thread([this] {
-      while (!is_closed_.load() && LoadBatch()) {}
+    if (!load_thrds_.empty()) { return; }
+    load_thrds_.emplace_back([this] {
+      while (!is_closed_.load() && LoadBatch(loader_.get(), &batch_buffer_)) {}
     });
   }
 
+  // Starts one load thread per shard loader, each yielding whole batches from its own shards
+  // into a queue of its own, instead of a single thread for loader_. The shards are read in
+  // proportion to shard_weights, their record counts or an estimate of them, by smooth weighted
+  // round robin: every shard gains its weight in credit per batch and the batch is taken from the
+  // shard with the most credit, which then pays the total weight. With deterministic Read waits
+  // for that shard, so the output order does not depend on thread timing. Otherwise it takes the
+  // ready shard with the most credit, a shard that was skipped keeps its credit and catches up
+  // later. Either way at most about batch_buffer_size batches are queued.
+  void StartLoadThreads(std::vector<std::unique_ptr<Dataset<LoadTarget>>>&& shard_loaders,
+                        const std::vector<int64_t>& shard_weights, bool deterministic) {
+    CHECK(load_thrds_.empty());
+    CHECK(!shard_loaders.empty());
+    CHECK_EQ(shard_loaders.size(), shard_weights.size());
+    if (shard_loaders.size() == 1) {
+      loader_ = std::move(shard_loaders.front());
+      StartLoadThread();
+      return;
+    }
+    shard_loaders_ = std::move(shard_loaders);
+    deterministic_ = deterministic;
+    const int64_t shard_num = shard_loaders_.size();
+    const double total_weight =
+        std::accumulate(shard_weights.begin(), shard_weights.end(), static_cast<double>(0));
+    CHECK_GT(total_weight, 0);
+    const size_t shard_buffer_size = (batch_buffer_size_ + shard_num - 1) / shard_num;
+    FOR_RANGE(int64_t, i, 0, shard_num) {
+      CHECK_GE(shard_weights.at(i), 0);
+      shard_weights_.push_back(shard_weights.at(i) / total_weight);
+      shard_credits_.push_back(0);
+      shard_batch_buffers_.emplace_back(
+          new Buffer<std::shared_ptr<LoadTargetPtrList>>(shard_buffer_size));
+    }
+    FOR_RANGE(int64_t, i, 0, shard_num) {
+      Dataset<LoadTarget>* loader = shard_loaders_.at(i).get();
+      Buffer<std::shared_ptr<LoadTargetPtrList>>* buffer = shard_batch_buffers_.at(i).get();
+      load_thrds_.emplace_back([this, loader, buffer] {
+        while (!is_closed_.load() && LoadBatch(loader, buffer)) {}
+      });
+    }
+  }
+
   std::unique_ptr<Dataset<LoadTarget>> loader_;
   std::unique_ptr<Parser<LoadTarget>> parser_;
 
  private:
   std::shared_ptr<LoadTargetPtrList> FetchBatchData() {
+    if (!shard_batch_buffers_.empty()) { return FetchShardBatchData(); }
     std::shared_ptr<LoadTargetPtrList> batch_data(nullptr);
     CHECK_EQ(batch_buffer_.Receive(&batch_data), BufferStatus::kBufferStatusSuccess);
     return batch_data;
   }
 
-  bool LoadBatch() {
+  // the smooth weighted round robin of StartLoadThreads
+  std::shared_ptr<LoadTargetPtrList> FetchShardBatchData() {
+    const int64_t shard_num = shard_batch_buffers_.size();
+    std::vector<int64_t> shard_ids(shard_num);
+    FOR_RANGE(int64_t, i, 0, shard_num) {
+      shard_credits_.at(i) += shard_weights_.at(i);
+      shard_ids.at(i) = i;
+    }
+    std::stable_sort(shard_ids.begin(), shard_ids.end(), [this](int64_t lhs, int64_t rhs) {
+      return shard_credits_.at(lhs) > shard_credits_.at(rhs);
+    });
+    std::shared_ptr<LoadTargetPtrList> batch_data(nullptr);
+    int64_t shard_id = shard_ids.front();
+    bool is_received = false;
+    if (!deterministic_) {
+      for (int64_t id : shard_ids) {
+        if (shard_batch_buffers_.at(id)->TryReceive(&batch_data)
+            == BufferStatus::kBufferStatusSuccess) {
+          shard_id = id;
+          is_received = true;
+          break;
+        }
+      }
+    }
+    if (!is_received) {
+      CHECK_EQ(shard_batch_buffers_.at(shard_id)->Receive(&batch_data),
+               BufferStatus::kBufferStatusSuccess);
+    }
+    // the weights sum up to 1
+    shard_credits_.at(shard_id) -= 1;
+    return batch_data;
+  }
+
+  static bool LoadBatch(Dataset<LoadTarget>* loader,
+                        Buffer<std::shared_ptr<LoadTargetPtrList>>* buffer) {
     std::shared_ptr<LoadTargetPtrList> batch_data =
-        std::make_shared<LoadTargetPtrList>(std::move(loader_->Next()));
-    return batch_buffer_.Send(batch_data) == BufferStatus::kBufferStatusSuccess;
+        std::make_shared<LoadTargetPtrList>(std::move(loader->Next()));
+    return buffer->Send(batch_data) == BufferStatus::kBufferStatusSuccess;
+  }
+
+  static void DrainAndClose(Buffer<std::shared_ptr<LoadTargetPtrList>>* buffer) {
+    bool buffer_drained = false;
+    while (!buffer_drained) {
+      std::shared_ptr<LoadTargetPtrList> abandoned_batch_data(nullptr);
+      auto status = buffer->TryReceive(&abandoned_batch_data);
+      CHECK_NE(status, BufferStatus::kBufferStatusErrorClosed);
+      buffer_drained = (status == BufferStatus::kBufferStatusEmpty);
+    }
+    buffer->Close();
   }
 
   std::atomic<bool> is_closed_;
+  int32_t batch_buffer_size_;
   Buffer<std::shared_ptr<LoadTargetPtrList>> batch_buffer_;
-  std::thread load_thrd_;
+  std::vector<std::unique_ptr<Dataset<LoadTarget>>> shard_loaders_;
+  std::vector<std::unique_ptr<Buffer<std::shared_ptr<LoadTargetPtrList>>>> shard_batch_buffers_;
+  // normalized to sum up to 1
+  std::vector<double> shard_weights_;
+  std::vector<double> shard_credits_;
+  bool deterministic_;
+  std::vector<std::thread> load_thrds_;
 };
 
 }  // namespace data
@@ -24,6 +24,13 @@ namespace data {
 
 static constexpr int kOneflowDatasetSeed = 524287;
 
+// the seed loader shard shard_id derives from the seed of its op, shard 0 keeps the seed so that
+// a single loader shuffles as before
+inline int64_t GetShardSeed(int64_t seed, int32_t shard_id) {
+  return static_cast<int64_t>(static_cast<uint64_t>(seed)
+                              + static_cast<uint64_t>(shard_id) * 0x9E3779B97F4A7C15ULL);
+}
+
 template<typename LoadTarget>
 class Dataset {
  public:
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_DISTRIBUTED_TRAINING_DATASET_H_
 
 #include "oneflow/user/data/dataset.h"
+#include "oneflow/core/framework/op_kernel.h"
 
 namespace oneflow {
 namespace data {
@@ -105,6 +106,20 @@ class DistributedTrainingDataset final : public Dataset<LoadTarget> {
   std::vector<int64_t> index_seq_;
 };
 
+// Every loader of every rank reads its own slice of one permutation of all records, which is
+// drawn anew every epoch. The seed has to agree across ranks, so -1 means a fixed one here.
+inline std::unique_ptr<Dataset<TensorBuffer>> NewGlobalShuffleLoader(
+    user_op::KernelInitContext* ctx, int32_t shard_id, int32_t shard_num,
+    std::unique_ptr<RandomAccessDataset<TensorBuffer>>&& dataset) {
+  const int64_t seed = ctx->Attr<int64_t>("seed");
+  const int64_t parallel_num = ctx->parallel_ctx().parallel_num();
+  const int64_t parallel_id = ctx->parallel_ctx().parallel_id();
+  CHECK_GE(dataset->Size(), parallel_num * shard_num) << "fewer records than loaders";
+  return std::make_unique<DistributedTrainingDataset<TensorBuffer>>(
+      parallel_num * shard_num, parallel_id * shard_num + shard_id, false, true,
+      seed == -1 ? kOneflowDatasetSeed : seed, std::move(dataset));
+}
+
 }  // namespace data
 }  // namespace oneflow
 
@@ -0,0 +1,96 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_MMAP_OFRECORD_DATASET_H_
+#define ONEFLOW_USER_DATA_MMAP_OFRECORD_DATASET_H_
+
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/core/persistence/mapped_file.h"
+
+namespace oneflow {
+namespace data {
+
+// Maps the part files of a shard of this rank and indexes the record boundaries once on open.
+// Samples are views into the mappings, so no record is copied, and any record can be read in O(1).
+class MmapOFRecordDataset final : public RandomAccessDataset<TensorBuffer> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MmapOFRecordDataset);
+  MmapOFRecordDataset(user_op::KernelInitContext* ctx, int32_t shard_id, int32_t shard_num,
+                      bool random_access) {
+    const FileSystemConf& data_fs_conf = Global<const IOConf>::Get()->data_fs_conf();
+    CHECK(data_fs_conf.has_localfs_conf() || data_fs_conf.has_networkfs_conf())
+        << "OFRecordReader can only mmap files on a local file system";
+    const std::vector<std::string> file_paths = GetOFRecordPartFilePaths(ctx);
+    const Range range = GetOFRecordPartRange(ctx, shard_id, shard_num);
+    for (int64_t i = range.begin(); i < range.end(); ++i) {
+      files_.emplace_back(new MappedFile(file_paths.at(i)));
+      IndexRecords(files_.size() - 1);
+      if (random_access) {
+        files_.back()->AdviseRandom();
+      } else {
+        files_.back()->AdviseSequential();
+      }
+    }
+    CHECK_GT(records_.size(), 0) << "no OFRecord in the part files of shard " << shard_id;
+  }
+  ~MmapOFRecordDataset() = default;
+
+  LoadTargetShdPtrVec At(int64_t index) const override {
+    const RecordPos& pos = records_.at(index);
+    const std::shared_ptr<MappedFile>& file = files_.at(pos.file_id);
+    LoadTargetShdPtr sample(new TensorBuffer());
+    sample->ResetToView(Shape({pos.byte_size}), DataType::kChar, file->data() + pos.offset, file);
+    LoadTargetShdPtrVec ret;
+    ret.push_back(std::move(sample));
+    return ret;
+  }
+
+  size_t Size() const override { return records_.size(); }
+
+ private:
+  struct RecordPos {
+    int32_t file_id;
+    // of the record bytes, past the int64 size in front of them
+    int64_t offset;
+    int64_t byte_size;
+  };
+
+  void IndexRecords(int32_t file_id) {
+    const MappedFile& file = *files_.at(file_id);
+    const int64_t file_size = file.size();
+    int64_t offset = 0;
+    while (offset < file_size) {
+      CHECK_LE(offset + static_cast<int64_t>(sizeof(int64_t)), file_size)
+          << file.file_path() << ": truncated record size at offset " << offset;
+      int64_t byte_size = -1;
+      std::memcpy(&byte_size, file.data() + offset, sizeof(int64_t));
+      offset += sizeof(int64_t);
+      CHECK_GT(byte_size, 0) << file.file_path() << ": bad record size at offset " << offset;
+      CHECK_LE(byte_size, file_size - offset)
+          << file.file_path() << ": truncated record at offset " << offset;
+      records_.push_back(RecordPos{file_id, offset, byte_size});
+      offset += byte_size;
+    }
+  }
+
+  std::vector<std::shared_ptr<MappedFile>> files_;
+  std::vector<RecordPos> records_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_MMAP_OFRECORD_DATASET_H_
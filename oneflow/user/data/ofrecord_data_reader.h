@@ -18,6 +18,8 @@ limitations under the License.
 
 #include "oneflow/user/data/data_reader.h"
 #include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/user/data/mmap_ofrecord_dataset.h"
+#include "oneflow/user/data/distributed_training_dataset.h"
 #include "oneflow/user/data/ofrecord_parser.h"
 #include "oneflow/user/data/random_shuffle_dataset.h"
 #include "oneflow/user/data/batch_dataset.h"
@@ -28,21 +30,68 @@ namespace data {
 
 class OFRecordDataReader final : public DataReader<TensorBuffer> {
  public:
-  OFRecordDataReader(user_op::KernelInitContext* ctx) : DataReader<TensorBuffer>(ctx) {
-    loader_.reset(new OFRecordDataset(ctx));
-    parser_.reset(new OFRecordParser());
-    if (ctx->Attr<bool>("random_shuffle")) {
-      loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
+  OFRecordDataReader(user_op::KernelInitContext* ctx)
+      : DataReader<TensorBuffer>(ctx, ctx->Attr<int32_t>("batch_queue_depth")) {
+    int32_t shard_num = std::max(ctx->Attr<int32_t>("loader_thread_num"), 1);
+    std::shared_ptr<const RecordIndex> index;
+    if (ctx->Attr<bool>("random_shuffle") && ctx->Attr<std::string>("shuffle_mode") == "global") {
+      CHECK(!ctx->Attr<bool>("use_mmap"))
+          << "use_mmap shuffles the records of the rank with shuffle_after_epoch already, "
+             "it does not combine with shuffle_mode global";
+      index = NewOFRecordIndex(ctx);
+    } else {
+      // every loader thread owns at least one part file
+      shard_num = std::min<int64_t>(shard_num, GetOFRecordPartRange(ctx).size());
     }
-    int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
-    loader_.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader_)));
-    StartLoadThread();
+    std::vector<std::unique_ptr<Dataset<TensorBuffer>>> shard_loaders;
+    std::vector<int64_t> shard_weights(shard_num);
+    FOR_RANGE(int32_t, shard_id, 0, shard_num) {
+      shard_loaders.push_back(
+          NewShardLoader(ctx, shard_id, shard_num, index, &shard_weights.at(shard_id)));
+    }
+    parser_.reset(new OFRecordParser());
+    StartLoadThreads(std::move(shard_loaders), shard_weights, ctx->Attr<bool>("deterministic"));
   }
   ~OFRecordDataReader() = default;
 
  protected:
   using DataReader<TensorBuffer>::loader_;
   using DataReader<TensorBuffer>::parser_;
+
+ private:
+  // shard_weight is set to the record count of the shard or to an estimate of it
+  static std::unique_ptr<Dataset<TensorBuffer>> NewShardLoader(
+      user_op::KernelInitContext* ctx, int32_t shard_id, int32_t shard_num,
+      const std::shared_ptr<const RecordIndex>& index, int64_t* shard_weight) {
+    int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
+    std::unique_ptr<Dataset<TensorBuffer>> loader;
+    if (index) {
+      // the index is split evenly over all loaders
+      *shard_weight = 1;
+      loader = NewGlobalShuffleLoader(ctx, shard_id, shard_num,
+                                      std::make_unique<IndexedOFRecordDataset>(index));
+      loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
+      return loader;
+    }
+    if (ctx->Attr<bool>("use_mmap")) {
+      // the files are already split over ranks, the index is shuffled as a whole every epoch
+      const bool shuffle_after_epoch = ctx->Attr<bool>("shuffle_after_epoch");
+      std::unique_ptr<RandomAccessDataset<TensorBuffer>> dataset(
+          new MmapOFRecordDataset(ctx, shard_id, shard_num, shuffle_after_epoch));
+      *shard_weight = dataset->Size();
+      loader.reset(new DistributedTrainingDataset<TensorBuffer>(
+          1, 0, false, shuffle_after_epoch, GetShardSeed(kOneflowDatasetSeed, shard_id),
+          std::move(dataset)));
+    } else {
+      *shard_weight = shard_num == 1 ? 1 : GetOFRecordPartByteSize(ctx, shard_id, shard_num);
+      loader.reset(new OFRecordDataset(ctx, shard_id, shard_num));
+    }
+    if (ctx->Attr<bool>("random_shuffle")) {
+      loader.reset(new RandomShuffleDataset<TensorBuffer>(ctx, shard_id, std::move(loader)));
+    }
+    loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
+    return loader;
+  }
 };
 
 }  // namespace data
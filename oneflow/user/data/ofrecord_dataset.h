@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_OFRECORD_DATASET_H_
 
 #include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/record_index.h"
 #include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/framework/op_kernel.h"
@@ -26,34 +27,83 @@ limitations under the License.
 namespace oneflow {
 namespace data {
 
+inline std::vector<std::string> GetOFRecordPartFilePaths(user_op::KernelInitContext* ctx) {
+  int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+  std::string data_dir = ctx->Attr<std::string>("data_dir");
+  std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+  int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+  std::vector<std::string> file_paths;
+  for (int i = 0; i < data_part_num; ++i) {
+    std::string num = std::to_string(i);
+    int32_t zero_count = std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
+    file_paths.push_back(JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
+  }
+  return file_paths;
+}
+
+// the part files [range.begin(), range.end()) this rank reads
+inline Range GetOFRecordPartRange(user_op::KernelInitContext* ctx) {
+  int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+  int64_t parallel_num = ctx->parallel_ctx().parallel_num();
+  CHECK_LE(parallel_num, data_part_num);
+  BalancedSplitter bs(data_part_num, parallel_num);
+  return bs.At(ctx->parallel_ctx().parallel_id());
+}
+
+// the part files of shard shard_id when the files of this rank are split over shard_num loaders
+inline Range GetOFRecordPartRange(user_op::KernelInitContext* ctx, int32_t shard_id,
+                                  int32_t shard_num) {
+  const Range rank_range = GetOFRecordPartRange(ctx);
+  CHECK_LE(shard_num, rank_range.size());
+  const Range shard_range = BalancedSplitter(rank_range.size(), shard_num).At(shard_id);
+  return Range(rank_range.begin() + shard_range.begin(), rank_range.begin() + shard_range.end());
+}
+
+// the byte size of the part files of a shard, which the record count is proportional to for
+// records of similar size
+inline int64_t GetOFRecordPartByteSize(user_op::KernelInitContext* ctx, int32_t shard_id,
+                                       int32_t shard_num) {
+  const std::vector<std::string> file_paths = GetOFRecordPartFilePaths(ctx);
+  const Range range = GetOFRecordPartRange(ctx, shard_id, shard_num);
+  int64_t byte_size = 0;
+  for (int64_t i = range.begin(); i < range.end(); ++i) {
+    byte_size += DataFS()->GetFileSize(file_paths.at(i));
+  }
+  return byte_size;
+}
+
+// an OFRecord is the record bytes behind their int64 size
+inline int64_t ReadOFRecordHead(const fs::RandomAccessFile& file, const std::string& file_path,
+                                int64_t offset, int64_t file_size, int64_t* byte_size) {
+  CHECK_LE(offset + static_cast<int64_t>(sizeof(int64_t)), file_size)
+      << file_path << ": truncated record size at offset " << offset;
+  file.Read(offset, sizeof(int64_t), reinterpret_cast<char*>(byte_size));
+  CHECK_GT(*byte_size, 0) << file_path << ": bad record size at offset " << offset;
+  return offset + sizeof(int64_t) + *byte_size;
+}
+
+// the index of all part files, every rank holds the same one
+inline std::shared_ptr<const RecordIndex> NewOFRecordIndex(user_op::KernelInitContext* ctx) {
+  return std::make_shared<const RecordIndex>(DataFS(), GetOFRecordPartFilePaths(ctx),
+                                             kOFRecordIndexFormat, &ReadOFRecordHead);
+}
+
 class OFRecordDataset final : public Dataset<TensorBuffer> {
  public:
   using LoadTargetPtr = std::shared_ptr<TensorBuffer>;
   using LoadTargetPtrList = std::vector<LoadTargetPtr>;
   OF_DISALLOW_COPY_AND_MOVE(OFRecordDataset);
-  OFRecordDataset(user_op::KernelInitContext* ctx) {
+  OFRecordDataset(user_op::KernelInitContext* ctx) : OFRecordDataset(ctx, 0, 1) {}
+  OFRecordDataset(user_op::KernelInitContext* ctx, int32_t shard_id, int32_t shard_num) {
     current_epoch_ = 0;
     shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
 
     // in stream
     data_part_num_ = ctx->Attr<int32_t>("data_part_num");
-    std::string data_dir = ctx->Attr<std::string>("data_dir");
-    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
-    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
-
-    for (int i = 0; i < data_part_num_; ++i) {
-      std::string num = std::to_string(i);
-      int32_t zero_count =
-          std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
-      data_file_paths_.push_back(
-          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
-    }
-
+    data_file_paths_ = GetOFRecordPartFilePaths(ctx);
     parallel_id_ = ctx->parallel_ctx().parallel_id();
     parallel_num_ = ctx->parallel_ctx().parallel_num();
-    CHECK_LE(parallel_num_, data_part_num_);
-    BalancedSplitter bs(data_part_num_, parallel_num_);
-    range_ = bs.At(parallel_id_);
+    range_ = GetOFRecordPartRange(ctx, shard_id, shard_num);
     std::vector<std::string> local_file_paths = GetLocalFilePaths();
     save_to_local_ = Global<const IOConf>::Get()->save_downloaded_file_to_local_fs();
     in_stream_.reset(
@@ -109,6 +159,33 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   std::unique_ptr<PersistentInStream> in_stream_;
 };
 
+// Any OFRecord of the part files by its position in a RecordIndex, read with one pread.
+class IndexedOFRecordDataset final : public RandomAccessDataset<TensorBuffer> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IndexedOFRecordDataset);
+  explicit IndexedOFRecordDataset(std::shared_ptr<const RecordIndex> index)
+      : index_(std::move(index)) {
+    CHECK_GT(index_->size(), 0) << "no OFRecord in the part files";
+  }
+  ~IndexedOFRecordDataset() = default;
+
+  LoadTargetShdPtrVec At(int64_t index) const override {
+    const RecordIndex::RecordPos& pos = index_->At(index);
+    LoadTargetShdPtr sample(new TensorBuffer());
+    sample->Resize(Shape({pos.byte_size}), DataType::kChar);
+    index_->file(pos.file_id)
+        .Read(pos.offset + sizeof(int64_t), pos.byte_size, sample->mut_data<char>());
+    LoadTargetShdPtrVec ret;
+    ret.push_back(std::move(sample));
+    return ret;
+  }
+
+  size_t Size() const override { return index_->size(); }
+
+ private:
+  std::shared_ptr<const RecordIndex> index_;
+};
+
 }  // namespace data
 }  // namespace oneflow
 
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CUSTOMIZED_DATA_ONEREC_DATA_READER_H_
 
 #include "oneflow/user/data/data_reader.h"
+#include "oneflow/user/data/distributed_training_dataset.h"
 #include "oneflow/user/data/onerec_dataset.h"
 #include "oneflow/user/data/onerec_parser.h"
 #include "oneflow/user/data/random_shuffle_dataset.h"
@@ -29,32 +30,61 @@ namespace data {
 
 class OneRecDataReader final : public DataReader<TensorBuffer> {
  public:
-  OneRecDataReader(user_op::KernelInitContext* ctx) : DataReader<TensorBuffer>(ctx) {
-    const int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
-    const auto random_shuffle = ctx->Attr<bool>("random_shuffle");
+  OneRecDataReader(user_op::KernelInitContext* ctx)
+      : DataReader<TensorBuffer>(ctx, ctx->Attr<int32_t>("batch_queue_depth")) {
+    int32_t shard_num = std::max(ctx->Attr<int32_t>("loader_thread_num"), 1);
+    std::shared_ptr<const RecordIndex> index;
+    if (ctx->Attr<bool>("random_shuffle") && ctx->Attr<std::string>("shuffle_mode") == "global") {
+      index = NewOneRecIndex(ctx);
+    } else {
+      // every loader thread owns at least one file
+      shard_num = std::min<int64_t>(shard_num, GetOneRecFileRange(ctx, 0, 1).size());
+    }
+    std::vector<std::unique_ptr<Dataset<TensorBuffer>>> shard_loaders;
+    std::vector<int64_t> shard_weights(shard_num);
+    FOR_RANGE(int32_t, shard_id, 0, shard_num) {
+      shard_loaders.push_back(NewShardLoader(ctx, shard_id, shard_num, index));
+      // the index is split evenly over all loaders
+      shard_weights.at(shard_id) =
+          (index || shard_num == 1) ? 1 : GetOneRecFileByteSize(ctx, shard_id, shard_num);
+    }
     parser_.reset(new OneRecParser());
-    if (random_shuffle) {
+    StartLoadThreads(std::move(shard_loaders), shard_weights, ctx->Attr<bool>("deterministic"));
+  }
+  ~OneRecDataReader() = default;
+
+ protected:
+  using DataReader<TensorBuffer>::loader_;
+  using DataReader<TensorBuffer>::parser_;
+
+ private:
+  static std::unique_ptr<Dataset<TensorBuffer>> NewShardLoader(
+      user_op::KernelInitContext* ctx, int32_t shard_id, int32_t shard_num,
+      const std::shared_ptr<const RecordIndex>& index) {
+    const int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
+    std::unique_ptr<Dataset<TensorBuffer>> loader;
+    if (ctx->Attr<bool>("random_shuffle")) {
       const auto mode = ctx->Attr<std::string>("shuffle_mode");
-      if (mode == "batch") {
-        loader_.reset(new OneRecDataset(ctx, batch_size));
-        loader_.reset(new BatchRandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
+      if (mode == "global") {
+        loader = NewGlobalShuffleLoader(
+            ctx, shard_id, shard_num,
+            std::make_unique<IndexedOneRecDataset>(index, ctx->Attr<bool>("verify_checksum")));
+        loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
+      } else if (mode == "batch") {
+        loader.reset(new OneRecDataset(ctx, batch_size, shard_id, shard_num));
+        loader.reset(new BatchRandomShuffleDataset<TensorBuffer>(ctx, shard_id, std::move(loader)));
       } else if (mode == "instance") {
-        loader_.reset(new OneRecDataset(ctx, 1));
-        loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
-        loader_.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader_)));
+        loader.reset(new OneRecDataset(ctx, 1, shard_id, shard_num));
+        loader.reset(new RandomShuffleDataset<TensorBuffer>(ctx, shard_id, std::move(loader)));
+        loader.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader)));
       } else {
         UNIMPLEMENTED();
       }
     } else {
-      loader_.reset(new OneRecDataset(ctx, batch_size));
+      loader.reset(new OneRecDataset(ctx, batch_size, shard_id, shard_num));
     }
-    StartLoadThread();
+    return loader;
   }
-  ~OneRecDataReader() = default;
-
- protected:
-  using DataReader<TensorBuffer>::loader_;
-  using DataReader<TensorBuffer>::parser_;
 };
 
 }  // namespace data
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/record_index.h"
 #include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/framework/op_kernel.h"
@@ -43,12 +44,7 @@ constexpr int32_t kHeaderSizeWithoutDigest =
     kMagicFieldSize + kReservedFieldSize + kPayloadSizeFieldSize;
 constexpr int32_t kHeaderSize = kHeaderSizeWithoutDigest + kDigestFieldSize;
 
-inline XXH64_hash_t ByteSwap(XXH64_hash_t x) {
-  return ((x & 0xff00000000000000ull) >> 56u) | ((x & 0x00ff000000000000ull) >> 40u)
-         | ((x & 0x0000ff0000000000ull) >> 24u) | ((x & 0x000000ff00000000ull) >> 8u)
-         | ((x & 0x00000000ff000000ull) << 8u) | ((x & 0x0000000000ff0000ull) << 24u)
-         | ((x & 0x000000000000ff00ull) << 40u) | ((x & 0x00000000000000ffull) << 56u);
-}
+inline XXH64_hash_t ByteSwap(XXH64_hash_t x) { return __builtin_bswap64(x); }
 
 struct OneRecFrameHeader {
   int64_t magic;
@@ -71,71 +67,162 @@ union OneRecFrameFooterView {
 
 namespace data {
 
+inline int64_t GetOneRecFrameSize(int64_t payload_size) {
+  return kHeaderSize + RoundUp(payload_size, kPayloadAlignmentSize) + kDigestFieldSize;
+}
+
+// a payload read into memory and the digest stored in its frame footer
+struct OneRecFramePayload {
+  const char* body;
+  int64_t size;
+  XXH64_hash_t digest;
+};
+
+// Checks the payload digests of frame_num frames in one pass. One-shot XXH64 calls need no hash
+// state, and the loop runs over data that is already in memory instead of between reads.
+inline void CheckOneRecFramePayloads(const OneRecFramePayload* frames, int64_t frame_num) {
+  FOR_RANGE(int64_t, i, 0, frame_num) {
+    const OneRecFramePayload& frame = frames[i];
+    CHECK_EQ(ByteSwap(frame.digest), XXH64(frame.body, frame.size, 0))
+        << "bad payload digest of frame " << i << " of " << frame_num;
+  }
+}
+
+// Reads up to sample_num frames from in_stream into samples and returns how many it read, which
+// is fewer than sample_num only at the end of the stream. Each frame takes one read for the
+// header and one for payload, padding and footer, the last two landing in the slack of the
+// sample buffer. Without verify_checksum only the structure of the frames is checked, which is
+// meant for trusted local data.
+inline int64_t ReadOneRecFrames(PersistentInStream* in_stream, bool verify_checksum,
+                                TensorBuffer* const* samples, int64_t sample_num,
+                                std::vector<OneRecFramePayload>* payloads) {
+  static_assert(sizeof(OneRecFrameHeader) == kHeaderSize, "");
+  static_assert(sizeof(OneRecFrameFooterView) == kDigestFieldSize, "");
+  payloads->clear();
+  int64_t read_num = 0;
+  for (; read_num < sample_num; ++read_num) {
+    OneRecFrameHeaderView header_view{};
+    if (in_stream->ReadFully(header_view.raw, kHeaderSize) != 0) { break; }
+    CHECK_EQ(header_view.header.magic, kMagicNumber);
+    CHECK_EQ(header_view.header.reserved, kReservedNumber);
+    // the header digest is checked before its payload size is trusted for an allocation
+    if (verify_checksum) {
+      CHECK_EQ(ByteSwap(header_view.header.digest),
+               XXH64(header_view.raw, kHeaderSizeWithoutDigest, 0));
+    }
+    const int64_t payload_size = header_view.header.payload_size;
+    CHECK_GE(payload_size, 0);
+    CHECK_LE(payload_size, kMaxPayloadSize);
+    const int64_t padded_size = RoundUp(payload_size, kPayloadAlignmentSize);
+    TensorBuffer* sample = samples[read_num];
+    sample->Resize(Shape({payload_size}), DataType::kChar);
+    sample->reserve(padded_size + kDigestFieldSize);
+    char* body = sample->mut_data<char>();
+    CHECK_EQ(in_stream->ReadFully(body, padded_size + kDigestFieldSize), 0);
+    if (verify_checksum) {
+      OneRecFrameFooterView footer_view{};
+      std::memcpy(footer_view.raw, body + padded_size, kDigestFieldSize);
+      payloads->push_back(OneRecFramePayload{body, payload_size, footer_view.digest});
+    }
+  }
+  if (verify_checksum) { CheckOneRecFramePayloads(payloads->data(), payloads->size()); }
+  return read_num;
+}
+
+// checks the frame header at offset, whose digest covers the header itself
+inline int64_t ReadOneRecFrameHead(const fs::RandomAccessFile& file, const std::string& file_path,
+                                   int64_t offset, int64_t file_size, int64_t* byte_size) {
+  CHECK_LE(offset + kHeaderSize, file_size)
+      << file_path << ": truncated frame header at offset " << offset;
+  OneRecFrameHeaderView header_view{};
+  file.Read(offset, kHeaderSize, header_view.raw);
+  CHECK_EQ(header_view.header.magic, kMagicNumber) << file_path << ": offset " << offset;
+  CHECK_EQ(header_view.header.reserved, kReservedNumber) << file_path << ": offset " << offset;
+  CHECK_EQ(ByteSwap(header_view.header.digest), XXH64(header_view.raw, kHeaderSizeWithoutDigest, 0))
+      << file_path << ": bad frame header digest at offset " << offset;
+  *byte_size = header_view.header.payload_size;
+  CHECK_GE(*byte_size, 0);
+  CHECK_LE(*byte_size, kMaxPayloadSize);
+  return offset + GetOneRecFrameSize(*byte_size);
+}
+
+// the index of all files, every rank holds the same one
+inline std::shared_ptr<const RecordIndex> NewOneRecIndex(user_op::KernelInitContext* ctx) {
+  return std::make_shared<const RecordIndex>(
+      DataFS(), ctx->Attr<std::vector<std::string>>("files"), kOneRecIndexFormat,
+      &ReadOneRecFrameHead);
+}
+
+// the files of shard shard_id when the files of this rank are split over shard_num loaders
+inline Range GetOneRecFileRange(user_op::KernelInitContext* ctx, int32_t shard_id,
+                                int32_t shard_num) {
+  const int64_t file_num = ctx->Attr<std::vector<std::string>>("files").size();
+  const BalancedSplitter bs(file_num, ctx->parallel_ctx().parallel_num());
+  const Range rank_range = bs.At(ctx->parallel_ctx().parallel_id());
+  CHECK_LE(shard_num, rank_range.size());
+  const Range shard_range = BalancedSplitter(rank_range.size(), shard_num).At(shard_id);
+  return Range(rank_range.begin() + shard_range.begin(), rank_range.begin() + shard_range.end());
+}
+
+// the byte size of the files of a shard, which the frame count is proportional to for frames of
+// similar size
+inline int64_t GetOneRecFileByteSize(user_op::KernelInitContext* ctx, int32_t shard_id,
+                                     int32_t shard_num) {
+  const std::vector<std::string>& file_paths = ctx->Attr<std::vector<std::string>>("files");
+  const Range range = GetOneRecFileRange(ctx, shard_id, shard_num);
+  int64_t byte_size = 0;
+  for (int64_t i = range.begin(); i < range.end(); ++i) {
+    byte_size += DataFS()->GetFileSize(file_paths.at(i));
+  }
+  return byte_size;
+}
+
 class OneRecDataset final : public Dataset<TensorBuffer> {
  public:
   using LoadTargetPtr = std::shared_ptr<TensorBuffer>;
   using LoadTargetPtrList = std::vector<LoadTargetPtr>;
   OF_DISALLOW_COPY_AND_MOVE(OneRecDataset);
-  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size) : batch_size_(batch_size) {
+  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size)
+      : OneRecDataset(ctx, batch_size, 0, 1) {}
+  // reads shard shard_id of the files of this rank split over shard_num loaders
+  OneRecDataset(user_op::KernelInitContext* ctx, int32_t batch_size, int32_t shard_id,
+                int32_t shard_num)
+      : batch_size_(batch_size) {
     current_epoch_ = 0;
+    verify_checksum_ = ctx->Attr<bool>("verify_checksum");
     shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
     data_file_paths_ = ctx->Attr<std::vector<std::string>>("files");
     parallel_id_ = ctx->parallel_ctx().parallel_id();
     parallel_num_ = ctx->parallel_ctx().parallel_num();
-    BalancedSplitter bs(data_file_paths_.size(), parallel_num_);
-    range_ = bs.At(parallel_id_);
+    range_ = GetOneRecFileRange(ctx, shard_id, shard_num);
     ResetInstream();
-    hash_state_ = LZ4_XXH64_createState();
+    samples_.resize(batch_size_);
   }
 
-  ~OneRecDataset() { CHECK_NE(LZ4_XXH64_freeState(hash_state_), XXH_ERROR); }
+  ~OneRecDataset() = default;
 
   LoadTargetPtrList Next() override {
     LoadTargetPtrList ret;
     ret.resize(batch_size_);
     for (int32_t i = 0; i < batch_size_; ++i) {
       ret.at(i).reset(new TensorBuffer());
-      ReadSample(*ret.at(i).get());
+      samples_.at(i) = ret.at(i).get();
     }
-    return ret;
-  }
-
- private:
-  void ReadSample(TensorBuffer& tensor) {
-    static_assert(sizeof(OneRecFrameHeader) == kHeaderSize, "");
-    OneRecFrameHeaderView header_view{};
-    static_assert(sizeof(header_view.header) == kHeaderSize, "");
-    int32_t read_status = in_stream_->ReadFully(header_view.raw, kHeaderSize);
-    if (read_status == -1) {
+    int64_t read_num = ReadOneRecFrames(in_stream_.get(), verify_checksum_, samples_.data(),
+                                        batch_size_, &payloads_);
+    while (read_num < batch_size_) {
       ResetInstream();
       current_epoch_++;
-      CHECK_EQ(in_stream_->ReadFully(header_view.raw, kHeaderSize), 0);
-    } else {
-      CHECK_EQ(read_status, 0);
+      const int64_t epoch_read_num =
+          ReadOneRecFrames(in_stream_.get(), verify_checksum_, samples_.data() + read_num,
+                           batch_size_ - read_num, &payloads_);
+      CHECK_GT(epoch_read_num, 0) << "no OneRec frame in the files";
+      read_num += epoch_read_num;
     }
-    CHECK_EQ(header_view.header.magic, kMagicNumber);
-    CHECK_EQ(header_view.header.reserved, kReservedNumber);
-    const int32_t payload_size = header_view.header.payload_size;
-    CHECK_GE(payload_size, 0);
-    CHECK_LE(payload_size, kMaxPayloadSize);
-    XXH64_hash_t const seed = 0;
-    CHECK_NE(LZ4_XXH64_reset(hash_state_, seed), XXH_ERROR);
-    CHECK_NE(XXH64_update(hash_state_, header_view.raw, kHeaderSizeWithoutDigest), XXH_ERROR);
-    CHECK_EQ(ByteSwap(header_view.header.digest), LZ4_XXH64_digest(hash_state_));
-    const int32_t padded_size = RoundUp(payload_size, kPayloadAlignmentSize) - payload_size;
-    tensor.Resize(Shape({payload_size}), DataType::kChar);
-    char* body = tensor.mut_data<char>();
-    CHECK_EQ(in_stream_->ReadFully(body, payload_size), 0);
-    char padded[kPayloadAlignmentSize];
-    CHECK_EQ(in_stream_->ReadFully(padded, padded_size), 0);  // read padded
-    static_assert(sizeof(OneRecFrameFooterView) == kDigestFieldSize, "");
-    OneRecFrameFooterView footer_view{};
-    CHECK_EQ(in_stream_->ReadFully(footer_view.raw, kDigestFieldSize), 0);  // read footer
-    CHECK_NE(XXH64_reset(hash_state_, seed), XXH_ERROR);
-    CHECK_NE(LZ4_XXH64_update(hash_state_, body, payload_size), XXH_ERROR);
-    CHECK_EQ(ByteSwap(footer_view.digest), LZ4_XXH64_digest(hash_state_));
+    return ret;
   }
 
+ private:
   void ResetInstream() {
     if (shuffle_after_epoch_) {
       std::mt19937 g(kOneflowDatasetSeed + current_epoch_);
@@ -153,16 +240,57 @@ class OneRecDataset final : public Dataset<TensorBuffer> {
 
   int32_t current_epoch_;
   bool shuffle_after_epoch_;
+  bool verify_checksum_;
 
   int32_t parallel_id_;
   int32_t parallel_num_;
   Range range_;
   std::vector<std::string> data_file_paths_;
   std::unique_ptr<PersistentInStream> in_stream_;
-  XXH64_state_t* hash_state_;
+  std::vector<TensorBuffer*> samples_;
+  std::vector<OneRecFramePayload> payloads_;
   int32_t batch_size_;
 };
 
+// Any frame of the files by its position in a RecordIndex. The payload is read straight into
+// the sample together with padding and footer, and checked against the footer digest unless
+// verify_checksum is off.
+class IndexedOneRecDataset final : public RandomAccessDataset<TensorBuffer> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IndexedOneRecDataset);
+  IndexedOneRecDataset(std::shared_ptr<const RecordIndex> index, bool verify_checksum)
+      : index_(std::move(index)), verify_checksum_(verify_checksum) {
+    CHECK_GT(index_->size(), 0) << "no OneRec frame in the files";
+  }
+  ~IndexedOneRecDataset() = default;
+
+  LoadTargetShdPtrVec At(int64_t index) const override {
+    const RecordIndex::RecordPos& pos = index_->At(index);
+    const fs::RandomAccessFile& file = index_->file(pos.file_id);
+    LoadTargetShdPtr sample(new TensorBuffer());
+    const int64_t padded_size = RoundUp(pos.byte_size, kPayloadAlignmentSize);
+    sample->Resize(Shape({pos.byte_size}), DataType::kChar);
+    sample->reserve(padded_size + kDigestFieldSize);
+    char* body = sample->mut_data<char>();
+    file.Read(pos.offset + kHeaderSize, padded_size + kDigestFieldSize, body);
+    if (verify_checksum_) {
+      OneRecFrameFooterView footer_view{};
+      std::memcpy(footer_view.raw, body + padded_size, kDigestFieldSize);
+      CHECK_EQ(ByteSwap(footer_view.digest), XXH64(body, pos.byte_size, 0))
+          << index_->file_path(pos.file_id) << ": bad payload digest at offset " << pos.offset;
+    }
+    LoadTargetShdPtrVec ret;
+    ret.push_back(std::move(sample));
+    return ret;
+  }
+
+  size_t Size() const override { return index_->size(); }
+
+ private:
+  std::shared_ptr<const RecordIndex> index_;
+  bool verify_checksum_;
+};
+
 }  // namespace data
 }  // namespace oneflow
 
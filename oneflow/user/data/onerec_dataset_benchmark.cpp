@@ -0,0 +1,109 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/onerec_dataset_test_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+// the per sample path OneRecDataset took before frames were read in batches, with a hash state
+// that is reset for every header and payload
+int64_t ReadFramesOneByOne(PersistentInStream* in_stream, XXH64_state_t* hash_state) {
+  int64_t frame_num = 0;
+  TensorBuffer tensor;
+  OneRecFrameHeaderView header_view{};
+  while (in_stream->ReadFully(header_view.raw, kHeaderSize) == 0) {
+    CHECK_EQ(header_view.header.magic, kMagicNumber);
+    CHECK_EQ(header_view.header.reserved, kReservedNumber);
+    const int32_t payload_size = header_view.header.payload_size;
+    CHECK_NE(LZ4_XXH64_reset(hash_state, 0), XXH_ERROR);
+    CHECK_NE(LZ4_XXH64_update(hash_state, header_view.raw, kHeaderSizeWithoutDigest), XXH_ERROR);
+    CHECK_EQ(ByteSwap(header_view.header.digest), LZ4_XXH64_digest(hash_state));
+    tensor.Resize(Shape({payload_size}), DataType::kChar);
+    char* body = tensor.mut_data<char>();
+    CHECK_EQ(in_stream->ReadFully(body, payload_size), 0);
+    char padded[kPayloadAlignmentSize];
+    CHECK_EQ(in_stream->ReadFully(padded, RoundUp(payload_size, kPayloadAlignmentSize)
+                                              - payload_size),
+             0);
+    OneRecFrameFooterView footer_view{};
+    CHECK_EQ(in_stream->ReadFully(footer_view.raw, kDigestFieldSize), 0);
+    CHECK_NE(LZ4_XXH64_reset(hash_state, 0), XXH_ERROR);
+    CHECK_NE(LZ4_XXH64_update(hash_state, body, payload_size), XXH_ERROR);
+    CHECK_EQ(ByteSwap(footer_view.digest), LZ4_XXH64_digest(hash_state));
+    frame_num += 1;
+  }
+  return frame_num;
+}
+
+int64_t ReadFramesInBatches(PersistentInStream* in_stream, bool verify_checksum,
+                            int64_t batch_size) {
+  std::vector<TensorBuffer> tensors(batch_size);
+  std::vector<TensorBuffer*> samples(batch_size);
+  FOR_RANGE(int64_t, i, 0, batch_size) { samples.at(i) = &tensors.at(i); }
+  std::vector<OneRecFramePayload> payloads;
+  int64_t frame_num = 0;
+  while (true) {
+    const int64_t read_num =
+        ReadOneRecFrames(in_stream, verify_checksum, samples.data(), batch_size, &payloads);
+    frame_num += read_num;
+    if (read_num < batch_size) { break; }
+  }
+  return frame_num;
+}
+
+}  // namespace
+
+// Set ONEFLOW_TEST_ONEREC_BENCHMARK_FRAME_NUM to read more frames, the default keeps the test
+// short.
+TEST(OneRecDataset, read_frames_benchmark) {
+  ResetIOConf();
+  const char* frame_num_env = std::getenv("ONEFLOW_TEST_ONEREC_BENCHMARK_FRAME_NUM");
+  const int64_t frame_num = frame_num_env == nullptr ? 200000 : std::stoll(frame_num_env);
+  fs::PosixFileSystem file_system;
+  for (int64_t max_payload_byte : {int64_t(256), int64_t(4096)}) {
+    const std::string file_path = WriteOneRecFile(&file_system, "tmp_onerec_frames_benchmark",
+                                                  MakePayloads(frame_num, max_payload_byte));
+    auto Measure = [&](const std::string& name, const std::function<int64_t()>& Read) {
+      auto start = std::chrono::steady_clock::now();
+      CHECK_EQ(Read(), frame_num);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      LOG(INFO) << name << ", payload up to " << max_payload_byte
+                << " B: " << frame_num / elapsed.count() << " records/s";
+    };
+    auto NewInStream = [&]() {
+      return std::make_unique<PersistentInStream>(
+          &file_system, std::vector<std::string>{file_path}, false, false);
+    };
+    XXH64_state_t* hash_state = LZ4_XXH64_createState();
+    Measure("one by one", [&]() { return ReadFramesOneByOne(NewInStream().get(), hash_state); });
+    CHECK_NE(LZ4_XXH64_freeState(hash_state), XXH_ERROR);
+    Measure("batch of 64", [&]() { return ReadFramesInBatches(NewInStream().get(), true, 64); });
+    Measure("batch of 64 without checksum",
+            [&]() { return ReadFramesInBatches(NewInStream().get(), false, 64); });
+    file_system.DelFile(file_path);
+  }
+  Global<const IOConf>::Delete();
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
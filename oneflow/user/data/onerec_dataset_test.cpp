@@ -0,0 +1,57 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/onerec_dataset_test_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+namespace data {
+
+TEST(OneRecDataset, read_frames_in_batches) {
+  ResetIOConf();
+  fs::PosixFileSystem file_system;
+  const std::vector<std::string> payloads = MakePayloads(1000, 300);
+  const std::string file_path = WriteOneRecFile(&file_system, "tmp_onerec_frames", payloads);
+  for (bool verify_checksum : {true, false}) {
+    PersistentInStream in_stream(&file_system, std::vector<std::string>{file_path}, false, false);
+    // a batch size that does not divide the frame number
+    std::vector<TensorBuffer> tensors(64);
+    std::vector<TensorBuffer*> samples;
+    for (TensorBuffer& tensor : tensors) { samples.push_back(&tensor); }
+    std::vector<OneRecFramePayload> frames;
+    size_t frame_id = 0;
+    while (true) {
+      const int64_t read_num =
+          ReadOneRecFrames(&in_stream, verify_checksum, samples.data(), samples.size(), &frames);
+      ASSERT_EQ(static_cast<int64_t>(frames.size()), verify_checksum ? read_num : 0);
+      FOR_RANGE(int64_t, i, 0, read_num) {
+        const TensorBuffer& tensor = tensors.at(i);
+        ASSERT_EQ(std::string(tensor.data<char>(), tensor.elem_cnt()), payloads.at(frame_id));
+        frame_id += 1;
+      }
+      if (read_num < static_cast<int64_t>(samples.size())) { break; }
+    }
+    ASSERT_EQ(frame_id, payloads.size());
+  }
+  file_system.DelFile(file_path);
+  Global<const IOConf>::Delete();
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
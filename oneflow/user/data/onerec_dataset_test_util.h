@@ -0,0 +1,78 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_ONEREC_DATASET_TEST_UTIL_H_
+#define ONEFLOW_USER_DATA_ONEREC_DATASET_TEST_UTIL_H_
+
+#include "oneflow/user/data/onerec_dataset.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+
+namespace oneflow {
+namespace data {
+
+// helpers shared by the onerec_dataset test and benchmark
+
+inline std::string MakeOneRecFrame(const std::string& payload) {
+  OneRecFrameHeaderView header_view{};
+  header_view.header.magic = kMagicNumber;
+  header_view.header.reserved = kReservedNumber;
+  header_view.header.payload_size = payload.size();
+  header_view.header.digest = ByteSwap(XXH64(header_view.raw, kHeaderSizeWithoutDigest, 0));
+  OneRecFrameFooterView footer_view{};
+  footer_view.digest = ByteSwap(XXH64(payload.data(), payload.size(), 0));
+  std::string frame(header_view.raw, kHeaderSize);
+  frame += payload;
+  frame.resize(kHeaderSize + RoundUp(payload.size(), kPayloadAlignmentSize), '\0');
+  frame.append(footer_view.raw, kDigestFieldSize);
+  CHECK_EQ(static_cast<int64_t>(frame.size()), GetOneRecFrameSize(payload.size()));
+  return frame;
+}
+
+// payload sizes vary so that frames end at every padding
+inline std::vector<std::string> MakePayloads(int64_t payload_num, int64_t max_payload_byte) {
+  std::mt19937 gen(0);
+  std::vector<std::string> payloads(payload_num);
+  for (std::string& payload : payloads) {
+    payload.resize(1 + gen() % max_payload_byte);
+    for (char& c : payload) { c = static_cast<char>(gen()); }
+  }
+  return payloads;
+}
+
+inline std::string WriteOneRecFile(fs::FileSystem* file_system, const std::string& name,
+                                   const std::vector<std::string>& payloads) {
+  std::string dir = GetCwd();
+  StringReplace(&dir, '\\', '/');
+  const std::string file_path = JoinPath(dir, name);
+  std::unique_ptr<fs::WritableFile> file;
+  file_system->NewWritableFile(file_path, &file);
+  for (const std::string& payload : payloads) {
+    const std::string frame = MakeOneRecFrame(payload);
+    file->Append(frame.data(), frame.size());
+  }
+  file->Close();
+  return file_path;
+}
+
+inline void ResetIOConf() {
+  if (Global<const IOConf>::Get() != nullptr) { Global<const IOConf>::Delete(); }
+  Global<const IOConf>::New(IOConf());
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_ONEREC_DATASET_TEST_UTIL_H_
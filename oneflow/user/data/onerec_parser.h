@@ -36,7 +36,7 @@ class OneRecParser final : public Parser<TensorBuffer> {
              user_op::KernelComputeContext* ctx) override {
     user_op::Tensor* out_tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
     const bool verify_example = ctx->Attr<bool>("verify_example");
-    FOR_RANGE(int32_t, i, 0, batch_data->size()) {
+    MultiThreadLoop(batch_data->size(), [&](size_t i) {
       TensorBuffer* tensor = batch_data->at(i).get();
       if (verify_example) {
         flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(tensor->data()),
@@ -45,7 +45,7 @@ class OneRecParser final : public Parser<TensorBuffer> {
       }
       TensorBuffer* out = out_tensor->mut_dptr<TensorBuffer>() + i;
       out->Swap(tensor);
-    }
+    });
   }
 };
 
@@ -30,10 +30,14 @@ class RandomShuffleDataset final : public Dataset<LoadTarget> {
   using LoadTargetPtrList = std::vector<LoadTargetPtr>;
   RandomShuffleDataset(user_op::KernelInitContext* ctx,
                        std::unique_ptr<Dataset<LoadTarget>>&& data_set)
+      : RandomShuffleDataset(ctx, 0, std::move(data_set)) {}
+  // loader shard shard_id of the op shuffles with a seed of its own
+  RandomShuffleDataset(user_op::KernelInitContext* ctx, int32_t shard_id,
+                       std::unique_ptr<Dataset<LoadTarget>>&& data_set)
       : loader_(std::move(data_set)) {
     // random
     seed_ = ctx->Attr<int64_t>("seed");
-    if (seed_ == -1) { seed_ = NewRandomSeed(); }
+    seed_ = seed_ == -1 ? NewRandomSeed() : GetShardSeed(seed_, shard_id);
     std::seed_seq seq({seed_});
     rand_engine_ = std::default_random_engine(seq);
 
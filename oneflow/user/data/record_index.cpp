@@ -0,0 +1,175 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/record_index.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/job/job_set.pb.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define XXH_NAMESPACE LZ4_
+#include <xxhash.h>
+
+namespace oneflow {
+namespace data {
+
+// of the indexed file, a sidecar of a file that changed since is rebuilt
+struct RecordIndexFileStamp {
+  int64_t byte_size;
+  // 0 on file systems other than the local ones
+  int64_t mtime_ns;
+  uint64_t head_hash;
+};
+
+namespace {
+
+constexpr int64_t kRecordIndexMagic = 0x5845444E49434552;  // 'RECINDEX', little endian
+constexpr int32_t kRecordIndexVersion = 2;
+// bytes at the start of the indexed file that the sidecar keeps a hash of
+constexpr int64_t kRecordIndexHashedHeadByte = 64 << 10;
+
+struct RecordIndexSidecarHead {
+  int64_t magic;
+  int32_t version;
+  int32_t format;
+  RecordIndexFileStamp data_file_stamp;
+  int64_t record_num;
+};
+
+struct RecordIndexSidecarEntry {
+  int64_t offset;
+  int64_t byte_size;
+};
+
+bool IsLocalDataFS() {
+  const FileSystemConf& data_fs_conf = Global<const IOConf>::Get()->data_fs_conf();
+  return data_fs_conf.has_localfs_conf() || data_fs_conf.has_networkfs_conf();
+}
+
+// sidecars are only written next to files on a local or mounted file system we may write to
+bool IsSidecarWritable(const std::string& file_path) {
+  return IsLocalDataFS() && access(Dirname(file_path).c_str(), W_OK) == 0;
+}
+
+// a file rewritten with its old size within the mtime granularity still differs in its head
+RecordIndexFileStamp GetFileStamp(const fs::RandomAccessFile& file, const std::string& file_path,
+                                  int64_t file_size) {
+  RecordIndexFileStamp stamp{};
+  stamp.byte_size = file_size;
+  struct stat file_stat {};
+  if (IsLocalDataFS() && stat(file_path.c_str(), &file_stat) == 0) {
+    stamp.mtime_ns = file_stat.st_mtim.tv_sec * 1000000000LL + file_stat.st_mtim.tv_nsec;
+  }
+  std::vector<char> head(std::min(file_size, kRecordIndexHashedHeadByte));
+  if (!head.empty()) { file.Read(0, head.size(), head.data()); }
+  stamp.head_hash = XXH64(head.data(), head.size(), 0);
+  return stamp;
+}
+
+bool operator==(const RecordIndexFileStamp& lhs, const RecordIndexFileStamp& rhs) {
+  return lhs.byte_size == rhs.byte_size && lhs.mtime_ns == rhs.mtime_ns
+         && lhs.head_hash == rhs.head_hash;
+}
+
+}  // namespace
+
+RecordIndex::RecordIndex(fs::FileSystem* fs, const std::vector<std::string>& file_paths,
+                         RecordIndexFormat format, const ReadRecordHeadFn& ReadRecordHead)
+    : fs_(fs), format_(format), file_paths_(file_paths) {
+  FOR_RANGE(int32_t, file_id, 0, file_paths_.size()) {
+    files_.emplace_back();
+    fs_->NewRandomAccessFile(file_paths_.at(file_id), &files_.back());
+    const int64_t file_size = fs_->GetFileSize(file_paths_.at(file_id));
+    const RecordIndexFileStamp stamp =
+        GetFileStamp(*files_.back(), file_paths_.at(file_id), file_size);
+    if (TryLoadSidecar(file_id, stamp)) { continue; }
+    const size_t record_begin = records_.size();
+    BuildFileIndex(file_id, file_size, ReadRecordHead);
+    TrySaveSidecar(file_id, stamp, record_begin);
+  }
+}
+
+bool RecordIndex::TryLoadSidecar(int32_t file_id, const RecordIndexFileStamp& stamp) {
+  const std::string sidecar_path = SidecarPath(file_paths_.at(file_id));
+  if (!fs_->FileExists(sidecar_path)) { return false; }
+  const int64_t sidecar_size = fs_->GetFileSize(sidecar_path);
+  if (sidecar_size < static_cast<int64_t>(sizeof(RecordIndexSidecarHead))) { return false; }
+  std::unique_ptr<fs::RandomAccessFile> sidecar;
+  fs_->NewRandomAccessFile(sidecar_path, &sidecar);
+  RecordIndexSidecarHead head{};
+  sidecar->Read(0, sizeof(head), reinterpret_cast<char*>(&head));
+  const int64_t entry_byte = sizeof(RecordIndexSidecarEntry);
+  if (head.magic != kRecordIndexMagic || head.version != kRecordIndexVersion
+      || head.format != format_ || !(head.data_file_stamp == stamp) || head.record_num < 0
+      || sidecar_size != static_cast<int64_t>(sizeof(head)) + head.record_num * entry_byte) {
+    LOG(WARNING) << sidecar_path << " is stale, rebuilding the index";
+    return false;
+  }
+  std::vector<RecordIndexSidecarEntry> entries(head.record_num);
+  sidecar->Read(sizeof(head), entries.size() * sizeof(RecordIndexSidecarEntry),
+                reinterpret_cast<char*>(entries.data()));
+  for (const RecordIndexSidecarEntry& entry : entries) {
+    CHECK(entry.offset >= 0 && entry.byte_size >= 0
+          && entry.offset + entry.byte_size <= stamp.byte_size)
+        << sidecar_path << ": record out of the bounds of the indexed file";
+    records_.push_back(RecordPos{file_id, entry.offset, entry.byte_size});
+  }
+  return true;
+}
+
+void RecordIndex::BuildFileIndex(int32_t file_id, int64_t file_size,
+                                 const ReadRecordHeadFn& ReadRecordHead) {
+  const fs::RandomAccessFile& data_file = *files_.at(file_id);
+  const std::string& file_path = file_paths_.at(file_id);
+  int64_t offset = 0;
+  while (offset < file_size) {
+    int64_t byte_size = -1;
+    const int64_t next_offset = ReadRecordHead(data_file, file_path, offset, file_size, &byte_size);
+    CHECK_GT(next_offset, offset);
+    CHECK_LE(next_offset, file_size) << file_path << ": truncated record at offset " << offset;
+    records_.push_back(RecordPos{file_id, offset, byte_size});
+    offset = next_offset;
+  }
+}
+
+void RecordIndex::TrySaveSidecar(int32_t file_id, const RecordIndexFileStamp& stamp,
+                                 size_t record_begin) {
+  const std::string& file_path = file_paths_.at(file_id);
+  if (!IsSidecarWritable(file_path)) { return; }
+  RecordIndexSidecarHead head{};
+  head.magic = kRecordIndexMagic;
+  head.version = kRecordIndexVersion;
+  head.format = format_;
+  head.data_file_stamp = stamp;
+  head.record_num = records_.size() - record_begin;
+  std::vector<RecordIndexSidecarEntry> entries;
+  entries.reserve(head.record_num);
+  FOR_RANGE(size_t, i, record_begin, records_.size()) {
+    entries.push_back(RecordIndexSidecarEntry{records_.at(i).offset, records_.at(i).byte_size});
+  }
+  // ranks and processes indexing the same file race for the sidecar, the rename is atomic
+  const std::string sidecar_path = SidecarPath(file_path);
+  const std::string tmp_path = sidecar_path + ".tmp" + std::to_string(NewRandomSeed());
+  std::unique_ptr<fs::WritableFile> sidecar;
+  fs_->NewWritableFile(tmp_path, &sidecar);
+  sidecar->Append(reinterpret_cast<const char*>(&head), sizeof(head));
+  sidecar->Append(reinterpret_cast<const char*>(entries.data()),
+                  entries.size() * sizeof(RecordIndexSidecarEntry));
+  sidecar->Close();
+  fs_->RenameFile(tmp_path, sidecar_path);
+}
+
+}  // namespace data
+}  // namespace oneflow
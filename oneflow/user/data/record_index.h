@@ -0,0 +1,80 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_RECORD_INDEX_H_
+#define ONEFLOW_USER_DATA_RECORD_INDEX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+namespace data {
+
+struct RecordIndexFileStamp;
+
+enum RecordIndexFormat : int32_t {
+  kOFRecordIndexFormat = 1,
+  kOneRecIndexFormat = 2,
+};
+
+// Reads the head of the record starting at offset, sets the byte size of its payload and
+// returns the offset the next record starts at.
+using ReadRecordHeadFn =
+    std::function<int64_t(const fs::RandomAccessFile& file, const std::string& file_path,
+                          int64_t offset, int64_t file_size, int64_t* byte_size)>;
+
+// Positions of every record of a list of files, so records can be read in any order while only
+// the index is held in memory. The index of a file is built by walking its record heads once and
+// kept in a sidecar "<file>.index" next to it, which later runs load instead. The sidecar is
+// only used while the size, mtime and a hash of the head of the file match.
+class RecordIndex final {
+ public:
+  struct RecordPos {
+    int32_t file_id;
+    // of the record head
+    int64_t offset;
+    // of the payload
+    int64_t byte_size;
+  };
+
+  OF_DISALLOW_COPY_AND_MOVE(RecordIndex);
+  RecordIndex(fs::FileSystem* fs, const std::vector<std::string>& file_paths,
+              RecordIndexFormat format, const ReadRecordHeadFn& ReadRecordHead);
+  ~RecordIndex() = default;
+
+  size_t size() const { return records_.size(); }
+  const RecordPos& At(int64_t index) const { return records_.at(index); }
+  // thread safe, every reader of the index shares the open files
+  const fs::RandomAccessFile& file(int32_t file_id) const { return *files_.at(file_id); }
+  const std::string& file_path(int32_t file_id) const { return file_paths_.at(file_id); }
+
+  static std::string SidecarPath(const std::string& file_path) { return file_path + ".index"; }
+
+ private:
+  bool TryLoadSidecar(int32_t file_id, const RecordIndexFileStamp& stamp);
+  void BuildFileIndex(int32_t file_id, int64_t file_size, const ReadRecordHeadFn& ReadRecordHead);
+  void TrySaveSidecar(int32_t file_id, const RecordIndexFileStamp& stamp, size_t record_begin);
+
+  fs::FileSystem* fs_;
+  RecordIndexFormat format_;
+  std::vector<std::string> file_paths_;
+  std::vector<std::unique_ptr<fs::RandomAccessFile>> files_;
+  std::vector<RecordPos> records_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_RECORD_INDEX_H_
@@ -0,0 +1,91 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/record_index.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/job/job_set.pb.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+const RecordIndexFormat kTestIndexFormat = kOFRecordIndexFormat;
+
+// records are laid out like OFRecord files: int64 byte size, then the bytes
+void WriteRecordFile(fs::FileSystem* file_system, const std::string& file_path,
+                     const std::vector<int64_t>& record_bytes, char fill) {
+  std::unique_ptr<fs::WritableFile> file;
+  file_system->NewWritableFile(file_path, &file);
+  for (int64_t record_byte : record_bytes) {
+    file->Append(reinterpret_cast<const char*>(&record_byte), sizeof(int64_t));
+    file->Append(std::string(record_byte, fill).data(), record_byte);
+  }
+  file->Close();
+}
+
+int64_t ReadTestRecordHead(const fs::RandomAccessFile& file, const std::string& file_path,
+                           int64_t offset, int64_t file_size, int64_t* byte_size) {
+  file.Read(offset, sizeof(int64_t), reinterpret_cast<char*>(byte_size));
+  return offset + sizeof(int64_t) + *byte_size;
+}
+
+std::vector<int64_t> GetRecordBytes(const RecordIndex& index) {
+  std::vector<int64_t> record_bytes;
+  FOR_RANGE(size_t, i, 0, index.size()) { record_bytes.push_back(index.At(i).byte_size); }
+  return record_bytes;
+}
+
+}  // namespace
+
+TEST(RecordIndex, rebuild_sidecar_of_changed_file) {
+  IOConf io_conf;
+  io_conf.mutable_data_fs_conf()->mutable_localfs_conf();
+  Global<const IOConf>::New(io_conf);
+  fs::PosixFileSystem file_system;
+  std::string dir = GetCwd();
+  StringReplace(&dir, '\\', '/');
+  const std::string file_path = JoinPath(dir, "tmp_record_index_test");
+  const std::string sidecar_path = RecordIndex::SidecarPath(file_path);
+  if (file_system.FileExists(sidecar_path)) { file_system.DelFile(sidecar_path); }
+  WriteRecordFile(&file_system, file_path, {10, 20}, 'a');
+  {
+    RecordIndex index(&file_system, {file_path}, kTestIndexFormat, &ReadTestRecordHead);
+    ASSERT_EQ(GetRecordBytes(index), (std::vector<int64_t>{10, 20}));
+  }
+  ASSERT_TRUE(file_system.FileExists(sidecar_path));
+  {
+    RecordIndex index(&file_system, {file_path}, kTestIndexFormat, &ReadTestRecordHead);
+    ASSERT_EQ(GetRecordBytes(index), (std::vector<int64_t>{10, 20}));
+  }
+  // same byte size, other records
+  WriteRecordFile(&file_system, file_path, {20, 10}, 'b');
+  {
+    RecordIndex index(&file_system, {file_path}, kTestIndexFormat, &ReadTestRecordHead);
+    ASSERT_EQ(GetRecordBytes(index), (std::vector<int64_t>{20, 10}));
+  }
+  file_system.DelFile(sidecar_path);
+  file_system.DelFile(file_path);
+  Global<const IOConf>::Delete();
+}
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
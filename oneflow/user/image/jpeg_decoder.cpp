@@ -0,0 +1,139 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/image/jpeg_decoder.h"
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace oneflow {
+
+namespace {
+
+struct JpegErrorMgr {
+  jpeg_error_mgr pub;
+  jmp_buf jmp;
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JpegErrorMgr*>(cinfo->err)->jmp, 1);
+}
+
+// corrupt-data warnings are not worth a log line per image
+void JpegOutputMessage(j_common_ptr cinfo) {}
+
+bool GetJpegOutColorSpace(const std::string& color_space, J_COLOR_SPACE* out_color_space) {
+  if (color_space == "BGR") {
+    *out_color_space = JCS_EXT_BGR;
+  } else if (color_space == "RGB") {
+    *out_color_space = JCS_RGB;
+  } else if (color_space == "GRAY") {
+    *out_color_space = JCS_GRAYSCALE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// the smallest scale_num / 8 that keeps the crop window at least min_h x min_w
+int32_t GetJpegScaleNum(const CropWindow& crop, int64_t min_h, int64_t min_w) {
+  FOR_RANGE(int32_t, scale_num, 1, 8) {
+    if (crop.shape.At(0) * scale_num >= min_h * 8 && crop.shape.At(1) * scale_num >= min_w * 8) {
+      return scale_num;
+    }
+  }
+  return 8;
+}
+
+}  // namespace
+
+bool IsJpeg(const unsigned char* data, size_t length) {
+  return length >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool DecodeJpegRoi(const unsigned char* data, size_t length, const std::string& color_space,
+                   int64_t min_h, int64_t min_w,
+                   const std::function<void(int64_t H, int64_t W, CropWindow*)>& GenCropWindow,
+                   std::vector<uint8_t>* buffer, JpegRoi* roi) {
+  J_COLOR_SPACE out_color_space = JCS_UNKNOWN;
+  if (!IsJpeg(data, length) || !GetJpegOutColorSpace(color_space, &out_color_space)) {
+    return false;
+  }
+  // everything with a destructor lives outside the setjmp/longjmp region
+  CropWindow crop;
+  jpeg_decompress_struct cinfo;
+  JpegErrorMgr jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = JpegErrorExit;
+  jerr.pub.output_message = JpegOutputMessage;
+  if (setjmp(jerr.jmp)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, data, length);
+  if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK
+      || cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  const int64_t H = cinfo.image_height;
+  const int64_t W = cinfo.image_width;
+  GenCropWindow(H, W, &crop);
+  CHECK(crop.shape.At(0) > 0 && crop.anchor.At(0) + crop.shape.At(0) <= H);
+  CHECK(crop.shape.At(1) > 0 && crop.anchor.At(1) + crop.shape.At(1) <= W);
+
+  cinfo.out_color_space = out_color_space;
+  cinfo.scale_num = GetJpegScaleNum(crop, min_h, min_w);
+  cinfo.scale_denom = 8;
+  jpeg_start_decompress(&cinfo);
+  const float scale_y = static_cast<float>(cinfo.output_height) / H;
+  const float scale_x = static_cast<float>(cinfo.output_width) / W;
+  const float crop_y = crop.anchor.At(0) * scale_y;
+  const float crop_x = crop.anchor.At(1) * scale_x;
+  const float crop_h = crop.shape.At(0) * scale_y;
+  const float crop_w = crop.shape.At(1) * scale_x;
+  const JDIMENSION row_begin = static_cast<JDIMENSION>(crop_y);
+  const JDIMENSION row_end = std::min<JDIMENSION>(
+      cinfo.output_height, static_cast<JDIMENSION>(std::ceil(crop_y + crop_h)));
+  // fancy upsampling replicates the edge columns of a cropped scanline, one extra column on each
+  // side keeps the window itself identical to a full decode
+  JDIMENSION col_begin = std::max<int64_t>(static_cast<int64_t>(crop_x) - 1, 0);
+  JDIMENSION col_num = std::min<JDIMENSION>(cinfo.output_width,
+                                            static_cast<JDIMENSION>(std::ceil(crop_x + crop_w)) + 1)
+                       - col_begin;
+  // widens the columns to iMCU boundaries, output_width becomes col_num
+  jpeg_crop_scanline(&cinfo, &col_begin, &col_num);
+  if (row_begin > 0) { jpeg_skip_scanlines(&cinfo, row_begin); }
+  const size_t row_byte = cinfo.output_width * cinfo.output_components;
+  buffer->resize((row_end - row_begin) * row_byte);
+  while (cinfo.output_scanline < row_end) {
+    JSAMPROW row = buffer->data() + (cinfo.output_scanline - row_begin) * row_byte;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  roi->height = row_end - row_begin;
+  roi->width = cinfo.output_width;
+  roi->channels = cinfo.output_components;
+  roi->roi_y = crop_y - row_begin;
+  roi->roi_x = crop_x - col_begin;
+  roi->roi_h = crop_h;
+  roi->roi_w = crop_w;
+  // the rows below the window are never decoded
+  jpeg_abort_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+}  // namespace oneflow
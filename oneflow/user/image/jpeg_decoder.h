@@ -0,0 +1,50 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_IMAGE_JPEG_DECODER_H_
+#define ONEFLOW_USER_IMAGE_JPEG_DECODER_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/user/image/crop_window.h"
+
+namespace oneflow {
+
+// A decoded region of interest: roi_{y,x,h,w} locate the requested crop inside the decoded
+// rows, in decoded pixels, so they may be fractional and the rows may hold a few extra columns.
+struct JpegRoi {
+  int64_t height;
+  int64_t width;
+  int64_t channels;
+  float roi_y;
+  float roi_x;
+  float roi_h;
+  float roi_w;
+};
+
+bool IsJpeg(const unsigned char* data, size_t length);
+
+// Decodes only the part of a JPEG covered by the crop window GenCropWindow picks for the
+// {H, W} of the image. Rows above the window are skipped, columns are limited to the iMCUs it
+// touches, and the image is scaled down in the DCT domain as far as the window stays at least
+// min_h x min_w. Returns false if libjpeg cannot decode the image into color_space, the caller
+// has to fall back to a full decode then.
+bool DecodeJpegRoi(const unsigned char* data, size_t length, const std::string& color_space,
+                   int64_t min_h, int64_t min_w,
+                   const std::function<void(int64_t H, int64_t W, CropWindow*)>& GenCropWindow,
+                   std::vector<uint8_t>* buffer, JpegRoi* roi);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_IMAGE_JPEG_DECODER_H_
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -28,7 +29,12 @@ struct CopyTensor;
 template<typename T, typename U>
 struct CopyTensor<DeviceType::kCPU, T, U> {
   static void Call(DeviceCtx* ctx, const Tensor* src, Tensor* dst) {
-    CopyElem(src->dptr<T>(), dst->mut_dptr<U>(), src->shape().elem_cnt());
+    const T* src_ptr = src->dptr<T>();
+    U* dst_ptr = dst->mut_dptr<U>();
+    ParallelFor(0, src->shape().elem_cnt(), kElemwiseParallelForGrain,
+                [src_ptr, dst_ptr](int64_t begin, int64_t end) {
+                  CopyElem(src_ptr + begin, dst_ptr + begin, end - begin);
+                });
   }
 };
 
@@ -0,0 +1,457 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// a GEMM task gets at least this many output channels
+constexpr int64_t kMinOcPerGemmTask = 16;
+// Winograd beats im2col once a batch has this many output tiles, 28x28 (49 tiles of 4x4)
+// is above and 14x14 (16 tiles of 4x4) is below
+constexpr int64_t kWinogradMinTileNum = 32;
+
+int64_t DivUp(int64_t n, int64_t m) { return (n + m - 1) / m; }
+
+// grain of a ParallelFor whose items cost flop_per_item multiply-adds each
+int64_t FlopGrain(int64_t flop_per_item) {
+  return std::max<int64_t>(kElemwiseParallelForGrain / std::max<int64_t>(flop_per_item, 1), 1);
+}
+
+int64_t ThreadNum() {
+  const ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  return thread_pool == nullptr ? 1 : thread_pool->thread_num();
+}
+
+// number of output channel blocks every one of item_num GEMMs is split into. A GEMM with fewer
+// rows runs slower per flop, so the GEMMs are only split until every thread has one.
+int64_t GemmOcSplitNum(int64_t item_num, int64_t out_channels) {
+  return std::max<int64_t>(
+      std::min(out_channels / kMinOcPerGemmTask, DivUp(ThreadNum(), item_num)), 1);
+}
+
+template<typename T>
+void Gemm(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, int64_t m, int64_t n,
+          int64_t k, const T* a, const T* b, T* c) {
+  NewKernelUtil<DeviceType::kCPU>::OFGemm(nullptr, trans_a, trans_b, m, n, k, static_cast<T>(1),
+                                          a, b, static_cast<T>(0), c);
+}
+
+// out[r][s] += bias[r] for rows of size cols
+template<typename T>
+void AddBiasToRows(const T* bias, int64_t rows, int64_t cols, T* out) {
+  FOR_RANGE(int64_t, r, 0, rows) {
+    T* out_row = out + r * cols;
+    FOR_RANGE(int64_t, s, 0, cols) { out_row[s] += bias[r]; }
+  }
+}
+
+bool IsChannelsFirst2D(const ConvCpuParams& params) {
+  return !params.channels_last && params.in_dims[0] == 1 && params.out_dims[0] == 1
+         && params.kernel_dims[0] == 1;
+}
+
+bool Is3x3Stride1(const ConvCpuParams& params) {
+  return params.kernel_dims[1] == 3 && params.kernel_dims[2] == 3 && params.strides[1] == 1
+         && params.strides[2] == 1 && params.dilation_rate[1] == 1
+         && params.dilation_rate[2] == 1;
+}
+
+template<typename T>
+void ForwardGemm1x1(const ConvCpuParams& params, const T* in, const T* weight, const T* bias,
+                    T* out) {
+  const int64_t in_channels = params.in_channels;
+  const int64_t out_channels = params.out_channels;
+  const int64_t spatial_size = params.out_spatial_size();
+  if (params.channels_last) {
+    // out[batch * spatial, oc] = in[batch * spatial, c] * weight[oc, c]^T, split over rows
+    const int64_t row_num = params.batch * spatial_size;
+    ParallelFor(0, row_num, FlopGrain(in_channels * out_channels),
+                [&](int64_t row_begin, int64_t row_end) {
+                  T* out_rows = out + row_begin * out_channels;
+                  Gemm<T>(CblasNoTrans, CblasTrans, row_end - row_begin, out_channels,
+                          in_channels, in + row_begin * in_channels, weight, out_rows);
+                  if (bias == nullptr) { return; }
+                  FOR_RANGE(int64_t, r, 0, row_end - row_begin) {
+                    FOR_RANGE(int64_t, o, 0, out_channels) {
+                      out_rows[r * out_channels + o] += bias[o];
+                    }
+                  }
+                });
+  } else {
+    // out[n] = weight[oc, c] * in[n][c, spatial], split over samples and output channels
+    const int64_t split_num = GemmOcSplitNum(params.batch, out_channels);
+    ParallelFor(0, params.batch * split_num, 1, [&](int64_t task_begin, int64_t task_end) {
+      FOR_RANGE(int64_t, task, task_begin, task_end) {
+        const int64_t n = task / split_num;
+        const int64_t oc_begin = out_channels * (task % split_num) / split_num;
+        const int64_t oc_end = out_channels * (task % split_num + 1) / split_num;
+        T* out_block = out + (n * out_channels + oc_begin) * spatial_size;
+        Gemm<T>(CblasNoTrans, CblasNoTrans, oc_end - oc_begin, spatial_size, in_channels,
+                weight + oc_begin * in_channels, in + n * in_channels * spatial_size, out_block);
+        if (bias != nullptr) {
+          AddBiasToRows(bias + oc_begin, oc_end - oc_begin, spatial_size, out_block);
+        }
+      }
+    });
+  }
+}
+
+// The 2D geometry of a channels first Winograd convolution.
+struct Conv2DGeom {
+  explicit Conv2DGeom(const ConvCpuParams& params)
+      : in_channels(params.in_channels),
+        out_channels(params.out_channels),
+        ih(params.in_dims[1]),
+        iw(params.in_dims[2]),
+        oh(params.out_dims[1]),
+        ow(params.out_dims[2]),
+        kh(params.kernel_dims[1]),
+        kw(params.kernel_dims[2]),
+        stride_h(params.strides[1]),
+        stride_w(params.strides[2]),
+        dilation_h(params.dilation_rate[1]),
+        dilation_w(params.dilation_rate[2]),
+        pad_h(params.padding_before[1]),
+        pad_w(params.padding_before[2]) {}
+
+  int64_t in_channels;
+  int64_t out_channels;
+  int64_t ih;
+  int64_t iw;
+  int64_t oh;
+  int64_t ow;
+  int64_t kh;
+  int64_t kw;
+  int64_t stride_h;
+  int64_t stride_w;
+  int64_t dilation_h;
+  int64_t dilation_w;
+  int64_t pad_h;
+  int64_t pad_w;
+};
+
+// Winograd F(m x m, 3 x 3): the transforms of Lavin & Gray, "Fast Algorithms for Convolutional
+// Neural Networks", written out so that the zeros of the matrices cost nothing. Every 1D
+// transform reads src[i * src_stride] and writes dst[i * dst_stride].
+template<int64_t m>
+struct Winograd;
+
+template<>
+struct Winograd<2> {
+  static constexpr int64_t kAlpha = 4;
+
+  // B^T d
+  template<typename T>
+  static void TransformInput(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T d0 = src[0];
+    const T d1 = src[src_stride];
+    const T d2 = src[2 * src_stride];
+    const T d3 = src[3 * src_stride];
+    dst[0] = d0 - d2;
+    dst[dst_stride] = d1 + d2;
+    dst[2 * dst_stride] = d2 - d1;
+    dst[3 * dst_stride] = d1 - d3;
+  }
+
+  // G g
+  template<typename T>
+  static void TransformKernel(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T g0 = src[0];
+    const T g1 = src[src_stride];
+    const T g2 = src[2 * src_stride];
+    dst[0] = g0;
+    dst[dst_stride] = (g0 + g1 + g2) * static_cast<T>(0.5);
+    dst[2 * dst_stride] = (g0 - g1 + g2) * static_cast<T>(0.5);
+    dst[3 * dst_stride] = g2;
+  }
+
+  // A^T y
+  template<typename T>
+  static void TransformOutput(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T m0 = src[0];
+    const T m1 = src[src_stride];
+    const T m2 = src[2 * src_stride];
+    const T m3 = src[3 * src_stride];
+    dst[0] = m0 + m1 + m2;
+    dst[dst_stride] = m1 - m2 - m3;
+  }
+};
+
+template<>
+struct Winograd<4> {
+  static constexpr int64_t kAlpha = 6;
+
+  template<typename T>
+  static void TransformInput(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T d0 = src[0];
+    const T d1 = src[src_stride];
+    const T d2 = src[2 * src_stride];
+    const T d3 = src[3 * src_stride];
+    const T d4 = src[4 * src_stride];
+    const T d5 = src[5 * src_stride];
+    dst[0] = 4 * d0 - 5 * d2 + d4;
+    dst[dst_stride] = -4 * (d1 + d2) + d3 + d4;
+    dst[2 * dst_stride] = 4 * (d1 - d2) - d3 + d4;
+    dst[3 * dst_stride] = 2 * (d3 - d1) - d2 + d4;
+    dst[4 * dst_stride] = 2 * (d1 - d3) - d2 + d4;
+    dst[5 * dst_stride] = 4 * d1 - 5 * d3 + d5;
+  }
+
+  template<typename T>
+  static void TransformKernel(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T g0 = src[0];
+    const T g1 = src[src_stride];
+    const T g2 = src[2 * src_stride];
+    dst[0] = g0 / 4;
+    dst[dst_stride] = -(g0 + g1 + g2) / 6;
+    dst[2 * dst_stride] = -(g0 - g1 + g2) / 6;
+    dst[3 * dst_stride] = (g0 + 2 * g1 + 4 * g2) / 24;
+    dst[4 * dst_stride] = (g0 - 2 * g1 + 4 * g2) / 24;
+    dst[5 * dst_stride] = g2;
+  }
+
+  template<typename T>
+  static void TransformOutput(const T* src, int64_t src_stride, T* dst, int64_t dst_stride) {
+    const T m0 = src[0];
+    const T m1 = src[src_stride];
+    const T m2 = src[2 * src_stride];
+    const T m3 = src[3 * src_stride];
+    const T m4 = src[4 * src_stride];
+    const T m5 = src[5 * src_stride];
+    dst[0] = m0 + m1 + m2 + m3 + m4;
+    dst[dst_stride] = m1 - m2 + 2 * (m3 - m4);
+    dst[2 * dst_stride] = m1 + m2 + 4 * (m3 + m4);
+    dst[3 * dst_stride] = m1 - m2 + 8 * (m3 - m4) + m5;
+  }
+};
+
+// Element counts of the transformed weights U[alpha^2][oc][c], the transformed input tiles
+// V[alpha^2][c][tile] and the products M[alpha^2][oc][tile] of one sample.
+template<int64_t m>
+struct WinogradWorkspace {
+  explicit WinogradWorkspace(const ConvCpuParams& params)
+      : tile_h_num(DivUp(params.out_dims[1], m)),
+        tile_w_num(DivUp(params.out_dims[2], m)),
+        tile_num(tile_h_num * tile_w_num),
+        u_elem_cnt(kAlpha2 * params.out_channels * params.in_channels),
+        v_elem_cnt(kAlpha2 * params.in_channels * tile_num),
+        m_elem_cnt(kAlpha2 * params.out_channels * tile_num) {}
+
+  static constexpr int64_t kAlpha2 = Winograd<m>::kAlpha * Winograd<m>::kAlpha;
+  int64_t tile_h_num;
+  int64_t tile_w_num;
+  int64_t tile_num;
+  int64_t u_elem_cnt;
+  int64_t v_elem_cnt;
+  int64_t m_elem_cnt;
+
+  int64_t elem_cnt() const { return u_elem_cnt + v_elem_cnt + m_elem_cnt; }
+};
+
+template<typename T, int64_t m>
+void ForwardWinograd(const ConvCpuParams& params, const T* in, const T* weight, const T* bias,
+                     T* workspace, T* out) {
+  constexpr int64_t kAlpha = Winograd<m>::kAlpha;
+  constexpr int64_t kAlpha2 = kAlpha * kAlpha;
+  const Conv2DGeom g(params);
+  const WinogradWorkspace<m> ws(params);
+  T* u = workspace;
+  T* v = u + ws.u_elem_cnt;
+  T* prod = v + ws.v_elem_cnt;
+  const int64_t u_stride = g.out_channels * g.in_channels;
+  const int64_t v_stride = g.in_channels * ws.tile_num;
+  const int64_t m_stride = g.out_channels * ws.tile_num;
+
+  // U = G g G^T
+  ParallelFor(0, g.out_channels * g.in_channels, FlopGrain(kAlpha2 * kAlpha),
+              [&](int64_t begin, int64_t end) {
+                T tmp[kAlpha * 3];
+                T transformed[kAlpha2];
+                FOR_RANGE(int64_t, i, begin, end) {
+                  const T* kernel = weight + i * 9;
+                  FOR_RANGE(int64_t, col, 0, 3) {
+                    Winograd<m>::TransformKernel(kernel + col, 3, tmp + col, 3);
+                  }
+                  FOR_RANGE(int64_t, row, 0, kAlpha) {
+                    Winograd<m>::TransformKernel(tmp + row * 3, 1, transformed + row * kAlpha, 1);
+                  }
+                  FOR_RANGE(int64_t, xi, 0, kAlpha2) { u[xi * u_stride + i] = transformed[xi]; }
+                }
+              });
+  const int64_t split_num = GemmOcSplitNum(kAlpha2, g.out_channels);
+  FOR_RANGE(int64_t, n, 0, params.batch) {
+    const T* in_n = in + n * g.in_channels * g.ih * g.iw;
+    T* out_n = out + n * g.out_channels * g.oh * g.ow;
+    // V = B^T d B, every item is one row of tiles of one channel
+    ParallelFor(0, g.in_channels * ws.tile_h_num, FlopGrain(ws.tile_w_num * kAlpha2 * kAlpha),
+                [&](int64_t begin, int64_t end) {
+                  T d[kAlpha2];
+                  T tmp[kAlpha2];
+                  T transformed[kAlpha2];
+                  FOR_RANGE(int64_t, item, begin, end) {
+                    const int64_t c = item / ws.tile_h_num;
+                    const int64_t tile_h = item % ws.tile_h_num;
+                    const T* in_c = in_n + c * g.ih * g.iw;
+                    FOR_RANGE(int64_t, tile_w, 0, ws.tile_w_num) {
+                      const int64_t ih_begin = tile_h * m - g.pad_h;
+                      const int64_t iw_begin = tile_w * m - g.pad_w;
+                      FOR_RANGE(int64_t, row, 0, kAlpha) {
+                        const int64_t ih = ih_begin + row;
+                        FOR_RANGE(int64_t, col, 0, kAlpha) {
+                          const int64_t iw = iw_begin + col;
+                          d[row * kAlpha + col] = (ih >= 0 && ih < g.ih && iw >= 0 && iw < g.iw)
+                                                      ? in_c[ih * g.iw + iw]
+                                                      : static_cast<T>(0);
+                        }
+                      }
+                      FOR_RANGE(int64_t, col, 0, kAlpha) {
+                        Winograd<m>::TransformInput(d + col, kAlpha, tmp + col, kAlpha);
+                      }
+                      FOR_RANGE(int64_t, row, 0, kAlpha) {
+                        Winograd<m>::TransformInput(tmp + row * kAlpha, 1,
+                                                    transformed + row * kAlpha, 1);
+                      }
+                      const int64_t tile = tile_h * ws.tile_w_num + tile_w;
+                      FOR_RANGE(int64_t, xi, 0, kAlpha2) {
+                        v[xi * v_stride + c * ws.tile_num + tile] = transformed[xi];
+                      }
+                    }
+                  }
+                });
+    // M[xi] = U[xi] V[xi], split over xi and output channels
+    ParallelFor(0, kAlpha2 * split_num, 1, [&](int64_t task_begin, int64_t task_end) {
+      FOR_RANGE(int64_t, task, task_begin, task_end) {
+        const int64_t xi = task / split_num;
+        const int64_t oc_begin = g.out_channels * (task % split_num) / split_num;
+        const int64_t oc_end = g.out_channels * (task % split_num + 1) / split_num;
+        Gemm<T>(CblasNoTrans, CblasNoTrans, oc_end - oc_begin, ws.tile_num, g.in_channels,
+                u + xi * u_stride + oc_begin * g.in_channels, v + xi * v_stride,
+                prod + xi * m_stride + oc_begin * ws.tile_num);
+      }
+    });
+    // y = A^T M A + bias, every item is one row of tiles of one output channel
+    ParallelFor(0, g.out_channels * ws.tile_h_num, FlopGrain(ws.tile_w_num * kAlpha2 * kAlpha),
+                [&](int64_t begin, int64_t end) {
+                  T gathered[kAlpha2];
+                  T tmp[m * kAlpha];
+                  T transformed[m * m];
+                  FOR_RANGE(int64_t, item, begin, end) {
+                    const int64_t oc = item / ws.tile_h_num;
+                    const int64_t tile_h = item % ws.tile_h_num;
+                    const T bias_val = bias == nullptr ? static_cast<T>(0) : bias[oc];
+                    T* out_c = out_n + oc * g.oh * g.ow;
+                    FOR_RANGE(int64_t, tile_w, 0, ws.tile_w_num) {
+                      const int64_t tile = tile_h * ws.tile_w_num + tile_w;
+                      FOR_RANGE(int64_t, xi, 0, kAlpha2) {
+                        gathered[xi] = prod[xi * m_stride + oc * ws.tile_num + tile];
+                      }
+                      FOR_RANGE(int64_t, col, 0, kAlpha) {
+                        Winograd<m>::TransformOutput(gathered + col, kAlpha, tmp + col, kAlpha);
+                      }
+                      FOR_RANGE(int64_t, row, 0, m) {
+                        Winograd<m>::TransformOutput(tmp + row * kAlpha, 1, transformed + row * m,
+                                                     1);
+                      }
+                      const int64_t row_num = std::min(m, g.oh - tile_h * m);
+                      const int64_t col_num = std::min(m, g.ow - tile_w * m);
+                      FOR_RANGE(int64_t, row, 0, row_num) {
+                        T* out_row = out_c + (tile_h * m + row) * g.ow + tile_w * m;
+                        FOR_RANGE(int64_t, col, 0, col_num) {
+                          out_row[col] = transformed[row * m + col] + bias_val;
+                        }
+                      }
+                    }
+                  }
+                });
+  }
+}
+
+}  // namespace
+
+const char* ConvCpuAlgoName(ConvCpuAlgo algo) {
+  switch (algo) {
+    case ConvCpuAlgo::kIm2ColGemm: return "im2col_gemm";
+    case ConvCpuAlgo::kGemm1x1: return "gemm_1x1";
+    case ConvCpuAlgo::kWinogradF2x3: return "winograd_f2x3";
+    case ConvCpuAlgo::kWinogradF4x3: return "winograd_f4x3";
+    default: UNIMPLEMENTED(); return "";
+  }
+}
+
+bool IsConvCpuAlgoSupported(const ConvCpuParams& params, ConvCpuAlgo algo) {
+  switch (algo) {
+    case ConvCpuAlgo::kIm2ColGemm: return true;
+    case ConvCpuAlgo::kGemm1x1: {
+      FOR_RANGE(int32_t, i, 0, 3) {
+        if (params.kernel_dims[i] != 1 || params.strides[i] != 1
+            || params.padding_before[i] != 0 || params.in_dims[i] != params.out_dims[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case ConvCpuAlgo::kWinogradF2x3:
+    case ConvCpuAlgo::kWinogradF4x3: return IsChannelsFirst2D(params) && Is3x3Stride1(params);
+    default: return false;
+  }
+}
+
+ConvCpuAlgo SelectConvCpuAlgo(const ConvCpuParams& params) {
+  if (IsConvCpuAlgoSupported(params, ConvCpuAlgo::kGemm1x1)) { return ConvCpuAlgo::kGemm1x1; }
+  if (IsConvCpuAlgoSupported(params, ConvCpuAlgo::kWinogradF4x3)) {
+    // the weight transform and the thin per-point GEMMs only amortize over enough tiles
+    if (params.batch * WinogradWorkspace<4>(params).tile_num >= kWinogradMinTileNum) {
+      return ConvCpuAlgo::kWinogradF4x3;
+    }
+    if (params.batch * WinogradWorkspace<2>(params).tile_num >= kWinogradMinTileNum) {
+      return ConvCpuAlgo::kWinogradF2x3;
+    }
+  }
+  return ConvCpuAlgo::kIm2ColGemm;
+}
+
+int64_t GetConvCpuWorkspaceElemCnt(const ConvCpuParams& params, ConvCpuAlgo algo) {
+  switch (algo) {
+    case ConvCpuAlgo::kWinogradF2x3: return WinogradWorkspace<2>(params).elem_cnt();
+    case ConvCpuAlgo::kWinogradF4x3: return WinogradWorkspace<4>(params).elem_cnt();
+    default: return 0;
+  }
+}
+
+template<typename T>
+void ConvCpuUtil<T>::Forward(const ConvCpuParams& params, ConvCpuAlgo algo, const T* in,
+                             const T* weight, const T* bias, T* workspace, T* out) {
+  CHECK(IsConvCpuAlgoSupported(params, algo)) << ConvCpuAlgoName(algo);
+  switch (algo) {
+    case ConvCpuAlgo::kGemm1x1: ForwardGemm1x1(params, in, weight, bias, out); break;
+    case ConvCpuAlgo::kWinogradF2x3:
+      ForwardWinograd<T, 2>(params, in, weight, bias, workspace, out);
+      break;
+    case ConvCpuAlgo::kWinogradF4x3:
+      ForwardWinograd<T, 4>(params, in, weight, bias, workspace, out);
+      break;
+    default: UNIMPLEMENTED();
+  }
+}
+
+template struct ConvCpuUtil<float>;
+template struct ConvCpuUtil<double>;
+
+}  // namespace oneflow
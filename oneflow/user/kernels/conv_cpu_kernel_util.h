@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Shape of a forward convolution with groups == 1. Every spatial quantity is 3D, a 1D or 2D
+// convolution has leading ones, like the 5D shapes of ConvOpKernelState.
+struct ConvCpuParams {
+  int64_t batch;
+  int64_t in_channels;
+  int64_t out_channels;
+  int64_t in_dims[3];
+  int64_t out_dims[3];
+  int64_t kernel_dims[3];
+  int32_t strides[3];
+  int32_t dilation_rate[3];
+  int32_t padding_before[3];
+  bool channels_last;
+
+  int64_t in_spatial_size() const { return in_dims[0] * in_dims[1] * in_dims[2]; }
+  int64_t out_spatial_size() const { return out_dims[0] * out_dims[1] * out_dims[2]; }
+  int64_t kernel_size() const { return kernel_dims[0] * kernel_dims[1] * kernel_dims[2]; }
+};
+
+// The values are those of JobConfigProto.cpu_conv_force_fwd_algo, 2 was a direct convolution
+// that never beat im2col and is not supported any more.
+enum class ConvCpuAlgo {
+  // im2col into a col buffer and one GEMM per sample, works for every shape
+  kIm2ColGemm = 0,
+  // 1x1 kernel, stride 1 and no padding, the input already is the col buffer
+  kGemm1x1 = 1,
+  // channels first 1D/2D 3x3 kernels with stride and dilation 1
+  kWinogradF2x3 = 3,
+  kWinogradF4x3 = 4,
+};
+
+const char* ConvCpuAlgoName(ConvCpuAlgo algo);
+bool IsConvCpuAlgoSupported(const ConvCpuParams& params, ConvCpuAlgo algo);
+// The algorithm to run params with, picked from the shape like the cudnn heuristics. The
+// thresholds come from conv_cpu_kernel_util_benchmark.cpp.
+ConvCpuAlgo SelectConvCpuAlgo(const ConvCpuParams& params);
+// Elements of scratch space Forward needs, kIm2ColGemm is not run by ConvCpuUtil and needs 0.
+int64_t GetConvCpuWorkspaceElemCnt(const ConvCpuParams& params, ConvCpuAlgo algo);
+
+template<typename T>
+struct ConvCpuUtil final {
+  // out = conv(in, weight) + bias with any algo but kIm2ColGemm. bias may be null. The weights
+  // are packed or transformed into workspace on every call, so updated weights are picked up.
+  static void Forward(const ConvCpuParams& params, ConvCpuAlgo algo, const T* in,
+                      const T* weight, const T* bias, T* workspace, T* out);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
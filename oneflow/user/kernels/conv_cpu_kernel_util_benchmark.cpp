@@ -0,0 +1,103 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util_test_util.h"
+#include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// the im2col + GEMM per sample of ConvCpuKernel, channels first
+void Im2ColGemm(const ConvCpuParams& p, const float* in, const float* weight, float* col_buf,
+                float* out) {
+  const int64_t out_spatial_size = p.out_spatial_size();
+  const int64_t ih_num = p.in_dims[1];
+  const int64_t iw_num = p.in_dims[2];
+  FOR_RANGE(int64_t, n, 0, p.batch) {
+    const float* in_n = in + n * p.in_channels * p.in_spatial_size();
+    float* col = col_buf;
+    FOR_RANGE(int64_t, c, 0, p.in_channels) {
+      FOR_RANGE(int64_t, kh, 0, p.kernel_dims[1]) {
+        FOR_RANGE(int64_t, kw, 0, p.kernel_dims[2]) {
+          FOR_RANGE(int64_t, oh, 0, p.out_dims[1]) {
+            const int64_t ih = oh * p.strides[1] - p.padding_before[1] + kh * p.dilation_rate[1];
+            FOR_RANGE(int64_t, ow, 0, p.out_dims[2]) {
+              const int64_t iw =
+                  ow * p.strides[2] - p.padding_before[2] + kw * p.dilation_rate[2];
+              *(col++) = (ih >= 0 && ih < ih_num && iw >= 0 && iw < iw_num)
+                             ? in_n[(c * ih_num + ih) * iw_num + iw]
+                             : 0.f;
+            }
+          }
+        }
+      }
+    }
+    NewKernelUtil<DeviceType::kCPU>::OFGemm(
+        nullptr, CblasNoTrans, CblasNoTrans, p.out_channels, out_spatial_size,
+        p.in_channels * p.kernel_size(), 1.f, weight, col_buf, 0.f,
+        out + n * p.out_channels * out_spatial_size);
+  }
+}
+
+void BenchmarkRow(const std::string& name, const ConvCpuParams& params) {
+  std::mt19937 gen(0);
+  const std::vector<float> in = RandomVector(InElemCnt(params), &gen);
+  const std::vector<float> weight = RandomVector(WeightElemCnt(params), &gen);
+  const std::vector<float> bias = RandomVector(params.out_channels, &gen);
+  std::vector<float> out(OutElemCnt(params));
+  const double flop = 2.0 * OutElemCnt(params) * params.in_channels * params.kernel_size();
+  const int64_t iter_num = std::max<int64_t>(1, static_cast<int64_t>(2e9 / flop));
+  std::ostringstream row;
+  row << name << " (" << ConvCpuAlgoName(SelectConvCpuAlgo(params)) << " selected):";
+  std::vector<float> col_buf(params.in_channels * params.kernel_size() * params.out_spatial_size());
+  const double im2col_ms = AverageMilliseconds(iter_num, [&]() {
+    Im2ColGemm(params, in.data(), weight.data(), col_buf.data(), out.data());
+  });
+  row << " " << ConvCpuAlgoName(ConvCpuAlgo::kIm2ColGemm) << " " << im2col_ms << " ms";
+  for (ConvCpuAlgo algo : kConvCpuUtilAlgos) {
+    if (!IsConvCpuAlgoSupported(params, algo)) { continue; }
+    std::vector<float> workspace(GetConvCpuWorkspaceElemCnt(params, algo));
+    const double ms = AverageMilliseconds(iter_num, [&]() {
+      ConvCpuUtil<float>::Forward(params, algo, in.data(), weight.data(), bias.data(),
+                                  workspace.data(), out.data());
+    });
+    row << ", " << ConvCpuAlgoName(algo) << " " << ms << " ms";
+  }
+  row << ", " << flop / 1e9 << " GFLOP";
+  LOG(INFO) << row.str();
+}
+
+}  // namespace
+
+TEST(ConvCpuUtil, benchmark) {
+  const int32_t thread_num = HardwareThreadNum();
+  ScopedGlobalThreadPool thread_pool(thread_num);
+  LOG(INFO) << "channels first float forward, " << thread_num << " threads";
+  // ResNet-50 layers at batch 1 and a small batch
+  BenchmarkRow("3x3 s1 64->64 56x56 n1", MakeParams(1, 64, 64, 56, 56, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s1 128->128 28x28 n1", MakeParams(1, 128, 128, 28, 28, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s1 256->256 14x14 n1", MakeParams(1, 256, 256, 14, 14, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s1 512->512 7x7 n1", MakeParams(1, 512, 512, 7, 7, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s1 16->16 32x32 n8", MakeParams(8, 16, 16, 32, 32, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s1 128->128 28x28 n4", MakeParams(4, 128, 128, 28, 28, 3, 1, 1, 1, false));
+  BenchmarkRow("3x3 s2 128->128 56x56 n1", MakeParams(1, 128, 128, 56, 56, 3, 2, 1, 1, false));
+  BenchmarkRow("7x7 s2 3->64 224x224 n1", MakeParams(1, 3, 64, 224, 224, 7, 2, 1, 3, false));
+  BenchmarkRow("1x1 s1 256->64 56x56 n1", MakeParams(1, 256, 64, 56, 56, 1, 1, 1, 0, false));
+  BenchmarkRow("1x1 s1 512->128 28x28 n4", MakeParams(4, 512, 128, 28, 28, 1, 1, 1, 0, false));
+}
+
+}  // namespace oneflow
@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util_test_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// out and the sum of the magnitudes of the terms of every output, in double
+void NaiveConv(const ConvCpuParams& p, const std::vector<float>& in,
+               const std::vector<float>& weight, const std::vector<float>& bias,
+               std::vector<double>* out, std::vector<double>* magnitude) {
+  out->assign(OutElemCnt(p), 0);
+  magnitude->assign(OutElemCnt(p), 0);
+  const int64_t oh_num = p.out_dims[1];
+  const int64_t ow_num = p.out_dims[2];
+  const int64_t ih_num = p.in_dims[1];
+  const int64_t iw_num = p.in_dims[2];
+  const int64_t kh_num = p.kernel_dims[1];
+  const int64_t kw_num = p.kernel_dims[2];
+  FOR_RANGE(int64_t, n, 0, p.batch) {
+    FOR_RANGE(int64_t, oc, 0, p.out_channels) {
+      FOR_RANGE(int64_t, oh, 0, oh_num) {
+        FOR_RANGE(int64_t, ow, 0, ow_num) {
+          const int64_t out_idx = p.channels_last
+                                      ? ((n * oh_num + oh) * ow_num + ow) * p.out_channels + oc
+                                      : ((n * p.out_channels + oc) * oh_num + oh) * ow_num + ow;
+          double sum = bias.empty() ? 0 : bias[oc];
+          double abs_sum = std::abs(sum);
+          FOR_RANGE(int64_t, c, 0, p.in_channels) {
+            FOR_RANGE(int64_t, kh, 0, kh_num) {
+              const int64_t ih = oh * p.strides[1] - p.padding_before[1] + kh * p.dilation_rate[1];
+              if (ih < 0 || ih >= ih_num) { continue; }
+              FOR_RANGE(int64_t, kw, 0, kw_num) {
+                const int64_t iw =
+                    ow * p.strides[2] - p.padding_before[2] + kw * p.dilation_rate[2];
+                if (iw < 0 || iw >= iw_num) { continue; }
+                const int64_t in_idx = p.channels_last
+                                           ? ((n * ih_num + ih) * iw_num + iw) * p.in_channels + c
+                                           : ((n * p.in_channels + c) * ih_num + ih) * iw_num + iw;
+                const int64_t w_idx = p.channels_last
+                                          ? ((oc * kh_num + kh) * kw_num + kw) * p.in_channels + c
+                                          : ((oc * p.in_channels + c) * kh_num + kh) * kw_num + kw;
+                const double term = static_cast<double>(in[in_idx]) * weight[w_idx];
+                sum += term;
+                abs_sum += std::abs(term);
+              }
+            }
+          }
+          out->at(out_idx) = sum;
+          magnitude->at(out_idx) = abs_sum;
+        }
+      }
+    }
+  }
+}
+
+void TestAllAlgos(const ConvCpuParams& params, bool has_bias) {
+  std::mt19937 gen(static_cast<uint32_t>(InElemCnt(params) + WeightElemCnt(params)));
+  const std::vector<float> in = RandomVector(InElemCnt(params), &gen);
+  const std::vector<float> weight = RandomVector(WeightElemCnt(params), &gen);
+  const std::vector<float> bias =
+      has_bias ? RandomVector(params.out_channels, &gen) : std::vector<float>();
+  std::vector<double> ref_out;
+  std::vector<double> magnitude;
+  NaiveConv(params, in, weight, bias, &ref_out, &magnitude);
+  ASSERT_TRUE(IsConvCpuAlgoSupported(params, SelectConvCpuAlgo(params)));
+  for (ConvCpuAlgo algo : kConvCpuUtilAlgos) {
+    if (!IsConvCpuAlgoSupported(params, algo)) { continue; }
+    // the Winograd transforms scale the rounding error of the products up
+    const double rel_tol = algo == ConvCpuAlgo::kWinogradF4x3   ? 1e-4
+                           : algo == ConvCpuAlgo::kWinogradF2x3 ? 2e-5
+                                                                 : 1e-5;
+    std::vector<float> workspace(GetConvCpuWorkspaceElemCnt(params, algo));
+    std::vector<float> out(OutElemCnt(params), std::numeric_limits<float>::quiet_NaN());
+    ConvCpuUtil<float>::Forward(params, algo, in.data(), weight.data(),
+                                has_bias ? bias.data() : nullptr, workspace.data(), out.data());
+    FOR_RANGE(int64_t, i, 0, OutElemCnt(params)) {
+      ASSERT_NEAR(ref_out[i], out[i], rel_tol * std::max(1.0, magnitude[i]))
+          << ConvCpuAlgoName(algo) << " at " << i;
+    }
+  }
+}
+
+void TestCases() {
+  // 1x1
+  TestAllAlgos(MakeParams(2, 5, 7, 6, 9, 1, 1, 1, 0, false), true);
+  TestAllAlgos(MakeParams(3, 6, 4, 5, 5, 1, 1, 1, 0, true), true);
+  TestAllAlgos(MakeParams(2, 40, 33, 20, 21, 1, 1, 1, 0, false), false);
+  // 3x3 with and without padding, odd sizes leave partial Winograd tiles
+  TestAllAlgos(MakeParams(2, 3, 5, 11, 13, 3, 1, 1, 1, false), true);
+  TestAllAlgos(MakeParams(1, 17, 19, 9, 30, 3, 1, 1, 0, false), false);
+  TestAllAlgos(MakeParams(2, 8, 16, 4, 4, 3, 1, 1, 2, false), true);
+  TestAllAlgos(MakeParams(1, 32, 48, 30, 27, 3, 1, 1, 1, false), true);
+  // strided, dilated and wide kernels only run im2col
+  TestAllAlgos(MakeParams(2, 3, 9, 23, 29, 3, 2, 1, 1, false), true);
+  TestAllAlgos(MakeParams(1, 4, 10, 20, 21, 3, 1, 2, 2, false), true);
+  TestAllAlgos(MakeParams(1, 3, 16, 37, 41, 7, 2, 1, 3, false), true);
+  TestAllAlgos(MakeParams(2, 5, 6, 1, 40, 1, 2, 1, 0, false), false);
+  // a 1D convolution
+  ConvCpuParams conv1d = MakeParams(2, 6, 10, 1, 50, 1, 1, 1, 0, false);
+  conv1d.kernel_dims[2] = 5;
+  conv1d.padding_before[2] = 2;
+  TestAllAlgos(conv1d, true);
+}
+
+}  // namespace
+
+TEST(ConvCpuUtil, forward) { TestCases(); }
+
+TEST(ConvCpuUtil, select_algo) {
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(1, 256, 64, 56, 56, 1, 1, 1, 0, false)),
+            ConvCpuAlgo::kGemm1x1);
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(4, 512, 128, 28, 28, 1, 1, 1, 0, true)),
+            ConvCpuAlgo::kGemm1x1);
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(1, 64, 64, 56, 56, 3, 1, 1, 1, false)),
+            ConvCpuAlgo::kWinogradF4x3);
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(1, 256, 256, 14, 14, 3, 1, 1, 1, false)),
+            ConvCpuAlgo::kWinogradF2x3);
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(1, 512, 512, 7, 7, 3, 1, 1, 1, false)),
+            ConvCpuAlgo::kIm2ColGemm);
+  ASSERT_EQ(SelectConvCpuAlgo(MakeParams(1, 128, 128, 56, 56, 3, 2, 1, 1, false)),
+            ConvCpuAlgo::kIm2ColGemm);
+  // the value of the removed direct convolution falls back to the selection
+  ASSERT_FALSE(IsConvCpuAlgoSupported(MakeParams(1, 8, 8, 9, 9, 3, 1, 1, 1, false),
+                                      static_cast<ConvCpuAlgo>(2)));
+}
+
+class ConvCpuUtilMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(ConvCpuUtilMultiThread, forward) { TestCases(); }
+
+}  // namespace oneflow
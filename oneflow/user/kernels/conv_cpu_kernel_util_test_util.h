@@ -0,0 +1,76 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_TEST_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_TEST_UTIL_H_
+
+#include <random>
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+
+namespace oneflow {
+
+// helpers shared by the conv_cpu_kernel_util test and benchmark
+
+// the algos ConvCpuUtil runs, kIm2ColGemm is run by ConvCpuKernel
+const std::vector<ConvCpuAlgo> kConvCpuUtilAlgos = {
+    ConvCpuAlgo::kGemm1x1, ConvCpuAlgo::kWinogradF2x3, ConvCpuAlgo::kWinogradF4x3};
+
+// a 2D convolution, d is 1
+inline ConvCpuParams MakeParams(int64_t batch, int64_t in_channels, int64_t out_channels,
+                                int64_t h, int64_t w, int64_t kernel, int32_t stride,
+                                int32_t dilation, int32_t padding, bool channels_last) {
+  ConvCpuParams params;
+  params.batch = batch;
+  params.in_channels = in_channels;
+  params.out_channels = out_channels;
+  params.channels_last = channels_last;
+  const int64_t in_dims[3] = {1, h, w};
+  FOR_RANGE(int32_t, i, 0, 3) {
+    const bool is_spatial = i > 0;
+    params.in_dims[i] = in_dims[i];
+    params.kernel_dims[i] = is_spatial ? kernel : 1;
+    params.strides[i] = is_spatial ? stride : 1;
+    params.dilation_rate[i] = is_spatial ? dilation : 1;
+    params.padding_before[i] = is_spatial ? padding : 0;
+    params.out_dims[i] = is_spatial ? (in_dims[i] + 2 * padding - dilation * (kernel - 1) - 1)
+                                              / stride
+                                          + 1
+                                    : 1;
+  }
+  return params;
+}
+
+inline std::vector<float> RandomVector(int64_t n, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dis(-1, 1);
+  std::vector<float> vec(n);
+  for (float& val : vec) { val = dis(*gen); }
+  return vec;
+}
+
+inline int64_t InElemCnt(const ConvCpuParams& p) {
+  return p.batch * p.in_channels * p.in_spatial_size();
+}
+
+inline int64_t OutElemCnt(const ConvCpuParams& p) {
+  return p.batch * p.out_channels * p.out_spatial_size();
+}
+
+inline int64_t WeightElemCnt(const ConvCpuParams& p) {
+  return p.out_channels * p.in_channels * p.kernel_size();
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_TEST_UTIL_H_
@@ -15,8 +15,11 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/ops/nn_util.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/job/job_desc.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
 #include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -381,11 +384,134 @@ std::shared_ptr<user_op::OpKernelState> CreateConvOpKernelState(user_op::KernelI
   return std::move(state);
 }
 
+// dx[i] = col2im(filter(T) * dy[i]), which is the data grad of conv and the forward of deconv.
+// The gemm is split over the rows of col_buf and col2im over the channels of dx, so no two
+// threads accumulate into the same element.
+template<typename T>
+void ComputeConvDataGrad(const ConvOpKernelState<T>& state, const user_op::Tensor* dy,
+                         const T* filter_dptr, T* col_buf_dptr, user_op::Tensor* dx) {
+  const ShapeView in_shape(state.in_5d_shape_);
+  const ShapeView weight_shape(state.weight_5d_shape_);
+  const ShapeView out_shape(state.out_5d_shape_);
+  const bool is_channels_first = state.idx_offset_ == 2;
+  const int64_t m = weight_shape.Count(1);                                     // ci * kd * kh * kw
+  const int64_t n = out_shape.Count(state.idx_offset_, state.idx_offset_ + 3);  // od * oh * ow
+  const int64_t k = weight_shape.At(0);                                         // filter
+  const int64_t channels = in_shape.At(is_channels_first ? 1 : 4);
+  const int64_t kernel_size = m / channels;
+  const int64_t kd_num = weight_shape.At(is_channels_first ? 2 : 1);
+  const int64_t kh_num = weight_shape.At(is_channels_first ? 3 : 2);
+  const int64_t kw_num = weight_shape.At(is_channels_first ? 4 : 3);
+  const int64_t gemm_grain = std::max<int64_t>(kElemwiseParallelForGrain / (n * k), 1);
+  const int64_t col2im_grain = std::max<int64_t>(kElemwiseParallelForGrain / (kernel_size * n), 1);
+  FOR_RANGE(int64_t, i, 0, dy->shape().At(0)) {
+    const T* dy_dptr = GetImgDptr<T>(dy, i);
+    T* dx_dptr = GetImgMutDptr<T>(dx, i);
+    // channels first:  col_buf' = weight(T) * out[i]'
+    // channels last :  col_buf' = weight(T) * out[i]'(T)
+    ParallelFor(0, m, gemm_grain, [&](int64_t m_begin, int64_t m_end) {
+      KernelUtil<DeviceType::kCPU, T>::Gemm(
+          nullptr, CblasRowMajor, CblasTrans, state.is_out_diff_need_trans_, m_end - m_begin, n, k,
+          static_cast<T>(1), filter_dptr + m_begin, m, dy_dptr,
+          state.is_out_diff_need_trans_ == CblasNoTrans ? n : k, static_cast<T>(0),
+          col_buf_dptr + m_begin * n, n);
+    });
+    // in' = col2im(col_buf')
+    ParallelFor(0, channels, col2im_grain, [&](int64_t c_begin, int64_t c_end) {
+      ColBufUtil<T> col_buf_util(in_shape, out_shape, state.idx_offset_, state.strides_3d_.data(),
+                                 state.dilation_rate_3d_.data(), state.padding_before_3d_.data());
+      FOR_RANGE(int64_t, c, c_begin, c_end) {
+        if (is_channels_first) {
+          // the rows of channel c are contiguous in col_buf
+          Col2ImWriter<T> col_buf_writer(col_buf_dptr + c * kernel_size * n,
+                                         dx_dptr + c * in_shape.Count(2), in_shape.Count(2),
+                                         in_shape.Count(3), in_shape.Count(4), 1,
+                                         out_shape.Count(3), out_shape.Count(4), 1);
+          FOR_RANGE(int64_t, kd, 0, kd_num) {
+            FOR_RANGE(int64_t, kh, 0, kh_num) {
+              FOR_RANGE(int64_t, kw, 0, kw_num) { col_buf_util(&col_buf_writer, c, kd, kh, kw); }
+            }
+          }
+        } else {
+          FOR_RANGE(int64_t, kd, 0, kd_num) {
+            FOR_RANGE(int64_t, kh, 0, kh_num) {
+              FOR_RANGE(int64_t, kw, 0, kw_num) {
+                const int64_t row = ((kd * kh_num + kh) * kw_num + kw) * channels + c;
+                Col2ImWriter<T> col_buf_writer(col_buf_dptr + row * n, dx_dptr, in_shape.Count(2),
+                                               in_shape.Count(2), in_shape.Count(3),
+                                               in_shape.Count(4), out_shape.Count(2, 4),
+                                               out_shape.Count(3, 4), 1);
+                col_buf_util(&col_buf_writer, c, kd, kh, kw);
+              }
+            }
+          }
+        }
+      }
+    });
+  }
+}
+
 template<typename T>
 void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
 }
 
+ConvCpuParams GenConvCpuParams(const user_op::UserOpConfWrapper& conf, const ShapeView& in_shape,
+                               const ShapeView& weight_shape, const ShapeView& out_shape) {
+  const std::string& data_format = conf.attr<std::string>("data_format");
+  const auto& strides = conf.attr<std::vector<int32_t>>("strides");
+  const auto& dilation_rate = conf.attr<std::vector<int32_t>>("dilation_rate");
+  const auto& padding_before = conf.attr<std::vector<int32_t>>("padding_before");
+  const int32_t idx_offset = IdxOffset(data_format);
+  const int32_t ndims = in_shape.NumAxes() - 2;
+  ConvCpuParams params;
+  params.batch = in_shape.At(0);
+  params.in_channels = in_shape.At(ChannelIdx(data_format, in_shape.NumAxes()));
+  params.out_channels = weight_shape.At(0);
+  params.channels_last = data_format == "channels_last";
+  // 1D and 2D convolutions get leading ones, like Gen5DShape and Gen3DVec
+  FOR_RANGE(int32_t, i, 0, 3) {
+    const int32_t dim = i - (3 - ndims);
+    const bool is_dummy = dim < 0;
+    params.in_dims[i] = is_dummy ? 1 : in_shape.At(idx_offset + dim);
+    params.out_dims[i] = is_dummy ? 1 : out_shape.At(idx_offset + dim);
+    params.kernel_dims[i] = is_dummy ? 1 : weight_shape.At(idx_offset + dim);
+    params.strides[i] = is_dummy ? 1 : strides.at(dim);
+    params.dilation_rate[i] = is_dummy ? 1 : dilation_rate.at(dim);
+    params.padding_before[i] = is_dummy ? 0 : padding_before.at(dim);
+  }
+  return params;
+}
+
+// the algo picked for the static shapes, so that it matches the tmp buffer of InferTmpSizeFn
+// when the shapes are dynamic
+ConvCpuAlgo GetConvCpuAlgo(const ConvCpuParams& params, const JobDesc& job_desc) {
+  if (job_desc.job_conf().has_cpu_conv_force_fwd_algo()) {
+    const auto algo = static_cast<ConvCpuAlgo>(job_desc.job_conf().cpu_conv_force_fwd_algo());
+    if (IsConvCpuAlgoSupported(params, algo)) { return algo; }
+  }
+  return SelectConvCpuAlgo(params);
+}
+
+template<typename T>
+size_t InferConvCpuTmpBufferSize(user_op::InferContext* ctx) {
+  const Shape& in_shape = ctx->TensorDesc4ArgNameAndIndex("in", 0)->shape();
+  const Shape& weight_shape = ctx->TensorDesc4ArgNameAndIndex("weight", 0)->shape();
+  const Shape& out_shape = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape();
+  const ConvCpuParams params = GenConvCpuParams(ctx->user_op_conf(), ShapeView(in_shape),
+                                                ShapeView(weight_shape), ShapeView(out_shape));
+  const ConvCpuAlgo algo = GetConvCpuAlgo(params, ctx->job_desc());
+  if (algo != ConvCpuAlgo::kIm2ColGemm) {
+    return GetConvCpuWorkspaceElemCnt(params, algo) * sizeof(T);
+  }
+  const int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));
+  size_t tmp_buffer_size = CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(T);
+  if (ctx->TensorDesc4ArgNameAndIndex("bias", 0) != nullptr) {
+    tmp_buffer_size += params.out_spatial_size() * sizeof(T);
+  }
+  return tmp_buffer_size;
+}
+
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -406,11 +532,27 @@ class ConvCpuKernel final : public user_op::OpKernel {
     user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
 
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+
+    const ConvCpuAlgo algo = GetConvCpuAlgo(
+        GenConvCpuParams(ctx->user_op_conf(),
+                         ShapeView(ctx->TensorDesc4ArgNameAndIndex("in", 0)->shape()),
+                         ShapeView(weight->shape()),
+                         ShapeView(ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape())),
+        ctx->job_desc());
+    if (algo != ConvCpuAlgo::kIm2ColGemm) {
+      ConvCpuUtil<T>::Forward(
+          GenConvCpuParams(ctx->user_op_conf(), in->shape(), weight->shape(), out->shape()), algo,
+          in->dptr<T>(), weight->dptr<T>(), bias == nullptr ? nullptr : bias->dptr<T>(),
+          tmp_buffer->mut_dptr<T>(), out->mut_dptr<T>());
+      return;
+    }
+
     T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
 
     auto* conv_state = dynamic_cast<ConvOpKernelState<T>*>(state);
-    conv_state->Update(in->shape(), out->shape());
     CHECK_NOTNULL(conv_state);
+    conv_state->Update(in->shape(), out->shape());
     bool is_bias_mul_inited = false;
     for (int64_t i = 0; i < in->shape().At(0); ++i) {
       conv_state->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_state->in_5d_shape_),
@@ -430,12 +572,11 @@ class ConvCpuKernel final : public user_op::OpKernel {
           static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, static_cast<T>(0),
           GetImgMutDptr<T>(out, i));
 
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
       if (bias != nullptr) {
         int64_t num_of_col_buf = CalcElemNumOfColBuf(out->shape(), weight->shape(), idx_offset);
-        int64_t num_of_bias_mul = tmp_buffer->shape().elem_cnt() - num_of_col_buf;
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf * sizeof(T);
+        int64_t num_of_bias_mul = conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+        CHECK_LE((num_of_col_buf + num_of_bias_mul) * sizeof(T), tmp_buffer->shape().elem_cnt());
+        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
         if (!is_bias_mul_inited) {
           InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
           is_bias_mul_inited = true;
@@ -455,29 +596,13 @@ class ConvCpuKernel final : public user_op::OpKernel {
   }
 };
 
-#define REGISTER_CONV_KERNEL(op_name, dtype, ndims)                                         \
-  REGISTER_USER_KERNEL(#op_name)                                                            \
-      .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                           \
-      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                   \
-                       & (user_op::HobAttr<int32_t>("groups") == 1)                         \
-                       & (user_op::HobDataType("in", 0) == GetDataType<dtype>::value))      \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                         \
-        size_t tmp_buffer_size = 0;                                                         \
-        const auto& out_shape = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape();         \
-        const auto& weight_shape = ctx->TensorDesc4ArgNameAndIndex("weight", 0)->shape();   \
-                                                                                            \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
-        tmp_buffer_size +=                                                                  \
-            CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);       \
-                                                                                            \
-        const auto* bias = ctx->TensorDesc4ArgNameAndIndex("bias", 0);                      \
-        if (bias != nullptr) {                                                              \
-          int64_t bias_mul_cnt = 1;                                                         \
-          for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); } \
-          tmp_buffer_size += bias_mul_cnt * sizeof(dtype);                                  \
-        }                                                                                   \
-        return tmp_buffer_size;                                                             \
-      })
+#define REGISTER_CONV_KERNEL(op_name, dtype, ndims)                                    \
+  REGISTER_USER_KERNEL(#op_name)                                                       \
+      .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                      \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                              \
+                       & (user_op::HobAttr<int32_t>("groups") == 1)                    \
+                       & (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn(InferConvCpuTmpBufferSize<dtype>)
 
 REGISTER_CONV_KERNEL(conv1d, float, 1);
 REGISTER_CONV_KERNEL(conv2d, float, 2);
@@ -512,25 +637,7 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
     Memset<DeviceType::kCPU>(ctx->device_ctx(), dx->mut_dptr<T>(), 0,
                              dx->shape().elem_cnt() * sizeof(T));
 
-    int32_t idx_offset = conv_state->idx_offset_;
-    FOR_RANGE(int64_t, i, 0, dy->shape().At(0)) {
-      // channels first:  col_buf' = weight(T) * out[i]'
-      // channels last :  col_buf' = weight(T) * out[i]'(T)
-      NewKernelUtil<DeviceType::kCPU>::OFGemm(
-          nullptr, CblasTrans, conv_state->is_out_diff_need_trans_,
-          conv_state->weight_5d_shape_.Count(1),                        //  ci * kd * kh * kw
-          conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3),  //  od * oh * ow
-          conv_state->weight_5d_shape_.At(0),                           //  filter
-          static_cast<T>(1), filter->dptr<T>(), GetImgDptr<T>(dy, i), static_cast<T>(0),
-          col_buf->mut_dptr<T>());
-
-      // in' = col2im(col_buf')
-      conv_state->col2im_func_(col_buf->dptr<T>(), ShapeView(conv_state->in_5d_shape_),
-                               ShapeView(conv_state->weight_5d_shape_),
-                               ShapeView(conv_state->out_5d_shape_), conv_state->strides_3d_.data(),
-                               conv_state->dilation_rate_3d_.data(),
-                               conv_state->padding_before_3d_.data(), GetImgMutDptr<T>(dx, i));
-    }
+    ComputeConvDataGrad<T>(*conv_state, dy, filter->dptr<T>(), col_buf->mut_dptr<T>(), dx);
     if (ctx->user_op_conf().has_input("_add_to_output", 0)) {
       const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
       CHECK_EQ(add_to_output->data_type(), dx->data_type());
@@ -562,6 +669,55 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, float);
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, double);
 
+template<typename T>
+class DeconvCpuKernel final : public user_op::OpKernel {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(DeconvCpuKernel);
+  DeconvCpuKernel() = default;
+  ~DeconvCpuKernel() = default;
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const {
+    // deconv is the data grad of the conv whose input is out and whose output is in
+    return CreateConvOpKernelState<T>(ctx, "out", "in", "weight");
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* conv_state = dynamic_cast<ConvOpKernelState<T>*>(state);
+    CHECK_NOTNULL(conv_state);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    conv_state->Update(out->shape(), in->shape());
+    Memset<DeviceType::kCPU>(ctx->device_ctx(), out->mut_dptr<T>(), 0,
+                             out->shape().elem_cnt() * sizeof(T));
+    ComputeConvDataGrad<T>(*conv_state, in, weight->dptr<T>(), col_buf->mut_dptr<T>(), out);
+  }
+};
+
+#define REGISTER_DECONV_KERNEL(op_name, dtype)                                            \
+  REGISTER_USER_KERNEL(#op_name)                                                          \
+      .SetCreateFn<DeconvCpuKernel<dtype>>()                                              \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                 \
+                       & (user_op::HobDataType("in", 0) == GetDataType<dtype>::value))    \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                       \
+        const auto& in_shape = ctx->TensorDesc4ArgNameAndIndex("in", 0)->shape();         \
+        const auto& weight_shape = ctx->TensorDesc4ArgNameAndIndex("weight", 0)->shape(); \
+        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));            \
+        return CalcElemNumOfColBuf(in_shape, weight_shape, idx_offset) * sizeof(dtype);   \
+      })
+
+REGISTER_DECONV_KERNEL(deconv1d, float);
+REGISTER_DECONV_KERNEL(deconv2d, float);
+REGISTER_DECONV_KERNEL(deconv3d, float);
+REGISTER_DECONV_KERNEL(deconv1d, double);
+REGISTER_DECONV_KERNEL(deconv2d, double);
+REGISTER_DECONV_KERNEL(deconv3d, double);
+
 template<typename T>
 class ConvFilterGradCpuKernel final : public user_op::OpKernel {
  public:
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -27,13 +28,16 @@ class CpuGeluKernel final : public user_op::OpKernel {
   void Compute(user_op::KernelComputeContext* ctx) const override {
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
-    const int32_t elem_cnt = in->shape().elem_cnt();
+    const int64_t elem_cnt = in->shape().elem_cnt();
     const T* in_ptr = in->dptr<T>();
     T* out_ptr = out->mut_dptr<T>();
     T inv_sqrt2 = std::sqrt(0.5);
-    FOR_RANGE(int32_t, i, 0, elem_cnt) {
-      out_ptr[i] = 0.5 * in_ptr[i] * (1.0 + std::erf(inv_sqrt2 * in_ptr[i]));
-    }
+    ParallelFor(0, elem_cnt, kElemwiseParallelForGrain,
+                [in_ptr, out_ptr, inv_sqrt2](int64_t begin, int64_t end) {
+                  FOR_RANGE(int64_t, i, begin, end) {
+                    out_ptr[i] = 0.5 * in_ptr[i] * (1.0 + std::erf(inv_sqrt2 * in_ptr[i]));
+                  }
+                });
   };
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -58,18 +62,21 @@ class CpuGeluGradKernel final : public user_op::OpKernel {
     const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
     const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
     user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
-    const int32_t elem_cnt = x->shape().elem_cnt();
+    const int64_t elem_cnt = x->shape().elem_cnt();
     const T* x_ptr = x->dptr<T>();
     const T* dy_ptr = dy->dptr<T>();
     T* dx_ptr = dx->mut_dptr<T>();
     T inv_sqrt2 = std::sqrt(0.5);
     T coef = std::sqrt(2.0 / std::acos(-1.0));
-    FOR_RANGE(int32_t, i, 0, elem_cnt) {
-      dx_ptr[i] = 0.5
-                  * (1.0 + std::erf(inv_sqrt2 * x_ptr[i])
-                     + x_ptr[i] * coef * std::exp(-0.5 * x_ptr[i] * x_ptr[i]))
-                  * dy_ptr[i];
-    }
+    ParallelFor(0, elem_cnt, kElemwiseParallelForGrain,
+                [x_ptr, dy_ptr, dx_ptr, inv_sqrt2, coef](int64_t begin, int64_t end) {
+                  FOR_RANGE(int64_t, i, begin, end) {
+                    dx_ptr[i] = 0.5
+                                * (1.0 + std::erf(inv_sqrt2 * x_ptr[i])
+                                   + x_ptr[i] * coef * std::exp(-0.5 * x_ptr[i] * x_ptr[i]))
+                                * dy_ptr[i];
+                  }
+                });
   };
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -0,0 +1,243 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/thread/thread_manager.h"
+#include "oneflow/user/image/image_util.h"
+#include "oneflow/user/image/jpeg_decoder.h"
+#include "oneflow/user/kernels/random_crop_kernel_state.h"
+#include <opencv2/opencv.hpp>
+
+namespace oneflow {
+
+namespace {
+
+enum TensorLayout {
+  kNCHW = 0,
+  kNHWC = 1,
+};
+
+// per thread scratch, reused across images so the hot loop does not allocate
+struct ImageScratch {
+  std::vector<uint8_t> roi_buffer;
+  std::vector<int64_t> y0;
+  std::vector<int64_t> y1;
+  std::vector<float> wy;
+  std::vector<int64_t> x0;
+  std::vector<int64_t> x1;
+  std::vector<float> wx;
+};
+
+// Bilinear taps for dst_size samples of the window [roi_begin, roi_begin + roi_size) on an axis
+// of src_size pixels, with the half-pixel centers of cv::INTER_LINEAR. Taps never leave the
+// pixels the window touches. Indices are multiplied by stride.
+void ComputeLinearTaps(float roi_begin, float roi_size, int64_t src_size, int64_t dst_size,
+                       int64_t stride, bool reverse, std::vector<int64_t>* idx0,
+                       std::vector<int64_t>* idx1, std::vector<float>* weight) {
+  const int64_t lo = std::max<int64_t>(static_cast<int64_t>(roi_begin), 0);
+  const int64_t hi =
+      std::min<int64_t>(static_cast<int64_t>(std::ceil(roi_begin + roi_size)), src_size) - 1;
+  CHECK_LE(lo, hi);
+  const float scale = roi_size / dst_size;
+  idx0->resize(dst_size);
+  idx1->resize(dst_size);
+  weight->resize(dst_size);
+  FOR_RANGE(int64_t, i, 0, dst_size) {
+    float pos = roi_begin + (i + 0.5f) * scale - 0.5f;
+    pos = std::min(std::max(pos, static_cast<float>(lo)), static_cast<float>(hi));
+    const int64_t i0 = static_cast<int64_t>(pos);
+    const int64_t dst = reverse ? dst_size - 1 - i : i;
+    idx0->at(dst) = i0 * stride;
+    idx1->at(dst) = std::min(i0 + 1, hi) * stride;
+    weight->at(dst) = pos - i0;
+  }
+}
+
+template<TensorLayout layout>
+inline int64_t GetOutOffset(int64_t h, int64_t w, int64_t c, int64_t H, int64_t W, int64_t C) {
+  return layout == kNCHW ? (c * H + h) * W + w : (h * W + w) * C + c;
+}
+
+// resizes, mirrors and normalizes in a single pass over the decoded window
+template<TensorLayout layout>
+void ResizeMirrorNormalize(const uint8_t* src, int64_t src_row_byte, const JpegRoi& roi,
+                           bool mirror, int64_t out_H, int64_t out_W,
+                           const std::vector<float>& mean_vec,
+                           const std::vector<float>& inv_std_vec, ImageScratch* scratch,
+                           float* out_dptr) {
+  const int64_t C = roi.channels;
+  ComputeLinearTaps(roi.roi_y, roi.roi_h, roi.height, out_H, src_row_byte, false, &scratch->y0,
+                    &scratch->y1, &scratch->wy);
+  ComputeLinearTaps(roi.roi_x, roi.roi_w, roi.width, out_W, C, mirror, &scratch->x0,
+                    &scratch->x1, &scratch->wx);
+  const int64_t* x0_ptr = scratch->x0.data();
+  const int64_t* x1_ptr = scratch->x1.data();
+  const float* wx_ptr = scratch->wx.data();
+  const float* mean = mean_vec.data();
+  const float* inv_std = inv_std_vec.data();
+  FOR_RANGE(int64_t, h, 0, out_H) {
+    const uint8_t* row0 = src + scratch->y0.at(h);
+    const uint8_t* row1 = src + scratch->y1.at(h);
+    const float wy = scratch->wy.at(h);
+    FOR_RANGE(int64_t, w, 0, out_W) {
+      const int64_t x0 = x0_ptr[w];
+      const int64_t x1 = x1_ptr[w];
+      const float wx = wx_ptr[w];
+      FOR_RANGE(int64_t, c, 0, C) {
+        const float top = row0[x0 + c] + (row0[x1 + c] - row0[x0 + c]) * wx;
+        const float bottom = row1[x0 + c] + (row1[x1 + c] - row1[x0 + c]) * wx;
+        const float val = top + (bottom - top) * wy;
+        out_dptr[GetOutOffset<layout>(h, w, c, out_H, out_W, C)] = (val - mean[c]) * inv_std[c];
+      }
+    }
+  }
+}
+
+class DecodeRandomCropResizeNormalizeState final : public user_op::OpKernelState {
+ public:
+  explicit DecodeRandomCropResizeNormalizeState(user_op::KernelInitContext* ctx) {
+    const user_op::TensorDesc* out_tensor_desc = ctx->TensorDesc4ArgNameAndIndex("out", 0);
+    random_crop_state_ = CreateRandomCropKernelState(ctx, out_tensor_desc->shape().At(0));
+    mean_vec_ = ctx->Attr<std::vector<float>>("mean");
+    const std::vector<float>& std_vec = ctx->Attr<std::vector<float>>("std");
+    const int64_t C = ImageUtil::IsColor(ctx->Attr<std::string>("color_space")) ? 3 : 1;
+    CHECK(mean_vec_.size() == 1 || mean_vec_.size() == C);
+    CHECK(std_vec.size() == 1 || std_vec.size() == C);
+    for (float elem : std_vec) { inv_std_vec_.push_back(1.0f / elem); }
+    if (mean_vec_.size() == 1) { mean_vec_.resize(C, mean_vec_.at(0)); }
+    if (inv_std_vec_.size() == 1) { inv_std_vec_.resize(C, inv_std_vec_.at(0)); }
+  }
+  ~DecodeRandomCropResizeNormalizeState() override = default;
+
+  RandomCropGenerator* GetGenerator(int32_t idx) { return random_crop_state_->GetGenerator(idx); }
+  const std::vector<float>& mean_vec() const { return mean_vec_; }
+  const std::vector<float>& inv_std_vec() const { return inv_std_vec_; }
+
+ private:
+  std::shared_ptr<RandomCropKernelState> random_crop_state_;
+  std::vector<float> mean_vec_;
+  std::vector<float> inv_std_vec_;
+};
+
+// Decodes one encoded image straight into its slot of the output batch. JPEGs only decode the
+// crop window, downscaled in the DCT domain; anything else takes a full OpenCV decode. Both paths
+// ignore EXIF orientation so they crop the same pixels.
+template<TensorLayout layout>
+void DecodeRandomCropResizeNormalize(const TensorBuffer& raw_bytes, const std::string& color_space,
+                                     RandomCropGenerator* random_crop_gen, bool mirror,
+                                     int64_t out_H, int64_t out_W,
+                                     const std::vector<float>& mean_vec,
+                                     const std::vector<float>& inv_std_vec, float* out_dptr) {
+  CHECK(raw_bytes.data_type() == DataType::kChar || raw_bytes.data_type() == DataType::kInt8
+        || raw_bytes.data_type() == DataType::kUInt8);
+  static thread_local ImageScratch scratch;
+  // libjpeg may fail after it picked the window, the fallback then crops the same window so that
+  // the generator advances once per image either way, unless the image has other dimensions
+  CropWindow crop;
+  Shape crop_image_shape;
+  const auto GenCropWindow = [&](int64_t H, int64_t W, CropWindow* window) {
+    if (crop_image_shape != Shape({H, W})) {
+      crop_image_shape = Shape({H, W});
+      random_crop_gen->GenerateCropWindow(crop_image_shape, &crop);
+    }
+    *window = crop;
+  };
+  const int64_t C = ImageUtil::IsColor(color_space) ? 3 : 1;
+  JpegRoi roi;
+  if (DecodeJpegRoi(raw_bytes.data<unsigned char>(), raw_bytes.nbytes(), color_space, out_H,
+                    out_W, GenCropWindow, &scratch.roi_buffer, &roi)) {
+    CHECK_EQ(roi.channels, C);
+    ResizeMirrorNormalize<layout>(scratch.roi_buffer.data(), roi.width * C, roi, mirror, out_H,
+                                  out_W, mean_vec, inv_std_vec, &scratch, out_dptr);
+    return;
+  }
+  cv::_InputArray raw_bytes_arr(raw_bytes.data<char>(), raw_bytes.elem_cnt());
+  cv::Mat image_mat =
+      cv::imdecode(raw_bytes_arr, (C == 3 ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE)
+                                      | cv::IMREAD_IGNORE_ORIENTATION);
+  CHECK(!image_mat.empty()) << "failed to decode image";
+  if (C == 3 && color_space != "BGR") {
+    ImageUtil::ConvertColor("BGR", image_mat, color_space, image_mat);
+  }
+  CHECK_EQ(image_mat.channels(), C);
+  CropWindow window;
+  GenCropWindow(image_mat.rows, image_mat.cols, &window);
+  roi.height = image_mat.rows;
+  roi.width = image_mat.cols;
+  roi.channels = C;
+  roi.roi_y = window.anchor.At(0);
+  roi.roi_x = window.anchor.At(1);
+  roi.roi_h = window.shape.At(0);
+  roi.roi_w = window.shape.At(1);
+  ResizeMirrorNormalize<layout>(image_mat.ptr(), image_mat.step, roi, mirror, out_H, out_W,
+                                mean_vec, inv_std_vec, &scratch, out_dptr);
+}
+
+}  // namespace
+
+class ImageDecodeRandomCropResizeNormalizeKernel final : public user_op::OpKernel {
+ public:
+  ImageDecodeRandomCropResizeNormalizeKernel() = default;
+  ~ImageDecodeRandomCropResizeNormalizeKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<DecodeRandomCropResizeNormalizeState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* fused_state = dynamic_cast<DecodeRandomCropResizeNormalizeState*>(state);
+    CHECK_NOTNULL(fused_state);
+    const user_op::Tensor* in_tensor = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* mirror_tensor = ctx->Tensor4ArgNameAndIndex("mirror", 0);
+    user_op::Tensor* out_tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t record_num = in_tensor->shape().elem_cnt();
+    CHECK_GT(record_num, 0);
+    CHECK_EQ(out_tensor->shape().At(0), record_num);
+    if (mirror_tensor) { CHECK_EQ(mirror_tensor->shape().elem_cnt(), record_num); }
+    const int8_t* mirror_dptr = mirror_tensor ? mirror_tensor->dptr<int8_t>() : nullptr;
+    const TensorBuffer* in_buffers = in_tensor->dptr<TensorBuffer>();
+    const std::string& color_space = ctx->Attr<std::string>("color_space");
+    const int64_t out_H = ctx->Attr<int64_t>("target_height");
+    const int64_t out_W = ctx->Attr<int64_t>("target_width");
+    const int64_t out_image_elem_cnt = out_tensor->shape().Count(1);
+    float* out_dptr = out_tensor->mut_dptr<float>();
+    const std::string& output_layout = ctx->Attr<std::string>("output_layout");
+    MultiThreadLoop(record_num, [&](size_t i) {
+      const bool mirror = mirror_dptr != nullptr && mirror_dptr[i] != 0;
+      if (output_layout == "NCHW") {
+        DecodeRandomCropResizeNormalize<TensorLayout::kNCHW>(
+            in_buffers[i], color_space, fused_state->GetGenerator(i), mirror, out_H, out_W,
+            fused_state->mean_vec(), fused_state->inv_std_vec(), out_dptr + out_image_elem_cnt * i);
+      } else if (output_layout == "NHWC") {
+        DecodeRandomCropResizeNormalize<TensorLayout::kNHWC>(
+            in_buffers[i], color_space, fused_state->GetGenerator(i), mirror, out_H, out_W,
+            fused_state->mean_vec(), fused_state->inv_std_vec(), out_dptr + out_image_elem_cnt * i);
+      } else {
+        UNIMPLEMENTED();
+      }
+    });
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("image_decode_random_crop_resize_normalize")
+    .SetCreateFn<ImageDecodeRandomCropResizeNormalizeKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")
+                     & (user_op::HobDataType("in", 0) == DataType::kTensorBuffer)
+                     & (user_op::HobDataType("out", 0) == DataType::kFloat));
+
+}  // namespace oneflow
@@ -0,0 +1,257 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/layer_norm_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// independent accumulators of a row, the compiler keeps them in vector registers
+constexpr int64_t kLaneNum = 16;
+// elements of a row whose moments are summed while they are in L1
+constexpr int64_t kWelfordBlockSize = 1024;
+
+int64_t RowGrain(int64_t norm_size) {
+  return std::max<int64_t>(kElemwiseParallelForGrain / std::max<int64_t>(norm_size, 1), 1);
+}
+
+int64_t ReduceTaskNum() {
+  const ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  // a few tasks per thread lets the pool rebalance
+  return thread_pool == nullptr ? 1 : thread_pool->thread_num() * 4;
+}
+
+// Merges the Welford state (cnt_b, mean_b, m2_b) into (cnt_a, mean_a, m2_a).
+template<typename T>
+inline void WelfordCombine(T cnt_b, T mean_b, T m2_b, T* cnt_a, T* mean_a, T* m2_a) {
+  const T cnt = *cnt_a + cnt_b;
+  if (cnt == 0) { return; }
+  const T delta = mean_b - *mean_a;
+  *mean_a += delta * cnt_b / cnt;
+  *m2_a += m2_b + delta * delta * *cnt_a * cnt_b / cnt;
+  *cnt_a = cnt;
+}
+
+// Sums Term(i) for every i in [0, n).
+template<typename T, typename TermFn>
+T LaneSum(int64_t n, const TermFn& Term) {
+  T lane_sum[kLaneNum] = {0};
+  const int64_t lane_end = n / kLaneNum * kLaneNum;
+  for (int64_t i = 0; i < lane_end; i += kLaneNum) {
+    FOR_RANGE(int64_t, l, 0, kLaneNum) { lane_sum[l] += Term(i + l); }
+  }
+  FOR_RANGE(int64_t, i, lane_end, n) { lane_sum[0] += Term(i); }
+  T sum = 0;
+  FOR_RANGE(int64_t, l, 0, kLaneNum) { sum += lane_sum[l]; }
+  return sum;
+}
+
+// Mean and biased variance of x[0, n), reading x from memory once. The row is cut into blocks
+// that stay in L1, the mean and the squared deviations of every block are summed in lanes and
+// the blocks are merged with Welford's update. A per element Welford update does not vectorize.
+template<typename T>
+void WelfordRow(const T* x, int64_t n, T* mean, T* variance) {
+  T cnt = 0;
+  T row_mean = 0;
+  T row_m2 = 0;
+  for (int64_t begin = 0; begin < n; begin += kWelfordBlockSize) {
+    const int64_t size = std::min(kWelfordBlockSize, n - begin);
+    const T* block = x + begin;
+    const T block_mean = LaneSum<T>(size, [=](int64_t i) { return block[i]; }) / size;
+    const T block_m2 = LaneSum<T>(size, [=](int64_t i) {
+      const T centered = block[i] - block_mean;
+      return centered * centered;
+    });
+    WelfordCombine<T>(static_cast<T>(size), block_mean, block_m2, &cnt, &row_mean, &row_m2);
+  }
+  *mean = row_mean;
+  *variance = std::max(row_m2 / static_cast<T>(n), static_cast<T>(0));
+}
+
+// Calls DoSegment(col, size, param_offset) on the runs of a row that use contiguous params.
+// Either of norm_size and instance_size divides the other.
+template<typename DoSegmentFn>
+void ForEachParamSegment(int64_t row, int64_t norm_size, int64_t instance_size,
+                         const DoSegmentFn& DoSegment) {
+  if (instance_size >= norm_size) {
+    DoSegment(0, norm_size, row * norm_size % instance_size);
+  } else {
+    for (int64_t col = 0; col < norm_size; col += instance_size) {
+      DoSegment(col, instance_size, 0);
+    }
+  }
+}
+
+template<typename T, bool has_gamma, bool has_beta>
+void ForwardImpl(int64_t num_instances, int64_t norm_size, int64_t instance_size, double epsilon,
+                 const T* x, const T* gamma, const T* beta, T* mean, T* inv_variance,
+                 T* normalized, T* y) {
+  ParallelFor(0, num_instances, RowGrain(norm_size), [&](int64_t row_begin, int64_t row_end) {
+    FOR_RANGE(int64_t, row, row_begin, row_end) {
+      const int64_t offset = row * norm_size;
+      T row_mean = 0;
+      T row_variance = 0;
+      WelfordRow(x + offset, norm_size, &row_mean, &row_variance);
+      const T row_inv_variance =
+          static_cast<T>(1) / std::sqrt(row_variance + static_cast<T>(epsilon));
+      mean[row] = row_mean;
+      inv_variance[row] = row_inv_variance;
+      ForEachParamSegment(
+          row, norm_size, instance_size, [&](int64_t col, int64_t size, int64_t param_offset) {
+            const T* x_seg = x + offset + col;
+            T* y_seg = y + offset + col;
+            FOR_RANGE(int64_t, k, 0, size) {
+              T val = (x_seg[k] - row_mean) * row_inv_variance;
+              if (has_gamma) {
+                normalized[offset + col + k] = val;
+                val *= gamma[param_offset + k];
+              }
+              if (has_beta) { val += beta[param_offset + k]; }
+              y_seg[k] = val;
+            }
+          });
+    }
+  });
+}
+
+template<typename T, bool has_add_to_output>
+void BackwardImpl(int64_t num_instances, int64_t norm_size, const T* x, const T* dy,
+                  const T* mean, const T* inv_variance, const T* add_to_output, T* dx) {
+  const T inv_norm_size = static_cast<T>(1) / static_cast<T>(norm_size);
+  ParallelFor(0, num_instances, RowGrain(norm_size), [&](int64_t row_begin, int64_t row_end) {
+    FOR_RANGE(int64_t, row, row_begin, row_end) {
+      const int64_t offset = row * norm_size;
+      const T* x_row = x + offset;
+      const T* dy_row = dy + offset;
+      const T row_mean = mean[row];
+      const T row_inv_variance = inv_variance[row];
+      // two lane sums vectorize where one loop carrying both does not
+      const T sum_dy = LaneSum<T>(norm_size, [=](int64_t i) { return dy_row[i]; });
+      const T sum_dy_x_centered =
+          LaneSum<T>(norm_size, [=](int64_t i) { return dy_row[i] * (x_row[i] - row_mean); });
+      // dx = dy * dy_coef + x * x_coef + bias
+      const T mean_dy = sum_dy * inv_norm_size;
+      const T mean_dy_x_hat = sum_dy_x_centered * row_inv_variance * inv_norm_size;
+      const T dy_coef = row_inv_variance;
+      const T x_coef = -row_inv_variance * row_inv_variance * mean_dy_x_hat;
+      const T bias = row_inv_variance * (row_inv_variance * mean_dy_x_hat * row_mean - mean_dy);
+      T* dx_row = dx + offset;
+      FOR_RANGE(int64_t, i, 0, norm_size) {
+        T val = dy_row[i] * dy_coef + x_row[i] * x_coef + bias;
+        if (has_add_to_output) { val += add_to_output[offset + i]; }
+        dx_row[i] = val;
+      }
+    }
+  });
+}
+
+}  // namespace
+
+template<typename T>
+void LayerNormCpuUtil<T>::Forward(int64_t num_instances, int64_t norm_size,
+                                  int64_t instance_size, double epsilon, const T* x,
+                                  const T* gamma, const T* beta, T* mean, T* inv_variance,
+                                  T* normalized, T* y) {
+  if (gamma == nullptr && beta == nullptr) { instance_size = norm_size; }
+  CHECK_GT(instance_size, 0);
+  CHECK(instance_size % norm_size == 0 || norm_size % instance_size == 0);
+  if (gamma != nullptr) { CHECK(normalized != nullptr); }
+#define CALL_FORWARD_IMPL(has_gamma, has_beta)                                                  \
+  if ((gamma != nullptr) == has_gamma && (beta != nullptr) == has_beta) {                       \
+    return ForwardImpl<T, has_gamma, has_beta>(num_instances, norm_size, instance_size, epsilon, \
+                                               x, gamma, beta, mean, inv_variance, normalized,  \
+                                               y);                                              \
+  }
+  CALL_FORWARD_IMPL(false, false)
+  CALL_FORWARD_IMPL(false, true)
+  CALL_FORWARD_IMPL(true, false)
+  CALL_FORWARD_IMPL(true, true)
+#undef CALL_FORWARD_IMPL
+}
+
+template<typename T>
+void LayerNormCpuUtil<T>::Backward(int64_t num_instances, int64_t norm_size, const T* x,
+                                   const T* dy, const T* mean, const T* inv_variance,
+                                   const T* add_to_output, T* dx) {
+  if (add_to_output != nullptr) {
+    BackwardImpl<T, true>(num_instances, norm_size, x, dy, mean, inv_variance, add_to_output, dx);
+  } else {
+    BackwardImpl<T, false>(num_instances, norm_size, x, dy, mean, inv_variance, add_to_output,
+                           dx);
+  }
+}
+
+template<typename T>
+void LayerNormCpuUtil<T>::ParamBackward(int64_t elem_cnt, int64_t instance_size, const T* dy,
+                                        const T* normalized, const T* gamma, T* gamma_diff,
+                                        T* beta_diff, T* normalized_diff) {
+  CHECK_GT(instance_size, 0);
+  CHECK_EQ(elem_cnt % instance_size, 0);
+  if (gamma_diff != nullptr) { CHECK(normalized != nullptr); }
+  const int64_t row_num = elem_cnt / instance_size;
+  const bool has_param_diff = gamma_diff != nullptr || beta_diff != nullptr;
+  // every task sums its block of rows into its own partial gamma_diff and beta_diff
+  const int64_t task_num = std::max<int64_t>(std::min(row_num, ReduceTaskNum()), 1);
+  std::vector<T> partial(has_param_diff ? task_num * 2 * instance_size : 0);
+  ParallelFor(0, task_num, 1, [&](int64_t task_begin, int64_t task_end) {
+    FOR_RANGE(int64_t, task, task_begin, task_end) {
+      T* task_gamma_diff = has_param_diff ? partial.data() + task * 2 * instance_size : nullptr;
+      T* task_beta_diff = has_param_diff ? task_gamma_diff + instance_size : nullptr;
+      FOR_RANGE(int64_t, row, row_num * task / task_num, row_num * (task + 1) / task_num) {
+        const int64_t offset = row * instance_size;
+        const T* dy_row = dy + offset;
+        if (beta_diff != nullptr) {
+          FOR_RANGE(int64_t, j, 0, instance_size) { task_beta_diff[j] += dy_row[j]; }
+        }
+        if (gamma_diff != nullptr) {
+          const T* normalized_row = normalized + offset;
+          FOR_RANGE(int64_t, j, 0, instance_size) {
+            task_gamma_diff[j] += dy_row[j] * normalized_row[j];
+          }
+        }
+        if (normalized_diff != nullptr) {
+          T* normalized_diff_row = normalized_diff + offset;
+          if (gamma != nullptr) {
+            FOR_RANGE(int64_t, j, 0, instance_size) {
+              normalized_diff_row[j] = dy_row[j] * gamma[j];
+            }
+          } else if (normalized_diff_row != dy_row) {
+            std::memcpy(normalized_diff_row, dy_row, instance_size * sizeof(T));
+          }
+        }
+      }
+    }
+  });
+  if (!has_param_diff) { return; }
+  ParallelFor(0, instance_size, RowGrain(task_num), [&](int64_t col_begin, int64_t col_end) {
+    FOR_RANGE(int64_t, j, col_begin, col_end) {
+      T gamma_diff_sum = 0;
+      T beta_diff_sum = 0;
+      FOR_RANGE(int64_t, task, 0, task_num) {
+        gamma_diff_sum += partial[task * 2 * instance_size + j];
+        beta_diff_sum += partial[task * 2 * instance_size + instance_size + j];
+      }
+      if (gamma_diff != nullptr) { gamma_diff[j] = gamma_diff_sum; }
+      if (beta_diff != nullptr) { beta_diff[j] = beta_diff_sum; }
+    }
+  });
+}
+
+template struct LayerNormCpuUtil<float>;
+template struct LayerNormCpuUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,47 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_LAYER_NORM_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_LAYER_NORM_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Layer normalization on the CPU. x is viewed as [num_instances, norm_size] and every row is
+// normalized on its own, so the forward and the dx pass split rows over the thread pool. gamma
+// and beta hold instance_size elements and repeat along the flattened x.
+template<typename T>
+struct LayerNormCpuUtil final {
+  // mean and inv_variance of every row from one Welford pass, then y = x_hat * gamma + beta in a
+  // second pass over the same row. gamma and beta may be null, x_hat is also written to
+  // normalized if gamma is not.
+  static void Forward(int64_t num_instances, int64_t norm_size, int64_t instance_size,
+                      double epsilon, const T* x, const T* gamma, const T* beta, T* mean,
+                      T* inv_variance, T* normalized, T* y);
+  // dx = inv_variance * (dy - mean(dy) - x_hat * mean(dy * x_hat)) per row, plus add_to_output
+  // if it is not null. dx may alias add_to_output.
+  static void Backward(int64_t num_instances, int64_t norm_size, const T* x, const T* dy,
+                       const T* mean, const T* inv_variance, const T* add_to_output, T* dx);
+  // gamma_diff = sum(dy * normalized) and beta_diff = sum(dy) over the rows of instance_size
+  // elements, normalized_diff = dy * gamma. Every output may be null, gamma null means ones.
+  static void ParamBackward(int64_t elem_cnt, int64_t instance_size, const T* dy,
+                            const T* normalized, const T* gamma, T* gamma_diff, T* beta_diff,
+                            T* normalized_diff);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_LAYER_NORM_KERNEL_UTIL_H_
@@ -0,0 +1,81 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/layer_norm_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+const double kEpsilon = 1e-5;
+
+std::vector<float> RandomVector(int64_t n, float offset, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dis(-1, 1);
+  std::vector<float> vec(n);
+  for (float& val : vec) { val = dis(*gen) + offset; }
+  return vec;
+}
+
+}  // namespace
+
+TEST(LayerNormCpuUtil, benchmark) {
+  // a BERT-base activation, [batch * seq_len, hidden]
+  const int64_t num_instances = 32 * 128;
+  const int64_t norm_size = 768;
+  const int64_t elem_cnt = num_instances * norm_size;
+  std::mt19937 gen(0);
+  const std::vector<float> x = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> dy = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> gamma = RandomVector(norm_size, 1, &gen);
+  const std::vector<float> beta = RandomVector(norm_size, 0, &gen);
+  std::vector<float> mean(num_instances);
+  std::vector<float> inv_variance(num_instances);
+  std::vector<float> normalized(elem_cnt);
+  std::vector<float> y(elem_cnt);
+  std::vector<float> dx(elem_cnt);
+  std::vector<float> gamma_diff(norm_size);
+  std::vector<float> beta_diff(norm_size);
+  std::vector<float> normalized_diff(elem_cnt);
+  const auto Forward = [&]() {
+    LayerNormCpuUtil<float>::Forward(num_instances, norm_size, norm_size, kEpsilon, x.data(),
+                                     gamma.data(), beta.data(), mean.data(), inv_variance.data(),
+                                     normalized.data(), y.data());
+  };
+  const auto Backward = [&]() {
+    LayerNormCpuUtil<float>::ParamBackward(elem_cnt, norm_size, dy.data(), normalized.data(),
+                                           gamma.data(), gamma_diff.data(), beta_diff.data(),
+                                           normalized_diff.data());
+    LayerNormCpuUtil<float>::Backward(num_instances, norm_size, x.data(), normalized_diff.data(),
+                                      mean.data(), inv_variance.data(), nullptr, dx.data());
+  };
+  const int64_t iter_num = 10;
+  const int32_t thread_num = HardwareThreadNum();
+  const double forward_1_ms = AverageMilliseconds(iter_num, Forward);
+  const double backward_1_ms = AverageMilliseconds(iter_num, Backward);
+  double forward_ms = 0;
+  double backward_ms = 0;
+  {
+    ScopedGlobalThreadPool thread_pool(thread_num);
+    forward_ms = AverageMilliseconds(iter_num, Forward);
+    backward_ms = AverageMilliseconds(iter_num, Backward);
+  }
+  LOG(INFO) << "[" << num_instances << ", " << norm_size << "] forward: 1 thread " << forward_1_ms
+            << " ms, " << thread_num << " threads " << forward_ms << " ms, backward: 1 thread "
+            << backward_1_ms << " ms, " << thread_num << " threads " << backward_ms << " ms";
+}
+
+}  // namespace oneflow
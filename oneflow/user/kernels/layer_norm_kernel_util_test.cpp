@@ -0,0 +1,172 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/layer_norm_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+const double kEpsilon = 1e-5;
+
+struct LayerNormCase {
+  int64_t num_instances;
+  int64_t norm_size;
+  // 0 means neither gamma nor beta
+  int64_t instance_size;
+  bool has_gamma;
+  bool has_beta;
+};
+
+std::vector<LayerNormCase> TestCases() {
+  // the last two are large enough for the rows to be split over threads
+  return {{4, 33, 33, true, true},        {7, 16, 16, true, false},  {5, 17, 0, false, false},
+          {6, 10, 30, true, true},        {6, 30, 10, false, true},  {1, 1, 1, true, true},
+          {3, 1000, 1000, true, true},    {3000, 48, 48, true, true}, {8, 9000, 9000, true, true}};
+}
+
+std::vector<float> RandomVector(int64_t n, float offset, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dis(-1, 1);
+  std::vector<float> vec(n);
+  for (float& val : vec) { val = dis(*gen) + offset; }
+  return vec;
+}
+
+// magnitude is the size of the terms summed into expected, a sum that cancels to a small value
+// keeps the rounding error of its terms
+void ExpectNear(double expected, float actual, double magnitude) {
+  ASSERT_NEAR(expected, actual, 1e-4 * std::max({1.0, std::abs(expected), magnitude}));
+}
+
+void ExpectNear(double expected, float actual) { ExpectNear(expected, actual, 0); }
+
+void TestForwardAndBackward(const LayerNormCase& test_case, bool add_to_output) {
+  const int64_t num_instances = test_case.num_instances;
+  const int64_t norm_size = test_case.norm_size;
+  const int64_t elem_cnt = num_instances * norm_size;
+  const int64_t instance_size = test_case.instance_size == 0 ? norm_size : test_case.instance_size;
+  std::mt19937 gen(static_cast<uint32_t>(elem_cnt));
+  // an offset far from zero checks that the one pass variance does not cancel
+  const std::vector<float> x = RandomVector(elem_cnt, 100, &gen);
+  const std::vector<float> dy = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> addend = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> gamma = RandomVector(instance_size, 1, &gen);
+  const std::vector<float> beta = RandomVector(instance_size, 0, &gen);
+  const float* gamma_ptr = test_case.has_gamma ? gamma.data() : nullptr;
+  const float* beta_ptr = test_case.has_beta ? beta.data() : nullptr;
+
+  std::vector<float> mean(num_instances);
+  std::vector<float> inv_variance(num_instances);
+  std::vector<float> normalized(elem_cnt);
+  std::vector<float> y(elem_cnt);
+  LayerNormCpuUtil<float>::Forward(num_instances, norm_size, test_case.instance_size, kEpsilon,
+                                   x.data(), gamma_ptr, beta_ptr, mean.data(),
+                                   inv_variance.data(),
+                                   test_case.has_gamma ? normalized.data() : nullptr, y.data());
+  std::vector<double> ref_x_hat(elem_cnt);
+  std::vector<double> ref_inv_variance(num_instances);
+  FOR_RANGE(int64_t, row, 0, num_instances) {
+    const float* x_row = x.data() + row * norm_size;
+    double sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) { sum += x_row[j]; }
+    const double m = sum / norm_size;
+    double square_sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) { square_sum += (x_row[j] - m) * (x_row[j] - m); }
+    ref_inv_variance[row] = 1 / std::sqrt(square_sum / norm_size + kEpsilon);
+    ExpectNear(m, mean[row]);
+    ExpectNear(ref_inv_variance[row], inv_variance[row]);
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      ref_x_hat[row * norm_size + j] = (x_row[j] - m) * ref_inv_variance[row];
+    }
+  }
+  FOR_RANGE(int64_t, i, 0, elem_cnt) {
+    double ref_y = ref_x_hat[i];
+    if (test_case.has_gamma) {
+      ExpectNear(ref_x_hat[i], normalized[i]);
+      ref_y *= gamma[i % instance_size];
+    }
+    if (test_case.has_beta) { ref_y += beta[i % instance_size]; }
+    ExpectNear(ref_y, y[i]);
+  }
+
+  std::vector<float> dx(addend);
+  LayerNormCpuUtil<float>::Backward(num_instances, norm_size, x.data(), dy.data(), mean.data(),
+                                    inv_variance.data(), add_to_output ? dx.data() : nullptr,
+                                    dx.data());
+  FOR_RANGE(int64_t, row, 0, num_instances) {
+    double sum_dy = 0;
+    double sum_dy_x_hat = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      sum_dy += dy[row * norm_size + j];
+      sum_dy_x_hat += dy[row * norm_size + j] * ref_x_hat[row * norm_size + j];
+    }
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      const int64_t i = row * norm_size + j;
+      double ref_dx = ref_inv_variance[row]
+                      * (dy[i] - sum_dy / norm_size - ref_x_hat[i] * sum_dy_x_hat / norm_size);
+      if (add_to_output) { ref_dx += addend[i]; }
+      // dx sums terms of the size of dy, so the tolerance is absolute
+      ASSERT_NEAR(ref_dx, dx[i], 1e-3);
+    }
+  }
+
+  // the param diffs are over the rows of instance_size elements, as layer_norm_param_grad sees
+  // them, and take the normalized of the forward pass
+  std::vector<float> gamma_diff(instance_size);
+  std::vector<float> beta_diff(instance_size);
+  std::vector<float> normalized_diff(elem_cnt);
+  LayerNormCpuUtil<float>::ParamBackward(
+      elem_cnt, instance_size, dy.data(), test_case.has_gamma ? normalized.data() : y.data(),
+      gamma_ptr, gamma_diff.data(), beta_diff.data(), normalized_diff.data());
+  FOR_RANGE(int64_t, j, 0, instance_size) {
+    double ref_gamma_diff = 0;
+    double ref_beta_diff = 0;
+    double abs_sum = 0;
+    for (int64_t i = j; i < elem_cnt; i += instance_size) {
+      const double val = test_case.has_gamma ? normalized[i] : y[i];
+      ref_gamma_diff += dy[i] * val;
+      ref_beta_diff += dy[i];
+      abs_sum += std::abs(dy[i] * val);
+    }
+    ExpectNear(ref_gamma_diff, gamma_diff[j], abs_sum / std::sqrt(elem_cnt / instance_size));
+    ExpectNear(ref_beta_diff, beta_diff[j], abs_sum / std::sqrt(elem_cnt / instance_size));
+  }
+  FOR_RANGE(int64_t, i, 0, elem_cnt) {
+    const double ref = test_case.has_gamma ? dy[i] * gamma[i % instance_size] : dy[i];
+    ASSERT_EQ(static_cast<float>(ref), normalized_diff[i]);
+  }
+}
+
+}  // namespace
+
+TEST(LayerNormCpuUtil, forward_and_backward) {
+  for (const LayerNormCase& test_case : TestCases()) {
+    TestForwardAndBackward(test_case, false);
+    TestForwardAndBackward(test_case, true);
+  }
+}
+
+class LayerNormCpuUtilMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(LayerNormCpuUtilMultiThread, forward_and_backward) {
+  for (const LayerNormCase& test_case : TestCases()) {
+    TestForwardAndBackward(test_case, false);
+    TestForwardAndBackward(test_case, true);
+  }
+}
+
+}  // namespace oneflow
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/kernels/math_binary_elementwise_func.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
@@ -34,7 +35,9 @@ class MathBinaryElementwiseCpuKernel final : public user_op::OpKernel {
     T* z = tensor_z->mut_dptr<T>();
     int64_t n = tensor_x->shape().elem_cnt();
     CHECK_LE(n, GetMaxVal<int32_t>() / 2);
-    for (int32_t i = 0; i < n; ++i) { z[i] = BinaryFunctor<T>::Forward(x[i], y[i]); }
+    ParallelFor(0, n, kElemwiseParallelForGrain, [x, y, z](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) { z[i] = BinaryFunctor<T>::Forward(x[i], y[i]); }
+    });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -58,7 +61,11 @@ class MathBinaryElementwiseXGradCpuKernel final : public user_op::OpKernel {
     T* dx = tensor_dx->mut_dptr<T>();
     int64_t n = tensor_x->shape().elem_cnt();
     CHECK_LE(n, GetMaxVal<int32_t>() / 2);
-    for (int32_t i = 0; i < n; ++i) { dx[i] = BinaryFunctor<T>::BackwardXGrad(x[i], y[i], dz[i]); }
+    ParallelFor(0, n, kElemwiseParallelForGrain, [x, y, dz, dx](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        dx[i] = BinaryFunctor<T>::BackwardXGrad(x[i], y[i], dz[i]);
+      }
+    });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -82,7 +89,11 @@ class MathBinaryElementwiseYGradCpuKernel final : public user_op::OpKernel {
     T* dy = tensor_dy->mut_dptr<T>();
     int64_t n = tensor_x->shape().elem_cnt();
     CHECK_LE(n, GetMaxVal<int32_t>() / 2);
-    for (int32_t i = 0; i < n; ++i) { dy[i] = BinaryFunctor<T>::BackwardYGrad(x[i], y[i], dz[i]); }
+    ParallelFor(0, n, kElemwiseParallelForGrain, [x, y, dz, dy](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        dy[i] = BinaryFunctor<T>::BackwardYGrad(x[i], y[i], dz[i]);
+      }
+    });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -0,0 +1,280 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/normalization_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+void CheckParamTensor(const user_op::Tensor* tensor, const NormalizationDims& dims,
+                      DataType data_type) {
+  CHECK_EQ(tensor->data_type(), data_type);
+  CHECK_EQ(tensor->shape().NumAxes(), 1);
+  CHECK_EQ(tensor->shape().At(0), dims.channel);
+}
+
+// one bit of the relu mask per element, as the gpu kernels lay it out
+int64_t ReserveSpaceWordCnt(const NormalizationDims& dims) {
+  return static_cast<int64_t>(RoundUp(dims.elem_cnt(), 32) / 32);
+}
+
+// Returns the dptr of the optional param output bn, or of buf if the op has no such output.
+template<typename T>
+T* ParamOutputPtr(user_op::KernelComputeContext* ctx, const std::string& bn,
+                  const NormalizationDims& dims, std::vector<T>* buf) {
+  if (ctx->user_op_conf().has_output(bn, 0)) {
+    user_op::Tensor* tensor = ctx->Tensor4ArgNameAndIndex(bn, 0);
+    CheckParamTensor(tensor, dims, GetDataType<T>::value);
+    return tensor->mut_dptr<T>();
+  }
+  buf->resize(dims.channel);
+  return buf->data();
+}
+
+}  // namespace
+
+template<typename T>
+class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationInferenceCpuKernel() = default;
+  ~NormalizationInferenceCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    CHECK(!ctx->Attr<bool>("training"));
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    const user_op::Tensor* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+    const user_op::Tensor* moving_mean = ctx->Tensor4ArgNameAndIndex("moving_mean", 0);
+    const user_op::Tensor* moving_variance = ctx->Tensor4ArgNameAndIndex("moving_variance", 0);
+    const auto epsilon = ctx->Attr<float>("epsilon");
+    CHECK_EQ(x->shape(), y->shape());
+    CHECK_EQ(y->data_type(), x->data_type());
+    const NormalizationDims dims = GetNormalizationDims(x->shape(), ctx->Attr<int32_t>("axis"));
+    for (const user_op::Tensor* param : {gamma, beta, moving_mean, moving_variance}) {
+      CheckParamTensor(param, dims, x->data_type());
+    }
+    const T* addend = nullptr;
+    if (ctx->user_op_conf().has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), y->data_type());
+      CHECK_EQ(add_to_output->shape(), y->shape());
+      addend = add_to_output->dptr<T>();
+    }
+    std::vector<T> scale(dims.channel);
+    std::vector<T> bias(dims.channel);
+    FOR_RANGE(int64_t, c, 0, dims.channel) {
+      scale[c] = gamma->dptr<T>()[c] / std::sqrt(moving_variance->dptr<T>()[c] + epsilon);
+      bias[c] = beta->dptr<T>()[c] - moving_mean->dptr<T>()[c] * scale[c];
+    }
+    NormalizationCpuUtil<T>::Forward(dims, x->dptr<T>(), scale.data(), bias.data(), addend,
+                                     y->mut_dptr<T>(), nullptr);
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BN_INFERENCE_CPU_KERNEL(dtype)                                                 \
+  REGISTER_USER_KERNEL("normalization")                                                         \
+      .SetCreateFn<NormalizationInferenceCpuKernel<dtype>>()                                    \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)            \
+                       & (user_op::HobAttr<bool>("training") == false))                         \
+      .SetInplaceProposalFn([](const user_op::InferContext& ctx,                                \
+                               user_op::AddInplaceArgPair AddInplaceArgPairFn) -> Maybe<void> { \
+        if (ctx.user_op_conf().has_input("_add_to_output", 0)) {                                \
+          OF_RETURN_IF_ERROR(AddInplaceArgPairFn("y", 0, "_add_to_output", 0, true));           \
+        }                                                                                       \
+        return Maybe<void>::Ok();                                                               \
+      });
+
+REGISTER_BN_INFERENCE_CPU_KERNEL(float)
+REGISTER_BN_INFERENCE_CPU_KERNEL(double)
+
+#undef REGISTER_BN_INFERENCE_CPU_KERNEL
+
+template<typename T>
+class NormalizationTrainCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationTrainCpuKernel() = default;
+  ~NormalizationTrainCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const bool is_add_relu = ctx->user_op_conf().op_type_name() == "normalization_add_relu";
+    if (!is_add_relu) { CHECK(ctx->Attr<bool>("training")); }
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    const user_op::Tensor* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+    user_op::Tensor* moving_mean = ctx->Tensor4ArgNameAndIndex("moving_mean", 0);
+    user_op::Tensor* moving_variance = ctx->Tensor4ArgNameAndIndex("moving_variance", 0);
+    const auto epsilon = ctx->Attr<float>("epsilon");
+    const auto momentum = ctx->Attr<float>("momentum");
+    CHECK_EQ(x->shape(), y->shape());
+    CHECK_EQ(y->data_type(), x->data_type());
+    const NormalizationDims dims = GetNormalizationDims(x->shape(), ctx->Attr<int32_t>("axis"));
+    CheckParamTensor(gamma, dims, x->data_type());
+    CheckParamTensor(beta, dims, x->data_type());
+    CheckParamTensor(moving_mean, dims, x->data_type());
+    CheckParamTensor(moving_variance, dims, x->data_type());
+    std::vector<T> mean_buf;
+    std::vector<T> inv_variance_buf;
+    T* mean = ParamOutputPtr<T>(ctx, "mean", dims, &mean_buf);
+    T* inv_variance = ParamOutputPtr<T>(ctx, "inv_variance", dims, &inv_variance_buf);
+
+    // inv_variance holds the biased variance until the scale is computed
+    NormalizationCpuUtil<T>::ComputeMeanAndVariance(dims, x->dptr<T>(), mean, inv_variance);
+    const int64_t reduce_cnt = dims.reduce_cnt();
+    const T unbiased_factor =
+        reduce_cnt > 1 ? static_cast<T>(reduce_cnt) / static_cast<T>(reduce_cnt - 1)
+                       : static_cast<T>(1);
+    std::vector<T> scale(dims.channel);
+    std::vector<T> bias(dims.channel);
+    FOR_RANGE(int64_t, c, 0, dims.channel) {
+      const T variance = inv_variance[c];
+      moving_mean->mut_dptr<T>()[c] =
+          moving_mean->dptr<T>()[c] * momentum + mean[c] * (1 - momentum);
+      moving_variance->mut_dptr<T>()[c] =
+          moving_variance->dptr<T>()[c] * momentum + variance * unbiased_factor * (1 - momentum);
+      inv_variance[c] = 1 / std::sqrt(variance + epsilon);
+      scale[c] = gamma->dptr<T>()[c] * inv_variance[c];
+      bias[c] = beta->dptr<T>()[c] - mean[c] * scale[c];
+    }
+
+    const T* addend = nullptr;
+    int32_t* mask = nullptr;
+    if (is_add_relu) {
+      CHECK(!ctx->user_op_conf().has_input("_add_to_output", 0));
+      if (ctx->user_op_conf().has_input("addend", 0)) {
+        const user_op::Tensor* addend_tensor = ctx->Tensor4ArgNameAndIndex("addend", 0);
+        CHECK_EQ(addend_tensor->shape(), y->shape());
+        addend = addend_tensor->dptr<T>();
+      }
+      user_op::Tensor* reserve_space = ctx->Tensor4ArgNameAndIndex("reserve_space", 0);
+      CHECK_EQ(reserve_space->data_type(), DataType::kInt32);
+      CHECK_GE(reserve_space->shape().elem_cnt(), ReserveSpaceWordCnt(dims));
+      mask = reserve_space->mut_dptr<int32_t>();
+    } else if (ctx->user_op_conf().has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), y->data_type());
+      CHECK_EQ(add_to_output->shape(), y->shape());
+      addend = add_to_output->dptr<T>();
+    }
+    NormalizationCpuUtil<T>::Forward(dims, x->dptr<T>(), scale.data(), bias.data(), addend,
+                                     y->mut_dptr<T>(), mask);
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BN_TRAIN_CPU_KERNEL(dtype)                                                     \
+  REGISTER_USER_KERNEL("normalization")                                                         \
+      .SetCreateFn<NormalizationTrainCpuKernel<dtype>>()                                        \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)            \
+                       & (user_op::HobAttr<bool>("training") == true))                          \
+      .SetInplaceProposalFn([](const user_op::InferContext& ctx,                                \
+                               user_op::AddInplaceArgPair AddInplaceArgPairFn) -> Maybe<void> { \
+        if (ctx.user_op_conf().has_input("_add_to_output", 0)) {                                \
+          OF_RETURN_IF_ERROR(AddInplaceArgPairFn("y", 0, "_add_to_output", 0, true));           \
+        }                                                                                       \
+        return Maybe<void>::Ok();                                                               \
+      });
+
+REGISTER_BN_TRAIN_CPU_KERNEL(float)
+REGISTER_BN_TRAIN_CPU_KERNEL(double)
+
+#undef REGISTER_BN_TRAIN_CPU_KERNEL
+
+#define REGISTER_BN_ADD_RELU_CPU_KERNEL(dtype)                                        \
+  REGISTER_USER_KERNEL("normalization_add_relu")                                      \
+      .SetCreateFn<NormalizationTrainCpuKernel<dtype>>()                              \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                             \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value));
+
+REGISTER_BN_ADD_RELU_CPU_KERNEL(float)
+REGISTER_BN_ADD_RELU_CPU_KERNEL(double)
+
+#undef REGISTER_BN_ADD_RELU_CPU_KERNEL
+
+template<typename T>
+class NormalizationGradCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationGradCpuKernel() = default;
+  ~NormalizationGradCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    user_op::Tensor* gamma_diff = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0);
+    user_op::Tensor* beta_diff = ctx->Tensor4ArgNameAndIndex("beta_diff", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    CHECK_EQ(dy->shape(), x->shape());
+    CHECK_EQ(dx->shape(), x->shape());
+    const NormalizationDims dims = GetNormalizationDims(x->shape(), ctx->Attr<int32_t>("axis"));
+    for (const user_op::Tensor* param : {gamma, mean, inv_variance}) {
+      CheckParamTensor(param, dims, x->data_type());
+    }
+    CheckParamTensor(gamma_diff, dims, x->data_type());
+    CheckParamTensor(beta_diff, dims, x->data_type());
+
+    const int32_t* mask = nullptr;
+    T* addend_diff = nullptr;
+    if (ctx->user_op_conf().op_type_name() == "normalization_add_relu_grad") {
+      const user_op::Tensor* reserve_space = ctx->Tensor4ArgNameAndIndex("reserve_space", 0);
+      CHECK_GE(reserve_space->shape().elem_cnt(), ReserveSpaceWordCnt(dims));
+      mask = reserve_space->dptr<int32_t>();
+      if (ctx->user_op_conf().has_output("addend_diff", 0)) {
+        user_op::Tensor* addend_diff_tensor = ctx->Tensor4ArgNameAndIndex("addend_diff", 0);
+        CHECK_EQ(addend_diff_tensor->shape(), x->shape());
+        addend_diff = addend_diff_tensor->mut_dptr<T>();
+      }
+    } else {
+      CHECK_EQ(ctx->user_op_conf().op_type_name(), "normalization_grad");
+    }
+    NormalizationCpuUtil<T>::ComputeParamDiff(dims, x->dptr<T>(), dy->dptr<T>(), mask,
+                                              mean->dptr<T>(), inv_variance->dptr<T>(),
+                                              gamma_diff->mut_dptr<T>(), beta_diff->mut_dptr<T>());
+    NormalizationCpuUtil<T>::Backward(dims, x->dptr<T>(), dy->dptr<T>(), mask, mean->dptr<T>(),
+                                      inv_variance->dptr<T>(), gamma->dptr<T>(),
+                                      gamma_diff->dptr<T>(), beta_diff->dptr<T>(),
+                                      dx->mut_dptr<T>(), addend_diff);
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BN_GRAD_CPU_KERNEL(op_type_name, dtype)                              \
+  REGISTER_USER_KERNEL(op_type_name)                                                  \
+      .SetCreateFn<NormalizationGradCpuKernel<dtype>>()                               \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                             \
+                       & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value));
+
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_grad", float)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_grad", double)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_add_relu_grad", float)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_add_relu_grad", double)
+
+#undef REGISTER_BN_GRAD_CPU_KERNEL
+
+}  // namespace oneflow
@@ -0,0 +1,362 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/normalization_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// independent accumulators of a row, the compiler keeps them in a vector register instead of
+// summing serially
+constexpr int64_t kLaneNum = 16;
+// elements per block of the elementwise passes, a multiple of the 32 bits of a mask word
+constexpr int64_t kBlockSize = 4096;
+// rows of a channels last tensor summed in T before the partial sums move to double
+constexpr int64_t kRowBlockSize = 256;
+
+int64_t ReduceTaskNum() {
+  const ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  // a few tasks per thread lets the pool rebalance
+  return thread_pool == nullptr ? 1 : thread_pool->thread_num() * 4;
+}
+
+inline bool IsMaskBitSet(const int32_t* mask, int64_t i) {
+  return (static_cast<uint32_t>(mask[i >> 5]) >> (i & 31)) & 1U;
+}
+
+// the bits of y[k] > 0 for k < size
+template<typename T>
+inline uint32_t PackPositiveBits(const T* y, int64_t size) {
+  uint32_t bits = 0;
+  FOR_RANGE(int64_t, k, 0, size) { bits |= static_cast<uint32_t>(y[k] > 0) << k; }
+  return bits;
+}
+
+// PackPositiveBits(y, 32) without a variable shift per element. The comparisons vectorize into
+// bytes and a multiply gathers the low bits of 8 little endian bytes into one byte.
+template<typename T>
+inline uint32_t PackPositiveBitsOfWord(const T* y) {
+  uint8_t is_positive[32];
+  FOR_RANGE(int64_t, k, 0, 32) { is_positive[k] = y[k] > 0; }
+  uint32_t bits = 0;
+  FOR_RANGE(int64_t, byte, 0, 4) {
+    uint64_t bytes = 0;
+    std::memcpy(&bytes, is_positive + byte * 8, sizeof(bytes));
+    bits |= static_cast<uint32_t>((bytes * 0x0102040810204080ULL) >> 56) << (byte * 8);
+  }
+  return bits;
+}
+
+// Sums the terms AddTerms(c, i, &a, &b) adds for every element i of every channel c into
+// sum_a[c] and sum_b[c].
+template<typename T, typename AddTermsFn>
+void ChannelSums(const NormalizationDims& dims, const AddTermsFn& AddTerms, double* sum_a,
+                 double* sum_b) {
+  const int64_t channel = dims.channel;
+  if (dims.inner == 1) {
+    // channels last, each task sums a block of rows for all channels at once
+    const int64_t task_num = std::max<int64_t>(std::min(dims.outer, ReduceTaskNum()), 1);
+    std::vector<double> partial_a(task_num * channel, 0);
+    std::vector<double> partial_b(task_num * channel, 0);
+    ParallelFor(0, task_num, 1, [&](int64_t task_begin, int64_t task_end) {
+      std::vector<T> acc_buf(2 * channel);
+      T* acc_a = acc_buf.data();
+      T* acc_b = acc_buf.data() + channel;
+      FOR_RANGE(int64_t, task, task_begin, task_end) {
+        double* task_a = partial_a.data() + task * channel;
+        double* task_b = partial_b.data() + task * channel;
+        const int64_t row_end = dims.outer * (task + 1) / task_num;
+        for (int64_t row = dims.outer * task / task_num; row < row_end; row += kRowBlockSize) {
+          std::fill(acc_buf.begin(), acc_buf.end(), static_cast<T>(0));
+          FOR_RANGE(int64_t, r, row, std::min(row + kRowBlockSize, row_end)) {
+            const int64_t offset = r * channel;
+            FOR_RANGE(int64_t, c, 0, channel) { AddTerms(c, offset + c, acc_a + c, acc_b + c); }
+          }
+          FOR_RANGE(int64_t, c, 0, channel) {
+            task_a[c] += acc_a[c];
+            task_b[c] += acc_b[c];
+          }
+        }
+      }
+    });
+    FOR_RANGE(int64_t, c, 0, channel) {
+      sum_a[c] = 0;
+      sum_b[c] = 0;
+      FOR_RANGE(int64_t, task, 0, task_num) {
+        sum_a[c] += partial_a[task * channel + c];
+        sum_b[c] += partial_b[task * channel + c];
+      }
+    }
+  } else {
+    // channels first, each task sums some rows of one channel, small channel counts are split
+    // over several tasks
+    const int64_t split_num =
+        std::max<int64_t>(std::min(dims.outer, ReduceTaskNum() / channel), 1);
+    const int64_t task_num = channel * split_num;
+    std::vector<double> partial_a(task_num, 0);
+    std::vector<double> partial_b(task_num, 0);
+    const int64_t inner = dims.inner;
+    const int64_t lane_end = inner / kLaneNum * kLaneNum;
+    ParallelFor(0, task_num, 1, [&](int64_t task_begin, int64_t task_end) {
+      FOR_RANGE(int64_t, task, task_begin, task_end) {
+        const int64_t c = task / split_num;
+        const int64_t split = task % split_num;
+        double task_a = 0;
+        double task_b = 0;
+        FOR_RANGE(int64_t, n, dims.outer * split / split_num,
+                  dims.outer * (split + 1) / split_num) {
+          const int64_t offset = (n * channel + c) * inner;
+          T lane_a[kLaneNum] = {0};
+          T lane_b[kLaneNum] = {0};
+          for (int64_t j = 0; j < lane_end; j += kLaneNum) {
+            FOR_RANGE(int64_t, l, 0, kLaneNum) {
+              AddTerms(c, offset + j + l, &lane_a[l], &lane_b[l]);
+            }
+          }
+          FOR_RANGE(int64_t, j, lane_end, inner) {
+            AddTerms(c, offset + j, &lane_a[0], &lane_b[0]);
+          }
+          FOR_RANGE(int64_t, l, 0, kLaneNum) {
+            task_a += lane_a[l];
+            task_b += lane_b[l];
+          }
+        }
+        partial_a[task] = task_a;
+        partial_b[task] = task_b;
+      }
+    });
+    FOR_RANGE(int64_t, c, 0, channel) {
+      sum_a[c] = 0;
+      sum_b[c] = 0;
+      FOR_RANGE(int64_t, split, 0, split_num) {
+        sum_a[c] += partial_a[c * split_num + split];
+        sum_b[c] += partial_b[c * split_num + split];
+      }
+    }
+  }
+}
+
+// Calls DoBlock(begin, end) on blocks of kBlockSize elements over the thread pool.
+template<typename DoBlockFn>
+void ForEachBlock(int64_t elem_cnt, const DoBlockFn& DoBlock) {
+  const int64_t block_num = (elem_cnt + kBlockSize - 1) / kBlockSize;
+  ParallelFor(0, block_num, std::max<int64_t>(kElemwiseParallelForGrain / kBlockSize, 1),
+              [&](int64_t block_begin, int64_t block_end) {
+                FOR_RANGE(int64_t, block, block_begin, block_end) {
+                  DoBlock(block * kBlockSize, std::min((block + 1) * kBlockSize, elem_cnt));
+                }
+              });
+}
+
+// Calls DoSegment(c, i, n) on the runs [i, i + n) of [begin, end) that stay in one row. A run
+// has channel c throughout if channels first, and channels c, c + 1, ... if channels last.
+template<bool channels_last, typename DoSegmentFn>
+void ForEachSegment(const NormalizationDims& dims, int64_t begin, int64_t end,
+                    const DoSegmentFn& DoSegment) {
+  int64_t i = begin;
+  while (i < end) {
+    int64_t c = 0;
+    int64_t segment_end = 0;
+    if (channels_last) {
+      c = i % dims.channel;
+      segment_end = std::min(end, i + dims.channel - c);
+    } else {
+      const int64_t row = i / dims.inner;
+      c = row % dims.channel;
+      segment_end = std::min(end, (row + 1) * dims.inner);
+    }
+    DoSegment(c, i, segment_end - i);
+    i = segment_end;
+  }
+}
+
+template<typename T, bool channels_last, bool has_addend, bool relu>
+void ForwardImpl(const NormalizationDims& dims, const T* x, const T* scale, const T* bias,
+                 const T* addend, T* y, int32_t* mask) {
+  ForEachBlock(dims.elem_cnt(), [&](int64_t begin, int64_t end) {
+    ForEachSegment<channels_last>(dims, begin, end, [&](int64_t c0, int64_t i0, int64_t n) {
+      FOR_RANGE(int64_t, k, 0, n) {
+        const int64_t c = channels_last ? c0 + k : c0;
+        const int64_t i = i0 + k;
+        T val = x[i] * scale[c] + bias[c];
+        if (has_addend) { val += addend[i]; }
+        if (relu) { val = val > 0 ? val : static_cast<T>(0); }
+        y[i] = val;
+      }
+    });
+    if (relu) {
+      // blocks start at multiples of 32, so no two blocks share a mask word
+      for (int64_t word_begin = begin; word_begin < end; word_begin += 32) {
+        mask[word_begin >> 5] = static_cast<int32_t>(
+            end - word_begin >= 32 ? PackPositiveBitsOfWord(y + word_begin)
+                                   : PackPositiveBits(y + word_begin, end - word_begin));
+      }
+    }
+  });
+}
+
+template<typename T, bool channels_last, bool has_mask, bool has_addend_diff>
+void BackwardImpl(const NormalizationDims& dims, const T* x, const T* dy, const int32_t* mask,
+                  const T* dy_coef, const T* x_coef, const T* bias, T* dx, T* addend_diff) {
+  ForEachBlock(dims.elem_cnt(), [&](int64_t begin, int64_t end) {
+    ForEachSegment<channels_last>(dims, begin, end, [&](int64_t c0, int64_t i0, int64_t n) {
+      FOR_RANGE(int64_t, k, 0, n) {
+        const int64_t c = channels_last ? c0 + k : c0;
+        const int64_t i = i0 + k;
+        T dy_val = dy[i];
+        if (has_mask) { dy_val = IsMaskBitSet(mask, i) ? dy_val : static_cast<T>(0); }
+        if (has_addend_diff) { addend_diff[i] = dy_val; }
+        dx[i] = dy_val * dy_coef[c] + x[i] * x_coef[c] + bias[c];
+      }
+    });
+  });
+}
+
+template<typename T, bool has_mask>
+void ComputeParamDiffImpl(const NormalizationDims& dims, const T* x, const T* dy,
+                          const int32_t* mask, const T* mean, double* sum_dy,
+                          double* sum_dy_x_centered) {
+  ChannelSums<T>(
+      dims,
+      [=](int64_t c, int64_t i, T* dy_acc, T* dy_x_acc) {
+        T dy_val = dy[i];
+        if (has_mask) { dy_val = IsMaskBitSet(mask, i) ? dy_val : static_cast<T>(0); }
+        *dy_acc += dy_val;
+        *dy_x_acc += dy_val * (x[i] - mean[c]);
+      },
+      sum_dy, sum_dy_x_centered);
+}
+
+}  // namespace
+
+NormalizationDims GetNormalizationDims(const ShapeView& x_shape, int32_t axis) {
+  CHECK_GE(axis, 0);
+  CHECK_LT(axis, x_shape.NumAxes());
+  NormalizationDims dims;
+  dims.outer = x_shape.Count(0, axis);
+  dims.channel = x_shape.At(axis);
+  dims.inner = x_shape.Count(axis + 1);
+  return dims;
+}
+
+template<typename T>
+void NormalizationCpuUtil<T>::ComputeMeanAndVariance(const NormalizationDims& dims, const T* x,
+                                                     T* mean, T* variance) {
+  // sums are taken around the first element of each channel, which keeps the one pass variance
+  // from cancelling when the mean is large against the spread
+  std::vector<T> shift(dims.channel);
+  FOR_RANGE(int64_t, c, 0, dims.channel) { shift[c] = x[c * dims.inner]; }
+  const T* shift_ptr = shift.data();
+  std::vector<double> sum(dims.channel);
+  std::vector<double> square_sum(dims.channel);
+  ChannelSums<T>(
+      dims,
+      [=](int64_t c, int64_t i, T* sum_acc, T* square_sum_acc) {
+        const T centered = x[i] - shift_ptr[c];
+        *sum_acc += centered;
+        *square_sum_acc += centered * centered;
+      },
+      sum.data(), square_sum.data());
+  const double reduce_cnt = dims.reduce_cnt();
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    const double shifted_mean = sum[c] / reduce_cnt;
+    mean[c] = static_cast<T>(shift[c] + shifted_mean);
+    variance[c] =
+        static_cast<T>(std::max(square_sum[c] / reduce_cnt - shifted_mean * shifted_mean, 0.0));
+  }
+}
+
+template<typename T>
+void NormalizationCpuUtil<T>::Forward(const NormalizationDims& dims, const T* x, const T* scale,
+                                      const T* bias, const T* addend, T* y, int32_t* mask) {
+  const bool channels_last = dims.inner == 1;
+#define CALL_FORWARD_IMPL(is_channels_last, has_addend, relu)                                  \
+  if (channels_last == is_channels_last && (addend != nullptr) == has_addend                   \
+      && (mask != nullptr) == relu) {                                                          \
+    return ForwardImpl<T, is_channels_last, has_addend, relu>(dims, x, scale, bias, addend, y, \
+                                                              mask);                           \
+  }
+  CALL_FORWARD_IMPL(false, false, false)
+  CALL_FORWARD_IMPL(false, false, true)
+  CALL_FORWARD_IMPL(false, true, false)
+  CALL_FORWARD_IMPL(false, true, true)
+  CALL_FORWARD_IMPL(true, false, false)
+  CALL_FORWARD_IMPL(true, false, true)
+  CALL_FORWARD_IMPL(true, true, false)
+  CALL_FORWARD_IMPL(true, true, true)
+#undef CALL_FORWARD_IMPL
+}
+
+template<typename T>
+void NormalizationCpuUtil<T>::ComputeParamDiff(const NormalizationDims& dims, const T* x,
+                                               const T* dy, const int32_t* mask, const T* mean,
+                                               const T* inv_variance, T* gamma_diff,
+                                               T* beta_diff) {
+  std::vector<double> sum_dy(dims.channel);
+  std::vector<double> sum_dy_x_centered(dims.channel);
+  if (mask != nullptr) {
+    ComputeParamDiffImpl<T, true>(dims, x, dy, mask, mean, sum_dy.data(),
+                                  sum_dy_x_centered.data());
+  } else {
+    ComputeParamDiffImpl<T, false>(dims, x, dy, mask, mean, sum_dy.data(),
+                                   sum_dy_x_centered.data());
+  }
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    gamma_diff[c] = static_cast<T>(sum_dy_x_centered[c] * inv_variance[c]);
+    beta_diff[c] = static_cast<T>(sum_dy[c]);
+  }
+}
+
+template<typename T>
+void NormalizationCpuUtil<T>::Backward(const NormalizationDims& dims, const T* x, const T* dy,
+                                       const int32_t* mask, const T* mean, const T* inv_variance,
+                                       const T* gamma, const T* gamma_diff, const T* beta_diff,
+                                       T* dx, T* addend_diff) {
+  // dx = gamma * inv_variance * (dy - beta_diff / m - x_hat * gamma_diff / m), folded into
+  // dy * dy_coef + x * x_coef + bias per channel
+  const T reduce_cnt = static_cast<T>(dims.reduce_cnt());
+  std::vector<T> dy_coef(dims.channel);
+  std::vector<T> x_coef(dims.channel);
+  std::vector<T> bias(dims.channel);
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    const T scale = gamma[c] * inv_variance[c];
+    const T x_hat_coef = inv_variance[c] * gamma_diff[c] / reduce_cnt;
+    dy_coef[c] = scale;
+    x_coef[c] = -scale * x_hat_coef;
+    bias[c] = scale * (mean[c] * x_hat_coef - beta_diff[c] / reduce_cnt);
+  }
+  const bool channels_last = dims.inner == 1;
+#define CALL_BACKWARD_IMPL(is_channels_last, has_mask, has_addend_diff)                           \
+  if (channels_last == is_channels_last && (mask != nullptr) == has_mask                          \
+      && (addend_diff != nullptr) == has_addend_diff) {                                           \
+    return BackwardImpl<T, is_channels_last, has_mask, has_addend_diff>(                          \
+        dims, x, dy, mask, dy_coef.data(), x_coef.data(), bias.data(), dx, addend_diff);          \
+  }
+  CALL_BACKWARD_IMPL(false, false, false)
+  CALL_BACKWARD_IMPL(false, true, false)
+  CALL_BACKWARD_IMPL(false, true, true)
+  CALL_BACKWARD_IMPL(true, false, false)
+  CALL_BACKWARD_IMPL(true, true, false)
+  CALL_BACKWARD_IMPL(true, true, true)
+#undef CALL_BACKWARD_IMPL
+  UNIMPLEMENTED();
+}
+
+template struct NormalizationCpuUtil<float>;
+template struct NormalizationCpuUtil<double>;
+
+}  // namespace oneflow
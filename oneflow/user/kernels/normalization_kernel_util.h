@@ -0,0 +1,63 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/shape_view.h"
+
+namespace oneflow {
+
+// x viewed as [outer, channel, inner] around the normalized axis. NCHW normalized at axis 1 has
+// inner = H * W, NHWC has inner = 1.
+struct NormalizationDims {
+  int64_t outer;
+  int64_t channel;
+  int64_t inner;
+
+  int64_t elem_cnt() const { return outer * channel * inner; }
+  // number of elements per channel
+  int64_t reduce_cnt() const { return outer * inner; }
+};
+
+NormalizationDims GetNormalizationDims(const ShapeView& x_shape, int32_t axis);
+
+// Batch normalization on the CPU. Per channel reductions split the channels, or the rows of a
+// channels last tensor, over the thread pool. Elementwise passes walk the tensor in cache sized
+// blocks, each a run of channels with a precomputed scale and bias.
+template<typename T>
+struct NormalizationCpuUtil final {
+  // mean and biased variance of every channel in one pass over x
+  static void ComputeMeanAndVariance(const NormalizationDims& dims, const T* x, T* mean,
+                                     T* variance);
+  // y = x * scale + bias, plus addend if not null, then relu if mask is not null. Bit i % 32 of
+  // mask[i / 32] is set where y[i] > 0. y may alias addend.
+  static void Forward(const NormalizationDims& dims, const T* x, const T* scale, const T* bias,
+                      const T* addend, T* y, int32_t* mask);
+  // gamma_diff = sum(dy * x_hat) and beta_diff = sum(dy) per channel. dy is taken as zero where
+  // the bit of mask is clear if mask is not null.
+  static void ComputeParamDiff(const NormalizationDims& dims, const T* x, const T* dy,
+                               const int32_t* mask, const T* mean, const T* inv_variance,
+                               T* gamma_diff, T* beta_diff);
+  // dx of the training mode forward from the param diffs above. The masked dy is also written to
+  // addend_diff if it is not null.
+  static void Backward(const NormalizationDims& dims, const T* x, const T* dy, const int32_t* mask,
+                       const T* mean, const T* inv_variance, const T* gamma, const T* gamma_diff,
+                       const T* beta_diff, T* dx, T* addend_diff);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
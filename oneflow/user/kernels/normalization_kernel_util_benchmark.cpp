@@ -0,0 +1,114 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/normalization_kernel_util.h"
+#include "oneflow/core/ndarray/ndarray_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+const float kEpsilon = 1e-5;
+
+std::vector<float> RandomVector(int64_t n, float offset, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dis(-1, 1);
+  std::vector<float> vec(n);
+  for (float& val : vec) { val = dis(*gen) + offset; }
+  return vec;
+}
+
+// the composition of ndarray ops a CPU batch norm would otherwise be built from, each op a full
+// pass over x
+void NdarrayNormalizationForward(const Shape& x_shape, const Shape& param_shape, const float* x,
+                                 const float* gamma, const float* beta, float* y, float* tmp,
+                                 float* mean, float* variance) {
+  using Util = NdarrayUtil<DeviceType::kCPU, float>;
+  const int64_t reduce_cnt = x_shape.elem_cnt() / param_shape.elem_cnt();
+  XpuVarNdarray<float> y_arr(x_shape, y);
+  XpuVarNdarray<float> tmp_arr(x_shape, tmp);
+  XpuVarNdarray<float> mean_arr(param_shape, mean);
+  XpuVarNdarray<float> variance_arr(param_shape, variance);
+  Util::ReduceSum(nullptr, mean_arr, XpuVarNdarray<const float>(x_shape, x), tmp_arr);
+  FOR_RANGE(int64_t, c, 0, param_shape.elem_cnt()) { mean[c] /= reduce_cnt; }
+  Util::BroadcastSub(nullptr, y_arr, XpuVarNdarray<const float>(x_shape, x),
+                     XpuVarNdarray<const float>(param_shape, mean));
+  Util::Mul(nullptr, tmp_arr, XpuVarNdarray<const float>(x_shape, y),
+            XpuVarNdarray<const float>(x_shape, y));
+  Util::ReduceSum(nullptr, variance_arr, XpuVarNdarray<const float>(x_shape, tmp), tmp_arr);
+  FOR_RANGE(int64_t, c, 0, param_shape.elem_cnt()) {
+    variance[c] = gamma[c] / std::sqrt(variance[c] / reduce_cnt + kEpsilon);
+  }
+  Util::BroadcastMul(nullptr, tmp_arr, XpuVarNdarray<const float>(x_shape, y),
+                     XpuVarNdarray<const float>(param_shape, variance));
+  Util::BroadcastAdd(nullptr, y_arr, XpuVarNdarray<const float>(x_shape, tmp),
+                     XpuVarNdarray<const float>(param_shape, beta));
+}
+
+void BenchmarkForward(const std::string& layout, const Shape& x_shape, const Shape& param_shape,
+                      int32_t axis) {
+  std::mt19937 gen(0);
+  const int64_t elem_cnt = x_shape.elem_cnt();
+  const NormalizationDims dims = GetNormalizationDims(ShapeView(x_shape), axis);
+  const std::vector<float> x = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> gamma = RandomVector(dims.channel, 1, &gen);
+  const std::vector<float> beta = RandomVector(dims.channel, 0, &gen);
+  std::vector<float> y(elem_cnt);
+  std::vector<float> tmp(elem_cnt);
+  std::vector<float> mean(dims.channel);
+  std::vector<float> variance(dims.channel);
+  std::vector<float> scale(dims.channel);
+  std::vector<float> bias(dims.channel);
+  std::vector<int32_t> mask(RoundUp(elem_cnt, 32) / 32);
+  const int64_t iter_num = 10;
+  const double ndarray_ms = AverageMilliseconds(iter_num, [&]() {
+    NdarrayNormalizationForward(x_shape, param_shape, x.data(), gamma.data(), beta.data(),
+                                y.data(), tmp.data(), mean.data(), variance.data());
+  });
+  const auto FusedForward = [&](const float* addend, int32_t* mask_ptr) {
+    NormalizationCpuUtil<float>::ComputeMeanAndVariance(dims, x.data(), mean.data(),
+                                                        variance.data());
+    FOR_RANGE(int64_t, c, 0, dims.channel) {
+      scale[c] = gamma[c] / std::sqrt(variance[c] + kEpsilon);
+      bias[c] = beta[c] - mean[c] * scale[c];
+    }
+    NormalizationCpuUtil<float>::Forward(dims, x.data(), scale.data(), bias.data(), addend,
+                                         y.data(), mask_ptr);
+  };
+  const int32_t thread_num = HardwareThreadNum();
+  const double single_thread_ms =
+      AverageMilliseconds(iter_num, [&]() { FusedForward(nullptr, nullptr); });
+  double fused_ms = 0;
+  double add_relu_ms = 0;
+  {
+    ScopedGlobalThreadPool thread_pool(thread_num);
+    fused_ms = AverageMilliseconds(iter_num, [&]() { FusedForward(nullptr, nullptr); });
+    add_relu_ms = AverageMilliseconds(iter_num, [&]() { FusedForward(tmp.data(), mask.data()); });
+  }
+  LOG(INFO) << layout << " " << x_shape.ToString() << " forward: ndarray ops " << ndarray_ms
+            << " ms, fused 1 thread " << single_thread_ms << " ms, fused " << thread_num
+            << " threads " << fused_ms << " ms, fused add relu " << add_relu_ms << " ms";
+}
+
+}  // namespace
+
+TEST(NormalizationCpuUtil, forward_benchmark) {
+  // x is viewed as [N, C, H * W] and [N * H * W, C] so that the params broadcast
+  BenchmarkForward("NCHW", Shape({32, 64, 56 * 56}), Shape({1, 64, 1}), 1);
+  BenchmarkForward("NHWC", Shape({32 * 56 * 56, 64}), Shape({1, 64}), 1);
+}
+
+}  // namespace oneflow
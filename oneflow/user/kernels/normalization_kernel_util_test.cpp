@@ -0,0 +1,182 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/normalization_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+const float kEpsilon = 1e-5;
+
+struct NormalizationCase {
+  Shape shape;
+  int32_t axis;
+};
+
+std::vector<NormalizationCase> TestCases() {
+  // the last two are large enough for the elementwise passes to be split over threads
+  return {{Shape({4, 5, 7, 9}), 1},    {Shape({4, 7, 9, 5}), 3},  {Shape({3, 6}), 1},
+          {Shape({2, 3, 1000}), 1},    {Shape({1, 1, 33}), 1},    {Shape({1000, 3}), 1},
+          {Shape({8, 3, 64, 65}), 1}, {Shape({4099, 24}), 1}};
+}
+
+std::vector<float> RandomVector(int64_t n, float offset, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dis(-1, 1);
+  std::vector<float> vec(n);
+  for (float& val : vec) { val = dis(*gen) + offset; }
+  return vec;
+}
+
+template<typename ForEachFn>
+void ForEachElemOfChannel(const NormalizationDims& dims, int64_t c, const ForEachFn& DoEach) {
+  FOR_RANGE(int64_t, n, 0, dims.outer) {
+    FOR_RANGE(int64_t, j, 0, dims.inner) { DoEach((n * dims.channel + c) * dims.inner + j); }
+  }
+}
+
+void NaiveMeanAndInvVariance(const NormalizationDims& dims, const std::vector<float>& x,
+                             std::vector<double>* mean, std::vector<double>* inv_variance) {
+  mean->assign(dims.channel, 0);
+  inv_variance->assign(dims.channel, 0);
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    double sum = 0;
+    ForEachElemOfChannel(dims, c, [&](int64_t i) { sum += x[i]; });
+    const double m = sum / dims.reduce_cnt();
+    double square_sum = 0;
+    ForEachElemOfChannel(dims, c, [&](int64_t i) { square_sum += (x[i] - m) * (x[i] - m); });
+    mean->at(c) = m;
+    inv_variance->at(c) = 1 / std::sqrt(square_sum / dims.reduce_cnt() + kEpsilon);
+  }
+}
+
+bool IsBitSet(const std::vector<int32_t>& mask, int64_t i) {
+  return (static_cast<uint32_t>(mask[i / 32]) >> (i % 32)) & 1U;
+}
+
+// magnitude is the size of the terms summed into expected, a sum that cancels to a small value
+// keeps the rounding error of its terms
+void ExpectNear(double expected, float actual, double magnitude) {
+  ASSERT_NEAR(expected, actual, 1e-4 * std::max({1.0, std::abs(expected), magnitude}));
+}
+
+void ExpectNear(double expected, float actual) { ExpectNear(expected, actual, 0); }
+
+void TestForwardAndBackward(const NormalizationCase& test_case, bool add_relu) {
+  std::mt19937 gen(static_cast<uint32_t>(test_case.shape.elem_cnt()));
+  const NormalizationDims dims = GetNormalizationDims(ShapeView(test_case.shape), test_case.axis);
+  const int64_t elem_cnt = dims.elem_cnt();
+  // an offset far from zero checks that the one pass variance does not cancel
+  const std::vector<float> x = RandomVector(elem_cnt, 100, &gen);
+  const std::vector<float> addend = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> dy = RandomVector(elem_cnt, 0, &gen);
+  const std::vector<float> gamma = RandomVector(dims.channel, 1, &gen);
+  const std::vector<float> beta = RandomVector(dims.channel, 0, &gen);
+
+  std::vector<double> ref_mean;
+  std::vector<double> ref_inv_variance;
+  NaiveMeanAndInvVariance(dims, x, &ref_mean, &ref_inv_variance);
+  std::vector<float> mean(dims.channel);
+  std::vector<float> variance(dims.channel);
+  NormalizationCpuUtil<float>::ComputeMeanAndVariance(dims, x.data(), mean.data(),
+                                                      variance.data());
+  std::vector<float> inv_variance(dims.channel);
+  std::vector<float> scale(dims.channel);
+  std::vector<float> bias(dims.channel);
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    ExpectNear(ref_mean[c], mean[c]);
+    ExpectNear(ref_inv_variance[c], 1 / std::sqrt(variance[c] + kEpsilon));
+    inv_variance[c] = 1 / std::sqrt(variance[c] + kEpsilon);
+    scale[c] = gamma[c] * inv_variance[c];
+    bias[c] = beta[c] - mean[c] * scale[c];
+  }
+
+  std::vector<float> y(elem_cnt);
+  std::vector<int32_t> mask(RoundUp(elem_cnt, 32) / 32, -1);
+  NormalizationCpuUtil<float>::Forward(dims, x.data(), scale.data(), bias.data(),
+                                       add_relu ? addend.data() : nullptr, y.data(),
+                                       add_relu ? mask.data() : nullptr);
+  std::vector<double> ref_y(elem_cnt);
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    ForEachElemOfChannel(dims, c, [&](int64_t i) {
+      double val = (x[i] - ref_mean[c]) * ref_inv_variance[c] * gamma[c] + beta[c];
+      if (add_relu) { val = std::max(val + addend[i], 0.0); }
+      ref_y[i] = val;
+    });
+  }
+  FOR_RANGE(int64_t, i, 0, elem_cnt) {
+    ExpectNear(ref_y[i], y[i]);
+    if (add_relu) { ASSERT_EQ(IsBitSet(mask, i), y[i] > 0); }
+  }
+
+  std::vector<float> gamma_diff(dims.channel);
+  std::vector<float> beta_diff(dims.channel);
+  std::vector<float> dx(elem_cnt);
+  std::vector<float> addend_diff(elem_cnt);
+  const int32_t* mask_ptr = add_relu ? mask.data() : nullptr;
+  NormalizationCpuUtil<float>::ComputeParamDiff(dims, x.data(), dy.data(), mask_ptr, mean.data(),
+                                                inv_variance.data(), gamma_diff.data(),
+                                                beta_diff.data());
+  NormalizationCpuUtil<float>::Backward(dims, x.data(), dy.data(), mask_ptr, mean.data(),
+                                        inv_variance.data(), gamma.data(), gamma_diff.data(),
+                                        beta_diff.data(), dx.data(),
+                                        add_relu ? addend_diff.data() : nullptr);
+  FOR_RANGE(int64_t, c, 0, dims.channel) {
+    double ref_gamma_diff = 0;
+    double ref_beta_diff = 0;
+    double abs_sum = 0;
+    const auto MaskedDy = [&](int64_t i) -> double {
+      return add_relu && !IsBitSet(mask, i) ? 0.0 : dy[i];
+    };
+    ForEachElemOfChannel(dims, c, [&](int64_t i) {
+      ref_beta_diff += MaskedDy(i);
+      ref_gamma_diff += MaskedDy(i) * (x[i] - ref_mean[c]) * ref_inv_variance[c];
+      abs_sum += std::abs(MaskedDy(i));
+    });
+    ExpectNear(ref_gamma_diff, gamma_diff[c], abs_sum / std::sqrt(dims.reduce_cnt()));
+    ExpectNear(ref_beta_diff, beta_diff[c], abs_sum / std::sqrt(dims.reduce_cnt()));
+    const double m = dims.reduce_cnt();
+    ForEachElemOfChannel(dims, c, [&](int64_t i) {
+      const double x_hat = (x[i] - ref_mean[c]) * ref_inv_variance[c];
+      const double ref_dx = gamma[c] * ref_inv_variance[c]
+                            * (MaskedDy(i) - ref_beta_diff / m - x_hat * ref_gamma_diff / m);
+      // dx sums terms of the size of dy, so the tolerance is absolute
+      ASSERT_NEAR(ref_dx, dx[i], 1e-3);
+      if (add_relu) { ASSERT_EQ(static_cast<double>(addend_diff[i]), MaskedDy(i)); }
+    });
+  }
+}
+
+}  // namespace
+
+TEST(NormalizationCpuUtil, forward_and_backward) {
+  for (const NormalizationCase& test_case : TestCases()) {
+    TestForwardAndBackward(test_case, false);
+    TestForwardAndBackward(test_case, true);
+  }
+}
+
+class NormalizationCpuUtilMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(NormalizationCpuUtilMultiThread, forward_and_backward) {
+  for (const NormalizationCase& test_case : TestCases()) {
+    TestForwardAndBackward(test_case, false);
+    TestForwardAndBackward(test_case, true);
+  }
+}
+
+}  // namespace oneflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/common/tensor_buffer.h"
+#include "oneflow/core/thread/thread_manager.h"
 #include "oneflow/user/kernels/example_generated.h"
 
 namespace oneflow {
@@ -26,25 +27,62 @@ int64_t GetBatchSizeInBytes(int64_t batch_size, const Shape& shape, const DataTy
   return batch_size * shape.elem_cnt() * GetSizeOfDataType(data_type);
 }
 
-void GetTensorsFromRecords(const TensorBuffer* records, const int64_t record_num,
-                           const std::string& key,
-                           std::vector<const onerec::example::Tensor*>* tensors) {
-  tensors->resize(record_num);
-  for (int32_t i = 0; i < record_num; ++i) {
-    const TensorBuffer* cur_record = records + i;
-    const auto buffer = reinterpret_cast<const uint8_t*>(cur_record->data());
+using OneRecFeatures = flatbuffers::Vector<flatbuffers::Offset<onerec::example::Feature>>;
+
+// Features are sorted by name. Records written by the same writer share their schema, so the
+// position of key in the previous record is tried before a binary search.
+const onerec::example::Feature* FindFeature(const OneRecFeatures* features, const std::string& key,
+                                            flatbuffers::uoffset_t* pos) {
+  const flatbuffers::uoffset_t size = features->size();
+  if (*pos < size && features->Get(*pos)->KeyCompareWithValue(key.c_str()) == 0) {
+    return features->Get(*pos);
+  }
+  flatbuffers::uoffset_t begin = 0;
+  flatbuffers::uoffset_t end = size;
+  while (begin < end) {
+    const flatbuffers::uoffset_t mid = begin + (end - begin) / 2;
+    if (features->Get(mid)->KeyCompareWithValue(key.c_str()) < 0) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  CHECK(begin < size && features->Get(begin)->KeyCompareWithValue(key.c_str()) == 0)
+      << "no feature " << key;
+  *pos = begin;
+  return features->Get(begin);
+}
 
+// Collects the tensor of every key from every record, walking each record once. tensors[k]
+// holds the column of keys[k].
+void GetTensorsOfKeysFromRecords(
+    const TensorBuffer* records, const int64_t record_num, const std::vector<std::string>& keys,
+    std::vector<std::vector<const onerec::example::Tensor*>>* tensors) {
+  tensors->resize(keys.size());
+  for (auto& column : *tensors) { column.resize(record_num); }
+  std::vector<flatbuffers::uoffset_t> key_pos(keys.size(), 0);
+  for (int64_t i = 0; i < record_num; ++i) {
+    const auto buffer = reinterpret_cast<const uint8_t*>(records[i].data());
     const onerec::example::Example* example = onerec::example::GetExample(buffer);
-    const auto* features = example->features();
+    const OneRecFeatures* features = example->features();
     CHECK_NOTNULL(features);
-    const onerec::example::Feature* feature = features->LookupByKey(key.c_str());
-    CHECK_NOTNULL(feature);
-    const onerec::example::Tensor* tensor = feature->tensor();
-    CHECK_NOTNULL(tensor);
-    (*tensors)[i] = tensor;
+    FOR_RANGE(size_t, k, 0, keys.size()) {
+      const onerec::example::Tensor* tensor =
+          FindFeature(features, keys.at(k), &key_pos.at(k))->tensor();
+      CHECK_NOTNULL(tensor);
+      (*tensors)[k][i] = tensor;
+    }
   }
 }
 
+void GetTensorsFromRecords(const TensorBuffer* records, const int64_t record_num,
+                           const std::string& key,
+                           std::vector<const onerec::example::Tensor*>* tensors) {
+  std::vector<std::vector<const onerec::example::Tensor*>> columns;
+  GetTensorsOfKeysFromRecords(records, record_num, {key}, &columns);
+  tensors->swap(columns.front());
+}
+
 void GetTensorDimsWithoutReshape(const std::vector<const onerec::example::Tensor*>& tensors,
                                  const int32_t num_axes,
                                  std::vector<std::vector<int32_t>>* tensor_dims) {
@@ -159,15 +197,14 @@ void CopyTensorsToBuffer(const std::vector<const onerec::example::Tensor*>& tens
   }
 }
 
-void DecodeField(const TensorBuffer* records, const int64_t record_num, const std::string key,
+void DecodeField(const std::vector<const onerec::example::Tensor*>& tensors,
                  const DataType data_type, const Shape& static_shape, const bool is_dynamic,
                  const bool has_reshape, const Shape& reshape, const bool has_batch_padding,
                  const Shape& batch_padding, user_op::Tensor* out_blob) {
+  const int64_t record_num = tensors.size();
   const int32_t batch_size = record_num;
   char* out_ptr = out_blob->mut_dptr<char>();
   const int64_t out_bytes = out_blob->shape().elem_cnt() * GetSizeOfDataType(data_type);
-  std::vector<const onerec::example::Tensor*> tensors;
-  GetTensorsFromRecords(records, record_num, key, &tensors);
   std::vector<std::vector<int32_t>> tensor_dims;
   if (has_reshape) {
     CHECK_EQ(reshape.NumAxes(), static_shape.NumAxes());
@@ -257,12 +294,43 @@ class OneRecDecoderKernel final : public user_op::OpKernel {
     const bool has_batch_padding = ctx->Attr<bool>("has_batch_padding");
     const Shape& batch_padding = ctx->Attr<Shape>("batch_padding");
 
-    DecodeField(records, record_num, key, data_type, static_shape, is_dynamic, has_reshape, reshape,
+    std::vector<const onerec::example::Tensor*> tensors;
+    GetTensorsFromRecords(records, record_num, key, &tensors);
+    DecodeField(tensors, data_type, static_shape, is_dynamic, has_reshape, reshape,
                 has_batch_padding, batch_padding, out_blob);
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
 
+// Decodes several fields of a batch at once. The records are walked once for all keys, then
+// every field is copied column-wise into its contiguous output on its own thread.
+class OneRecBatchDecoderKernel final : public user_op::OpKernel {
+ public:
+  OneRecBatchDecoderKernel() = default;
+  ~OneRecBatchDecoderKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in_blob = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const int64_t record_num = in_blob->shape().At(0);
+    CHECK(record_num > 0);
+    const TensorBuffer* records = in_blob->dptr<TensorBuffer>();
+    const auto& keys = ctx->Attr<std::vector<std::string>>("keys");
+    const auto& data_types = ctx->Attr<std::vector<DataType>>("data_types");
+    const auto& static_shapes = ctx->Attr<std::vector<Shape>>("static_shapes");
+    const bool is_dynamic = ctx->Attr<bool>("is_dynamic");
+    CHECK_EQ(ctx->user_op_conf().output_size("out"), static_cast<int32_t>(keys.size()));
+    std::vector<std::vector<const onerec::example::Tensor*>> tensors;
+    GetTensorsOfKeysFromRecords(records, record_num, keys, &tensors);
+    MultiThreadLoop(keys.size(), [&](size_t k) {
+      const Shape& static_shape = static_shapes.at(k);
+      DecodeField(tensors.at(k), data_types.at(k), static_shape, is_dynamic, false, static_shape,
+                  false, static_shape, ctx->Tensor4ArgNameAndIndex("out", k));
+    });
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
 #define REGISTER_ONEREC_DECODER_KERNEL(dtype)                                       \
   REGISTER_USER_KERNEL("onerec_decoder")                                            \
       .SetCreateFn<OneRecDecoderKernel<dtype>>()                                    \
@@ -278,4 +346,9 @@ REGISTER_ONEREC_DECODER_KERNEL(int32_t)
 REGISTER_ONEREC_DECODER_KERNEL(int64_t)
 REGISTER_ONEREC_DECODER_KERNEL(uint8_t)
 
+REGISTER_USER_KERNEL("onerec_batch_decoder")
+    .SetCreateFn<OneRecBatchDecoderKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")
+                     & (user_op::HobDataType("in", 0) == DataType::kTensorBuffer));
+
 }  // namespace oneflow
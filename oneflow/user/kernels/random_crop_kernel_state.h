@@ -43,6 +43,9 @@ class RandomCropKernelState final : public user_op::OpKernelState {
 };
 
 std::shared_ptr<RandomCropKernelState> CreateRandomCropKernelState(user_op::KernelInitContext* ctx);
+// one generator per sample of a batch of the given size
+std::shared_ptr<RandomCropKernelState> CreateRandomCropKernelState(user_op::KernelInitContext* ctx,
+                                                                   int32_t size);
 
 }  // namespace oneflow
 
@@ -14,93 +14,149 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/softmax_kernel_util.h"
-#include "oneflow/core/ndarray/ndarray_util.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
 namespace {
 
+// independent accumulators of a row, the compiler keeps them in vector registers
+constexpr int64_t kLaneNum = 16;
+
+int64_t RowGrain(int64_t w) {
+  return std::max<int64_t>(kElemwiseParallelForGrain / std::max<int64_t>(w, 1), 1);
+}
+
 template<typename T>
-size_t GetProbTmpSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * sizeof(T));
+T RowMax(int64_t w, const T* x) {
+  T lane_max[kLaneNum];
+  std::fill(lane_max, lane_max + kLaneNum, x[0]);
+  const int64_t lane_end = w / kLaneNum * kLaneNum;
+  for (int64_t j = 0; j < lane_end; j += kLaneNum) {
+    FOR_RANGE(int64_t, l, 0, kLaneNum) { lane_max[l] = std::max(lane_max[l], x[j + l]); }
+  }
+  FOR_RANGE(int64_t, j, lane_end, w) { lane_max[0] = std::max(lane_max[0], x[j]); }
+  return *std::max_element(lane_max, lane_max + kLaneNum);
+}
+
+// exp(x) for x <= 0, the softmax of a row only takes the exp of in[j] - max. std::exp is a libm
+// call that keeps the loop scalar, this is plain arithmetic the compiler vectorizes. Cody-Waite
+// range reduction x = n * ln(2) + r, a degree 7 polynomial for exp(r) and 2^n from the exponent
+// bits, within 1e-7 relative error. Results below the smallest normal float, -inf included,
+// flush to 0 and NaN stays NaN.
+inline float ExpOfNonPositive(float x) {
+  // -87.3f, the smallest x whose exp is a normal float
+  constexpr uint32_t kMinBits = 0xC2AE999AU;
+  constexpr uint32_t kNegInfBits = 0xFF800000U;
+  constexpr uint32_t kNaNBits = 0x7FC00000U;
+  // The selects are masks on the bits, float compares and branches do not vectorize under the
+  // default -ftrapping-math. With the sign bit set, a larger uint is a more negative float, and
+  // the uints above -inf are the NaNs with the sign bit set. A NaN without it passes the clamp
+  // and the arithmetic below keeps it.
+  uint32_t x_bits;
+  std::memcpy(&x_bits, &x, sizeof(x));
+  const uint32_t nan_mask = 0U - static_cast<uint32_t>(x_bits > kNegInfBits);
+  const uint32_t underflow_mask = 0U - static_cast<uint32_t>(x_bits > kMinBits);
+  x_bits = std::min<uint32_t>(x_bits, kMinBits);
+  std::memcpy(&x, &x_bits, sizeof(x));
+  // adding 1.5 * 2^23 rounds x * log2(e) to the integer n, left in the low mantissa bits
+  const float shifted = x * 1.44269504088896341f + 12582912.f;
+  const float n = shifted - 12582912.f;
+  const float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.f;
+  // the low bits of shifted hold n as a two's complement int, n + 127 is the biased exponent
+  uint32_t scale_bits;
+  std::memcpy(&scale_bits, &shifted, sizeof(shifted));
+  scale_bits = (scale_bits + 127U) << 23;
+  float scale;
+  std::memcpy(&scale, &scale_bits, sizeof(scale));
+  const float result = p * scale;
+  uint32_t result_bits;
+  std::memcpy(&result_bits, &result, sizeof(result));
+  result_bits = (result_bits & ~underflow_mask) | (kNaNBits & nan_mask);
+  float masked_result;
+  std::memcpy(&masked_result, &result_bits, sizeof(result_bits));
+  return masked_result;
 }
 
+inline double ExpOfNonPositive(double x) { return std::exp(x); }
+
+// prob[j] = exp(in[j] - max_val), returns the sum of prob
 template<typename T>
-size_t GetDiffTmpSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * sizeof(T));
+T ExpAndSum(int64_t w, const T* in, T max_val, T* prob) {
+  T lane_sum[kLaneNum] = {0};
+  const int64_t lane_end = w / kLaneNum * kLaneNum;
+  for (int64_t j = 0; j < lane_end; j += kLaneNum) {
+    FOR_RANGE(int64_t, l, 0, kLaneNum) {
+      const T e = ExpOfNonPositive(in[j + l] - max_val);
+      prob[j + l] = e;
+      lane_sum[l] += e;
+    }
+  }
+  FOR_RANGE(int64_t, j, lane_end, w) {
+    prob[j] = ExpOfNonPositive(in[j] - max_val);
+    lane_sum[0] += prob[j];
+  }
+  T sum = 0;
+  FOR_RANGE(int64_t, l, 0, kLaneNum) { sum += lane_sum[l]; }
+  return sum;
 }
 
 template<typename T>
-size_t GetReduceTempStorageSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * w * sizeof(T));
+T RowDot(int64_t w, const T* x, const T* y) {
+  T lane_sum[kLaneNum] = {0};
+  const int64_t lane_end = w / kLaneNum * kLaneNum;
+  for (int64_t j = 0; j < lane_end; j += kLaneNum) {
+    FOR_RANGE(int64_t, l, 0, kLaneNum) { lane_sum[l] += x[j + l] * y[j + l]; }
+  }
+  FOR_RANGE(int64_t, j, lane_end, w) { lane_sum[0] += x[j] * y[j]; }
+  T sum = 0;
+  FOR_RANGE(int64_t, l, 0, kLaneNum) { sum += lane_sum[l]; }
+  return sum;
 }
 
 }  // namespace
 
+// Fused per row and parallel over rows. A row is read from memory once and stays in cache for
+// its max, exp-and-sum and normalize sweeps, so no temp storage is needed.
 template<typename T>
 struct SoftmaxKernelUtil<DeviceType::kCPU, T> {
-  static size_t GetComputeProbTempStorageSizeInBytes(int64_t n, int64_t w) {
-    return GetProbTmpSize<T>(n, w) + GetReduceTempStorageSize<T>(n, w);
-  }
+  static size_t GetComputeProbTempStorageSizeInBytes(int64_t n, int64_t w) { return 0; }
 
-  static size_t GetComputeDiffTempStorageSizeInBytes(int64_t n, int64_t w) {
-    return GetDiffTmpSize<T>(n, w) + GetReduceTempStorageSize<T>(n, w);
-  }
+  static size_t GetComputeDiffTempStorageSizeInBytes(int64_t n, int64_t w) { return 0; }
 
   static void ComputeProb(DeviceCtx* ctx, const int64_t n, const int64_t w, const T* in, T* prob,
                           void* temp_storage, const size_t temp_storage_bytes) {
-    auto Val = NdarrayUtil<DeviceType::kCPU, T>::GetValNdarrayBuilder();
-    auto Var = NdarrayUtil<DeviceType::kCPU, T>::GetVarNdarrayBuilder();
-    const size_t min_temp_storage_bytes =
-        SoftmaxKernelUtil<DeviceType::kCPU, T>::GetComputeProbTempStorageSizeInBytes(n, w);
-    CHECK_GE(temp_storage_bytes, min_temp_storage_bytes);
-    const size_t reduce_temp_storage_bytes = GetReduceTempStorageSize<T>(n, w);
-    T* reduce_storage = reinterpret_cast<T*>(temp_storage);
-    auto reduce_storage_var =
-        Var({static_cast<int64_t>(reduce_temp_storage_bytes / sizeof(T))}, reduce_storage);
-    T* tmp = reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(temp_storage)
-                                  + reduce_temp_storage_bytes);
-    // max | tmp[i] = Max_j(in[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceMax(ctx, Var({n, 1}, tmp), Val({n, w}, in),
-                                                reduce_storage_var);
-    // sub | prob[i][j] = in[i][j] - tmp[i]
-    NdarrayUtil<DeviceType::kCPU, T>::BroadcastSub(ctx, Var({n, w}, prob), Val({n, w}, in),
-                                                   Val({n, 1}, tmp));
-    // exp | prob[i][j] = exp(prob[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceExp(ctx, Var({n, w}, prob));
-    // sum | tmp[i] = Sum_j(prob[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceSum(ctx, Var({n, 1}, tmp), Val({n, w}, prob),
-                                                reduce_storage_var);
-    // div | prob[i][j] /= tmp[i]
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceBroadcastDiv(ctx, Var({n, w}, prob), Val({n, 1}, tmp));
+    if (w == 0) { return; }
+    ParallelFor(0, n, RowGrain(w), [&](int64_t row_begin, int64_t row_end) {
+      FOR_RANGE(int64_t, i, row_begin, row_end) {
+        const T* in_row = in + i * w;
+        T* prob_row = prob + i * w;
+        const T inv_sum = 1 / ExpAndSum(w, in_row, RowMax(w, in_row), prob_row);
+        FOR_RANGE(int64_t, j, 0, w) { prob_row[j] *= inv_sum; }
+      }
+    });
   }
 
   static void ComputeDiff(DeviceCtx* ctx, const int64_t n, const int64_t w, const T* dy,
                           const T* out, T* dx, void* temp_storage,
                           const size_t temp_storage_bytes) {
-    auto Val = NdarrayUtil<DeviceType::kCPU, T>::GetValNdarrayBuilder();
-    auto Var = NdarrayUtil<DeviceType::kCPU, T>::GetVarNdarrayBuilder();
-    const size_t min_temp_storage_bytes =
-        SoftmaxKernelUtil<DeviceType::kCPU, T>::GetComputeProbTempStorageSizeInBytes(n, w);
-    CHECK_GE(temp_storage_bytes, min_temp_storage_bytes);
-    const size_t reduce_temp_storage_bytes = GetReduceTempStorageSize<T>(n, w);
-    T* reduce_storage = reinterpret_cast<T*>(temp_storage);
-    auto reduce_storage_var =
-        Var({static_cast<int64_t>(reduce_temp_storage_bytes / sizeof(T))}, reduce_storage);
-    T* sum_vec = reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(temp_storage)
-                                      + reduce_temp_storage_bytes);
-    // it's safe to use dx as tmp
-    // dot product | get dot product sum_vec[i] from out[i] * dy[i]
-    T* tmp = dx;
-    NdarrayUtil<DeviceType::kCPU, T>::Mul(ctx, Var({n * w}, tmp), Val({n * w}, out),
-                                          Val({n * w}, dy));
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceSum(ctx, Var({n, 1}, sum_vec), Val({n, w}, tmp),
-                                                reduce_storage_var);
-    // sub | dx[i][j] = dy[i][j] - sum_vec[i]
-    NdarrayUtil<DeviceType::kCPU, T>::BroadcastSub(ctx, Var({n, w}, dx), Val({n, w}, dy),
-                                                   Val({n, 1}, sum_vec));
-    // elementwise multiplication | dx[i][j] *= out[i][j]
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceMul(ctx, Var({n * w}, dx), Val({n * w}, out));
+    // dx[i][j] = (dy[i][j] - dot(dy[i], out[i])) * out[i][j], dx may alias dy
+    ParallelFor(0, n, RowGrain(w), [&](int64_t row_begin, int64_t row_end) {
+      FOR_RANGE(int64_t, i, row_begin, row_end) {
+        const T* dy_row = dy + i * w;
+        const T* out_row = out + i * w;
+        T* dx_row = dx + i * w;
+        const T dot = RowDot(w, dy_row, out_row);
+        FOR_RANGE(int64_t, j, 0, w) { dx_row[j] = (dy_row[j] - dot) * out_row[j]; }
+      }
+    });
   }
 };
 
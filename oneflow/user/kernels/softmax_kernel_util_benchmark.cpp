@@ -0,0 +1,77 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/softmax_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+template<typename T>
+std::vector<T> RandomVector(int64_t n, T scale, std::mt19937* gen) {
+  std::uniform_real_distribution<T> dis(-scale, scale);
+  std::vector<T> vec(n);
+  for (T& val : vec) { val = dis(*gen); }
+  return vec;
+}
+
+// the ndarray path this replaces: max, sub, exp, sum and div, each a pass over n * w
+void UnfusedSoftmax(int64_t n, int64_t w, const float* in, float* prob, float* tmp) {
+  FOR_RANGE(int64_t, i, 0, n) {
+    tmp[i] = in[i * w];
+    FOR_RANGE(int64_t, j, 0, w) { tmp[i] = std::max(tmp[i], in[i * w + j]); }
+  }
+  FOR_RANGE(int64_t, i, 0, n * w) { prob[i] = in[i] - tmp[i / w]; }
+  FOR_RANGE(int64_t, i, 0, n * w) { prob[i] = std::exp(prob[i]); }
+  FOR_RANGE(int64_t, i, 0, n) {
+    tmp[i] = 0;
+    FOR_RANGE(int64_t, j, 0, w) { tmp[i] += prob[i * w + j]; }
+  }
+  FOR_RANGE(int64_t, i, 0, n * w) { prob[i] /= tmp[i / w]; }
+}
+
+}  // namespace
+
+TEST(SoftmaxKernelUtil, benchmark) {
+  // attention scores [batch * heads * seq_len, seq_len] and classifier logits [batch, classes]
+  for (const std::pair<int64_t, int64_t>& n7w : std::vector<std::pair<int64_t, int64_t>>{
+           {32 * 12 * 128, 128}, {256, 1000}}) {
+    const int64_t n = n7w.first;
+    const int64_t w = n7w.second;
+    std::mt19937 gen(0);
+    const std::vector<float> in = RandomVector<float>(n * w, 10, &gen);
+    const std::vector<float> dy = RandomVector<float>(n * w, 1, &gen);
+    std::vector<float> prob(n * w);
+    std::vector<float> dx(n * w);
+    std::vector<float> tmp(n);
+    const int64_t iter_num = std::max<int64_t>(2e7 / (n * w), 1);
+    const double unfused_ms = AverageMilliseconds(
+        iter_num, [&]() { UnfusedSoftmax(n, w, in.data(), prob.data(), tmp.data()); });
+    const double prob_ms = AverageMilliseconds(iter_num, [&]() {
+      SoftmaxKernelUtil<DeviceType::kCPU, float>::ComputeProb(nullptr, n, w, in.data(),
+                                                              prob.data(), nullptr, 0);
+    });
+    const double diff_ms = AverageMilliseconds(iter_num, [&]() {
+      SoftmaxKernelUtil<DeviceType::kCPU, float>::ComputeDiff(nullptr, n, w, dy.data(),
+                                                              prob.data(), dx.data(), nullptr, 0);
+    });
+    LOG(INFO) << "[" << n << ", " << w << "] unfused prob " << unfused_ms << " ms, prob "
+              << prob_ms << " ms, diff " << diff_ms << " ms";
+  }
+}
+
+}  // namespace oneflow
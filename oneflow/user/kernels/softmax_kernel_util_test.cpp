@@ -0,0 +1,123 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/softmax_kernel_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+struct SoftmaxCase {
+  int64_t n;
+  int64_t w;
+};
+
+std::vector<SoftmaxCase> TestCases() {
+  // odd widths leave a lane tail, the last two are large enough for the rows to be split over
+  // threads
+  return {{1, 1}, {3, 7}, {5, 16}, {4, 33}, {2, 1000}, {3000, 10}, {64, 4096}};
+}
+
+template<typename T>
+std::vector<T> RandomVector(int64_t n, T scale, std::mt19937* gen) {
+  std::uniform_real_distribution<T> dis(-scale, scale);
+  std::vector<T> vec(n);
+  for (T& val : vec) { val = dis(*gen); }
+  return vec;
+}
+
+template<typename T>
+void TestProbAndDiff(const SoftmaxCase& test_case) {
+  const int64_t n = test_case.n;
+  const int64_t w = test_case.w;
+  std::mt19937 gen(static_cast<uint32_t>(n * w));
+  // logits spread over [-50, 50] reach the underflow clamp of exp
+  std::vector<T> in = RandomVector<T>(n * w, 50, &gen);
+  if (w > 1) { in.at(1) = -std::numeric_limits<T>::infinity(); }
+  const std::vector<T> dy = RandomVector<T>(n * w, 1, &gen);
+  std::vector<T> prob(n * w);
+  std::vector<T> dx(n * w);
+  SoftmaxKernelUtil<DeviceType::kCPU, T>::ComputeProb(nullptr, n, w, in.data(), prob.data(),
+                                                      nullptr, 0);
+  SoftmaxKernelUtil<DeviceType::kCPU, T>::ComputeDiff(nullptr, n, w, dy.data(), prob.data(),
+                                                      dx.data(), nullptr, 0);
+  FOR_RANGE(int64_t, i, 0, n) {
+    double max_val = -std::numeric_limits<double>::infinity();
+    FOR_RANGE(int64_t, j, 0, w) { max_val = std::max<double>(max_val, in[i * w + j]); }
+    double sum = 0;
+    FOR_RANGE(int64_t, j, 0, w) { sum += std::exp(in[i * w + j] - max_val); }
+    std::vector<double> ref_prob(w);
+    double dot = 0;
+    FOR_RANGE(int64_t, j, 0, w) {
+      ref_prob[j] = std::exp(in[i * w + j] - max_val) / sum;
+      ASSERT_NEAR(ref_prob[j], prob[i * w + j], 1e-6 * std::max(1.0, ref_prob[j] * w));
+      dot += dy[i * w + j] * ref_prob[j];
+    }
+    FOR_RANGE(int64_t, j, 0, w) {
+      ASSERT_NEAR((dy[i * w + j] - dot) * ref_prob[j], dx[i * w + j], 1e-5);
+    }
+  }
+  // exp(-inf) is exactly 0, not the smallest normal float
+  if (w > 1) { ASSERT_EQ(prob.at(1), 0); }
+  // dx may alias dy
+  std::vector<T> dy_dx(dy);
+  SoftmaxKernelUtil<DeviceType::kCPU, T>::ComputeDiff(nullptr, n, w, dy_dx.data(), prob.data(),
+                                                      dy_dx.data(), nullptr, 0);
+  ASSERT_EQ(dy_dx, dx);
+}
+
+template<typename T>
+void TestNaNPropagates(const SoftmaxCase& test_case) {
+  const int64_t n = test_case.n;
+  const int64_t w = test_case.w;
+  std::mt19937 gen(static_cast<uint32_t>(n * w));
+  std::vector<T> in = RandomVector<T>(n * w, 50, &gen);
+  // a NaN with the sign bit set, which a clamp on the bits would turn into a finite value
+  in.at(w - 1) = -std::numeric_limits<T>::quiet_NaN();
+  ASSERT_TRUE(std::signbit(in.at(w - 1)));
+  std::vector<T> prob(n * w);
+  SoftmaxKernelUtil<DeviceType::kCPU, T>::ComputeProb(nullptr, n, w, in.data(), prob.data(),
+                                                      nullptr, 0);
+  FOR_RANGE(int64_t, j, 0, w) { ASSERT_TRUE(std::isnan(prob.at(j))) << j; }
+}
+
+}  // namespace
+
+TEST(SoftmaxKernelUtil, prob_and_diff) {
+  for (const SoftmaxCase& test_case : TestCases()) {
+    TestProbAndDiff<float>(test_case);
+    TestProbAndDiff<double>(test_case);
+  }
+}
+
+TEST(SoftmaxKernelUtil, nan_propagates) {
+  for (const SoftmaxCase& test_case : TestCases()) {
+    TestNaNPropagates<float>(test_case);
+    TestNaNPropagates<double>(test_case);
+  }
+}
+
+class SoftmaxKernelUtilMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(SoftmaxKernelUtilMultiThread, prob_and_diff) {
+  for (const SoftmaxCase& test_case : TestCases()) {
+    TestProbAndDiff<float>(test_case);
+    TestProbAndDiff<double>(test_case);
+  }
+}
+
+}  // namespace oneflow
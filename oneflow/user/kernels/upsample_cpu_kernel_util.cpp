@@ -0,0 +1,352 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+int64_t RowGrain(int64_t elem_cnt_per_row) {
+  return std::max<int64_t>(kElemwiseParallelForGrain / std::max<int64_t>(elem_cnt_per_row, 1), 1);
+}
+
+// The source pixels along one axis. Output index o reads input indices lo[o] and hi[o] with the
+// weights 1 - lerp[o] and lerp[o], nearest only reads lo[o]. The output indices reading input
+// index i are [begin[i], end[i]), a contiguous range since lo and hi never decrease and hi is
+// at most lo + 1.
+template<typename T>
+struct UpsampleAxis {
+  std::vector<int64_t> lo;
+  std::vector<int64_t> hi;
+  std::vector<T> lerp;
+  std::vector<int64_t> begin;
+  std::vector<int64_t> end;
+
+  T Weight(int64_t o, int64_t i) const {
+    const T zero = static_cast<T>(0);
+    return (lo[o] == i ? 1 - lerp[o] : zero) + (hi[o] == i ? lerp[o] : zero);
+  }
+};
+
+template<typename T>
+void InitReaderRanges(int64_t in_size, UpsampleAxis<T>* axis) {
+  const int64_t out_size = axis->lo.size();
+  axis->begin.resize(in_size);
+  axis->end.resize(in_size);
+  int64_t begin = 0;
+  int64_t end = 0;
+  FOR_RANGE(int64_t, i, 0, in_size) {
+    while (begin < out_size && axis->hi[begin] < i) { ++begin; }
+    while (end < out_size && axis->lo[end] <= i) { ++end; }
+    axis->begin[i] = begin;
+    axis->end[i] = std::max(begin, end);
+  }
+}
+
+// same as GetNearestInputIndex of upsample_kernel.cu
+template<typename T>
+UpsampleAxis<T> NearestAxis(int64_t in_size, int64_t out_size, float scale) {
+  UpsampleAxis<T> axis;
+  axis.lo.resize(out_size);
+  FOR_RANGE(int64_t, o, 0, out_size) {
+    const int64_t src = static_cast<int64_t>(std::floor((static_cast<float>(o) + 0.5f) * scale));
+    axis.lo[o] = std::max<int64_t>(std::min<int64_t>(src, in_size - 1), 0);
+  }
+  axis.hi = axis.lo;
+  axis.lerp.assign(out_size, static_cast<T>(0));
+  InitReaderRanges(in_size, &axis);
+  return axis;
+}
+
+// same as GetBilinearParam of upsample_kernel.cu
+template<typename T>
+UpsampleAxis<T> BilinearAxis(int64_t in_size, int64_t out_size, float scale) {
+  UpsampleAxis<T> axis;
+  axis.lo.resize(out_size);
+  axis.hi.resize(out_size);
+  axis.lerp.resize(out_size);
+  FOR_RANGE(int64_t, o, 0, out_size) {
+    const float src = (static_cast<float>(o) + 0.5f) * scale - 0.5f;
+    axis.lo[o] = src > 0 ? static_cast<int64_t>(std::floor(src)) : 0;
+    axis.hi[o] = src < in_size - 1 ? static_cast<int64_t>(std::ceil(src)) : in_size - 1;
+    axis.lerp[o] = src - std::floor(src);
+  }
+  InitReaderRanges(in_size, &axis);
+  return axis;
+}
+
+// y rows that read the same x rows as the row before them are copied from it, unless they start
+// a chunk and the row before belongs to another task
+template<typename T>
+bool CopyRepeatedRow(const UpsampleAxis<T>& h, int64_t oh, bool is_chunk_begin, int64_t row_size,
+                     T* y_row) {
+  if (is_chunk_begin || oh == 0 || h.lo[oh] != h.lo[oh - 1] || h.hi[oh] != h.hi[oh - 1]
+      || h.lerp[oh] != h.lerp[oh - 1]) {
+    return false;
+  }
+  std::copy(y_row - row_size, y_row, y_row);
+  return true;
+}
+
+template<typename T>
+void NearestForwardChannelsFirst(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                                 const UpsampleAxis<T>& w, const T* x, T* y) {
+  ParallelFor(0, p.batch * p.channels * p.out_h, RowGrain(p.out_w),
+              [&](int64_t item_begin, int64_t item_end) {
+                FOR_RANGE(int64_t, item, item_begin, item_end) {
+                  const int64_t plane = item / p.out_h;
+                  const int64_t oh = item % p.out_h;
+                  T* y_row = y + item * p.out_w;
+                  if (CopyRepeatedRow(h, oh, item == item_begin, p.out_w, y_row)) { continue; }
+                  const T* x_row = x + (plane * p.in_h + h.lo[oh]) * p.in_w;
+                  const int64_t* src = w.lo.data();
+                  FOR_RANGE(int64_t, ow, 0, p.out_w) { y_row[ow] = x_row[src[ow]]; }
+                }
+              });
+}
+
+template<typename T>
+void NearestForwardChannelsLast(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                                const UpsampleAxis<T>& w, const T* x, T* y) {
+  const int64_t c_num = p.channels;
+  const int64_t row_size = p.out_w * c_num;
+  ParallelFor(0, p.batch * p.out_h, RowGrain(row_size), [&](int64_t item_begin, int64_t item_end) {
+    FOR_RANGE(int64_t, item, item_begin, item_end) {
+      const int64_t n = item / p.out_h;
+      const int64_t oh = item % p.out_h;
+      T* y_row = y + item * row_size;
+      if (CopyRepeatedRow(h, oh, item == item_begin, row_size, y_row)) { continue; }
+      const T* x_row = x + (n * p.in_h + h.lo[oh]) * p.in_w * c_num;
+      FOR_RANGE(int64_t, ow, 0, p.out_w) {
+        const T* src = x_row + w.lo[ow] * c_num;
+        std::copy(src, src + c_num, y_row + ow * c_num);
+      }
+    }
+  });
+}
+
+// The horizontally interpolated x rows of one task. Consecutive y rows mostly read the same two
+// x rows, so the two most recent ones are kept.
+template<typename T>
+class BilinearRowCache final {
+ public:
+  BilinearRowCache(const UpsampleCpuParams& p, const UpsampleAxis<T>& w, const T* x)
+      : p_(p), w_(w), x_(x), rows_(2 * p.out_w), keys_{-1, -1} {}
+
+  // the row of x at row_idx = plane * in_h + ih, evicting the row other than keep_idx
+  const T* Get(int64_t row_idx, int64_t keep_idx) {
+    if (keys_[0] == row_idx) { return rows_.data(); }
+    if (keys_[1] == row_idx) { return rows_.data() + p_.out_w; }
+    const int64_t slot = keys_[0] == keep_idx ? 1 : 0;
+    keys_[slot] = row_idx;
+    T* row = rows_.data() + slot * p_.out_w;
+    const T* x_row = x_ + row_idx * p_.in_w;
+    const int64_t* lo = w_.lo.data();
+    const int64_t* hi = w_.hi.data();
+    const T* lerp = w_.lerp.data();
+    FOR_RANGE(int64_t, ow, 0, p_.out_w) {
+      const T left = x_row[lo[ow]];
+      row[ow] = left + (x_row[hi[ow]] - left) * lerp[ow];
+    }
+    return row;
+  }
+
+ private:
+  const UpsampleCpuParams& p_;
+  const UpsampleAxis<T>& w_;
+  const T* x_;
+  std::vector<T> rows_;
+  int64_t keys_[2];
+};
+
+template<typename T>
+void BilinearForwardChannelsFirst(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                                  const UpsampleAxis<T>& w, const T* x, T* y) {
+  ParallelFor(0, p.batch * p.channels * p.out_h, RowGrain(p.out_w),
+              [&](int64_t item_begin, int64_t item_end) {
+                BilinearRowCache<T> cache(p, w, x);
+                FOR_RANGE(int64_t, item, item_begin, item_end) {
+                  const int64_t plane = item / p.out_h;
+                  const int64_t oh = item % p.out_h;
+                  T* y_row = y + item * p.out_w;
+                  if (CopyRepeatedRow(h, oh, item == item_begin, p.out_w, y_row)) { continue; }
+                  const int64_t top_idx = plane * p.in_h + h.lo[oh];
+                  const int64_t bottom_idx = plane * p.in_h + h.hi[oh];
+                  const T* top = cache.Get(top_idx, bottom_idx);
+                  const T* bottom = cache.Get(bottom_idx, top_idx);
+                  const T lerp = h.lerp[oh];
+                  FOR_RANGE(int64_t, ow, 0, p.out_w) {
+                    y_row[ow] = top[ow] + (bottom[ow] - top[ow]) * lerp;
+                  }
+                }
+              });
+}
+
+template<typename T>
+void BilinearForwardChannelsLast(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                                 const UpsampleAxis<T>& w, const T* x, T* y) {
+  const int64_t c_num = p.channels;
+  const int64_t row_size = p.out_w * c_num;
+  ParallelFor(0, p.batch * p.out_h, RowGrain(row_size), [&](int64_t item_begin, int64_t item_end) {
+    FOR_RANGE(int64_t, item, item_begin, item_end) {
+      const int64_t n = item / p.out_h;
+      const int64_t oh = item % p.out_h;
+      T* y_row = y + item * row_size;
+      if (CopyRepeatedRow(h, oh, item == item_begin, row_size, y_row)) { continue; }
+      const T* top = x + (n * p.in_h + h.lo[oh]) * p.in_w * c_num;
+      const T* bottom = x + (n * p.in_h + h.hi[oh]) * p.in_w * c_num;
+      const T h_lerp = h.lerp[oh];
+      FOR_RANGE(int64_t, ow, 0, p.out_w) {
+        const T* top_left = top + w.lo[ow] * c_num;
+        const T* top_right = top + w.hi[ow] * c_num;
+        const T* bottom_left = bottom + w.lo[ow] * c_num;
+        const T* bottom_right = bottom + w.hi[ow] * c_num;
+        const T w_lerp = w.lerp[ow];
+        T* dst = y_row + ow * c_num;
+        FOR_RANGE(int64_t, c, 0, c_num) {
+          const T t = top_left[c] + (top_right[c] - top_left[c]) * w_lerp;
+          const T b = bottom_left[c] + (bottom_right[c] - bottom_left[c]) * w_lerp;
+          dst[c] = t + (b - t) * h_lerp;
+        }
+      }
+    }
+  });
+}
+
+// grain of the backward passes, whose items are dx rows that read out_h / in_h dy rows each
+int64_t BackwardRowGrain(const UpsampleCpuParams& p, int64_t dy_row_size) {
+  return RowGrain(dy_row_size * std::max<int64_t>(p.out_h / std::max<int64_t>(p.in_h, 1), 1));
+}
+
+// Every item is one dx row of one channel: the dy rows reading it are summed with their
+// vertical weights, then the sum is scattered along the row.
+template<typename T, bool is_bilinear>
+void BackwardChannelsFirst(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                           const UpsampleAxis<T>& w, const T* dy, T* dx) {
+  ParallelFor(0, p.batch * p.channels * p.in_h, BackwardRowGrain(p, p.out_w),
+              [&](int64_t item_begin, int64_t item_end) {
+                std::vector<T> col_sum(p.out_w);
+                FOR_RANGE(int64_t, item, item_begin, item_end) {
+                  const int64_t plane = item / p.in_h;
+                  const int64_t ih = item % p.in_h;
+                  T* dx_row = dx + item * p.in_w;
+                  std::fill(dx_row, dx_row + p.in_w, static_cast<T>(0));
+                  if (h.begin[ih] == h.end[ih]) { continue; }
+                  std::fill(col_sum.begin(), col_sum.end(), static_cast<T>(0));
+                  FOR_RANGE(int64_t, oh, h.begin[ih], h.end[ih]) {
+                    const T* dy_row = dy + (plane * p.out_h + oh) * p.out_w;
+                    const T weight = h.Weight(oh, ih);
+                    T* sum = col_sum.data();
+                    FOR_RANGE(int64_t, ow, 0, p.out_w) { sum[ow] += weight * dy_row[ow]; }
+                  }
+                  FOR_RANGE(int64_t, ow, 0, p.out_w) {
+                    if (is_bilinear) {
+                      dx_row[w.lo[ow]] += (1 - w.lerp[ow]) * col_sum[ow];
+                      dx_row[w.hi[ow]] += w.lerp[ow] * col_sum[ow];
+                    } else {
+                      dx_row[w.lo[ow]] += col_sum[ow];
+                    }
+                  }
+                }
+              });
+}
+
+// Every item is one dx row of all channels, the channels of a pixel are contiguous.
+template<typename T, bool is_bilinear>
+void BackwardChannelsLast(const UpsampleCpuParams& p, const UpsampleAxis<T>& h,
+                          const UpsampleAxis<T>& w, const T* dy, T* dx) {
+  const int64_t c_num = p.channels;
+  ParallelFor(
+      0, p.batch * p.in_h, BackwardRowGrain(p, p.out_w * c_num),
+      [&](int64_t item_begin, int64_t item_end) {
+        FOR_RANGE(int64_t, item, item_begin, item_end) {
+          const int64_t n = item / p.in_h;
+          const int64_t ih = item % p.in_h;
+          T* dx_row = dx + item * p.in_w * c_num;
+          std::fill(dx_row, dx_row + p.in_w * c_num, static_cast<T>(0));
+          FOR_RANGE(int64_t, oh, h.begin[ih], h.end[ih]) {
+            const T* dy_row = dy + (n * p.out_h + oh) * p.out_w * c_num;
+            const T weight = h.Weight(oh, ih);
+            FOR_RANGE(int64_t, ow, 0, p.out_w) {
+              const T* src = dy_row + ow * c_num;
+              if (is_bilinear) {
+                const T left_weight = weight * (1 - w.lerp[ow]);
+                const T right_weight = weight * w.lerp[ow];
+                T* left = dx_row + w.lo[ow] * c_num;
+                T* right = dx_row + w.hi[ow] * c_num;
+                FOR_RANGE(int64_t, c, 0, c_num) { left[c] += left_weight * src[c]; }
+                FOR_RANGE(int64_t, c, 0, c_num) { right[c] += right_weight * src[c]; }
+              } else {
+                T* dst = dx_row + w.lo[ow] * c_num;
+                FOR_RANGE(int64_t, c, 0, c_num) { dst[c] += src[c]; }
+              }
+            }
+          }
+        }
+      });
+}
+
+}  // namespace
+
+template<typename T>
+void UpsampleCpuUtil<T>::NearestForward(const UpsampleCpuParams& params, const T* x, T* y) {
+  const UpsampleAxis<T> h = NearestAxis<T>(params.in_h, params.out_h, params.scale_h);
+  const UpsampleAxis<T> w = NearestAxis<T>(params.in_w, params.out_w, params.scale_w);
+  if (params.channels_last) {
+    NearestForwardChannelsLast(params, h, w, x, y);
+  } else {
+    NearestForwardChannelsFirst(params, h, w, x, y);
+  }
+}
+
+template<typename T>
+void UpsampleCpuUtil<T>::NearestBackward(const UpsampleCpuParams& params, const T* dy, T* dx) {
+  const UpsampleAxis<T> h = NearestAxis<T>(params.in_h, params.out_h, params.scale_h);
+  const UpsampleAxis<T> w = NearestAxis<T>(params.in_w, params.out_w, params.scale_w);
+  if (params.channels_last) {
+    BackwardChannelsLast<T, false>(params, h, w, dy, dx);
+  } else {
+    BackwardChannelsFirst<T, false>(params, h, w, dy, dx);
+  }
+}
+
+template<typename T>
+void UpsampleCpuUtil<T>::BilinearForward(const UpsampleCpuParams& params, const T* x, T* y) {
+  const UpsampleAxis<T> h = BilinearAxis<T>(params.in_h, params.out_h, params.scale_h);
+  const UpsampleAxis<T> w = BilinearAxis<T>(params.in_w, params.out_w, params.scale_w);
+  if (params.channels_last) {
+    BilinearForwardChannelsLast(params, h, w, x, y);
+  } else {
+    BilinearForwardChannelsFirst(params, h, w, x, y);
+  }
+}
+
+template<typename T>
+void UpsampleCpuUtil<T>::BilinearBackward(const UpsampleCpuParams& params, const T* dy, T* dx) {
+  const UpsampleAxis<T> h = BilinearAxis<T>(params.in_h, params.out_h, params.scale_h);
+  const UpsampleAxis<T> w = BilinearAxis<T>(params.in_w, params.out_w, params.scale_w);
+  if (params.channels_last) {
+    BackwardChannelsLast<T, true>(params, h, w, dy, dx);
+  } else {
+    BackwardChannelsFirst<T, true>(params, h, w, dy, dx);
+  }
+}
+
+template struct UpsampleCpuUtil<float>;
+template struct UpsampleCpuUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,53 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Shape of an upsample, x is [batch, channels, in_h, in_w] or [batch, in_h, in_w, channels] and
+// y is the same with out_h and out_w.
+struct UpsampleCpuParams {
+  int64_t batch;
+  int64_t channels;
+  int64_t in_h;
+  int64_t in_w;
+  int64_t out_h;
+  int64_t out_w;
+  // 1 / height_scale and 1 / width_scale, the source coordinates are computed in float like the
+  // GPU kernels so that both devices pick the same pixels
+  float scale_h;
+  float scale_w;
+  bool channels_last;
+};
+
+// Nearest and bilinear upsampling on the CPU. The source pixels of every output row and column
+// are looked up once per call. The backward passes are gathers: every task owns whole rows of dx
+// and sums the rows of dy that read them, so they run in parallel without atomics and overwrite
+// dx.
+template<typename T>
+struct UpsampleCpuUtil final {
+  static void NearestForward(const UpsampleCpuParams& params, const T* x, T* y);
+  static void NearestBackward(const UpsampleCpuParams& params, const T* dy, T* dx);
+  static void BilinearForward(const UpsampleCpuParams& params, const T* x, T* y);
+  static void BilinearBackward(const UpsampleCpuParams& params, const T* dy, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,61 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/upsample_cpu_kernel_util_test_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+void BenchmarkRow(const std::string& name, const UpsampleCpuParams& p) {
+  std::vector<float> x(XElemCnt(p), 1.f);
+  std::vector<float> y(YElemCnt(p), 1.f);
+  const int64_t iter_num = std::max<int64_t>(1, 2e7 / YElemCnt(p));
+  std::ostringstream row;
+  row << name << (p.channels_last ? " NHWC" : " NCHW") << ":";
+  for (bool is_bilinear : {false, true}) {
+    for (bool is_backward : {false, true}) {
+      const float* src = is_backward ? y.data() : x.data();
+      float* dst = is_backward ? x.data() : y.data();
+      const double naive_ms = AverageMilliseconds(
+          iter_num, [&]() { NaiveUpsample(p, is_bilinear, is_backward, src, dst); });
+      const double ms =
+          AverageMilliseconds(iter_num, [&]() { Run(p, is_bilinear, is_backward, src, dst); });
+      row << " " << (is_bilinear ? "bilinear" : "nearest") << (is_backward ? " grad " : " ")
+          << naive_ms << " -> " << ms << " ms,";
+    }
+  }
+  LOG(INFO) << row.str();
+}
+
+}  // namespace
+
+TEST(UpsampleCpuUtil, benchmark) {
+  const int32_t thread_num = HardwareThreadNum();
+  ScopedGlobalThreadPool thread_pool(thread_num);
+  LOG(INFO) << "float 2x upsample, element-wise loop -> UpsampleCpuUtil, " << thread_num
+            << " threads";
+  // FPN / U-Net decoder feature maps
+  for (bool channels_last : {false, true}) {
+    BenchmarkRow("1x256x14x14", MakeParams(1, 256, 14, 14, 2.f, 2.f, channels_last));
+    BenchmarkRow("1x256x28x28", MakeParams(1, 256, 28, 28, 2.f, 2.f, channels_last));
+    BenchmarkRow("1x128x64x64", MakeParams(1, 128, 64, 64, 2.f, 2.f, channels_last));
+    BenchmarkRow("8x64x56x56", MakeParams(8, 64, 56, 56, 2.f, 2.f, channels_last));
+    BenchmarkRow("1x3x256x256", MakeParams(1, 3, 256, 256, 2.f, 2.f, channels_last));
+  }
+}
+
+}  // namespace oneflow
@@ -0,0 +1,67 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "oneflow/user/kernels/upsample_cpu_kernel_util_test_util.h"
+#include "oneflow/core/thread/thread_pool_test_util.h"
+
+namespace oneflow {
+
+namespace {
+
+template<typename T>
+void TestCase(const UpsampleCpuParams& p) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<T> dis(-1, 1);
+  std::vector<T> x(XElemCnt(p));
+  std::vector<T> dy(YElemCnt(p));
+  for (T& val : x) { val = dis(gen); }
+  for (T& val : dy) { val = dis(gen); }
+  for (bool is_bilinear : {false, true}) {
+    std::vector<T> y(YElemCnt(p), static_cast<T>(-7));
+    std::vector<T> expected_y(YElemCnt(p));
+    Run(p, is_bilinear, false, x.data(), y.data());
+    NaiveUpsample(p, is_bilinear, false, x.data(), expected_y.data());
+    FOR_RANGE(size_t, i, 0, y.size()) { ASSERT_NEAR(y.at(i), expected_y.at(i), 1e-5) << i; }
+    // dx is overwritten, not accumulated into
+    std::vector<T> dx(XElemCnt(p), static_cast<T>(-7));
+    std::vector<T> expected_dx(XElemCnt(p));
+    Run(p, is_bilinear, true, dy.data(), dx.data());
+    NaiveUpsample(p, is_bilinear, true, dy.data(), expected_dx.data());
+    FOR_RANGE(size_t, i, 0, dx.size()) { ASSERT_NEAR(dx.at(i), expected_dx.at(i), 1e-4) << i; }
+  }
+}
+
+void TestCases() {
+  for (bool channels_last : {false, true}) {
+    TestCase<float>(MakeParams(2, 3, 5, 7, 2.f, 2.f, channels_last));
+    TestCase<float>(MakeParams(1, 4, 6, 4, 3.f, 1.f, channels_last));
+    TestCase<float>(MakeParams(2, 2, 4, 9, 1.f, 2.f, channels_last));
+    // the scales do not divide the output, some x rows are skipped by nearest
+    TestCase<float>(MakeParams(1, 3, 7, 6, 1.5f, 2.5f, channels_last));
+    TestCase<float>(MakeParams(3, 1, 1, 1, 4.f, 4.f, channels_last));
+    TestCase<double>(MakeParams(2, 5, 8, 8, 2.f, 2.f, channels_last));
+  }
+}
+
+}  // namespace
+
+TEST(UpsampleCpuUtil, forward_backward) { TestCases(); }
+
+class UpsampleCpuUtilMultiThread : public GlobalThreadPoolTest {};
+
+TEST_F(UpsampleCpuUtilMultiThread, forward_backward) { TestCases(); }
+
+}  // namespace oneflow
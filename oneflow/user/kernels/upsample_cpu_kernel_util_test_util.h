@@ -0,0 +1,128 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_TEST_UTIL_H_
+#define ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_TEST_UTIL_H_
+
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+
+namespace oneflow {
+
+// helpers shared by the upsample_cpu_kernel_util test and benchmark
+
+inline UpsampleCpuParams MakeParams(int64_t batch, int64_t channels, int64_t h, int64_t w,
+                                    float height_scale, float width_scale, bool channels_last) {
+  UpsampleCpuParams params;
+  params.batch = batch;
+  params.channels = channels;
+  params.in_h = h;
+  params.in_w = w;
+  params.out_h = static_cast<int32_t>(height_scale) * h;
+  params.out_w = static_cast<int32_t>(width_scale) * w;
+  params.scale_h = 1.f / height_scale;
+  params.scale_w = 1.f / width_scale;
+  params.channels_last = channels_last;
+  return params;
+}
+
+inline int64_t XElemCnt(const UpsampleCpuParams& p) {
+  return p.batch * p.channels * p.in_h * p.in_w;
+}
+
+inline int64_t YElemCnt(const UpsampleCpuParams& p) {
+  return p.batch * p.channels * p.out_h * p.out_w;
+}
+
+inline int64_t Offset(const UpsampleCpuParams& p, int64_t n, int64_t c, int64_t h, int64_t h_num,
+                      int64_t w, int64_t w_num) {
+  return p.channels_last ? ((n * h_num + h) * w_num + w) * p.channels + c
+                         : ((n * p.channels + c) * h_num + h) * w_num + w;
+}
+
+// One output element at a time like the GPU kernels, the backward scatters into dx.
+template<typename T>
+void NaiveUpsample(const UpsampleCpuParams& p, bool is_bilinear, bool is_backward, const T* src,
+                   T* dst) {
+  if (is_backward) { std::fill(dst, dst + XElemCnt(p), static_cast<T>(0)); }
+  FOR_RANGE(int64_t, n, 0, p.batch) {
+    FOR_RANGE(int64_t, c, 0, p.channels) {
+      FOR_RANGE(int64_t, oh, 0, p.out_h) {
+        FOR_RANGE(int64_t, ow, 0, p.out_w) {
+          const int64_t y_offset = Offset(p, n, c, oh, p.out_h, ow, p.out_w);
+          auto X = [&](int64_t ih, int64_t iw) { return Offset(p, n, c, ih, p.in_h, iw, p.in_w); };
+          if (!is_bilinear) {
+            const int64_t ih = std::max<int64_t>(
+                std::min<int64_t>(std::floor((static_cast<float>(oh) + 0.5f) * p.scale_h),
+                                  p.in_h - 1),
+                0);
+            const int64_t iw = std::max<int64_t>(
+                std::min<int64_t>(std::floor((static_cast<float>(ow) + 0.5f) * p.scale_w),
+                                  p.in_w - 1),
+                0);
+            if (is_backward) {
+              dst[X(ih, iw)] += src[y_offset];
+            } else {
+              dst[y_offset] = src[X(ih, iw)];
+            }
+            continue;
+          }
+          const float in_h = (static_cast<float>(oh) + 0.5f) * p.scale_h - 0.5f;
+          const float in_w = (static_cast<float>(ow) + 0.5f) * p.scale_w - 0.5f;
+          const int64_t top = in_h > 0 ? std::floor(in_h) : 0;
+          const int64_t bottom = in_h < p.in_h - 1 ? std::ceil(in_h) : p.in_h - 1;
+          const T h_lerp = in_h - std::floor(in_h);
+          const int64_t left = in_w > 0 ? std::floor(in_w) : 0;
+          const int64_t right = in_w < p.in_w - 1 ? std::ceil(in_w) : p.in_w - 1;
+          const T w_lerp = in_w - std::floor(in_w);
+          if (is_backward) {
+            const T dy = src[y_offset];
+            const T dbottom = h_lerp * dy;
+            const T dtop = dy - dbottom;
+            dst[X(top, left)] += (1 - w_lerp) * dtop;
+            dst[X(top, right)] += w_lerp * dtop;
+            dst[X(bottom, left)] += (1 - w_lerp) * dbottom;
+            dst[X(bottom, right)] += w_lerp * dbottom;
+          } else {
+            const T t = src[X(top, left)] + (src[X(top, right)] - src[X(top, left)]) * w_lerp;
+            const T b =
+                src[X(bottom, left)] + (src[X(bottom, right)] - src[X(bottom, left)]) * w_lerp;
+            dst[y_offset] = t + (b - t) * h_lerp;
+          }
+        }
+      }
+    }
+  }
+}
+
+template<typename T>
+void Run(const UpsampleCpuParams& p, bool is_bilinear, bool is_backward, const T* src, T* dst) {
+  if (is_bilinear) {
+    if (is_backward) {
+      UpsampleCpuUtil<T>::BilinearBackward(p, src, dst);
+    } else {
+      UpsampleCpuUtil<T>::BilinearForward(p, src, dst);
+    }
+  } else {
+    if (is_backward) {
+      UpsampleCpuUtil<T>::NearestBackward(p, src, dst);
+    } else {
+      UpsampleCpuUtil<T>::NearestForward(p, src, dst);
+    }
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_TEST_UTIL_H_
@@ -0,0 +1,146 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+UpsampleCpuParams GenUpsampleCpuParams(const user_op::KernelComputeContext* ctx,
+                                       const ShapeView& x_shape, const ShapeView& y_shape) {
+  UpsampleCpuParams params;
+  params.channels_last = ctx->Attr<std::string>("data_format") == "channels_last";
+  const int32_t h_idx = params.channels_last ? 1 : 2;
+  params.batch = x_shape.At(0);
+  params.channels = x_shape.At(params.channels_last ? 3 : 1);
+  params.in_h = x_shape.At(h_idx);
+  params.in_w = x_shape.At(h_idx + 1);
+  params.out_h = y_shape.At(h_idx);
+  params.out_w = y_shape.At(h_idx + 1);
+  params.scale_h = 1.f / ctx->Attr<float>("height_scale");
+  params.scale_w = 1.f / ctx->Attr<float>("width_scale");
+  return params;
+}
+
+}  // namespace
+
+template<typename T>
+class UpsampleNearestCPUKernel final : public user_op::OpKernel {
+ public:
+  UpsampleNearestCPUKernel() = default;
+  ~UpsampleNearestCPUKernel() = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x_blob = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y_blob = ctx->Tensor4ArgNameAndIndex("y", 0);
+    UpsampleCpuUtil<T>::NearestForward(
+        GenUpsampleCpuParams(ctx, x_blob->shape(), y_blob->shape()), x_blob->dptr<T>(),
+        y_blob->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class UpsampleNearestGradCPUKernel final : public user_op::OpKernel {
+ public:
+  UpsampleNearestGradCPUKernel() = default;
+  ~UpsampleNearestGradCPUKernel() = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    user_op::Tensor* dx_blob = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    if (dx_blob == nullptr) { return; }
+    const user_op::Tensor* dy_blob = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    // every element of dx is written, no memset needed
+    UpsampleCpuUtil<T>::NearestBackward(
+        GenUpsampleCpuParams(ctx, dx_blob->shape(), dy_blob->shape()), dy_blob->dptr<T>(),
+        dx_blob->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_UPSAMPLE_NEAREST_CPU_KERNEL(dtype)                                      \
+  REGISTER_USER_KERNEL("upsample")                                                       \
+      .SetCreateFn<UpsampleNearestCPUKernel<dtype>>()                                    \
+      .SetIsMatchedHob(                                                                  \
+          (user_op::HobDeviceTag() == "cpu")                                             \
+          & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)                  \
+          & (user_op::HobAttr<std::string>("interpolation") == std::string("nearest"))); \
+  REGISTER_USER_KERNEL("upsample_grad")                                                  \
+      .SetCreateFn<UpsampleNearestGradCPUKernel<dtype>>()                                \
+      .SetIsMatchedHob(                                                                  \
+          (user_op::HobDeviceTag() == "cpu")                                             \
+          & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)                 \
+          & (user_op::HobAttr<std::string>("interpolation") == std::string("nearest")));
+
+REGISTER_UPSAMPLE_NEAREST_CPU_KERNEL(float)
+REGISTER_UPSAMPLE_NEAREST_CPU_KERNEL(double)
+
+template<typename T>
+class UpsampleBilinearCPUKernel final : public user_op::OpKernel {
+ public:
+  UpsampleBilinearCPUKernel() = default;
+  ~UpsampleBilinearCPUKernel() = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x_blob = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y_blob = ctx->Tensor4ArgNameAndIndex("y", 0);
+    UpsampleCpuUtil<T>::BilinearForward(
+        GenUpsampleCpuParams(ctx, x_blob->shape(), y_blob->shape()), x_blob->dptr<T>(),
+        y_blob->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class UpsampleBilinearGradCPUKernel final : public user_op::OpKernel {
+ public:
+  UpsampleBilinearGradCPUKernel() = default;
+  ~UpsampleBilinearGradCPUKernel() = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    user_op::Tensor* dx_blob = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    if (dx_blob == nullptr) { return; }
+    const user_op::Tensor* dy_blob = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    UpsampleCpuUtil<T>::BilinearBackward(
+        GenUpsampleCpuParams(ctx, dx_blob->shape(), dy_blob->shape()), dy_blob->dptr<T>(),
+        dx_blob->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_UPSAMPLE_BILINEAR_CPU_KERNEL(dtype)                                      \
+  REGISTER_USER_KERNEL("upsample")                                                        \
+      .SetCreateFn<UpsampleBilinearCPUKernel<dtype>>()                                    \
+      .SetIsMatchedHob(                                                                   \
+          (user_op::HobDeviceTag() == "cpu")                                              \
+          & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)                   \
+          & (user_op::HobAttr<std::string>("interpolation") == std::string("bilinear"))); \
+  REGISTER_USER_KERNEL("upsample_grad")                                                   \
+      .SetCreateFn<UpsampleBilinearGradCPUKernel<dtype>>()                                \
+      .SetIsMatchedHob(                                                                   \
+          (user_op::HobDeviceTag() == "cpu")                                              \
+          & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)                  \
+          & (user_op::HobAttr<std::string>("interpolation") == std::string("bilinear")));
+
+REGISTER_UPSAMPLE_BILINEAR_CPU_KERNEL(float)
+REGISTER_UPSAMPLE_BILINEAR_CPU_KERNEL(double)
+
+}  // namespace oneflow
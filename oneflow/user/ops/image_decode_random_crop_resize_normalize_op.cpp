@@ -0,0 +1,115 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/image/image_util.h"
+
+namespace oneflow {
+
+REGISTER_CPU_ONLY_USER_OP("image_decode_random_crop_resize_normalize")
+    .Input("in")
+    .OptionalInput("mirror")
+    .Output("out")
+    .Attr<int64_t>("target_height")
+    .Attr<int64_t>("target_width")
+    .Attr<std::string>("color_space", "BGR")
+    .Attr<std::string>("output_layout", "NCHW")
+    .Attr<std::vector<float>>("mean", {0.0})
+    .Attr<std::vector<float>>("std", {1.0})
+    .Attr<int32_t>("num_attempts", 10)
+    .Attr<int64_t>("seed", -1)
+    .Attr<bool>("has_seed", false)
+    .Attr<std::vector<float>>("random_area", {0.08, 1.0})
+    .Attr<std::vector<float>>("random_aspect_ratio", {0.75, 1.333333})
+    .SetCheckAttrFn([](const user_op::UserOpDefWrapper& def,
+                       const user_op::UserOpConfWrapper& conf) -> Maybe<void> {
+      bool check_failed = false;
+      std::stringstream err;
+      err << "Illegal attr value for " << conf.op_type_name() << " op, op_name: " << conf.op_name();
+      const std::string& color_space = conf.attr<std::string>("color_space");
+      if (color_space != "BGR" && color_space != "RGB" && color_space != "GRAY") {
+        err << ", color_space: " << color_space
+            << " (color_space can only be one of BGR, RGB and GRAY)";
+        check_failed = true;
+      }
+      const std::string& output_layout = conf.attr<std::string>("output_layout");
+      if (output_layout != "NCHW" && output_layout != "NHWC") {
+        err << ", output_layout: " << output_layout
+            << " (output_layout can only be one of NCHW and NHWC)";
+        check_failed = true;
+      }
+      if (conf.attr<int64_t>("target_height") <= 0 || conf.attr<int64_t>("target_width") <= 0) {
+        err << ", target_height: " << conf.attr<int64_t>("target_height")
+            << ", target_width: " << conf.attr<int64_t>("target_width")
+            << " (target size must be positive)";
+        check_failed = true;
+      }
+      const size_t channel_num = ImageUtil::IsColor(color_space) ? 3 : 1;
+      const std::vector<float>& mean_vec = conf.attr<std::vector<float>>("mean");
+      if (mean_vec.size() != 1 && mean_vec.size() != channel_num) {
+        err << ", mean size: " << mean_vec.size() << " (mean must have 1 or " << channel_num
+            << " values)";
+        check_failed = true;
+      }
+      const std::vector<float>& std_vec = conf.attr<std::vector<float>>("std");
+      if (std_vec.size() != 1 && std_vec.size() != channel_num) {
+        err << ", std size: " << std_vec.size() << " (std must have 1 or " << channel_num
+            << " values)";
+        check_failed = true;
+      }
+      for (float elem : std_vec) {
+        if (!(elem > 0)) {
+          err << ", std: " << elem << " (std must be positive)";
+          check_failed = true;
+          break;
+        }
+      }
+      if (check_failed) { return oneflow::Error::CheckFailedError() << err.str(); }
+      return Maybe<void>::Ok();
+    })
+    .SetTensorDescInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
+      const user_op::TensorDesc* in_desc = ctx->TensorDesc4ArgNameAndIndex("in", 0);
+      CHECK_OR_RETURN(in_desc->data_type() == DataType::kTensorBuffer);
+      CHECK_OR_RETURN(in_desc->shape().NumAxes() == 1 && in_desc->shape().At(0) >= 1);
+      const int64_t N = in_desc->shape().At(0);
+      const user_op::TensorDesc* mirror_desc = ctx->TensorDesc4ArgNameAndIndex("mirror", 0);
+      if (mirror_desc) {
+        CHECK_OR_RETURN(mirror_desc->shape().NumAxes() == 1 && mirror_desc->shape().At(0) == N);
+        CHECK_EQ_OR_RETURN(mirror_desc->data_type(), DataType::kInt8);
+      }
+      const int64_t H = ctx->Attr<int64_t>("target_height");
+      const int64_t W = ctx->Attr<int64_t>("target_width");
+      const int64_t C = ImageUtil::IsColor(ctx->Attr<std::string>("color_space")) ? 3 : 1;
+      user_op::TensorDesc* out_desc = ctx->TensorDesc4ArgNameAndIndex("out", 0);
+      if (ctx->Attr<std::string>("output_layout") == "NCHW") {
+        *out_desc->mut_shape() = Shape({N, C, H, W});
+      } else {
+        *out_desc->mut_shape() = Shape({N, H, W, C});
+      }
+      *out_desc->mut_data_type() = DataType::kFloat;
+      return Maybe<void>::Ok();
+    })
+    .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
+      ctx->NewBuilder().Split(ctx->inputs(), 0).Split(ctx->outputs(), 0).Build();
+      return Maybe<void>::Ok();
+    })
+    .SetInputArgModifyFn([](user_op::GetInputArgModifier GetInputArgModifierFn,
+                            const user_op::UserOpConfWrapper&) {
+      user_op::InputArgModifier* in_modifier = GetInputArgModifierFn("in", 0);
+      CHECK_NOTNULL(in_modifier);
+      in_modifier->set_requires_grad(false);
+    });
+
+}  // namespace oneflow
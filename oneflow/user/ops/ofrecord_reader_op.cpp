@@ -25,9 +25,14 @@ REGISTER_CPU_ONLY_USER_OP("OFRecordReader")
     .Attr<std::string>("part_name_prefix", "part-")
     .Attr<int32_t>("part_name_suffix_length", -1)
     .Attr<bool>("random_shuffle", false)
+    .Attr<std::string>("shuffle_mode", "instance")
     .Attr<int64_t>("seed", -1)
     .Attr<int32_t>("shuffle_buffer_size", 1024)
     .Attr<bool>("shuffle_after_epoch", false)
+    .Attr<bool>("use_mmap", false)
+    .Attr<int32_t>("loader_thread_num", 1)
+    .Attr<int32_t>("batch_queue_depth", 4)
+    .Attr<bool>("deterministic", true)
     .SetTensorDescInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
       user_op::TensorDesc* out_tensor = ctx->TensorDesc4ArgNameAndIndex("out", 0);
       int32_t local_batch_size = ctx->Attr<int32_t>("batch_size");
@@ -50,6 +55,13 @@ REGISTER_CPU_ONLY_USER_OP("OFRecordReader")
       user_op::OutputArgModifier* out_modifier = GetOutputArgModifierFn("out", 0);
       CHECK(out_modifier != nullptr);
       out_modifier->set_header_infered_before_compute(false);
+    })
+    .SetCheckAttrFn([](const user_op::UserOpDefWrapper& op_def,
+                       const user_op::UserOpConfWrapper& op_conf) -> Maybe<void> {
+      const std::string& shuffle_mode = op_conf.attr<std::string>("shuffle_mode");
+      CHECK_OR_RETURN(shuffle_mode == "instance" || shuffle_mode == "global")
+          << "shuffle_mode should be instance or global, got " << shuffle_mode;
+      return Maybe<void>::Ok();
     });
 
 }  // namespace oneflow
@@ -61,4 +61,53 @@ REGISTER_CPU_ONLY_USER_OP("onerec_decoder")
       CHECK(out_modifier != nullptr);
       out_modifier->set_header_infered_before_compute(false);
     });
+
+REGISTER_CPU_ONLY_USER_OP("onerec_batch_decoder")
+    .Input("in")
+    .OutputWithMinimum("out", 1)
+    .Attr<std::vector<std::string>>("keys")
+    .Attr<std::vector<DataType>>("data_types")
+    .Attr<std::vector<Shape>>("static_shapes")
+    .Attr<bool>("is_dynamic", false)
+    .SetTensorDescInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
+      user_op::TensorDesc* in_tensor = ctx->TensorDesc4ArgNameAndIndex("in", 0);
+      CHECK_OR_RETURN(in_tensor->data_type() == DataType::kTensorBuffer);
+      CHECK_OR_RETURN(in_tensor->shape().NumAxes() == 1 && in_tensor->shape().At(0) >= 1);
+      const auto& keys = ctx->Attr<std::vector<std::string>>("keys");
+      const auto& data_types = ctx->Attr<std::vector<DataType>>("data_types");
+      const auto& static_shapes = ctx->Attr<std::vector<Shape>>("static_shapes");
+      const int32_t out_size = ctx->user_op_conf().output_size("out");
+      CHECK_EQ_OR_RETURN(static_cast<int32_t>(keys.size()), out_size);
+      CHECK_EQ_OR_RETURN(static_cast<int32_t>(data_types.size()), out_size);
+      CHECK_EQ_OR_RETURN(static_cast<int32_t>(static_shapes.size()), out_size);
+      FOR_RANGE(int32_t, k, 0, out_size) {
+        user_op::TensorDesc* out_tensor = ctx->TensorDesc4ArgNameAndIndex("out", k);
+        const Shape& static_shape = static_shapes.at(k);
+        DimVector dim_vec(1 + static_shape.NumAxes());
+        dim_vec[0] = in_tensor->shape().At(0);
+        FOR_RANGE(int64_t, i, 1, dim_vec.size()) { dim_vec[i] = static_shape.At(i - 1); }
+        *out_tensor->mut_shape() = Shape(dim_vec);
+        *out_tensor->mut_data_type() = data_types.at(k);
+        out_tensor->set_is_dynamic(ctx->Attr<bool>("is_dynamic"));
+      }
+      return Maybe<void>::Ok();
+    })
+    .SetInputArgModifyFn([](user_op::GetInputArgModifier GetInputArgModifierFn,
+                            const user_op::UserOpConfWrapper&) {
+      user_op::InputArgModifier* in_modifier = GetInputArgModifierFn("in", 0);
+      CHECK_NOTNULL(in_modifier);
+      in_modifier->set_requires_grad(false);
+    })
+    .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
+      ctx->NewBuilder().Split(ctx->inputs(), 0).Split(ctx->outputs(), 0).Build();
+      return Maybe<void>::Ok();
+    })
+    .SetOutputArgModifyFn([](user_op::GetOutputArgModifier GetOutputArgModifierFn,
+                             const user_op::UserOpConfWrapper& conf) {
+      FOR_RANGE(int32_t, k, 0, conf.output_size("out")) {
+        user_op::OutputArgModifier* out_modifier = GetOutputArgModifierFn("out", k);
+        CHECK(out_modifier != nullptr);
+        out_modifier->set_header_infered_before_compute(false);
+      }
+    });
 }
@@ -27,6 +27,10 @@ REGISTER_CPU_ONLY_USER_OP("OneRecReader")
     .Attr<int32_t>("shuffle_buffer_size", 1024)
     .Attr<bool>("shuffle_after_epoch", false)
     .Attr<bool>("verify_example", true)
+    .Attr<bool>("verify_checksum", true)
+    .Attr<int32_t>("loader_thread_num", 1)
+    .Attr<int32_t>("batch_queue_depth", 4)
+    .Attr<bool>("deterministic", true)
     .SetTensorDescInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
       user_op::TensorDesc* out_tensor = ctx->TensorDesc4ArgNameAndIndex("out", 0);
       int32_t local_batch_size = ctx->Attr<int32_t>("batch_size");
@@ -42,6 +46,13 @@ REGISTER_CPU_ONLY_USER_OP("OneRecReader")
     .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
       ctx->NewBuilder().Split(ctx->outputs(), 0).Build();
       return Maybe<void>::Ok();
+    })
+    .SetCheckAttrFn([](const user_op::UserOpDefWrapper& op_def,
+                       const user_op::UserOpConfWrapper& op_conf) -> Maybe<void> {
+      const std::string& shuffle_mode = op_conf.attr<std::string>("shuffle_mode");
+      CHECK_OR_RETURN(shuffle_mode == "instance" || shuffle_mode == "global")
+          << "shuffle_mode should be instance or global, got " << shuffle_mode;
+      return Maybe<void>::Ok();
     });
 
 }  // namespace oneflow
@@ -17,6 +17,19 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+// channels_last only has cpu kernels, so it is rejected when the op is placed on gpu
+Maybe<void> CheckDataFormatOfDevice(const user_op::UserOpDefWrapper& op_def,
+                                    const user_op::UserOpConfWrapper& op_conf) {
+  const std::string& data_format = op_conf.attr<std::string>("data_format");
+  CHECK_OR_RETURN(data_format == "channels_first" || op_conf.op_conf().device_tag() != "gpu")
+      << op_conf.op_name() << ": upsample on gpu only supports data_format channels_first";
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
 REGISTER_USER_OP("upsample")
     .Input("x")
     .Output("y")
@@ -29,15 +42,18 @@ REGISTER_USER_OP("upsample")
       user_op::TensorDesc* y_desc = ctx->TensorDesc4ArgNameAndIndex("y", 0);
       const float height_scale = ctx->Attr<float>("height_scale");
       const float width_scale = ctx->Attr<float>("width_scale");
-      if (ctx->Attr<std::string>("data_format") != "channels_first"
-          || x_desc->shape().NumAxes() != 4) {
-        LOG(FATAL) << "upsample only supports NCHW";
-      }
-      *y_desc->mut_shape() = Shape({x_desc->shape().At(0), x_desc->shape().At(1),
-                                    static_cast<int32_t>(height_scale) * x_desc->shape().At(2),
-                                    static_cast<int32_t>(width_scale) * x_desc->shape().At(3)});
+      const std::string& data_format = ctx->Attr<std::string>("data_format");
+      if (x_desc->shape().NumAxes() != 4) { LOG(FATAL) << "upsample only supports 4D input"; }
+      CHECK_OR_RETURN(data_format == "channels_first" || data_format == "channels_last");
+      const int32_t h_idx = data_format == "channels_first" ? 2 : 1;
+      *y_desc->mut_shape() = x_desc->shape();
+      y_desc->mut_shape()->Set(h_idx,
+                               static_cast<int32_t>(height_scale) * x_desc->shape().At(h_idx));
+      y_desc->mut_shape()->Set(h_idx + 1,
+                               static_cast<int32_t>(width_scale) * x_desc->shape().At(h_idx + 1));
       return Maybe<void>::Ok();
     })
+    .SetCheckAttrFn(CheckDataFormatOfDevice)
     .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
       ctx->NewBuilder().Split(user_op::OpArg("x", 0), 0).Split(user_op::OpArg("y", 0), 0).Build();
       return Maybe<void>::Ok();
@@ -55,14 +71,16 @@ REGISTER_USER_OP("upsample_grad")
       Shape* dx_shape = ctx->Shape4ArgNameAndIndex("dx", 0);
       const float height_scale = ctx->Attr<float>("height_scale");
       const float width_scale = ctx->Attr<float>("width_scale");
-      if (ctx->Attr<std::string>("data_format") != "channels_first" || dy_shape->NumAxes() != 4) {
-        LOG(FATAL) << "upsample_nearest only supports NCHW";
-      }
-      *dx_shape = Shape({dy_shape->At(0), dy_shape->At(1),
-                         dy_shape->At(2) / static_cast<int32_t>(height_scale),
-                         dy_shape->At(3) / static_cast<int32_t>(width_scale)});
+      const std::string& data_format = ctx->Attr<std::string>("data_format");
+      if (dy_shape->NumAxes() != 4) { LOG(FATAL) << "upsample_grad only supports 4D input"; }
+      CHECK_OR_RETURN(data_format == "channels_first" || data_format == "channels_last");
+      const int32_t h_idx = data_format == "channels_first" ? 2 : 1;
+      *dx_shape = *dy_shape;
+      dx_shape->Set(h_idx, dy_shape->At(h_idx) / static_cast<int32_t>(height_scale));
+      dx_shape->Set(h_idx + 1, dy_shape->At(h_idx + 1) / static_cast<int32_t>(width_scale));
       return Maybe<void>::Ok();
     })
+    .SetCheckAttrFn(CheckDataFormatOfDevice)
     .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
       ctx->NewBuilder().Split(user_op::OpArg("dy", 0), 0).Split(user_op::OpArg("dx", 0), 0).Build();
       return Maybe<void>::Ok();